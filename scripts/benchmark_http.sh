@@ -0,0 +1,71 @@
+#!/bin/bash -e
+
+# Measures end-to-end latency of the daemon's HTTP endpoint over loopback,
+# with more and more clients uploading at once. Each upload is paced to
+# arrive in real time, like live audio would, unless PACED=false is set.
+# The lag is how long after the end of the audio the final result arrived,
+# which for paced uploads is the delay a live listener would notice.
+#
+# Usage: scripts/benchmark_http.sh <WAV file> [max clients] [requests per client]
+# Start a daemon first, for example:
+# spchcat --serve --http_port=8080 --stream_workers=4 &
+# scripts/benchmark_http.sh audio/4507-16021-0012.wav 32 4
+
+WAV_FILE=${1:?"Usage: $0 <WAV file> [max clients] [requests per client]"}
+MAX_CLIENTS=${2:-$(nproc)}
+REQUESTS=${3:-4}
+URL=${URL:-http://127.0.0.1:8080/transcribe}
+PACED=${PACED:-true}
+
+# The byte rate is a little-endian 32-bit number at offset 28 of the header.
+BYTE_RATE=$(od -An -tu4 -j28 -N4 ${WAV_FILE} | tr -d ' ')
+RATE_ARGS=""
+AUDIO_SECONDS=0
+if [[ ${PACED} = "true" ]]
+then
+  RATE_ARGS="--limit-rate ${BYTE_RATE}"
+  AUDIO_SECONDS=$(awk -v bytes=$(stat -c %s ${WAV_FILE}) -v rate=${BYTE_RATE} \
+    'BEGIN { print bytes / rate }')
+fi
+
+TIMES_FILE=$(mktemp)
+trap "rm -f ${TIMES_FILE}" EXIT
+
+# Prints the given percentile of a column of times from successful requests.
+percentile() {
+  awk -v audio=${AUDIO_SECONDS} '$1 == 200 { print $2, $2 - audio }' \
+    ${TIMES_FILE} | cut -d' ' -f$1 | sort -n | awk -v p=$2 '
+    { times[NR] = $1 }
+    END {
+      index_for_p = int((NR * p + 99) / 100);
+      if (index_for_p < 1) { index_for_p = 1; }
+      if (NR == 0) { print "-"; } else { printf "%.3f", times[index_for_p]; }
+    }'
+}
+
+echo "Sending ${WAV_FILE} to ${URL}"
+printf "%-8s %8s %10s %10s %10s %10s %8s\n" "clients" "requests" \
+  "total p50" "total p95" "lag p50" "lag p95" "errors"
+
+CLIENTS=1
+while [[ ${CLIENTS} -le ${MAX_CLIENTS} ]]
+do
+  : > ${TIMES_FILE}
+  for CLIENT in $(seq ${CLIENTS})
+  do
+    for REQUEST in $(seq ${REQUESTS})
+    do
+      curl -s -o /dev/null ${RATE_ARGS} --data-binary @${WAV_FILE} \
+        -w "%{http_code} %{time_total}\n" ${URL} \
+        >> ${TIMES_FILE} || echo "000 0" >> ${TIMES_FILE}
+    done &
+  done
+  wait
+  SUCCESSES=$(awk '$1 == 200' ${TIMES_FILE} | wc -l)
+  ERRORS=$(awk '$1 != 200' ${TIMES_FILE} | wc -l)
+  printf "%-8d %8d %10s %10s %10s %10s %8d\n" ${CLIENTS} \
+    $((SUCCESSES + ERRORS)) \
+    $(percentile 1 50) $(percentile 1 95) $(percentile 2 50) $(percentile 2 95) \
+    ${ERRORS}
+  CLIENTS=$((CLIENTS * 2))
+done
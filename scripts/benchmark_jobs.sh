@@ -0,0 +1,42 @@
+#!/bin/bash -e
+
+# Compares files-per-second for parallel file transcription, with every
+# --jobs worker loading its own model versus all workers sharing one model.
+#
+# Usage: scripts/benchmark_jobs.sh <folder of WAV files> [max jobs] [spchcat args]
+# For example:
+# scripts/benchmark_jobs.sh ../audio 8 --languages_dir=build/models/
+
+WAV_DIR=${1:?"Usage: $0 <folder of WAV files> [max jobs] [spchcat args]"}
+MAX_JOBS=${2:-$(nproc)}
+shift 2 || shift $#
+SPCHCAT=${SPCHCAT:-./spchcat}
+
+WAV_FILES=$(find ${WAV_DIR} -type f -name '*.wav' | sort)
+FILE_COUNT=$(echo "${WAV_FILES}" | wc -l)
+
+echo "Transcribing ${FILE_COUNT} files from ${WAV_DIR}"
+printf "%-8s %-12s %10s %12s\n" "jobs" "model" "seconds" "files/sec"
+
+JOBS=1
+while [[ ${JOBS} -le ${MAX_JOBS} ]]
+do
+  for SHARED in false true
+  do
+    if [[ ${SHARED} = "true" ]]
+    then
+      MODE="shared"
+    else
+      MODE="per_worker"
+    fi
+    START=$(date +%s.%N)
+    ${SPCHCAT} --jobs=${JOBS} --shared_model=${SHARED} "$@" ${WAV_FILES} > /dev/null
+    END=$(date +%s.%N)
+    awk -v jobs=${JOBS} -v mode=${MODE} -v start=${START} -v end=${END} \
+      -v files=${FILE_COUNT} 'BEGIN {
+        elapsed = end - start;
+        printf "%-8d %-12s %10.2f %12.2f\n", jobs, mode, elapsed, files / elapsed;
+      }'
+  done
+  JOBS=$((JOBS * 2))
+done
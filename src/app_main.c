@@ -1,8 +1,19 @@
 #include "app_main.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include <pulse/simple.h>
 #include <pulse/error.h>
@@ -10,11 +21,48 @@
 #include "coqui-stt.h"
 
 #include "audio_buffer.h"
+#include "audio_ring_buffer.h"
+#include "decode_cadence.h"
+#include "downmix.h"
+#include "file_utils.h"
+#include "job_socket.h"
+#include "http_server.h"
+#include "json_writer.h"
+#include "model_cache.h"
 #include "pa_list_devices.h"
+#include "resampler.h"
 #include "settings.h"
+#include "silence_splitter.h"
+#include "stream_reader.h"
+#include "stream_scheduler.h"
 #include "string_utils.h"
+#include "subtitle_writer.h"
+#include "thread_pool.h"
+#include "time_utils.h"
 #include "trace.h"
+#include "transcript_json.h"
+#include "transcript_renderer.h"
+#include "voice_activity.h"
 #include "wav_io.h"
+#include "word_timing.h"
+
+// How long a stretch of quiet to look for when cutting up files for
+// --split_seconds.
+#define SPLIT_GAP_MS (300)
+
+// How long the daemon waits for a client that's connected to send its job,
+// or for an HTTP client to send its request's headers, so one that never
+// does can't hold up everyone else.
+#define SERVE_RECEIVE_TIMEOUT_SECONDS (5)
+
+// How often the daemon looks for streams that have gone idle, so it can
+// watch their input again, and for finished ones to clean up.
+#define SERVE_POLL_MS (10)
+
+// How much weight the decoding cost measured by earlier steps keeps after
+// each new one, so the estimate used to admit live streams follows changes
+// in load over the last few hundred steps.
+#define SERVE_COST_DECAY (0.99)
 
 static bool load_model(const Settings* settings, ModelState** model_state) {
   const int create_status = STT_CreateModel(settings->model, model_state);
@@ -138,30 +186,77 @@ static char* get_device_name(const char* source) {
   }
 }
 
+static char* plain_text_from_gated_transcript(
+  const CandidateTranscript* transcript, const TranscriptTiming* timing) {
+  TranscriptRenderer* renderer = transcript_renderer_alloc();
+  transcript_renderer_update(renderer, transcript, timing, NULL);
+  char* result = string_builder_duplicate(renderer->text);
+  transcript_renderer_free(renderer);
+  return result;
+}
+
 static char* plain_text_from_transcript(const CandidateTranscript* transcript) {
-  char* result = string_duplicate("");
-  float previous_time = 0.0f;
-  for (int i = 0; i < transcript->num_tokens; ++i) {
-    const TokenMetadata* token = &transcript->tokens[i];
-    const float current_time = token->start_time;
-    const float time_since_previous = current_time - previous_time;
-    if (time_since_previous > 1.0f) {
-      const int result_length = strlen(result);
-      if (result[result_length - 1] == ' ') {
-        result[result_length - 1] = '\n';
-      }
-      else {
-        result = string_append_in_place(result, "\n");
-      }
-      if (strcmp(token->text, " ") != 0) {
-        result = string_append_in_place(result, token->text);
-      }
-    }
-    else {
-      result = string_append_in_place(result, token->text);
-    }
-    previous_time = current_time;
-  }
+  return plain_text_from_gated_transcript(transcript, NULL);
+}
+
+// How many alternative transcripts to ask the decoder for when it finishes.
+// Only JSON output has anywhere to show more than the best one.
+static int final_candidates_count(const Settings* settings) {
+  return settings->json_output ? settings->json_candidate_transcripts : 1;
+}
+
+// True if --format asks for subtitles rather than plain text.
+static bool is_subtitle_output(const Settings* settings) {
+  return (strcmp(settings->format, "text") != 0);
+}
+
+// If `file` is NULL the cues are kept in the writer's text instead.
+static SubtitleWriter* subtitle_writer_from_settings(const Settings* settings,
+  FILE* file) {
+  const SubtitleFormat format = (strcmp(settings->format, "srt") == 0) ?
+    SUBTITLE_FORMAT_SRT : SUBTITLE_FORMAT_VTT;
+  return subtitle_writer_alloc(file, format, settings->cue_max_ms / 1000.0f,
+    settings->cue_max_chars);
+}
+
+static char* subtitles_from_transcript(const Settings* settings,
+  const CandidateTranscript* transcript) {
+  SubtitleWriter* writer = subtitle_writer_from_settings(settings, NULL);
+  subtitle_writer_update(writer, transcript, NULL, true);
+  char* result = string_builder_duplicate(writer->text);
+  subtitle_writer_free(writer);
+  return result;
+}
+
+// True if --show_times asks for a line per word with its times, rather than
+// plain text. JSON output adds the times to its results instead.
+static bool is_word_timing_output(const Settings* settings) {
+  return settings->show_times && !settings->json_output;
+}
+
+static char* word_timings_from_transcript(
+  const CandidateTranscript* transcript) {
+  WordTimingWriter* writer = word_timing_writer_alloc(NULL);
+  word_timing_writer_update(writer, transcript, NULL, true);
+  char* result = string_builder_duplicate(writer->text);
+  word_timing_writer_free(writer);
+  return result;
+}
+
+// Produces one line of JSON holding all the candidate transcripts for a file.
+static char* json_from_file_transcripts(const char* filename,
+  const CandidateTranscript* transcripts, int transcripts_count,
+  bool include_words) {
+  JsonWriter* writer = json_writer_alloc(NULL);
+  json_writer_begin_object(writer);
+  json_writer_key(writer, "file");
+  json_writer_string(writer, filename);
+  transcript_json_write_candidates(writer, transcripts, transcripts_count,
+    NULL, include_words);
+  json_writer_end_object(writer);
+  json_writer_end_line(writer);
+  char* result = string_builder_duplicate(writer->buffer);
+  json_writer_free(writer);
   return result;
 }
 
@@ -203,158 +298,2959 @@ static void print_changed_lines(const char* current_text,
   string_list_free(previous_lines, previous_lines_length);
 }
 
-static void output_streaming_transcript(const Metadata* current_metadata,
-  const Metadata* previous_metadata) {
-  const CandidateTranscript* current_transcript =
-    &current_metadata->transcripts[0];
-  char* current_text = plain_text_from_transcript(current_transcript);
-  char* previous_text;
-  if (previous_metadata == NULL) {
-    previous_text = string_duplicate("");
-  }
-  else {
-    const CandidateTranscript* previous_transcript =
-      &previous_metadata->transcripts[0];
-    previous_text = plain_text_from_transcript(previous_transcript);
-  }
+// One stretch of speech from a single channel, used to merge the transcripts
+// of all the channels in a file into one timeline.
+typedef struct ChannelSegmentStruct {
+  int channel;
+  float start_time;
+  char* text;
+} ChannelSegment;
+
+// State shared between all the workers transcribing files in parallel.
+typedef struct FileJobsStruct {
+  const Settings* settings;
+  // One entry per worker. When the model is shared, every entry points to the
+  // same ModelState and calls into it are serialized by `model_mutex`.
+  ModelState** model_states;
+  bool* owns_model_state;
+  pthread_mutex_t model_mutex;
+  // Results can arrive in any order, so they're held here until all of the
+  // files before them have been written, to keep the output deterministic.
+  pthread_mutex_t output_mutex;
+  char** results;
+  int next_output_index;
+  int jobs_count;
+  // With --split_channels every channel of every file is a separate item, so
+  // the channels of one file can be decoded on different workers at once.
+  // Their segments are gathered here until the last one for a file is done.
+  int* item_files;
+  int* item_channels;
+  ChannelSegment** file_segments;
+  int* file_segments_length;
+  int* file_channels_remaining;
+} FileJobs;
 
-  print_changed_lines(current_text, previous_text, stdout);
+static void lock_shared_model(FileJobs* jobs) {
+  if (jobs->settings->shared_model) {
+    pthread_mutex_lock(&jobs->model_mutex);
+  }
+}
 
-  free(current_text);
-  free(previous_text);
+static void unlock_shared_model(FileJobs* jobs) {
+  if (jobs->settings->shared_model) {
+    pthread_mutex_unlock(&jobs->model_mutex);
+  }
 }
 
-static bool process_file(const Settings* settings, ModelState* model_state,
+static bool check_channel(int32_t channel, int32_t channels,
   const char* filename) {
-  AudioBuffer* buffer = NULL;
-  if (!wav_io_load(filename, &buffer)) {
+  if ((channel < DOWNMIX_ALL_CHANNELS) || (channel >= channels)) {
+    fprintf(stderr, "Channel %d was requested, but '%s' has %d channel%s\n",
+      channel, filename, channels, (channels == 1) ? "" : "s");
     return false;
   }
+  return true;
+}
+
+// Loads a whole file, and converts it to mono at the model's sample rate.
+// Returns NULL if the file couldn't be used.
+static AudioBuffer* load_model_audio(ModelState* model_state,
+  const char* filename, int32_t channel) {
+  AudioBuffer* buffer = NULL;
+  if (!wav_io_load_mapped(filename, &buffer)) {
+    return NULL;
+  }
+  if (!check_channel(channel, buffer->channels, filename)) {
+    audio_buffer_free(buffer);
+    return NULL;
+  }
+  // Mixing down first means the resampler has less work to do.
+  downmix_buffer(buffer, channel);
+  const int32_t model_rate = STT_GetModelSampleRate(model_state);
+  if (buffer->sample_rate != model_rate) {
+    AudioBuffer* resampled = resampler_resample_buffer(buffer, model_rate);
+    audio_buffer_free(buffer);
+    buffer = resampled;
+    if (buffer == NULL) {
+      fprintf(stderr, "Unable to convert '%s' to the model's sample rate\n",
+        filename);
+      return NULL;
+    }
+  }
+  return buffer;
+}
+
+// Loads a whole file and decodes it. Returns NULL if the file couldn't be
+// used.
+static Metadata* decode_file(FileJobs* jobs, ModelState* model_state,
+  const char* filename, int32_t channel, int candidates_count) {
+  AudioBuffer* buffer = load_model_audio(model_state, filename, channel);
+  if (buffer == NULL) {
+    return NULL;
+  }
+  lock_shared_model(jobs);
   Metadata* metadata = STT_SpeechToTextWithMetadata(model_state, buffer->data,
-    buffer->samples_per_channel, 1);
-  output_streaming_transcript(metadata, NULL);
+    buffer->samples_per_channel, candidates_count);
+  unlock_shared_model(jobs);
   audio_buffer_free(buffer);
-  return true;
+  return metadata;
 }
 
-static bool process_files(const Settings* settings, ModelState* model_state) {
-  for (int i = 0; i < settings->files_count; ++i) {
-    if (!process_file(settings, model_state, settings->files[i])) {
-      return false;
+static char* transcribe_file(FileJobs* jobs, ModelState* model_state,
+  const char* filename) {
+  const Settings* settings = jobs->settings;
+  Metadata* metadata = decode_file(jobs, model_state, filename,
+    settings->channel, final_candidates_count(settings));
+  if (metadata == NULL) {
+    return NULL;
+  }
+  char* result;
+  if (settings->json_output) {
+    result = json_from_file_transcripts(filename, metadata->transcripts,
+      metadata->num_transcripts, settings->show_times);
+  }
+  else if (is_subtitle_output(settings)) {
+    result = subtitles_from_transcript(settings, &metadata->transcripts[0]);
+  }
+  else if (is_word_timing_output(settings)) {
+    result = word_timings_from_transcript(&metadata->transcripts[0]);
+  }
+  else {
+    result = plain_text_from_transcript(&metadata->transcripts[0]);
+  }
+  STT_FreeMetadata(metadata);
+  return result;
+}
+
+// Joins the transcripts of consecutive pieces of a recording into one, with
+// each token moved onto the whole recording's timeline using the
+// `start_times` of the pieces, in seconds. A space is added wherever a join
+// would otherwise run two words together. The tokens returned only borrow
+// their text from the originals, so they have to be freed first.
+static TokenMetadata* stitch_transcripts(
+  const CandidateTranscript** transcripts, const float* start_times,
+  int transcripts_length, int* tokens_length) {
+  int max_length = 0;
+  for (int i = 0; i < transcripts_length; ++i) {
+    max_length += transcripts[i]->num_tokens + 1;
+  }
+  TokenMetadata* result = malloc(max_length * sizeof(TokenMetadata));
+  *tokens_length = 0;
+  bool ends_in_word = false;
+  for (int i = 0; i < transcripts_length; ++i) {
+    const CandidateTranscript* transcript = transcripts[i];
+    const float start_time = start_times[i];
+    // Coqui counts timesteps in units of 20ms.
+    const unsigned int start_timestep = lrintf(start_time * 50.0f);
+    for (int j = 0; j < (int)(transcript->num_tokens); ++j) {
+      const TokenMetadata* token = &transcript->tokens[j];
+      const bool is_space = (strcmp(token->text, " ") == 0);
+      const TokenMetadata moved = { token->text,
+        token->timestep + start_timestep, token->start_time + start_time };
+      if ((j == 0) && ends_in_word && !is_space) {
+        // The space takes the time of the word after it, so the gap before
+        // that word still decides whether a new line starts.
+        const TokenMetadata space = { " ", moved.timestep, moved.start_time };
+        memcpy(&result[*tokens_length], &space, sizeof(TokenMetadata));
+        *tokens_length += 1;
+      }
+      memcpy(&result[*tokens_length], &moved, sizeof(TokenMetadata));
+      *tokens_length += 1;
+      ends_in_word = !is_space;
     }
   }
-  return true;
+  return result;
 }
 
-static bool process_live_input(const Settings* settings, ModelState* model_state) {
-  char* device_name = get_device_name(settings->source);
+// Splits one channel's transcript into stretches of speech, using the same
+// pauses that start a new line in the plain text, and adds them to the list.
+static void add_channel_segments(const CandidateTranscript* transcript,
+  int channel, ChannelSegment** segments, int* segments_length) {
+  StringBuilder* text = string_builder_alloc();
+  float start_time = 0.0f;
+  float previous_time = 0.0f;
+  for (int i = 0; i <= (int)(transcript->num_tokens); ++i) {
+    const bool is_end = (i == (int)(transcript->num_tokens));
+    const TokenMetadata* token = is_end ? NULL : &transcript->tokens[i];
+    const bool is_gap = !is_end &&
+      ((token->start_time - previous_time) > TRANSCRIPT_LINE_GAP);
+    if ((is_end || is_gap) && (text->length > 0)) {
+      if (text->data[text->length - 1] == ' ') {
+        string_builder_truncate(text, text->length - 1);
+      }
+      *segments = realloc(*segments,
+        (*segments_length + 1) * sizeof(ChannelSegment));
+      ChannelSegment* segment = &(*segments)[*segments_length];
+      segment->channel = channel;
+      segment->start_time = start_time;
+      segment->text = string_builder_duplicate(text);
+      *segments_length += 1;
+      string_builder_reset(text);
+    }
+    if (is_end) {
+      break;
+    }
+    previous_time = token->start_time;
+    const bool is_space = (strcmp(token->text, " ") == 0);
+    if ((text->length == 0) && is_space) {
+      continue;
+    }
+    if (text->length == 0) {
+      start_time = token->start_time;
+    }
+    string_builder_append(text, token->text);
+  }
+  string_builder_free(text);
+}
 
-  const uint32_t model_rate = STT_GetModelSampleRate(model_state);
-  const pa_sample_spec sample_spec = { PA_SAMPLE_S16LE, model_rate, 1 };
-  int pa_error;
-  pa_simple* source_stream = pa_simple_new(
-    NULL, yargs_app_name(), PA_STREAM_RECORD, device_name, yargs_app_name(),
-    &sample_spec, NULL, NULL, &pa_error);
-  if (source_stream == NULL) {
-    if (device_name == NULL) {
-      fprintf(stderr, "Unable to open default audio input device.\n");
+static int compare_channel_segments(const void* a, const void* b) {
+  const ChannelSegment* segment_a = (const ChannelSegment*)(a);
+  const ChannelSegment* segment_b = (const ChannelSegment*)(b);
+  if (segment_a->start_time != segment_b->start_time) {
+    return (segment_a->start_time < segment_b->start_time) ? -1 : 1;
+  }
+  return segment_a->channel - segment_b->channel;
+}
+
+// Orders the segments from all channels by when they started, and writes
+// them out one per line, each labelled with its channel.
+static char* merge_channel_segments(ChannelSegment* segments,
+  int segments_length) {
+  if (segments_length > 0) {
+    qsort(segments, segments_length, sizeof(ChannelSegment),
+      compare_channel_segments);
+  }
+  StringBuilder* result = string_builder_alloc();
+  for (int i = 0; i < segments_length; ++i) {
+    char* line = string_alloc_sprintf("channel %d: %s\n",
+      segments[i].channel, segments[i].text);
+    string_builder_append(result, line);
+    free(line);
+  }
+  char* result_text = string_builder_duplicate(result);
+  string_builder_free(result);
+  return result_text;
+}
+
+static void channel_segments_free(ChannelSegment* segments,
+  int segments_length) {
+  for (int i = 0; i < segments_length; ++i) {
+    free(segments[i].text);
+  }
+  free(segments);
+}
+
+// True once there's been enough quiet after the last word to end an
+// utterance. Past the `stream_size` soft limit any pause a quarter of
+// `endpoint_silence_ms` will do, and a limit of zero disables the check.
+static bool is_long_pause(const Settings* settings, float silence_ms,
+  float utterance_ms) {
+  if (settings->endpoint_silence_ms <= 0) {
+    return false;
+  }
+  float required_silence_ms = settings->endpoint_silence_ms;
+  if ((settings->stream_size > 0) && (utterance_ms >= settings->stream_size)) {
+    required_silence_ms /= 4.0f;
+  }
+  return (silence_ms >= required_silence_ms);
+}
+
+// A file that's being fed through the decoder a block at a time. A fresh
+// stream is started after each long pause, just like for live input, so the
+// decoder's results and the text kept for them stay the same size no matter
+// how long the recording is.
+typedef struct FileStreamStruct {
+  FileJobs* jobs;
+  ModelState* model_state;
+  StreamingState* streaming_state;
+  int32_t sample_rate;
+  // Samples fed to all streams so far, and how many of those had been fed
+  // when the current stream was created.
+  int64_t samples_fed;
+  int64_t stream_start;
+  TranscriptTiming timing;
+  // Always kept up to date, since it knows when the last word was.
+  TranscriptRenderer* renderer;
+  // How many of the renderer's lines have been written out.
+  int lines_written;
+  // Where lines go, or if that's NULL, where they're collected instead.
+  FILE* output;
+  StringBuilder* collected;
+  SubtitleWriter* subtitles;
+  WordTimingWriter* words;
+  // JSON results are only written once the file is finished, so each
+  // stream's final results are kept until then, with their start times.
+  Metadata** pieces;
+  float* piece_starts;
+  int pieces_length;
+} FileStream;
+
+// Lines in the transcript are only split at long pauses, so once a later line
+// has started the earlier ones won't change any more. This writes out any of
+// those that haven't been seen yet, or all of them when the stream is done.
+static void write_finalized_lines(FileStream* stream, bool is_final) {
+  const TranscriptRenderer* renderer = stream->renderer;
+  if (renderer->text->length == 0) {
+    return;
+  }
+  const int finalized_length =
+    is_final ? renderer->lines_length : (renderer->lines_length - 1);
+  for (int i = stream->lines_written; i < finalized_length; ++i) {
+    const int32_t start = renderer->line_offsets[i];
+    int32_t end = renderer->text->length;
+    if ((i + 1) < renderer->lines_length) {
+      end = renderer->line_offsets[i + 1] - 1;
+    }
+    if (stream->output != NULL) {
+      fprintf(stream->output, "%.*s\n", (int)(end - start),
+        renderer->text->data + start);
+      fflush(stream->output);
     }
     else {
-      fprintf(stderr,
-        "Unable to open audio input device named '%s', from source '%s'.\n",
-        device_name, settings->source);
+      string_builder_append_span(stream->collected,
+        renderer->text->data + start, end - start);
+      string_builder_append_char(stream->collected, '\n');
     }
-    fprintf(stderr, "The command 'pactl list sources' will show available devices.\n");
-    fprintf(stderr, "You can use the contents of the 'Name:' field as the '--source' argument to specify one.\n");
-    free(device_name);
-    return false;
   }
+  if (finalized_length > stream->lines_written) {
+    stream->lines_written = finalized_length;
+  }
+}
 
-  StreamingState* streaming_state = NULL;
-  const int stream_error = STT_CreateStream(model_state, &streaming_state);
+static void file_stream_update(FileStream* stream,
+  const CandidateTranscript* transcript, bool is_final) {
+  transcript_renderer_update(stream->renderer, transcript, &stream->timing,
+    NULL);
+  if (stream->subtitles != NULL) {
+    subtitle_writer_update(stream->subtitles, transcript, &stream->timing,
+      is_final);
+  }
+  else if (stream->words != NULL) {
+    word_timing_writer_update(stream->words, transcript, &stream->timing,
+      is_final);
+  }
+  else if (!stream->jobs->settings->json_output) {
+    write_finalized_lines(stream, is_final);
+  }
+}
+
+static bool file_stream_start(FileStream* stream) {
+  lock_shared_model(stream->jobs);
+  const int stream_error =
+    STT_CreateStream(stream->model_state, &stream->streaming_state);
+  unlock_shared_model(stream->jobs);
   if (stream_error != STT_ERR_OK) {
-    const char* error_message = STT_ErrorCodeToErrorMessage(stream_error);
+    char* error_message = STT_ErrorCodeToErrorMessage(stream_error);
     fprintf(stderr, "STT_CreateStream() failed with '%s'\n", error_message);
-    pa_simple_free(source_stream);
-    free(device_name);
+    free(error_message);
+    stream->streaming_state = NULL;
     return false;
   }
+  stream->stream_start = stream->samples_fed;
+  stream->timing.stream_start =
+    (float)(stream->stream_start) / stream->sample_rate;
+  return true;
+}
 
-  const size_t source_buffer_byte_count = settings->source_buffer_size * 2;
-  int16_t* source_buffer = malloc(source_buffer_byte_count);
+// Ends the current stream and passes on its final results.
+static void file_stream_finish(FileStream* stream) {
+  const Settings* settings = stream->jobs->settings;
+  lock_shared_model(stream->jobs);
+  Metadata* metadata = STT_FinishStreamWithMetadata(stream->streaming_state,
+    settings->json_output ? final_candidates_count(settings) : 1);
+  unlock_shared_model(stream->jobs);
+  stream->streaming_state = NULL;
+  if (settings->json_output) {
+    stream->pieces = realloc(stream->pieces,
+      (stream->pieces_length + 1) * sizeof(Metadata*));
+    stream->piece_starts = realloc(stream->piece_starts,
+      (stream->pieces_length + 1) * sizeof(float));
+    stream->pieces[stream->pieces_length] = metadata;
+    stream->piece_starts[stream->pieces_length] = stream->timing.stream_start;
+    stream->pieces_length += 1;
+  }
+  else {
+    file_stream_update(stream, &metadata->transcripts[0], true);
+    STT_FreeMetadata(metadata);
+  }
+  transcript_renderer_reset(stream->renderer);
+  stream->lines_written = 0;
+}
 
-  AudioBuffer* capture_buffer = NULL;
-  if (settings->stream_capture_file != NULL) {
-    capture_buffer =
-      audio_buffer_alloc(model_rate, settings->stream_capture_duration, 1);
+// How long it's been since the last word in the current stream, or since
+// the stream started if nothing's been recognized yet.
+static float file_stream_silence_ms(const FileStream* stream) {
+  const float fed_time = (float)(stream->samples_fed) / stream->sample_rate;
+  float last_time;
+  if (!transcript_renderer_last_word_time(stream->renderer, &last_time)) {
+    last_time = stream->timing.stream_start;
   }
-  int stream_capture_offset = 0;
+  return (fed_time - last_time) * 1000.0f;
+}
 
-  Metadata* previous_metadata = NULL;
-  while (true) {
-    int read_error;
-    const int read_result = pa_simple_read(source_stream, source_buffer,
-      source_buffer_byte_count, &read_error);
-    if (read_result < 0) {
-      fprintf(stderr, "pa_simple_read() failed with '%s'.\n",
-        pa_strerror(read_error));
-      break;
+// Produces the file's JSON results from every stream's final ones. If the
+// file needed more than one stream, their best transcripts are joined, since
+// alternatives for each piece can't be combined into alternatives for the
+// whole file.
+static char* file_stream_json(const FileStream* stream,
+  const char* filename) {
+  const bool include_words = stream->jobs->settings->show_times;
+  if (stream->pieces_length == 1) {
+    return json_from_file_transcripts(filename,
+      stream->pieces[0]->transcripts, stream->pieces[0]->num_transcripts,
+      include_words);
+  }
+  const CandidateTranscript** transcripts =
+    malloc(stream->pieces_length * sizeof(CandidateTranscript*));
+  // Confidences are log probabilities, so the pieces' ones add up.
+  double confidence = 0.0;
+  for (int i = 0; i < stream->pieces_length; ++i) {
+    transcripts[i] = &stream->pieces[i]->transcripts[0];
+    confidence += transcripts[i]->confidence;
+  }
+  int tokens_length;
+  TokenMetadata* tokens = stitch_transcripts(transcripts,
+    stream->piece_starts, stream->pieces_length, &tokens_length);
+  const CandidateTranscript stitched = { tokens, tokens_length, confidence };
+  char* result =
+    json_from_file_transcripts(filename, &stitched, 1, include_words);
+  free(tokens);
+  free(transcripts);
+  return result;
+}
+
+// Reads the file a block at a time and feeds it through a stream, so memory
+// use stays the same no matter how long the recording is, and text starts
+// appearing before the whole file has been processed.
+static char* transcribe_file_streaming(FileJobs* jobs, ModelState* model_state,
+  const char* filename, FILE* output) {
+  WavReader* reader = NULL;
+  if (!wav_io_open(filename, &reader)) {
+    return NULL;
+  }
+  if (!check_channel(jobs->settings->channel, reader->channels, filename)) {
+    wav_io_close(reader);
+    return NULL;
+  }
+
+  // Files at a different rate than the model expects are converted a block
+  // at a time as they're read.
+  const int32_t model_rate = STT_GetModelSampleRate(model_state);
+  const int32_t block_size = jobs->settings->file_buffer_size;
+  Resampler* resampler = NULL;
+  int16_t* resampled = NULL;
+  if (reader->sample_rate != model_rate) {
+    resampler = resampler_alloc(reader->sample_rate, model_rate, 1);
+    if (resampler == NULL) {
+      wav_io_close(reader);
+      return NULL;
     }
-    if (capture_buffer != NULL) {
-      if ((stream_capture_offset + settings->source_buffer_size) > settings->stream_capture_duration) {
+    resampled =
+      malloc(resampler_max_output(resampler, block_size) * sizeof(int16_t));
+  }
+
+  FileStream stream;
+  memset(&stream, 0, sizeof(stream));
+  stream.jobs = jobs;
+  stream.model_state = model_state;
+  stream.sample_rate = model_rate;
+  if (!file_stream_start(&stream)) {
+    resampler_free(resampler);
+    free(resampled);
+    wav_io_close(reader);
+    return NULL;
+  }
+
+  int16_t* block =
+    malloc((size_t)(block_size) * reader->channels * sizeof(int16_t));
+  stream.renderer = transcript_renderer_alloc();
+  stream.output = output;
+  stream.collected = string_builder_alloc();
+  // Subtitle cues are written in place of lines, as soon as they're settled.
+  stream.subtitles = is_subtitle_output(jobs->settings) ?
+    subtitle_writer_from_settings(jobs->settings, output) : NULL;
+  stream.words = is_word_timing_output(jobs->settings) ?
+    word_timing_writer_alloc(output) : NULL;
+  DecodeCadence* cadence = decode_cadence_alloc(model_rate,
+    jobs->settings->decode_interval_ms, jobs->settings->adaptive_decode);
+  bool status = true;
+  bool is_finished = false;
+  while (!is_finished) {
+    int32_t samples_read = wav_io_read(reader, block, block_size);
+    is_finished = (samples_read == 0);
+    downmix_to_mono(block, samples_read, reader->channels,
+      jobs->settings->channel, block);
+    const int16_t* samples = block;
+    if (resampler != NULL) {
+      if (is_finished) {
+        samples_read = resampler_flush(resampler, resampled);
+      }
+      else {
+        samples_read = resampler_process(resampler, block, samples_read,
+          resampled);
+      }
+      samples = resampled;
+    }
+    if (samples_read == 0) {
+      continue;
+    }
+    lock_shared_model(jobs);
+    STT_FeedAudioContent(stream.streaming_state, samples, samples_read);
+    unlock_shared_model(jobs);
+    stream.samples_fed += samples_read;
+    decode_cadence_add_samples(cadence, samples_read);
+    if (!decode_cadence_should_decode(cadence)) {
+      continue;
+    }
+    lock_shared_model(jobs);
+    const double start_ms = time_now_ms();
+    Metadata* metadata =
+      STT_IntermediateDecodeWithMetadata(stream.streaming_state, 1);
+    decode_cadence_record_decode(cadence, time_now_ms() - start_ms);
+    unlock_shared_model(jobs);
+    file_stream_update(&stream, &metadata->transcripts[0], false);
+    STT_FreeMetadata(metadata);
+
+    const float stream_ms =
+      ((stream.samples_fed - stream.stream_start) * 1000.0f) / model_rate;
+    if (is_long_pause(jobs->settings, file_stream_silence_ms(&stream),
+      stream_ms)) {
+      file_stream_finish(&stream);
+      cadence->samples_since_decode = 0;
+      if (!file_stream_start(&stream)) {
+        status = false;
         break;
       }
-      int16_t* current_capture = capture_buffer->data + stream_capture_offset;
-      memcpy(current_capture, source_buffer, source_buffer_byte_count);
-      stream_capture_offset += settings->source_buffer_size;
     }
+  }
 
-    STT_FeedAudioContent(streaming_state, source_buffer,
-      settings->source_buffer_size);
-    Metadata* current_metadata = STT_IntermediateDecodeWithMetadata(streaming_state, 1);
+  char* result_text = NULL;
+  if (status) {
+    file_stream_finish(&stream);
+    if (jobs->settings->json_output) {
+      result_text = file_stream_json(&stream, filename);
+    }
+    else if (stream.subtitles != NULL) {
+      result_text = string_builder_duplicate(stream.subtitles->text);
+    }
+    else if (stream.words != NULL) {
+      result_text = string_builder_duplicate(stream.words->text);
+    }
+    else {
+      result_text = string_builder_duplicate(stream.collected);
+    }
+  }
 
-    output_streaming_transcript(current_metadata, previous_metadata);
+  for (int i = 0; i < stream.pieces_length; ++i) {
+    STT_FreeMetadata(stream.pieces[i]);
+  }
+  free(stream.pieces);
+  free(stream.piece_starts);
+  string_builder_free(stream.collected);
+  subtitle_writer_free(stream.subtitles);
+  word_timing_writer_free(stream.words);
+  transcript_renderer_free(stream.renderer);
+  decode_cadence_free(cadence);
+  resampler_free(resampler);
+  free(resampled);
+  free(block);
+  wav_io_close(reader);
+  return result_text;
+}
 
-    if (previous_metadata != NULL) {
-      STT_FreeMetadata(previous_metadata);
+static void output_file_result(FileJobs* jobs, int file_index, char* text) {
+  pthread_mutex_lock(&jobs->output_mutex);
+  jobs->results[file_index] = text;
+  const int files_count = jobs->settings->files_count;
+  while ((jobs->next_output_index < files_count) &&
+    (jobs->results[jobs->next_output_index] != NULL)) {
+    char* next_text = jobs->results[jobs->next_output_index];
+    if (jobs->settings->stream_files || jobs->settings->split_channels ||
+      jobs->settings->json_output || is_subtitle_output(jobs->settings) ||
+      is_word_timing_output(jobs->settings)) {
+      fputs(next_text, stdout);
+    }
+    else {
+      print_changed_lines(next_text, "", stdout);
     }
-    previous_metadata = current_metadata;
+    free(next_text);
+    jobs->results[jobs->next_output_index] = NULL;
+    jobs->next_output_index += 1;
   }
+  pthread_mutex_unlock(&jobs->output_mutex);
+}
 
-  if (capture_buffer != NULL) {
-    wav_io_save(settings->stream_capture_file, capture_buffer);
-    audio_buffer_free(capture_buffer);
+// Workers load their own copy of the model the first time they're used, so
+// that the loading itself also happens in parallel.
+static ModelState* worker_model(FileJobs* jobs, int thread_index) {
+  if (jobs->model_states[thread_index] == NULL) {
+    ModelState* model_state = NULL;
+    if (!load_model(jobs->settings, &model_state)) {
+      return NULL;
+    }
+    jobs->owns_model_state[thread_index] = true;
+    jobs->model_states[thread_index] = model_state;
+    if (!load_scorer(jobs->settings, model_state)) {
+      return NULL;
+    }
   }
+  return jobs->model_states[thread_index];
+}
+
+// One file that's being decoded as several pieces at once.
+typedef struct FileSplitStruct {
+  FileJobs* jobs;
+  const AudioBuffer* buffer;
+  const AudioSegment* segments;
+  Metadata** results;
+} FileSplit;
 
-  if (previous_metadata != NULL) {
-    STT_FreeMetadata(previous_metadata);
+static bool process_file_segment(void* cookie, int thread_index,
+  int segment_index) {
+  FileSplit* split = (FileSplit*)(cookie);
+  ModelState* model_state = worker_model(split->jobs, thread_index);
+  if (model_state == NULL) {
+    return false;
+  }
+  const AudioSegment* segment = &split->segments[segment_index];
+  lock_shared_model(split->jobs);
+  split->results[segment_index] = STT_SpeechToTextWithMetadata(model_state,
+    split->buffer->data + segment->start, segment->length, 1);
+  unlock_shared_model(split->jobs);
+  return (split->results[segment_index] != NULL);
+}
+
+// Cuts a long file into pieces at pauses, decodes the pieces on all the
+// workers at once, and joins the results back together, so that a single
+// recording can make use of every core.
+static char* transcribe_file_split(FileJobs* jobs, ModelState* model_state,
+  const char* filename) {
+  AudioBuffer* buffer =
+    load_model_audio(model_state, filename, jobs->settings->channel);
+  if (buffer == NULL) {
+    return NULL;
+  }
+  const int32_t sample_rate = buffer->sample_rate;
+  AudioSegment* segments = NULL;
+  int segments_length = 0;
+  silence_splitter_find_segments(buffer->data, buffer->samples_per_channel,
+    jobs->settings->split_seconds * sample_rate,
+    (SPLIT_GAP_MS * sample_rate) / 1000, &segments, &segments_length);
+
+  FileSplit split;
+  split.jobs = jobs;
+  split.buffer = buffer;
+  split.segments = segments;
+  split.results = calloc(segments_length, sizeof(Metadata*));
+  const bool status = thread_pool_run(jobs->jobs_count, segments_length,
+    process_file_segment, &split);
+
+  char* result = NULL;
+  if (status) {
+    const CandidateTranscript** transcripts =
+      malloc(segments_length * sizeof(CandidateTranscript*));
+    float* start_times = malloc(segments_length * sizeof(float));
+    // Confidences are log probabilities, so the pieces' ones add up.
+    double confidence = 0.0;
+    for (int i = 0; i < segments_length; ++i) {
+      transcripts[i] = &split.results[i]->transcripts[0];
+      start_times[i] = (float)(segments[i].start) / sample_rate;
+      confidence += transcripts[i]->confidence;
+    }
+    int tokens_length;
+    TokenMetadata* tokens = stitch_transcripts(transcripts, start_times,
+      segments_length, &tokens_length);
+    const CandidateTranscript stitched = { tokens, tokens_length, confidence };
+    // Alternatives for each piece can't be combined into alternatives for
+    // the whole file, so only the best transcript is given.
+    if (jobs->settings->json_output) {
+      result = json_from_file_transcripts(filename, &stitched, 1,
+        jobs->settings->show_times);
+    }
+    else if (is_subtitle_output(jobs->settings)) {
+      result = subtitles_from_transcript(jobs->settings, &stitched);
+    }
+    else if (is_word_timing_output(jobs->settings)) {
+      result = word_timings_from_transcript(&stitched);
+    }
+    else {
+      result = plain_text_from_transcript(&stitched);
+    }
+    free(tokens);
+    free(start_times);
+    free(transcripts);
+  }
+
+  for (int i = 0; i < segments_length; ++i) {
+    STT_FreeMetadata(split.results[i]);
+  }
+  free(split.results);
+  free(segments);
+  audio_buffer_free(buffer);
+  return result;
+}
+
+static bool process_file_channel(void* cookie, int thread_index,
+  int item_index) {
+  FileJobs* jobs = (FileJobs*)(cookie);
+  ModelState* model_state = worker_model(jobs, thread_index);
+  if (model_state == NULL) {
+    return false;
+  }
+  const int file_index = jobs->item_files[item_index];
+  const int channel = jobs->item_channels[item_index];
+  const char* filename = jobs->settings->files[file_index];
+  Metadata* metadata = decode_file(jobs, model_state, filename, channel, 1);
+  if (metadata == NULL) {
+    return false;
+  }
+
+  pthread_mutex_lock(&jobs->output_mutex);
+  add_channel_segments(&metadata->transcripts[0], channel,
+    &jobs->file_segments[file_index], &jobs->file_segments_length[file_index]);
+  jobs->file_channels_remaining[file_index] -= 1;
+  const bool is_file_done = (jobs->file_channels_remaining[file_index] == 0);
+  pthread_mutex_unlock(&jobs->output_mutex);
+  STT_FreeMetadata(metadata);
+
+  if (is_file_done) {
+    char* text = merge_channel_segments(jobs->file_segments[file_index],
+      jobs->file_segments_length[file_index]);
+    channel_segments_free(jobs->file_segments[file_index],
+      jobs->file_segments_length[file_index]);
+    jobs->file_segments[file_index] = NULL;
+    jobs->file_segments_length[file_index] = 0;
+    output_file_result(jobs, file_index, text);
   }
-  pa_simple_free(source_stream);
-  free(device_name);
   return true;
 }
 
-static bool process_audio(const Settings* settings, ModelState* model_state) {
-  if (strcmp(settings->source, "file") == 0) {
-    return process_files(settings, model_state);
+static bool process_file(void* cookie, int thread_index, int file_index) {
+  FileJobs* jobs = (FileJobs*)(cookie);
+  const Settings* settings = jobs->settings;
+  ModelState* model_state = worker_model(jobs, thread_index);
+  if (model_state == NULL) {
+    return false;
+  }
+  const char* filename = settings->files[file_index];
+  char* text;
+  if (settings->stream_files) {
+    // Lines can only be written as they arrive if no other files are being
+    // worked on at the same time, otherwise the output order isn't stable.
+    FILE* output = (jobs->jobs_count == 1) ? stdout : NULL;
+    text = transcribe_file_streaming(jobs, model_state, filename, output);
   }
   else {
-    return process_live_input(settings, model_state);
+    text = transcribe_file(jobs, model_state, filename);
   }
+  if (text == NULL) {
+    return false;
+  }
+  output_file_result(jobs, file_index, text);
+  return true;
 }
 
-int app_main(int argc, char** argv) {
-  Settings* settings = settings_init_from_argv(argc, argv);
-  if (settings == NULL) {
-    return 1;
+// Reads the headers of all the files to find out how many channels each one
+// has, and sets up one item for each of them.
+static bool plan_file_channels(FileJobs* jobs, int* items_count) {
+  const int files_count = jobs->settings->files_count;
+  jobs->item_files = NULL;
+  jobs->item_channels = NULL;
+  jobs->file_segments = calloc(files_count, sizeof(ChannelSegment*));
+  jobs->file_segments_length = calloc(files_count, sizeof(int));
+  jobs->file_channels_remaining = calloc(files_count, sizeof(int));
+  *items_count = 0;
+  for (int i = 0; i < files_count; ++i) {
+    WavReader* reader = NULL;
+    if (!wav_io_open(jobs->settings->files[i], &reader)) {
+      return false;
+    }
+    const int channels = reader->channels;
+    wav_io_close(reader);
+    jobs->item_files = realloc(jobs->item_files,
+      (*items_count + channels) * sizeof(int));
+    jobs->item_channels = realloc(jobs->item_channels,
+      (*items_count + channels) * sizeof(int));
+    for (int channel = 0; channel < channels; ++channel) {
+      jobs->item_files[*items_count] = i;
+      jobs->item_channels[*items_count] = channel;
+      *items_count += 1;
+    }
+    jobs->file_channels_remaining[i] = channels;
   }
+  return true;
+}
 
-  ModelState* model_state = NULL;
-  if (!load_model(settings, &model_state)) {
-    return 1;
+static void free_file_channels(FileJobs* jobs) {
+  if (jobs->file_segments != NULL) {
+    for (int i = 0; i < jobs->settings->files_count; ++i) {
+      channel_segments_free(jobs->file_segments[i],
+        jobs->file_segments_length[i]);
+    }
   }
+  free(jobs->file_segments);
+  free(jobs->file_segments_length);
+  free(jobs->file_channels_remaining);
+  free(jobs->item_files);
+  free(jobs->item_channels);
+}
 
-  if (!load_scorer(settings, model_state)) {
+static bool process_files(const Settings* settings, ModelState* model_state) {
+  FileJobs jobs;
+  jobs.settings = settings;
+  jobs.item_files = NULL;
+  jobs.item_channels = NULL;
+  jobs.file_segments = NULL;
+  jobs.file_segments_length = NULL;
+  jobs.file_channels_remaining = NULL;
+
+  int jobs_count = settings->jobs;
+  int items_count = settings->files_count;
+  thread_pool_funcptr process_item = process_file;
+  if (settings->split_channels) {
+    // Each channel is its own item, so --jobs still limits how many models
+    // are loaded, and files with more channels than that are decoded in
+    // batches.
+    if (!plan_file_channels(&jobs, &items_count)) {
+      free_file_channels(&jobs);
+      return false;
+    }
+    process_item = process_file_channel;
+  }
+  if (jobs_count < 1) {
+    jobs_count = 1;
+  }
+
+  jobs.model_states = calloc(jobs_count, sizeof(ModelState*));
+  jobs.owns_model_state = calloc(jobs_count, sizeof(bool));
+  for (int i = 0; i < jobs_count; ++i) {
+    if ((i == 0) || settings->shared_model) {
+      jobs.model_states[i] = model_state;
+    }
+  }
+  pthread_mutex_init(&jobs.model_mutex, NULL);
+  pthread_mutex_init(&jobs.output_mutex, NULL);
+  jobs.results = calloc(settings->files_count, sizeof(char*));
+  jobs.next_output_index = 0;
+  jobs.jobs_count = jobs_count;
+
+  bool status = true;
+  if (settings->split_seconds > 0) {
+    // The workers are all busy with the pieces of one file at a time.
+    for (int i = 0; status && (i < settings->files_count); ++i) {
+      char* text = transcribe_file_split(&jobs, model_state,
+        settings->files[i]);
+      if (text == NULL) {
+        status = false;
+        break;
+      }
+      output_file_result(&jobs, i, text);
+    }
+  }
+  else {
+    status = thread_pool_run(jobs_count, items_count, process_item, &jobs);
+  }
+
+  for (int i = 0; i < settings->files_count; ++i) {
+    free(jobs.results[i]);
+  }
+  free(jobs.results);
+  for (int i = 0; i < jobs_count; ++i) {
+    if (jobs.owns_model_state[i]) {
+      STT_FreeModel(jobs.model_states[i]);
+    }
+  }
+  free(jobs.owns_model_state);
+  free(jobs.model_states);
+  free_file_channels(&jobs);
+  pthread_mutex_destroy(&jobs.output_mutex);
+  pthread_mutex_destroy(&jobs.model_mutex);
+  return status;
+}
+
+// Shared between the capture thread, which reads from PulseAudio into the ring
+// buffer as fast as the audio arrives, and the decoding loop that drains it.
+typedef struct LiveCaptureStruct {
+  pa_simple* source_stream;
+  AudioRingBuffer* ring;
+  int32_t read_size;
+  // Posted by the capture thread whenever new samples are available, so the
+  // decoding loop can sleep while the ring is empty.
+  sem_t data_ready;
+  // Written by the decoding loop to ask the capture thread to exit.
+  bool should_stop;
+  // Written by the capture thread once it's exited, for any reason.
+  bool has_finished;
+} LiveCapture;
+
+static void* capture_thread_main(void* arg) {
+  LiveCapture* capture = (LiveCapture*)(arg);
+  const size_t read_byte_count = capture->read_size * sizeof(int16_t);
+  int16_t* read_buffer = malloc(read_byte_count);
+  while (!__atomic_load_n(&capture->should_stop, __ATOMIC_ACQUIRE)) {
+    int read_error;
+    const int read_result = pa_simple_read(capture->source_stream,
+      read_buffer, read_byte_count, &read_error);
+    if (read_result < 0) {
+      fprintf(stderr, "pa_simple_read() failed with '%s'.\n",
+        pa_strerror(read_error));
+      break;
+    }
+    audio_ring_buffer_write(capture->ring, read_buffer, capture->read_size);
+    sem_post(&capture->data_ready);
+  }
+  free(read_buffer);
+  __atomic_store_n(&capture->has_finished, true, __ATOMIC_RELEASE);
+  sem_post(&capture->data_ready);
+  return NULL;
+}
+
+// Capture is the stage that can't afford to fall behind, so try to give it
+// real-time priority. This usually needs extra permissions, so if it fails
+// we fall back to a normal thread.
+static bool start_capture_thread(LiveCapture* capture, pthread_t* thread) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  struct sched_param param;
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  pthread_attr_setschedparam(&attr, &param);
+  const int realtime_status =
+    pthread_create(thread, &attr, capture_thread_main, capture);
+  pthread_attr_destroy(&attr);
+  if (realtime_status == 0) {
+    return true;
+  }
+  return (pthread_create(thread, NULL, capture_thread_main, capture) == 0);
+}
+
+static void print_pipeline_stats(const AudioRingBuffer* ring,
+  uint32_t sample_rate) {
+  const float ms_per_sample = 1000.0f / sample_rate;
+  const int32_t peak_occupancy =
+    __atomic_load_n(&ring->peak_occupancy, __ATOMIC_RELAXED);
+  const uint64_t overrun_count =
+    __atomic_load_n(&ring->overrun_count, __ATOMIC_RELAXED);
+  const uint64_t overrun_samples =
+    __atomic_load_n(&ring->overrun_samples, __ATOMIC_RELAXED);
+  fprintf(stderr,
+    "Capture ring: %.0fms capacity, %.0fms now, %.0fms peak (%.0f%%), "
+    "%llu overruns dropping %.0fms\n",
+    ring->capacity * ms_per_sample,
+    audio_ring_buffer_occupancy(ring) * ms_per_sample,
+    peak_occupancy * ms_per_sample,
+    (peak_occupancy * 100.0f) / ring->capacity,
+    (unsigned long long)(overrun_count),
+    overrun_samples * ms_per_sample);
+}
+
+// Everything needed to decode live input. A fresh stream is started after
+// each utterance, so decoding doesn't get slower as the session goes on.
+typedef struct LiveDecoderStruct {
+  ModelState* model_state;
+  StreamingState* streaming_state;
+  DecodeCadence* cadence;
+  TranscriptRenderer* renderer;
+  TranscriptTiming timing;
+  // The gating that `timing` maps times back through, if there is any. Its
+  // record of speech before the current stream is dropped as each utterance
+  // ends, so a long session doesn't keep growing it.
+  VoiceActivity* vad;
+  int32_t sample_rate;
+  // Samples fed to all streams so far, and how many of those had been fed
+  // when the current stream was created.
+  int64_t samples_fed;
+  int64_t stream_start;
+  // When someone talks for too long without a pause, a second stream is
+  // started a little before the first one has to end, and fed the same audio,
+  // so it's already got the context it needs when it takes over.
+  StreamingState* next_streaming_state;
+  int64_t next_stream_start;
+  // Where results go, which is normally stdout.
+  FILE* output;
+  // With --json_output results are written here instead of to the terminal.
+  JsonWriter* json;
+  int candidates_count;
+  bool json_words;
+  // With --format=srt or vtt, cues are written here as they're settled.
+  SubtitleWriter* subtitles;
+  // With --show_times, each word's times are written here once it's settled.
+  WordTimingWriter* words;
+} LiveDecoder;
+
+static void live_feed(LiveDecoder* decoder, const int16_t* samples,
+  int32_t count) {
+  STT_FeedAudioContent(decoder->streaming_state, samples, count);
+  if (decoder->next_streaming_state != NULL) {
+    STT_FeedAudioContent(decoder->next_streaming_state, samples, count);
+  }
+  decode_cadence_add_samples(decoder->cadence, count);
+  decoder->samples_fed += count;
+}
+
+// Where the renderer should show live text, which is nowhere when the
+// results are going out in some other form instead.
+static FILE* live_display(const LiveDecoder* decoder) {
+  return ((decoder->json == NULL) && (decoder->subtitles == NULL) &&
+    (decoder->words == NULL)) ? decoder->output : NULL;
+}
+
+// Writes one line of JSON for the current utterance. Partial results are
+// replaced by later ones, until one marked as final arrives.
+static void live_write_json(LiveDecoder* decoder,
+  const CandidateTranscript* transcripts, int transcripts_count,
+  bool is_final) {
+  JsonWriter* writer = decoder->json;
+  json_writer_begin_object(writer);
+  json_writer_key(writer, "final");
+  json_writer_bool(writer, is_final);
+  transcript_json_write_candidates(writer, transcripts, transcripts_count,
+    &decoder->timing, decoder->json_words);
+  json_writer_end_object(writer);
+  json_writer_end_line(writer);
+}
+
+// Runs a partial decode over everything fed so far, times it so the cadence
+// can back off if decoding is falling behind, and shows any changes.
+static void live_intermediate_decode(LiveDecoder* decoder) {
+  const double start_ms = time_now_ms();
+  Metadata* current_metadata =
+    STT_IntermediateDecodeWithMetadata(decoder->streaming_state, 1);
+  decode_cadence_record_decode(decoder->cadence, time_now_ms() - start_ms);
+
+  const bool has_changed = transcript_renderer_update(decoder->renderer,
+    &current_metadata->transcripts[0], &decoder->timing,
+    live_display(decoder));
+  if (has_changed && (decoder->json != NULL)) {
+    live_write_json(decoder, current_metadata->transcripts, 1, false);
+  }
+  if (has_changed && (decoder->subtitles != NULL)) {
+    subtitle_writer_update(decoder->subtitles,
+      &current_metadata->transcripts[0], &decoder->timing, false);
+  }
+  if (has_changed && (decoder->words != NULL)) {
+    word_timing_writer_update(decoder->words,
+      &current_metadata->transcripts[0], &decoder->timing, false);
+  }
+  STT_FreeMetadata(current_metadata);
+}
+
+// Returns how long it's been since the last word in the current stream, or
+// since the stream started if nothing's been recognized yet, so that streams
+// of pure silence get restarted too.
+static float live_silence_ms(const LiveDecoder* decoder, int64_t samples_heard) {
+  const float heard_time = (float)(samples_heard) / decoder->sample_rate;
+  float last_time;
+  if (!transcript_renderer_last_word_time(decoder->renderer, &last_time)) {
+    last_time = transcript_session_time(0.0f, &decoder->timing);
+  }
+  return (heard_time - last_time) * 1000.0f;
+}
+
+// An utterance ends once there's been `endpoint_silence_ms` of silence after
+// the last word. Past the `stream_size` soft limit any pause a quarter that
+// long will do, and past the `extended_stream_size` hard limit the utterance
+// is cut off regardless. The limits are in milliseconds of audio fed to the
+// stream, and zero disables them.
+static bool is_utterance_finished(const Settings* settings, float silence_ms,
+  float utterance_ms) {
+  if ((settings->extended_stream_size > 0) &&
+    (utterance_ms >= settings->extended_stream_size)) {
+    return true;
+  }
+  return is_long_pause(settings, silence_ms, utterance_ms);
+}
+
+static bool live_create_stream(LiveDecoder* decoder,
+  StreamingState** streaming_state) {
+  const int stream_error =
+    STT_CreateStream(decoder->model_state, streaming_state);
+  if (stream_error != STT_ERR_OK) {
+    char* error_message = STT_ErrorCodeToErrorMessage(stream_error);
+    fprintf(stderr, "STT_CreateStream() failed with '%s'\n", error_message);
+    free(error_message);
+    *streaming_state = NULL;
+    return false;
+  }
+  return true;
+}
+
+// Shows the final text for an utterance, and moves on to a new line. The
+// best of the `transcripts` comes first, and the others are only used for
+// JSON output.
+static void live_output_final(LiveDecoder* decoder,
+  const CandidateTranscript* transcripts, int transcripts_count) {
+  transcript_renderer_update(decoder->renderer, &transcripts[0],
+    &decoder->timing, live_display(decoder));
+  if (decoder->subtitles != NULL) {
+    subtitle_writer_update(decoder->subtitles, &transcripts[0],
+      &decoder->timing, true);
+  }
+  if (decoder->words != NULL) {
+    word_timing_writer_update(decoder->words, &transcripts[0],
+      &decoder->timing, true);
+  }
+  if (decoder->renderer->text->length > 0) {
+    if (decoder->json != NULL) {
+      live_write_json(decoder, transcripts, transcripts_count, true);
+    }
+    else if (live_display(decoder) != NULL) {
+      fprintf(decoder->output, "\n");
+      fflush(decoder->output);
+    }
+  }
+  transcript_renderer_reset(decoder->renderer);
+  decoder->cadence->samples_since_decode = 0;
+}
+
+// Finishes the current stream, leaves its final text on screen, and starts a
+// new one for the next utterance.
+static bool live_finish_utterance(LiveDecoder* decoder) {
+  Metadata* final_metadata = STT_FinishStreamWithMetadata(
+    decoder->streaming_state, decoder->candidates_count);
+  decoder->streaming_state = NULL;
+  live_output_final(decoder, final_metadata->transcripts,
+    final_metadata->num_transcripts);
+  STT_FreeMetadata(final_metadata);
+  if (decoder->next_streaming_state != NULL) {
+    STT_FreeStream(decoder->next_streaming_state);
+    decoder->next_streaming_state = NULL;
+  }
+
+  decoder->stream_start = decoder->samples_fed;
+  decoder->timing.stream_start =
+    (float)(decoder->stream_start) / decoder->sample_rate;
+  decoder->timing.hidden_before = 0.0f;
+  // Session times are floats, so they can round to a little before the
+  // stream's start, and a second's margin is kept for them.
+  if (decoder->vad != NULL) {
+    voice_activity_forget_before(decoder->vad,
+      decoder->stream_start - decoder->sample_rate);
+  }
+  return live_create_stream(decoder, &decoder->streaming_state);
+}
+
+// Returns the index of the space token in `transcript` that's closest to
+// `time`, as long as it's within `max_distance` seconds, or -1 otherwise.
+static int find_nearest_space(const CandidateTranscript* transcript,
+  float time, float max_distance) {
+  int result = -1;
+  float best_distance = max_distance;
+  for (int i = 0; i < transcript->num_tokens; ++i) {
+    const TokenMetadata* token = &transcript->tokens[i];
+    if (strcmp(token->text, " ") != 0) {
+      continue;
+    }
+    const float distance = fabsf(token->start_time - time);
+    if (distance <= best_distance) {
+      best_distance = distance;
+      result = i;
+    }
+  }
+  return result;
+}
+
+// Works out where to switch from the tokens of a stream that's ending to the
+// ones from the stream taking over from it, which was started at
+// `overlap_start` seconds into the first and overlaps it until
+// `overlap_end`. The switch happens at a gap between words near the middle
+// of the overlap, where both streams have plenty of context on either side.
+// Sets `current_keep` to the number of tokens to keep from the first stream,
+// and `next_hidden_before` to the time in the second stream before which its
+// tokens should be ignored.
+static void find_handover_point(const CandidateTranscript* current,
+  const CandidateTranscript* next, float overlap_start, float overlap_end,
+  int* current_keep, float* next_hidden_before) {
+  const float overlap_middle = (overlap_start + overlap_end) / 2.0f;
+  const float half_overlap = (overlap_end - overlap_start) / 2.0f;
+  float split_time = overlap_middle;
+  const int current_space =
+    find_nearest_space(current, overlap_middle, half_overlap);
+  if (current_space != -1) {
+    split_time = current->tokens[current_space].start_time;
+  }
+  *current_keep = 0;
+  while ((*current_keep < current->num_tokens) &&
+    (current->tokens[*current_keep].start_time < split_time)) {
+    *current_keep += 1;
+  }
+
+  // The two streams won't agree exactly on where the gap is, so look for the
+  // next stream's own gap nearby, and skip the space token itself.
+  const float next_split_time = split_time - overlap_start;
+  const int next_space = find_nearest_space(next, next_split_time, 0.3f);
+  if (next_space != -1) {
+    *next_hidden_before = next->tokens[next_space].start_time + 0.001f;
+  }
+  else {
+    *next_hidden_before = next_split_time;
+  }
+}
+
+// Finishes the current stream and switches over to the one that's been
+// running alongside it, without losing or repeating words at the join.
+static void live_hand_over(LiveDecoder* decoder) {
+  // Only the best transcript can be cut off at the handover point, so no
+  // alternatives are asked for.
+  Metadata* final_metadata =
+    STT_FinishStreamWithMetadata(decoder->streaming_state, 1);
+  Metadata* next_metadata =
+    STT_IntermediateDecodeWithMetadata(decoder->next_streaming_state, 1);
+  const CandidateTranscript* final_transcript =
+    &final_metadata->transcripts[0];
+
+  const float overlap_start = (float)(decoder->next_stream_start -
+    decoder->stream_start) / decoder->sample_rate;
+  const float overlap_end = (float)(decoder->samples_fed -
+    decoder->stream_start) / decoder->sample_rate;
+  int current_keep;
+  float next_hidden_before;
+  find_handover_point(final_transcript, &next_metadata->transcripts[0],
+    overlap_start, overlap_end, &current_keep, &next_hidden_before);
+
+  CandidateTranscript kept_transcript = {
+    final_transcript->tokens, current_keep, final_transcript->confidence,
+  };
+  live_output_final(decoder, &kept_transcript, 1);
+  STT_FreeMetadata(final_metadata);
+
+  decoder->streaming_state = decoder->next_streaming_state;
+  decoder->next_streaming_state = NULL;
+  decoder->stream_start = decoder->next_stream_start;
+  decoder->timing.stream_start =
+    (float)(decoder->stream_start) / decoder->sample_rate;
+  decoder->timing.hidden_before = next_hidden_before;
+  transcript_renderer_update(decoder->renderer,
+    &next_metadata->transcripts[0], &decoder->timing, live_display(decoder));
+  STT_FreeMetadata(next_metadata);
+}
+
+// Checks whether the speaker has paused for long enough to end the current
+// utterance, or talked for long enough that it's time to switch streams,
+// given `samples_heard` samples of live input so far.
+static bool live_check_endpoint(LiveDecoder* decoder, const Settings* settings,
+  int64_t samples_heard) {
+  if (decoder->samples_fed == decoder->stream_start) {
+    return true;
+  }
+  const float utterance_ms =
+    ((decoder->samples_fed - decoder->stream_start) * 1000.0f) /
+    decoder->sample_rate;
+  const bool can_hand_over = (settings->extended_stream_size > 0) &&
+    (settings->stream_overlap_ms > 0) &&
+    (settings->stream_overlap_ms < settings->extended_stream_size);
+  if (can_hand_over) {
+    if ((decoder->next_streaming_state == NULL) && (utterance_ms >=
+      (settings->extended_stream_size - settings->stream_overlap_ms))) {
+      if (!live_create_stream(decoder, &decoder->next_streaming_state)) {
+        return false;
+      }
+      decoder->next_stream_start = decoder->samples_fed;
+    }
+    if ((decoder->next_streaming_state != NULL) &&
+      (utterance_ms >= settings->extended_stream_size)) {
+      live_hand_over(decoder);
+      return true;
+    }
+  }
+  if (!is_utterance_finished(settings,
+    live_silence_ms(decoder, samples_heard), utterance_ms)) {
+    return true;
+  }
+  // The last decode may have been a while ago, so make sure nothing's been
+  // said since then before cutting the utterance off.
+  if (decoder->cadence->samples_since_decode > 0) {
+    live_intermediate_decode(decoder);
+    if (!is_utterance_finished(settings,
+      live_silence_ms(decoder, samples_heard), utterance_ms)) {
+      return true;
+    }
+  }
+  return live_finish_utterance(decoder);
+}
+
+static void live_decoder_init(LiveDecoder* decoder, const Settings* settings,
+  ModelState* model_state, StreamingState* streaming_state,
+  VoiceActivity* vad, FILE* output) {
+  const uint32_t model_rate = STT_GetModelSampleRate(model_state);
+  decoder->model_state = model_state;
+  decoder->streaming_state = streaming_state;
+  decoder->cadence = decode_cadence_alloc(model_rate,
+    settings->decode_interval_ms, settings->adaptive_decode);
+  decoder->renderer = transcript_renderer_alloc();
+  decoder->timing.stream_start = 0.0f;
+  decoder->timing.hidden_before = 0.0f;
+  decoder->timing.vad = vad;
+  decoder->vad = vad;
+  decoder->sample_rate = model_rate;
+  decoder->samples_fed = 0;
+  decoder->stream_start = 0;
+  decoder->next_streaming_state = NULL;
+  decoder->next_stream_start = 0;
+  decoder->output = output;
+  decoder->json = settings->json_output ? json_writer_alloc(output) : NULL;
+  decoder->candidates_count = final_candidates_count(settings);
+  decoder->json_words = settings->show_times;
+  decoder->subtitles = is_subtitle_output(settings) ?
+    subtitle_writer_from_settings(settings, output) : NULL;
+  decoder->words = is_word_timing_output(settings) ?
+    word_timing_writer_alloc(output) : NULL;
+}
+
+static void live_decoder_release(LiveDecoder* decoder) {
+  json_writer_free(decoder->json);
+  subtitle_writer_free(decoder->subtitles);
+  word_timing_writer_free(decoder->words);
+  transcript_renderer_free(decoder->renderer);
+  if (decoder->streaming_state != NULL) {
+    STT_FreeStream(decoder->streaming_state);
+  }
+  if (decoder->next_streaming_state != NULL) {
+    STT_FreeStream(decoder->next_streaming_state);
+  }
+  decode_cadence_free(decoder->cadence);
+}
+
+// There won't be a pause after the last words when piped input ends, so the
+// current utterance is finished off straight away.
+static void live_finish_input(LiveDecoder* decoder) {
+  if (decoder->streaming_state == NULL) {
+    return;
+  }
+  Metadata* final_metadata = STT_FinishStreamWithMetadata(
+    decoder->streaming_state, decoder->candidates_count);
+  decoder->streaming_state = NULL;
+  live_output_final(decoder, final_metadata->transcripts,
+    final_metadata->num_transcripts);
+  STT_FreeMetadata(final_metadata);
+}
+
+// Passes `count` newly heard samples through voice activity gating, if `vad`
+// is set, into the decoder, then shows any new text and ends the utterance
+// if there's been a long enough pause. `gated_buffer` needs room for
+// voice_activity_max_output() samples.
+static bool live_process(LiveDecoder* decoder, const Settings* settings,
+  const int16_t* samples, int32_t count, VoiceActivity* vad,
+  int16_t* gated_buffer, int64_t* samples_heard) {
+  const int16_t* speech = samples;
+  int32_t speech_count = count;
+  if (vad != NULL) {
+    speech_count = voice_activity_process(vad, samples, count, gated_buffer);
+    speech = gated_buffer;
+  }
+  if (speech_count > 0) {
+    live_feed(decoder, speech, speech_count);
+  }
+  *samples_heard += count;
+  if (decode_cadence_should_decode(decoder->cadence)) {
+    live_intermediate_decode(decoder);
+  }
+  return live_check_endpoint(decoder, settings, *samples_heard);
+}
+
+static bool process_live_input(const Settings* settings, ModelState* model_state) {
+  char* device_name = get_device_name(settings->source);
+
+  const uint32_t model_rate = STT_GetModelSampleRate(model_state);
+  const pa_sample_spec sample_spec = { PA_SAMPLE_S16LE, model_rate, 1 };
+  int pa_error;
+  pa_simple* source_stream = pa_simple_new(
+    NULL, yargs_app_name(), PA_STREAM_RECORD, device_name, yargs_app_name(),
+    &sample_spec, NULL, NULL, &pa_error);
+  if (source_stream == NULL) {
+    if (device_name == NULL) {
+      fprintf(stderr, "Unable to open default audio input device.\n");
+    }
+    else {
+      fprintf(stderr,
+        "Unable to open audio input device named '%s', from source '%s'.\n",
+        device_name, settings->source);
+    }
+    fprintf(stderr, "The command 'pactl list sources' will show available devices.\n");
+    fprintf(stderr, "You can use the contents of the 'Name:' field as the '--source' argument to specify one.\n");
+    free(device_name);
+    return false;
+  }
+
+  StreamingState* streaming_state = NULL;
+  const int stream_error = STT_CreateStream(model_state, &streaming_state);
+  if (stream_error != STT_ERR_OK) {
+    const char* error_message = STT_ErrorCodeToErrorMessage(stream_error);
+    fprintf(stderr, "STT_CreateStream() failed with '%s'\n", error_message);
+    pa_simple_free(source_stream);
+    free(device_name);
+    return false;
+  }
+
+  int32_t ring_size = (model_rate * settings->ring_buffer_ms) / 1000;
+  if (ring_size < settings->source_buffer_size) {
+    ring_size = settings->source_buffer_size;
+  }
+  LiveCapture capture;
+  capture.source_stream = source_stream;
+  capture.ring = audio_ring_buffer_alloc(ring_size);
+  capture.read_size = settings->source_buffer_size;
+  sem_init(&capture.data_ready, 0, 0);
+  capture.should_stop = false;
+  capture.has_finished = false;
+  pthread_t capture_thread;
+  if (!start_capture_thread(&capture, &capture_thread)) {
+    fprintf(stderr, "Unable to start audio capture thread.\n");
+    sem_destroy(&capture.data_ready);
+    audio_ring_buffer_free(capture.ring);
+    STT_FreeStream(streaming_state);
+    pa_simple_free(source_stream);
+    free(device_name);
+    return false;
+  }
+
+  // The decoder takes everything that's built up in the ring each time
+  // around, so if a decode runs long the next feed catches up in one go.
+  const int32_t feed_buffer_size = capture.ring->capacity;
+  int16_t* feed_buffer = malloc(feed_buffer_size * sizeof(int16_t));
+
+  AudioBuffer* capture_buffer = NULL;
+  if (settings->stream_capture_file != NULL) {
+    capture_buffer =
+      audio_buffer_alloc(model_rate, settings->stream_capture_duration, 1);
+  }
+  int stream_capture_offset = 0;
+
+
+  // With voice activity gating, only speech is fed to the decoder, so it has
+  // almost nothing to do while the room is quiet.
+  VoiceActivity* vad = NULL;
+  int16_t* gated_buffer = NULL;
+  if (settings->vad) {
+    vad = voice_activity_alloc(model_rate, settings->vad_preroll_ms,
+      settings->vad_hangover_ms);
+    gated_buffer = malloc(voice_activity_max_output(vad, feed_buffer_size) *
+      sizeof(int16_t));
+  }
+
+  LiveDecoder decoder;
+  live_decoder_init(&decoder, settings, model_state, streaming_state, vad,
+    stdout);
+
+  uint64_t overruns_reported = 0;
+  int64_t samples_heard = 0;
+  bool status = true;
+  while (true) {
+    const int32_t feed_count =
+      audio_ring_buffer_read(capture.ring, feed_buffer, feed_buffer_size);
+    if (feed_count == 0) {
+      if (__atomic_load_n(&capture.has_finished, __ATOMIC_ACQUIRE) &&
+        (audio_ring_buffer_occupancy(capture.ring) == 0)) {
+        break;
+      }
+      sem_wait(&capture.data_ready);
+      continue;
+    }
+
+    if (capture_buffer != NULL) {
+      if ((stream_capture_offset + feed_count) > settings->stream_capture_duration) {
+        break;
+      }
+      int16_t* current_capture = capture_buffer->data + stream_capture_offset;
+      memcpy(current_capture, feed_buffer, feed_count * sizeof(int16_t));
+      stream_capture_offset += feed_count;
+    }
+
+    if (settings->show_pipeline_stats) {
+      const uint64_t overrun_count =
+        __atomic_load_n(&capture.ring->overrun_count, __ATOMIC_RELAXED);
+      if (overrun_count != overruns_reported) {
+        print_pipeline_stats(capture.ring, model_rate);
+        overruns_reported = overrun_count;
+      }
+    }
+
+    if (!live_process(&decoder, settings, feed_buffer, feed_count, vad,
+      gated_buffer, &samples_heard)) {
+      status = false;
+      break;
+    }
+  }
+  // Make sure the last few words show up even if the capture ended between
+  // scheduled decodes.
+  if ((decoder.streaming_state != NULL) &&
+    (decoder.cadence->samples_since_decode > 0)) {
+    live_intermediate_decode(&decoder);
+  }
+
+  __atomic_store_n(&capture.should_stop, true, __ATOMIC_RELEASE);
+  pthread_join(capture_thread, NULL);
+  if (settings->show_pipeline_stats) {
+    print_pipeline_stats(capture.ring, model_rate);
+  }
+
+  if (capture_buffer != NULL) {
+    wav_io_save(settings->stream_capture_file, capture_buffer);
+    audio_buffer_free(capture_buffer);
+  }
+
+  live_decoder_release(&decoder);
+  voice_activity_free(vad);
+  free(gated_buffer);
+  free(feed_buffer);
+  sem_destroy(&capture.data_ready);
+  audio_ring_buffer_free(capture.ring);
+  pa_simple_free(source_stream);
+  free(device_name);
+  return status;
+}
+
+// Decodes audio piped in from another program like live input, but without
+// a capture thread or ring buffer in between. A pipe holds the writer back
+// when decoding falls behind, so nothing is ever dropped, and the samples go
+// from the pipe to the decoder without touching the disk.
+static bool process_stdin_input(const Settings* settings,
+  ModelState* model_state) {
+  StreamingState* streaming_state = NULL;
+  const int stream_error = STT_CreateStream(model_state, &streaming_state);
+  if (stream_error != STT_ERR_OK) {
+    char* error_message = STT_ErrorCodeToErrorMessage(stream_error);
+    fprintf(stderr, "STT_CreateStream() failed with '%s'\n", error_message);
+    free(error_message);
+    return false;
+  }
+
+  const uint32_t model_rate = STT_GetModelSampleRate(model_state);
+  StreamReader* reader = stream_reader_alloc(STDIN_FILENO,
+    settings->raw_sample_rate, settings->raw_channels, model_rate,
+    settings->channel, settings->source_buffer_size);
+
+  // Reads can return a lot of samples at once when the writer is ahead, so
+  // they're split up to keep the decode cadence and endpointing as
+  // responsive as they are for live input.
+  const int32_t feed_size = settings->source_buffer_size;
+  VoiceActivity* vad = NULL;
+  int16_t* gated_buffer = NULL;
+  if (settings->vad) {
+    vad = voice_activity_alloc(model_rate, settings->vad_preroll_ms,
+      settings->vad_hangover_ms);
+    gated_buffer =
+      malloc(voice_activity_max_output(vad, feed_size) * sizeof(int16_t));
+  }
+  LiveDecoder decoder;
+  live_decoder_init(&decoder, settings, model_state, streaming_state, vad,
+    stdout);
+
+  int64_t samples_heard = 0;
+  bool status = true;
+  while (status && !reader->is_finished) {
+    const int16_t* samples;
+    const int32_t count = stream_reader_read(reader, -1, &samples);
+    if (count < 0) {
+      status = false;
+      break;
+    }
+    for (int32_t offset = 0; offset < count; offset += feed_size) {
+      int32_t feed_count = count - offset;
+      if (feed_count > feed_size) {
+        feed_count = feed_size;
+      }
+      if (!live_process(&decoder, settings, samples + offset, feed_count,
+        vad, gated_buffer, &samples_heard)) {
+        status = false;
+        break;
+      }
+    }
+  }
+
+  if (status) {
+    live_finish_input(&decoder);
+  }
+
+  live_decoder_release(&decoder);
+  voice_activity_free(vad);
+  free(gated_buffer);
+  stream_reader_free(reader);
+  return status;
+}
+
+static bool process_audio(const Settings* settings, ModelState* model_state) {
+  if (strcmp(settings->source, "file") == 0) {
+    return process_files(settings, model_state);
+  }
+  else if (strcmp(settings->source, "stdin") == 0) {
+    return process_stdin_input(settings, model_state);
+  }
+  else {
+    return process_live_input(settings, model_state);
+  }
+}
+
+// The settings that decide how a model is loaded and set up, so a client's
+// job can be checked against the model the daemon already has. Files are
+// compared by their full paths, since the client may be in another
+// directory.
+typedef struct ModelOptionsStruct {
+  char* model;
+  char* scorer;
+  char* hot_words;
+  int beam_width;
+  float lm_alpha;
+  float lm_beta;
+} ModelOptions;
+
+static char* full_path(const char* filename) {
+  if (filename == NULL) {
+    return NULL;
+  }
+  char* result = realpath(filename, NULL);
+  if (result == NULL) {
+    result = string_duplicate(filename);
+  }
+  return result;
+}
+
+static void model_options_init(ModelOptions* options,
+  const Settings* settings) {
+  options->model = full_path(settings->model);
+  options->scorer = full_path(settings->scorer);
+  options->hot_words = (settings->hot_words != NULL) ?
+    string_duplicate(settings->hot_words) : NULL;
+  options->beam_width = settings->beam_width;
+  options->lm_alpha = settings->lm_alpha;
+  options->lm_beta = settings->lm_beta;
+}
+
+static void model_options_free(ModelOptions* options) {
+  free(options->model);
+  free(options->scorer);
+  free(options->hot_words);
+}
+
+static bool optional_strings_equal(const char* a, const char* b) {
+  if ((a == NULL) || (b == NULL)) {
+    return (a == b);
+  }
+  return (strcmp(a, b) == 0);
+}
+
+static bool model_options_equal(const ModelOptions* a, const ModelOptions* b) {
+  return optional_strings_equal(a->model, b->model) &&
+    optional_strings_equal(a->scorer, b->scorer) &&
+    optional_strings_equal(a->hot_words, b->hot_words) &&
+    (a->beam_width == b->beam_width) && (a->lm_alpha == b->lm_alpha) &&
+    (a->lm_beta == b->lm_beta);
+}
+
+// Runs one job from a client in a forked child of the daemon. The child
+// shares the model the daemon has already loaded, and reads and writes the
+// client's own standard streams, so the job behaves just as if the client
+// had run it itself. Jobs that need a different model, scorer, or decoder
+// settings are handed back for the client to run. Never returns.
+static void run_socket_job(Settings* daemon_settings, ModelState* model_state,
+  int listen_fd, int connection_fd, SocketJob* job) {
+  close(listen_fd);
+  for (int i = 0; i < 3; ++i) {
+    dup2(job->fds[i], i);
+  }
+  ModelOptions daemon_options;
+  model_options_init(&daemon_options, daemon_settings);
+  // The argument parser only keeps one set of arguments at a time, so the
+  // daemon's are released before the client's are parsed.
+  settings_free(daemon_settings);
+  int status = 1;
+  if (chdir(job->cwd) != 0) {
+    fprintf(stderr, "Couldn't change to directory '%s'\n", job->cwd);
+  }
+  else {
+    Settings* settings = settings_init_from_argv(job->argc, job->argv);
+    if (settings != NULL) {
+      ModelOptions job_options;
+      model_options_init(&job_options, settings);
+      if (model_options_equal(&daemon_options, &job_options)) {
+        status = process_audio(settings, model_state) ? 0 : 1;
+      }
+      else {
+        status = JOB_SOCKET_STATUS_RUN_LOCALLY;
+      }
+      model_options_free(&job_options);
+      settings_free(settings);
+    }
+  }
+  model_options_free(&daemon_options);
+  fflush(stdout);
+  fflush(stderr);
+  job_socket_send_status(connection_fd, status);
+  _exit(status);
+}
+
+// A model the daemon has loaded, with the lock that serializes calls into
+// it, just like with --shared_model. Each language has its own, so streams
+// in different languages can be decoded at the same time.
+typedef struct ServedModelStruct {
+  ModelState* model_state;
+  // The daemon's own model is freed by app_main().
+  bool owns_model_state;
+  pthread_mutex_t mutex;
+} ServedModel;
+
+// Where to load a model in the cache from.
+typedef struct ServedModelFilesStruct {
+  const char* model;
+  const char* scorer;
+} ServedModelFiles;
+
+// Audio being streamed to the daemon, either by a client's stdin with
+// --stream_workers, or as the body of an HTTP request. It's decoded inside
+// the daemon a step at a time, sharing the models and a few worker threads
+// with every other stream.
+typedef struct ServedStreamStruct {
+  // Must come first, so the scheduler's pointer can be cast back to this.
+  SchedulerStream scheduler_stream;
+  int id;
+  const Settings* settings;
+  // The --connect client's connection, or the HTTP request's.
+  int connection_fd;
+  // Only set for --connect clients.
+  SocketJob* job;
+  // Only kept until the stream starts, since it says how long the body is.
+  HttpRequest* request;
+  // HTTP results are gathered in memory, then sent as a chunk after each
+  // step. The response only starts once there's something to send, so that
+  // audio that can't be read can still get an error status. The buffer and
+  // its length are updated by the memory stream whenever it's flushed.
+  bool is_http;
+  bool has_response_started;
+  char* http_buffer;
+  size_t http_buffer_length;
+  FILE* output;
+  // Loading a model can take seconds, so if it isn't in the cache already
+  // the stream waits for the server's loader thread, rather than holding up
+  // the thread accepting connections or a worker. The stream isn't woken
+  // until the loader is done, and `model` is left NULL if that failed. The
+  // input is only read once there's a decoder for it.
+  char* model_filename;
+  char* scorer_filename;
+  ModelCacheEntry* model;
+  struct ServedStreamStruct* next_load;
+  int input_fd;
+  int32_t raw_sample_rate;
+  int32_t raw_channels;
+  bool has_decoder;
+  StreamReader* reader;
+  VoiceActivity* vad;
+  int16_t* gated_buffer;
+  LiveDecoder decoder;
+  int64_t samples_heard;
+  // Set by the last step, once the input has ended and the client has been
+  // told how it went.
+  bool is_done;
+  struct ServedStreamStruct* next;
+} ServedStream;
+
+// An HTTP connection whose request headers are still arriving. They're read
+// as they turn up, between looking after everything else, and the
+// connection is dropped if they haven't all arrived in time.
+typedef struct PendingHttpStruct {
+  int connection_fd;
+  HttpHeadReader* reader;
+  double deadline_ms;
+  struct PendingHttpStruct* next;
+} PendingHttp;
+
+// A --connect client whose job is still arriving, which is read in the same
+// way as HTTP headers.
+typedef struct PendingJobStruct {
+  int connection_fd;
+  JobSocketReader* reader;
+  double deadline_ms;
+  struct PendingJobStruct* next;
+} PendingJob;
+
+typedef struct StreamServerStruct {
+  const Settings* settings;
+  // HTTP requests always get JSON Lines results, but otherwise use the
+  // daemon's settings.
+  Settings http_settings;
+  // Holds the daemon's own model for as long as the server runs, and other
+  // languages' models for as long as there's room in --model_cache_mb.
+  ModelCache* models;
+  ModelCacheEntry* default_model;
+  // Live streams are run before batch ones, and new ones are only admitted
+  // while the workers look able to keep up with them in real time. That's
+  // judged from how long recent steps took to decode each millisecond of
+  // audio. The times are protected by `cost_mutex`, and the counts are only
+  // touched by the thread accepting connections.
+  pthread_mutex_t cost_mutex;
+  double decode_ms;
+  double audio_ms;
+  int live_streams_count;
+  int64_t live_rejections;
+  StreamScheduler* scheduler;
+  // Streams waiting for a model that has to be loaded, in the order they
+  // asked, and the thread that loads them one at a time. Protected by
+  // `loader_mutex`.
+  pthread_t loader_thread;
+  pthread_mutex_t loader_mutex;
+  pthread_cond_t loader_wake;
+  ServedStream* loads_head;
+  ServedStream* loads_tail;
+  bool should_stop_loader;
+  // -1 if there's no HTTP port.
+  int http_fd;
+  // Only touched by the thread accepting connections.
+  PendingHttp* pending_http;
+  int pending_http_count;
+  PendingJob* pending_jobs;
+  int pending_jobs_count;
+  ServedStream* streams;
+  int streams_count;
+  int next_id;
+} StreamServer;
+
+static ServedModel* served_model_alloc(ModelState* model_state,
+  bool owns_model_state) {
+  ServedModel* result = calloc(1, sizeof(ServedModel));
+  result->model_state = model_state;
+  result->owns_model_state = owns_model_state;
+  pthread_mutex_init(&result->mutex, NULL);
+  return result;
+}
+
+// Called by the cache once a model isn't needed any more.
+static void served_model_free(void* cookie, void* value) {
+  ServedModel* model = (ServedModel*)(value);
+  if (model->owns_model_state) {
+    STT_FreeModel(model->model_state);
+  }
+  pthread_mutex_destroy(&model->mutex);
+  free(model);
+}
+
+// How much of the cache's budget a model needs. The size of its files is
+// a good enough guess at how much memory it'll take once it's loaded.
+static int64_t served_model_size(const char* model_filename,
+  const char* scorer_filename) {
+  int64_t result = file_size(model_filename);
+  if (scorer_filename != NULL) {
+    result += file_size(scorer_filename);
+  }
+  return (result > 0) ? result : 0;
+}
+
+static void stream_server_log_models(StreamServer* server) {
+  ModelCacheStats stats;
+  model_cache_get_stats(server->models, &stats);
+  const int64_t lookups = stats.hits + stats.misses;
+  fprintf(stderr, "%d models loaded, using %.0fMB of %.0fMB, "
+    "%.1f%% hit rate\n", stats.entries_count,
+    stats.used_bytes / (1024.0 * 1024.0),
+    stats.budget_bytes / (1024.0 * 1024.0),
+    (lookups > 0) ? ((stats.hits * 100.0) / lookups) : 0.0);
+}
+
+// Called by the cache when a stream needs a model that isn't loaded yet.
+// It's set up with the daemon's settings, apart from the files.
+static bool served_model_load(void* cookie, const char* key, void* load_arg,
+  void** value) {
+  StreamServer* server = (StreamServer*)(cookie);
+  const ServedModelFiles* files = (const ServedModelFiles*)(load_arg);
+  Settings settings = *server->settings;
+  settings.model = (char*)(files->model);
+  settings.scorer = (char*)(files->scorer);
+  const double start_ms = time_now_ms();
+  ModelState* model_state = NULL;
+  if (!load_model(&settings, &model_state)) {
+    return false;
+  }
+  if (!load_scorer(&settings, model_state)) {
+    STT_FreeModel(model_state);
+    return false;
+  }
+  *value = served_model_alloc(model_state, true);
+  fprintf(stderr, "Loaded '%s' in %.0fms\n", key, time_now_ms() - start_ms);
+  stream_server_log_models(server);
+  return true;
+}
+
+static ServedModel* served_stream_model(const ServedStream* stream) {
+  return (ServedModel*)(stream->model->value);
+}
+
+// Passes on whatever results the last step produced.
+static bool served_stream_flush(ServedStream* stream) {
+  fflush(stream->output);
+  if (!stream->is_http || (stream->http_buffer_length == 0)) {
+    return true;
+  }
+  bool status = true;
+  if (!stream->has_response_started) {
+    status = http_server_begin_chunked(stream->connection_fd,
+      "application/x-ndjson");
+    stream->has_response_started = true;
+  }
+  status = status && http_server_send_chunk(stream->connection_fd,
+    stream->http_buffer, stream->http_buffer_length);
+  rewind(stream->output);
+  fflush(stream->output);
+  return status;
+}
+
+// Sets up the decoder once the loader has acquired the stream's model.
+// Returns false if the model couldn't be loaded, or there wasn't room for it
+// because every other model was in use.
+static bool served_stream_start(StreamServer* server, ServedStream* stream) {
+  if (stream->model == NULL) {
+    return false;
+  }
+  ServedModel* model = served_stream_model(stream);
+  StreamingState* streaming_state = NULL;
+  pthread_mutex_lock(&model->mutex);
+  const int stream_error =
+    STT_CreateStream(model->model_state, &streaming_state);
+  pthread_mutex_unlock(&model->mutex);
+  if (stream_error != STT_ERR_OK) {
+    fprintf(stderr, "Stream %d couldn't start decoding\n", stream->id);
+    return false;
+  }
+
+  const Settings* settings = stream->settings;
+  const uint32_t model_rate = STT_GetModelSampleRate(model->model_state);
+  stream->reader = stream_reader_alloc(stream->input_fd,
+    stream->raw_sample_rate, stream->raw_channels, model_rate,
+    settings->channel, settings->source_buffer_size);
+  if (stream->request != NULL) {
+    stream_reader_limit_length(stream->reader,
+      stream->request->content_length,
+      (const uint8_t*)(stream->request->body_start),
+      stream->request->body_start_length);
+    http_request_free(stream->request);
+    stream->request = NULL;
+  }
+  if (settings->vad) {
+    stream->vad = voice_activity_alloc(model_rate, settings->vad_preroll_ms,
+      settings->vad_hangover_ms);
+    stream->gated_buffer = malloc(voice_activity_max_output(stream->vad,
+      settings->source_buffer_size) * sizeof(int16_t));
+  }
+  live_decoder_init(&stream->decoder, settings, model->model_state,
+    streaming_state, stream->vad, stream->output);
+  stream->has_decoder = true;
+  return true;
+}
+
+// Finishes a stream once its input has ended or can't be read, and lets the
+// client know how it went.
+static void served_stream_finish(StreamServer* server, ServedStream* stream,
+  bool status) {
+  if (status) {
+    ServedModel* model = served_stream_model(stream);
+    pthread_mutex_lock(&model->mutex);
+    live_finish_input(&stream->decoder);
+    pthread_mutex_unlock(&model->mutex);
+  }
+  const bool was_sent = served_stream_flush(stream);
+  if (!stream->is_http) {
+    job_socket_send_status(stream->connection_fd, status ? 0 : 1);
+  }
+  else if (!stream->has_response_started && !status) {
+    http_server_send_error(stream->connection_fd, 400,
+      "The audio couldn't be read or decoded");
+  }
+  else if (was_sent) {
+    if (!stream->has_response_started) {
+      http_server_begin_chunked(stream->connection_fd,
+        "application/x-ndjson");
+    }
+    http_server_end_chunked(stream->connection_fd);
+  }
+  stream->is_done = true;
+}
+
+static void stream_server_add_cost(StreamServer* server, double decode_ms,
+  double audio_ms) {
+  pthread_mutex_lock(&server->cost_mutex);
+  server->decode_ms = (server->decode_ms * SERVE_COST_DECAY) + decode_ms;
+  server->audio_ms = (server->audio_ms * SERVE_COST_DECAY) + audio_ms;
+  pthread_mutex_unlock(&server->cost_mutex);
+}
+
+// How long decoding a millisecond of audio has taken lately, which is the
+// real-time factor of a single stream. Zero until something's been decoded.
+static double stream_server_cost(StreamServer* server) {
+  pthread_mutex_lock(&server->cost_mutex);
+  const double result = (server->audio_ms > 0.0) ?
+    (server->decode_ms / server->audio_ms) : 0.0;
+  pthread_mutex_unlock(&server->cost_mutex);
+  return result;
+}
+
+// The real-time factor the workers would be running at with one more live
+// stream. Calls into each model are serialized, so only as many workers as
+// there are models loaded can be decoding at once. Batch streams aren't
+// counted, since they only get what's left over.
+static double stream_server_projected_load(StreamServer* server) {
+  ModelCacheStats stats;
+  model_cache_get_stats(server->models, &stats);
+  int parallel_count = server->scheduler->threads_count;
+  if (stats.entries_count < parallel_count) {
+    parallel_count = stats.entries_count;
+  }
+  if (parallel_count < 1) {
+    parallel_count = 1;
+  }
+  return ((server->live_streams_count + 1) * stream_server_cost(server)) /
+    parallel_count;
+}
+
+// Returns false if another live stream would push the projected real-time
+// factor over 1.0, so its results would fall further and further behind.
+static bool stream_server_admit_live(StreamServer* server) {
+  const double projected_load = stream_server_projected_load(server);
+  if (projected_load <= 1.0) {
+    return true;
+  }
+  server->live_rejections += 1;
+  fprintf(stderr, "Turned away a live stream, since %d live streams would "
+    "need a real-time factor of %.2f\n", server->live_streams_count + 1,
+    projected_load);
+  return false;
+}
+
+// Loads queued streams' models one at a time, waking each stream when done.
+static void* stream_server_loader_main(void* arg) {
+  StreamServer* server = (StreamServer*)(arg);
+  pthread_mutex_lock(&server->loader_mutex);
+  while (true) {
+    while ((server->loads_head == NULL) && !server->should_stop_loader) {
+      pthread_cond_wait(&server->loader_wake, &server->loader_mutex);
+    }
+    if (server->should_stop_loader) {
+      break;
+    }
+    ServedStream* stream = server->loads_head;
+    server->loads_head = stream->next_load;
+    if (server->loads_head == NULL) {
+      server->loads_tail = NULL;
+    }
+    pthread_mutex_unlock(&server->loader_mutex);
+
+    const ServedModelFiles files = {
+      stream->model_filename, stream->scorer_filename,
+    };
+    stream->model = model_cache_acquire(server->models, files.model,
+      served_model_size(files.model, files.scorer), (void*)(&files));
+    if (stream->model == NULL) {
+      fprintf(stderr, "Stream %d couldn't get the model '%s'\n", stream->id,
+        files.model);
+    }
+    stream_scheduler_wake(server->scheduler, &stream->scheduler_stream);
+
+    pthread_mutex_lock(&server->loader_mutex);
+  }
+  pthread_mutex_unlock(&server->loader_mutex);
+  return NULL;
+}
+
+// Gets a new stream going. If its model is already loaded it's woken
+// straight away, and otherwise it's left to the loader thread.
+static void stream_server_find_model(StreamServer* server,
+  ServedStream* stream) {
+  stream->model =
+    model_cache_acquire_loaded(server->models, stream->model_filename);
+  if (stream->model != NULL) {
+    stream_scheduler_wake(server->scheduler, &stream->scheduler_stream);
+    return;
+  }
+  pthread_mutex_lock(&server->loader_mutex);
+  if (server->loads_tail != NULL) {
+    server->loads_tail->next_load = stream;
+  }
+  else {
+    server->loads_head = stream;
+  }
+  server->loads_tail = stream;
+  pthread_cond_signal(&server->loader_wake);
+  pthread_mutex_unlock(&server->loader_mutex);
+}
+
+// Feeds whatever audio the client has sent since the last step, and passes
+// on any new results. Returns true if there might be more waiting already.
+static bool served_stream_step(void* cookie, int thread_index,
+  SchedulerStream* scheduler_stream) {
+  StreamServer* server = (StreamServer*)(cookie);
+  ServedStream* stream = (ServedStream*)(scheduler_stream);
+  if (stream->is_done) {
+    return false;
+  }
+  if (!stream->has_decoder && !served_stream_start(server, stream)) {
+    if (stream->is_http) {
+      http_server_send_error(stream->connection_fd, 503,
+        "The language's model couldn't be loaded");
+    }
+    else {
+      job_socket_send_status(stream->connection_fd, 1);
+    }
+    stream->is_done = true;
+    return false;
+  }
+  const int16_t* samples;
+  const int32_t count = stream_reader_read(stream->reader, 0, &samples);
+  if (count < 0) {
+    served_stream_finish(server, stream, false);
+    return false;
+  }
+  const int32_t feed_size = stream->settings->source_buffer_size;
+  bool status = true;
+  ServedModel* model = served_stream_model(stream);
+  pthread_mutex_lock(&model->mutex);
+  const double start_ms = time_now_ms();
+  for (int32_t offset = 0; offset < count; offset += feed_size) {
+    int32_t feed_count = count - offset;
+    if (feed_count > feed_size) {
+      feed_count = feed_size;
+    }
+    if (!live_process(&stream->decoder, stream->settings, samples + offset,
+      feed_count, stream->vad, stream->gated_buffer,
+      &stream->samples_heard)) {
+      status = false;
+      break;
+    }
+  }
+  const double decode_ms = time_now_ms() - start_ms;
+  pthread_mutex_unlock(&model->mutex);
+  if (count > 0) {
+    stream_server_add_cost(server, decode_ms,
+      (count * 1000.0) / stream->decoder.sample_rate);
+  }
+  // A client that's gone away won't be reading any more results.
+  status = served_stream_flush(stream) && status;
+  if (!status || stream->reader->is_finished) {
+    served_stream_finish(server, stream, status);
+    return false;
+  }
+  return (count > 0);
+}
+
+static StreamServer* stream_server_alloc(const Settings* settings,
+  ModelState* model_state) {
+  StreamServer* result = calloc(1, sizeof(StreamServer));
+  result->settings = settings;
+  result->http_settings = *settings;
+  result->http_settings.json_output = true;
+  result->http_settings.format = "text";
+  result->http_fd = -1;
+  pthread_mutex_init(&result->cost_mutex, NULL);
+  // The daemon's own model is always kept, so the budget is on top of it.
+  const int64_t default_size =
+    served_model_size(settings->model, settings->scorer);
+  result->models = model_cache_alloc(
+    default_size + ((int64_t)(settings->model_cache_mb) * 1024 * 1024),
+    served_model_load, served_model_free, result);
+  result->default_model = model_cache_add(result->models, settings->model,
+    served_model_alloc(model_state, false), default_size);
+  if (settings->http_port != 0) {
+    result->http_fd =
+      http_server_listen(settings->http_address, settings->http_port);
+  }
+  if ((settings->http_port == 0) || (result->http_fd >= 0)) {
+    result->scheduler = stream_scheduler_alloc(settings->stream_workers,
+      served_stream_step, result);
+  }
+  if (result->scheduler == NULL) {
+    if (result->http_fd >= 0) {
+      close(result->http_fd);
+    }
+    model_cache_release(result->models, result->default_model);
+    model_cache_free(result->models);
+    pthread_mutex_destroy(&result->cost_mutex);
+    free(result);
+    return NULL;
+  }
+  pthread_mutex_init(&result->loader_mutex, NULL);
+  pthread_cond_init(&result->loader_wake, NULL);
+  pthread_create(&result->loader_thread, NULL, stream_server_loader_main,
+    result);
+  if (result->http_fd >= 0) {
+    fprintf(stderr, "Listening for HTTP requests on %s:%d\n",
+      settings->http_address, settings->http_port);
+  }
+  return result;
+}
+
+// Gets ready to decode audio from `input_fd` with the given model, with
+// results written to a copy of `output_fd`, or gathered for an HTTP response
+// if that's -1. Decoding starts once the stream is woken. Returns NULL if
+// the stream couldn't be set up.
+static ServedStream* stream_server_add(StreamServer* server,
+  const Settings* settings, int connection_fd, int input_fd,
+  int32_t raw_sample_rate, int32_t raw_channels, int output_fd,
+  const char* model_filename, const char* scorer_filename,
+  SchedulerPriority priority) {
+  ServedStream* stream = calloc(1, sizeof(ServedStream));
+  stream->is_http = (output_fd < 0);
+  if (stream->is_http) {
+    stream->output =
+      open_memstream(&stream->http_buffer, &stream->http_buffer_length);
+  }
+  else {
+    const int output_copy = dup(output_fd);
+    stream->output = (output_copy >= 0) ? fdopen(output_copy, "w") : NULL;
+    if ((stream->output == NULL) && (output_copy >= 0)) {
+      close(output_copy);
+    }
+  }
+  if (stream->output == NULL) {
+    fprintf(stderr, "Couldn't start a stream for a client\n");
+    free(stream->http_buffer);
+    free(stream);
+    return NULL;
+  }
+
+  scheduler_stream_init(&stream->scheduler_stream);
+  stream->scheduler_stream.priority = priority;
+  if (priority == SCHEDULER_PRIORITY_LIVE) {
+    server->live_streams_count += 1;
+  }
+  stream->id = server->next_id;
+  server->next_id += 1;
+  stream->settings = settings;
+  stream->connection_fd = connection_fd;
+  stream->model_filename = string_duplicate(model_filename);
+  stream->scorer_filename = (scorer_filename != NULL) ?
+    string_duplicate(scorer_filename) : NULL;
+  stream->input_fd = input_fd;
+  stream->raw_sample_rate = raw_sample_rate;
+  stream->raw_channels = raw_channels;
+
+  stream->next = server->streams;
+  server->streams = stream;
+  server->streams_count += 1;
+  return stream;
+}
+
+static bool is_bool_word(const char* value) {
+  const char* words[] = { "true", "TRUE", "yes", "YES", "1",
+    "false", "FALSE", "no", "NO", "0" };
+  for (size_t i = 0; i < (sizeof(words) / sizeof(words[0])); ++i) {
+    if (strcmp(value, words[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Streams decoded inside the daemon use its own settings, so they're only
+// used for jobs whose command line asks for nothing beyond connecting and
+// reading stdin. Jobs with any other options are forked instead, where the
+// client's command line is parsed as usual.
+static bool is_plain_stream_job(const SocketJob* job) {
+  for (int i = 1; i < job->argc; ++i) {
+    const char* arg = job->argv[i];
+    if (strcmp(arg, "-") == 0) {
+      continue;
+    }
+    if (!string_starts_with(arg, "--")) {
+      return false;
+    }
+    const char* name = arg + 2;
+    const char* equals = strchr(name, '=');
+    const size_t name_length =
+      (equals != NULL) ? (size_t)(equals - name) : strlen(name);
+    const char* next = ((i + 1) < job->argc) ? job->argv[i + 1] : NULL;
+    if ((name_length == strlen("connect")) &&
+      (strncmp(name, "connect", name_length) == 0)) {
+      if ((equals == NULL) && (next != NULL) && is_bool_word(next)) {
+        i += 1;
+      }
+    }
+    else if ((name_length == strlen("socket_path")) &&
+      (strncmp(name, "socket_path", name_length) == 0)) {
+      if (equals == NULL) {
+        i += 1;
+      }
+    }
+    else if (strcmp(name, "source=stdin") == 0) {
+      continue;
+    }
+    else if ((strcmp(name, "source") == 0) && (next != NULL) &&
+      (strcmp(next, "stdin") == 0)) {
+      i += 1;
+    }
+    else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Starts decoding a --connect client's stdin, using the daemon's own
+// settings. Piped audio is treated as live. Returns false if that wasn't
+// possible, after letting the client know.
+static bool stream_server_add_job(StreamServer* server, int connection_fd,
+  SocketJob* job) {
+  if (!stream_server_admit_live(server)) {
+    dprintf(job->fds[2], "The daemon is too busy to keep up with another "
+      "live stream\n");
+    job_socket_send_status(connection_fd, 1);
+    return false;
+  }
+  ServedStream* stream = stream_server_add(server, server->settings,
+    connection_fd, job->fds[0], server->settings->raw_sample_rate,
+    server->settings->raw_channels, job->fds[1], server->settings->model,
+    server->settings->scorer, SCHEDULER_PRIORITY_LIVE);
+  if (stream == NULL) {
+    job_socket_send_status(connection_fd, 1);
+    return false;
+  }
+  stream->job = job;
+  stream_server_find_model(server, stream);
+  return true;
+}
+
+// Replies to GET /metrics with how well the model cache is doing.
+static void stream_server_send_metrics(StreamServer* server,
+  int connection_fd) {
+  ModelCacheStats stats;
+  model_cache_get_stats(server->models, &stats);
+  const int64_t lookups = stats.hits + stats.misses;
+  const int64_t loads = stats.misses - stats.rejections;
+  char* body = NULL;
+  size_t body_length = 0;
+  FILE* body_file = open_memstream(&body, &body_length);
+  JsonWriter* json = json_writer_alloc(body_file);
+  json_writer_begin_object(json);
+  json_writer_key(json, "streams");
+  json_writer_int(json, server->streams_count);
+  json_writer_key(json, "live_streams");
+  json_writer_int(json, server->live_streams_count);
+  json_writer_key(json, "live_rejections");
+  json_writer_int(json, server->live_rejections);
+  json_writer_key(json, "real_time_factor");
+  json_writer_double(json, stream_server_cost(server), 3);
+  json_writer_key(json, "projected_load");
+  json_writer_double(json, stream_server_projected_load(server), 3);
+  json_writer_key(json, "models");
+  json_writer_int(json, stats.entries_count);
+  json_writer_key(json, "used_bytes");
+  json_writer_int(json, stats.used_bytes);
+  json_writer_key(json, "budget_bytes");
+  json_writer_int(json, stats.budget_bytes);
+  json_writer_key(json, "hits");
+  json_writer_int(json, stats.hits);
+  json_writer_key(json, "misses");
+  json_writer_int(json, stats.misses);
+  json_writer_key(json, "hit_rate");
+  json_writer_double(json,
+    (lookups > 0) ? ((double)(stats.hits) / lookups) : 0.0, 3);
+  json_writer_key(json, "rejections");
+  json_writer_int(json, stats.rejections);
+  json_writer_key(json, "load_failures");
+  json_writer_int(json, stats.load_failures);
+  json_writer_key(json, "evictions");
+  json_writer_int(json, stats.evictions);
+  json_writer_key(json, "average_load_ms");
+  json_writer_double(json,
+    (loads > 0) ? (stats.total_load_ms / loads) : 0.0, 1);
+  json_writer_key(json, "max_load_ms");
+  json_writer_double(json, stats.max_load_ms, 1);
+  json_writer_end_object(json);
+  json_writer_end_line(json);
+  json_writer_free(json);
+  fclose(body_file);
+  http_server_send_response(connection_fd, 200, "application/json", body,
+    body_length);
+  free(body);
+}
+
+// Answers a request once its headers have all arrived, either straight away
+// for errors and GET /metrics, or by starting a stream that decodes the body
+// of a POST /transcribe as it arrives. Raw PCM bodies can give their format
+// with `sample_rate` and `channels` query parameters, but WAV headers are
+// used when there are any. A `language` parameter picks another language's
+// model, found the same way as --language's. Uploads of recordings that
+// aren't needed in real time should pass `priority=batch`, so they only use
+// capacity that live streams don't need, and aren't turned away when the
+// daemon is busy.
+static void stream_server_handle_http(StreamServer* server, int connection_fd,
+  HttpRequest* request) {
+  if (strcmp(request->path, "/metrics") == 0) {
+    if (strcmp(request->method, "GET") == 0) {
+      stream_server_send_metrics(server, connection_fd);
+    }
+    else {
+      http_server_send_error(connection_fd, 405,
+        "Metrics are read with GET /metrics");
+    }
+    http_request_free(request);
+    close(connection_fd);
+    return;
+  }
+
+  int status = 200;
+  const char* message = NULL;
+  if (strcmp(request->path, "/transcribe") != 0) {
+    status = 404;
+    message = "Audio should be sent to POST /transcribe";
+  }
+  else if (strcmp(request->method, "POST") != 0) {
+    status = 405;
+    message = "Audio should be sent to POST /transcribe";
+  }
+  else if (request->is_chunked || (request->content_length < 0)) {
+    status = 411;
+    message = "The audio's Content-Length is needed";
+  }
+  const Settings* settings = &server->http_settings;
+  int32_t raw_sample_rate = settings->raw_sample_rate;
+  int32_t raw_channels = settings->raw_channels;
+  http_request_query_int(request, "sample_rate", &raw_sample_rate);
+  http_request_query_int(request, "channels", &raw_channels);
+  // Checked before anything is allocated for the stream, since buffers are
+  // sized by them.
+  char range_message[128];
+  if ((status == 200) &&
+    ((raw_sample_rate < RESAMPLER_MIN_RATE) ||
+      (raw_sample_rate > RESAMPLER_MAX_RATE) || (raw_channels < 1) ||
+      (raw_channels > STREAM_READER_MAX_CHANNELS))) {
+    snprintf(range_message, sizeof(range_message),
+      "The sample rate must be %d to %d Hz, with 1 to %d channels",
+      RESAMPLER_MIN_RATE, RESAMPLER_MAX_RATE, STREAM_READER_MAX_CHANNELS);
+    status = 400;
+    message = range_message;
+  }
+  char* language = http_request_query_string(request, "language");
+  char* model_filename = NULL;
+  char* scorer_filename = NULL;
+  if ((status == 200) && (language != NULL) &&
+    !settings_find_language(settings, language, &model_filename,
+      &scorer_filename)) {
+    status = 404;
+    message = "There's no model for that language";
+  }
+  free(language);
+  SchedulerPriority priority = SCHEDULER_PRIORITY_LIVE;
+  char* priority_name = http_request_query_string(request, "priority");
+  if ((priority_name != NULL) && (strcmp(priority_name, "batch") == 0)) {
+    priority = SCHEDULER_PRIORITY_BATCH;
+  }
+  else if ((status == 200) && (priority_name != NULL) &&
+    (strcmp(priority_name, "live") != 0)) {
+    status = 400;
+    message = "The priority must be 'live' or 'batch'";
+  }
+  free(priority_name);
+  if ((status == 200) && (priority == SCHEDULER_PRIORITY_LIVE) &&
+    !stream_server_admit_live(server)) {
+    status = 503;
+    message = "The daemon is too busy to keep up with another live stream";
+  }
+
+  ServedStream* stream = NULL;
+  if (status == 200) {
+    stream = stream_server_add(server, settings, connection_fd,
+      connection_fd, raw_sample_rate, raw_channels, -1,
+      (model_filename != NULL) ? model_filename : settings->model,
+      (model_filename != NULL) ? scorer_filename : settings->scorer,
+      priority);
+    if (stream == NULL) {
+      status = 503;
+      message = "No decoder was available";
+    }
+  }
+  free(model_filename);
+  free(scorer_filename);
+  if (stream == NULL) {
+    http_server_send_error(connection_fd, status, message);
+    http_request_free(request);
+    close(connection_fd);
+    return;
+  }
+  stream->request = request;
+  stream_server_find_model(server, stream);
+}
+
+// Reads whatever has arrived of a pending request's headers. Returns true
+// once the connection has been dealt with, so it's no longer pending.
+static bool stream_server_read_http(StreamServer* server,
+  PendingHttp* pending) {
+  HttpRequest* request = NULL;
+  int error_status = 500;
+  const HttpHeadStatus status = http_head_reader_read(pending->reader,
+    pending->connection_fd, &request, &error_status);
+  if (status == HTTP_HEAD_INCOMPLETE) {
+    if (time_now_ms() < pending->deadline_ms) {
+      return false;
+    }
+    error_status = 408;
+  }
+  if (status != HTTP_HEAD_COMPLETE) {
+    http_server_send_error(pending->connection_fd, error_status,
+      "The request couldn't be read");
+    close(pending->connection_fd);
+    return true;
+  }
+  stream_server_handle_http(server, pending->connection_fd, request);
+  return true;
+}
+
+// Takes a new HTTP connection. Its headers are read without blocking, so a
+// client that sends them slowly can't hold up any others.
+static void stream_server_accept_http(StreamServer* server) {
+  const int connection_fd = accept(server->http_fd, NULL, NULL);
+  if (connection_fd < 0) {
+    return;
+  }
+  fcntl(connection_fd, F_SETFL, fcntl(connection_fd, F_GETFL) | O_NONBLOCK);
+  PendingHttp* pending = calloc(1, sizeof(PendingHttp));
+  pending->connection_fd = connection_fd;
+  pending->reader = http_head_reader_alloc();
+  pending->deadline_ms =
+    time_now_ms() + (SERVE_RECEIVE_TIMEOUT_SECONDS * 1000.0);
+  pending->next = server->pending_http;
+  server->pending_http = pending;
+  server->pending_http_count += 1;
+}
+
+// Reads whatever has arrived of a pending --connect job. Returns true once
+// the connection has been dealt with, so it's no longer pending. Plain
+// streamed jobs are started here, and any others are returned in `job`, to
+// be run in their own process.
+static bool stream_server_read_job(StreamServer* server, PendingJob* pending,
+  SocketJob** job) {
+  const JobSocketReadStatus status = job_socket_reader_read(pending->reader,
+    pending->connection_fd, job);
+  if (status == JOB_SOCKET_READ_INCOMPLETE) {
+    if (time_now_ms() < pending->deadline_ms) {
+      return false;
+    }
+    fprintf(stderr, "Timed out receiving job from client\n");
+  }
+  if (status != JOB_SOCKET_READ_COMPLETE) {
+    close(pending->connection_fd);
+    return true;
+  }
+  if ((server->settings->stream_workers > 0) &&
+    (((*job)->flags & JOB_SOCKET_FLAG_STREAM) != 0) &&
+    is_plain_stream_job(*job)) {
+    if (!stream_server_add_job(server, pending->connection_fd, *job)) {
+      socket_job_free(*job);
+      close(pending->connection_fd);
+    }
+    *job = NULL;
+  }
+  return true;
+}
+
+// Takes a new --connect client. Its job is read without blocking, so a
+// client that's slow to send it can't hold up any others.
+static void stream_server_accept_job(StreamServer* server, int listen_fd) {
+  const int connection_fd = accept(listen_fd, NULL, NULL);
+  if (connection_fd < 0) {
+    return;
+  }
+  PendingJob* pending = calloc(1, sizeof(PendingJob));
+  pending->connection_fd = connection_fd;
+  pending->reader = job_socket_reader_alloc();
+  pending->deadline_ms =
+    time_now_ms() + (SERVE_RECEIVE_TIMEOUT_SECONDS * 1000.0);
+  pending->next = server->pending_jobs;
+  server->pending_jobs = pending;
+  server->pending_jobs_count += 1;
+}
+
+// Reports how long the stream spent waiting for a worker, which grows when
+// there are more streams than the workers can keep up with.
+static void served_stream_free(StreamServer* server, ServedStream* stream) {
+  const SchedulerStream* scheduler_stream = &stream->scheduler_stream;
+  const double average_lag_ms = (scheduler_stream->steps_count > 0) ?
+    (scheduler_stream->total_lag_ms / scheduler_stream->steps_count) : 0.0;
+  fprintf(stderr, "Stream %d finished after %lld steps, queue lag %.1fms "
+    "average, %.1fms max\n", stream->id,
+    (long long)(scheduler_stream->steps_count), average_lag_ms,
+    scheduler_stream->max_lag_ms);
+
+  if (stream->has_decoder) {
+    ServedModel* model = served_stream_model(stream);
+    pthread_mutex_lock(&model->mutex);
+    live_decoder_release(&stream->decoder);
+    pthread_mutex_unlock(&model->mutex);
+  }
+  model_cache_release(server->models, stream->model);
+  if (stream->scheduler_stream.priority == SCHEDULER_PRIORITY_LIVE) {
+    server->live_streams_count -= 1;
+  }
+  http_request_free(stream->request);
+  stream_reader_free(stream->reader);
+  voice_activity_free(stream->vad);
+  free(stream->gated_buffer);
+  free(stream->model_filename);
+  free(stream->scorer_filename);
+  fclose(stream->output);
+  free(stream->http_buffer);
+  close(stream->connection_fd);
+  socket_job_free(stream->job);
+  free(stream);
+}
+
+// Waits until something happens, or SERVE_POLL_MS has passed. Meanwhile new
+// connections on `listen_fd` and the HTTP port are accepted, jobs and HTTP
+// requests' headers are read as they arrive, streams with new input are
+// woken, and finished ones are cleaned up. Streams that are queued or
+// running aren't watched, since they'll read everything that's waiting
+// anyway, and a step that ends with nothing left to read only makes its
+// stream idle once it's returned, so idle streams are picked up by the next
+// poll. Returns true if there's a job in `job` that needs its own process,
+// which is left to the caller along with its `connection_fd`.
+static bool stream_server_poll(StreamServer* server, int listen_fd,
+  int* connection_fd, SocketJob** job) {
+  // The listening sockets come first, then pending HTTP requests and jobs,
+  // then the streams.
+  const int first_pending = 2;
+  const int first_pending_job = first_pending + server->pending_http_count;
+  const int first_stream = first_pending_job + server->pending_jobs_count;
+  struct pollfd* poll_fds =
+    calloc(server->streams_count + first_stream, sizeof(struct pollfd));
+  ServedStream** polled_streams =
+    calloc(server->streams_count + first_stream, sizeof(ServedStream*));
+  poll_fds[0].fd = listen_fd;
+  poll_fds[0].events = POLLIN;
+  // Negative descriptors are ignored.
+  poll_fds[1].fd = server->http_fd;
+  poll_fds[1].events = POLLIN;
+  int poll_fds_count = first_pending;
+  for (PendingHttp* pending = server->pending_http; pending != NULL;
+    pending = pending->next) {
+    poll_fds[poll_fds_count].fd = pending->connection_fd;
+    poll_fds[poll_fds_count].events = POLLIN;
+    poll_fds_count += 1;
+  }
+  for (PendingJob* pending = server->pending_jobs; pending != NULL;
+    pending = pending->next) {
+    poll_fds[poll_fds_count].fd = pending->connection_fd;
+    poll_fds[poll_fds_count].events = POLLIN;
+    poll_fds_count += 1;
+  }
+  ServedStream** link = &server->streams;
+  while (*link != NULL) {
+    ServedStream* stream = *link;
+    if (!stream_scheduler_is_idle(server->scheduler,
+      &stream->scheduler_stream)) {
+      link = &stream->next;
+      continue;
+    }
+    if (stream->is_done) {
+      *link = stream->next;
+      server->streams_count -= 1;
+      served_stream_free(server, stream);
+      continue;
+    }
+    // Still waiting for the loader, which will wake it.
+    if (stream->reader == NULL) {
+      link = &stream->next;
+      continue;
+    }
+    poll_fds[poll_fds_count].fd = stream->reader->fd;
+    poll_fds[poll_fds_count].events = POLLIN;
+    polled_streams[poll_fds_count] = stream;
+    poll_fds_count += 1;
+    link = &stream->next;
+  }
+
+  *job = NULL;
+  const bool has_events = (poll(poll_fds, poll_fds_count, SERVE_POLL_MS) > 0);
+  // Pending requests are also checked when nothing's arrived, in case
+  // they've run out of time.
+  PendingHttp** pending_link = &server->pending_http;
+  for (int i = first_pending; i < first_pending_job; ++i) {
+    PendingHttp* pending = *pending_link;
+    const bool is_readable = has_events && (poll_fds[i].revents != 0);
+    if ((is_readable || (time_now_ms() >= pending->deadline_ms)) &&
+      stream_server_read_http(server, pending)) {
+      *pending_link = pending->next;
+      server->pending_http_count -= 1;
+      http_head_reader_free(pending->reader);
+      free(pending);
+      continue;
+    }
+    pending_link = &pending->next;
+  }
+  // Only one job at a time can be handed back, so any others that are ready
+  // are left for the next poll, which won't wait for them.
+  PendingJob** job_link = &server->pending_jobs;
+  for (int i = first_pending_job; i < first_stream; ++i) {
+    PendingJob* pending = *job_link;
+    const bool is_readable = has_events && (poll_fds[i].revents != 0);
+    if ((*job == NULL) &&
+      (is_readable || (time_now_ms() >= pending->deadline_ms)) &&
+      stream_server_read_job(server, pending, job)) {
+      *connection_fd = pending->connection_fd;
+      *job_link = pending->next;
+      server->pending_jobs_count -= 1;
+      job_socket_reader_free(pending->reader);
+      free(pending);
+      continue;
+    }
+    job_link = &pending->next;
+  }
+  if (has_events) {
+    if (poll_fds[0].revents != 0) {
+      stream_server_accept_job(server, listen_fd);
+    }
+    if (poll_fds[1].revents != 0) {
+      stream_server_accept_http(server);
+    }
+    for (int i = first_stream; i < poll_fds_count; ++i) {
+      if (poll_fds[i].revents != 0) {
+        stream_scheduler_wake(server->scheduler,
+          &polled_streams[i]->scheduler_stream);
+      }
+    }
+  }
+  free(poll_fds);
+  free(polled_streams);
+  return (*job != NULL);
+}
+
+static void stream_server_free(StreamServer* server) {
+  if (server == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&server->loader_mutex);
+  server->should_stop_loader = true;
+  pthread_cond_signal(&server->loader_wake);
+  pthread_mutex_unlock(&server->loader_mutex);
+  pthread_join(server->loader_thread, NULL);
+  pthread_mutex_destroy(&server->loader_mutex);
+  pthread_cond_destroy(&server->loader_wake);
+  stream_scheduler_free(server->scheduler);
+  while (server->streams != NULL) {
+    ServedStream* stream = server->streams;
+    server->streams = stream->next;
+    served_stream_free(server, stream);
+  }
+  while (server->pending_http != NULL) {
+    PendingHttp* pending = server->pending_http;
+    server->pending_http = pending->next;
+    close(pending->connection_fd);
+    http_head_reader_free(pending->reader);
+    free(pending);
+  }
+  while (server->pending_jobs != NULL) {
+    PendingJob* pending = server->pending_jobs;
+    server->pending_jobs = pending->next;
+    close(pending->connection_fd);
+    job_socket_reader_free(pending->reader);
+    free(pending);
+  }
+  if (server->http_fd >= 0) {
+    close(server->http_fd);
+  }
+  model_cache_release(server->models, server->default_model);
+  model_cache_free(server->models);
+  pthread_mutex_destroy(&server->cost_mutex);
+  free(server);
+}
+
+// Runs a job in a new child process, which exits once it's done.
+static void fork_job(Settings* settings, ModelState* model_state,
+  int listen_fd, int connection_fd, SocketJob* job) {
+  // Anything still buffered would otherwise be written twice.
+  fflush(NULL);
+  const pid_t pid = fork();
+  if (pid == 0) {
+    run_socket_job(settings, model_state, listen_fd, connection_fd, job);
+  }
+  if (pid < 0) {
+    fprintf(stderr, "Couldn't start a job: %s\n", strerror(errno));
+    job_socket_send_status(connection_fd, 1);
+  }
+  socket_job_free(job);
+  close(connection_fd);
+}
+
+// Forking only copies the thread that called it, so a child forked while
+// the stream server is running could start out with a lock that one of the
+// other threads was holding. That covers the cache's, the models', and the
+// scheduler's mutexes, as well as ones inside TensorFlow Lite, malloc, and
+// stdio that can't be reached from here, and the child would wait for them
+// forever. Instead the daemon forks this helper before starting any threads,
+// and sends it every job that needs its own process, along with the client's
+// connection. It forks a child for each one, and exits once the daemon's end
+// of `channel_fd` has closed.
+static void run_job_forker(Settings* settings, ModelState* model_state,
+  int listen_fd, int channel_fd) {
+  while (true) {
+    SocketJob* job = NULL;
+    if (!job_socket_receive_job(channel_fd, -1, &job)) {
+      break;
+    }
+    const int connection_fd = job_socket_receive_fd(channel_fd);
+    if (connection_fd < 0) {
+      socket_job_free(job);
+      break;
+    }
+    fork_job(settings, model_state, listen_fd, connection_fd, job);
+  }
+  _exit(0);
+}
+
+// Starts the helper that forks jobs, and returns the daemon's end of the
+// connection to it, or -1 on failure.
+static int start_job_forker(Settings* settings, ModelState* model_state,
+  int listen_fd) {
+  int channel[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) != 0) {
+    fprintf(stderr, "Couldn't create a socket: %s\n", strerror(errno));
+    return -1;
+  }
+  fflush(NULL);
+  const pid_t pid = fork();
+  if (pid == 0) {
+    close(channel[0]);
+    run_job_forker(settings, model_state, listen_fd, channel[1]);
+  }
+  close(channel[1]);
+  if (pid < 0) {
+    fprintf(stderr, "Couldn't start the job helper: %s\n", strerror(errno));
+    close(channel[0]);
+    return -1;
+  }
+  return channel[0];
+}
+
+// Keeps the model loaded and runs jobs sent by clients using --connect, each
+// one in its own process, until the daemon is killed. With --stream_workers,
+// jobs streaming audio to stdin are decoded inside the daemon instead, so
+// that many of them can share one model and a few threads, and the same goes
+// for requests to the --http_port, which can also ask for other languages.
+static bool serve_jobs(Settings* settings, ModelState* model_state) {
+  const int listen_fd = job_socket_listen(settings->socket_path);
+  if (listen_fd < 0) {
+    return false;
+  }
+  // Finished jobs are cleaned up automatically.
+  signal(SIGCHLD, SIG_IGN);
+  StreamServer* server = NULL;
+  // Only set while there's a stream server, whose threads mean jobs can't
+  // be forked from here.
+  int forker_fd = -1;
+  if ((settings->stream_workers > 0) || (settings->http_port != 0)) {
+    // A client going away mustn't take every other stream down with it, or
+    // the job helper.
+    signal(SIGPIPE, SIG_IGN);
+    forker_fd = start_job_forker(settings, model_state, listen_fd);
+    if (forker_fd < 0) {
+      close(listen_fd);
+      return false;
+    }
+    server = stream_server_alloc(settings, model_state);
+    if (server == NULL) {
+      close(forker_fd);
+      close(listen_fd);
+      return false;
+    }
+  }
+  fprintf(stderr, "Listening for jobs on '%s'\n", settings->socket_path);
+  while (true) {
+    int connection_fd = -1;
+    SocketJob* job = NULL;
+    if (server != NULL) {
+      // Jobs are received alongside the streams, which decodes any that
+      // can be, and hands back the rest.
+      if (!stream_server_poll(server, listen_fd, &connection_fd, &job)) {
+        continue;
+      }
+    }
+    else {
+      // With every job in its own process, there's nothing else to hold up.
+      connection_fd = accept(listen_fd, NULL, NULL);
+      if (connection_fd < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fprintf(stderr, "Couldn't accept a connection: %s\n",
+          strerror(errno));
+        break;
+      }
+      if (!job_socket_receive_job(connection_fd,
+        SERVE_RECEIVE_TIMEOUT_SECONDS * 1000, &job)) {
+        close(connection_fd);
+        continue;
+      }
+    }
+    if (forker_fd < 0) {
+      fork_job(settings, model_state, listen_fd, connection_fd, job);
+      continue;
+    }
+    if (!job_socket_send_job(forker_fd, job->argc, job->argv, job->cwd,
+      job->fds, job->flags) ||
+      !job_socket_send_fd(forker_fd, connection_fd)) {
+      fprintf(stderr, "Couldn't hand a job to the job helper\n");
+      job_socket_send_status(connection_fd, 1);
+    }
+    socket_job_free(job);
+    close(connection_fd);
+  }
+  stream_server_free(server);
+  if (forker_fd >= 0) {
+    close(forker_fd);
+  }
+  close(listen_fd);
+  return false;
+}
+
+// Hands the whole command line over to a daemon started with --serve, and
+// waits for it to finish. Returns false if there's no daemon to use, or if
+// the daemon's model isn't the one the job asked for.
+static bool run_on_daemon(const Settings* settings, int argc, char** argv,
+  int* status) {
+  const int socket_fd = job_socket_connect(settings->socket_path);
+  if (socket_fd < 0) {
+    return false;
+  }
+  char* cwd = getcwd(NULL, 0);
+  const int fds[] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+  const int flags = (strcmp(settings->source, "stdin") == 0) ?
+    JOB_SOCKET_FLAG_STREAM : 0;
+  const bool was_sent = (cwd != NULL) &&
+    job_socket_send_job(socket_fd, argc, argv, cwd, fds, flags);
+  free(cwd);
+  if (!was_sent) {
+    close(socket_fd);
+    return false;
+  }
+  if (!job_socket_receive_status(socket_fd, status)) {
+    fprintf(stderr, "The daemon stopped before the job was finished\n");
+    *status = 1;
+  }
+  close(socket_fd);
+  return (*status != JOB_SOCKET_STATUS_RUN_LOCALLY);
+}
+
+int app_main(int argc, char** argv) {
+  Settings* settings = settings_init_from_argv(argc, argv);
+  if (settings == NULL) {
+    return 1;
+  }
+
+  if (settings->connect) {
+    int daemon_status;
+    if (run_on_daemon(settings, argc, argv, &daemon_status)) {
+      settings_free(settings);
+      return daemon_status;
+    }
+    // Without a daemon, or one with the model the job needs, the job is run
+    // here instead.
+  }
+
+  ModelState* model_state = NULL;
+  if (!load_model(settings, &model_state)) {
+    return 1;
+  }
+
+  if (!load_scorer(settings, model_state)) {
+    return 1;
+  }
+
+  if (settings->serve) {
+    serve_jobs(settings, model_state);
     return 1;
   }
 
@@ -130,8 +130,317 @@ void test_print_changed_lines() {
   free(result);
 }
 
+void test_plain_text_from_gated_transcript() {
+  // Without gating these would all be on one line, but the voice activity
+  // detector skipped five seconds of silence between the two words.
+  TokenMetadata tokens[] = {
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"y", 65, 1.3f},
+    {"o", 70, 1.4f},
+  };
+  const int tokens_length = sizeof(tokens) / sizeof(tokens[0]);
+  CandidateTranscript transcript = {
+    tokens, tokens_length, 1.0f,
+  };
+  VoiceActivitySegment segments[] = {
+    {0, 0},
+    {(int64_t)(1.25f * 16000), (int64_t)(6.25f * 16000)},
+  };
+  VoiceActivity* vad = voice_activity_alloc(16000, 300, 500);
+  vad->segments = segments;
+  vad->segments_length = 2;
+  TranscriptTiming timing = { 0.0f, 0.0f, vad };
+  char* result = plain_text_from_gated_transcript(&transcript, &timing);
+  TEST_STREQ("hi\nyo", result);
+  free(result);
+
+  // Tokens already shown by a previous stream should be skipped.
+  timing.hidden_before = 1.25f;
+  result = plain_text_from_gated_transcript(&transcript, &timing);
+  TEST_STREQ("yo", result);
+  free(result);
+  vad->segments = NULL;
+  voice_activity_free(vad);
+}
+
+void test_write_finalized_lines() {
+  TokenMetadata tokens[] = {
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 500, 10.0f},
+    {"y", 505, 10.1f},
+    {"o", 510, 10.2f},
+  };
+  FileStream stream;
+  memset(&stream, 0, sizeof(stream));
+  stream.renderer = transcript_renderer_alloc();
+  stream.collected = string_builder_alloc();
+
+  CandidateTranscript start = { tokens, 2, 1.0f };
+  transcript_renderer_update(stream.renderer, &start, NULL, NULL);
+  write_finalized_lines(&stream, false);
+  TEST_INTEQ(0, stream.lines_written);
+  TEST_STREQ("", stream.collected->data);
+
+  // The first line can't change once the second has started.
+  CandidateTranscript middle = { tokens, 4, 1.0f };
+  transcript_renderer_update(stream.renderer, &middle, NULL, NULL);
+  write_finalized_lines(&stream, false);
+  TEST_INTEQ(1, stream.lines_written);
+  TEST_STREQ("hi\n", stream.collected->data);
+
+  CandidateTranscript end = { tokens, 5, 1.0f };
+  transcript_renderer_update(stream.renderer, &end, NULL, NULL);
+  write_finalized_lines(&stream, false);
+  TEST_INTEQ(1, stream.lines_written);
+  TEST_STREQ("hi\n", stream.collected->data);
+
+  write_finalized_lines(&stream, true);
+  TEST_INTEQ(2, stream.lines_written);
+  TEST_STREQ("hi\nyo\n", stream.collected->data);
+
+  string_builder_free(stream.collected);
+  transcript_renderer_free(stream.renderer);
+}
+
+void test_is_utterance_finished() {
+  Settings settings;
+  memset(&settings, 0, sizeof(settings));
+  settings.endpoint_silence_ms = 1000;
+
+  TEST_CHECK(!is_utterance_finished(&settings, 500.0f, 3000.0f));
+  TEST_CHECK(is_utterance_finished(&settings, 1000.0f, 3000.0f));
+  TEST_CHECK(!is_utterance_finished(&settings, 500.0f, 600000.0f));
+
+  // Past the soft limit, shorter pauses are enough.
+  settings.stream_size = 10000;
+  TEST_CHECK(!is_utterance_finished(&settings, 300.0f, 9000.0f));
+  TEST_CHECK(is_utterance_finished(&settings, 300.0f, 11000.0f));
+  TEST_CHECK(!is_utterance_finished(&settings, 100.0f, 11000.0f));
+
+  // Past the hard limit, the utterance ends whatever's happening.
+  settings.extended_stream_size = 20000;
+  TEST_CHECK(!is_utterance_finished(&settings, 0.0f, 19000.0f));
+  TEST_CHECK(is_utterance_finished(&settings, 0.0f, 20000.0f));
+
+  settings.endpoint_silence_ms = 0;
+  TEST_CHECK(!is_utterance_finished(&settings, 5000.0f, 11000.0f));
+  TEST_CHECK(is_utterance_finished(&settings, 0.0f, 20000.0f));
+}
+
+void test_find_handover_point() {
+  // "one two three four" from the stream that's ending, which was cut off
+  // partway through the last word.
+  TokenMetadata current_tokens[] = {
+    {"o", 0, 0.0f},
+    {"n", 1, 0.1f},
+    {"e", 2, 0.2f},
+    {" ", 3, 0.4f},
+    {"t", 4, 0.5f},
+    {"w", 5, 0.6f},
+    {"o", 6, 0.7f},
+    {" ", 7, 1.0f},
+    {"t", 8, 1.1f},
+    {"h", 9, 1.2f},
+    {"r", 10, 1.3f},
+    {"e", 11, 1.4f},
+    {"e", 12, 1.5f},
+    {" ", 13, 1.7f},
+    {"f", 14, 1.8f},
+    {"o", 15, 1.9f},
+  };
+  CandidateTranscript current = {
+    current_tokens, sizeof(current_tokens) / sizeof(current_tokens[0]), 1.0f,
+  };
+  // The stream taking over started at 0.6s, in the middle of "two", and its
+  // timing is slightly different.
+  TokenMetadata next_tokens[] = {
+    {"o", 0, 0.05f},
+    {" ", 1, 0.42f},
+    {"t", 2, 0.5f},
+    {"h", 3, 0.6f},
+    {"r", 4, 0.7f},
+    {"e", 5, 0.8f},
+    {"e", 6, 0.9f},
+    {" ", 7, 1.1f},
+    {"f", 8, 1.2f},
+    {"o", 9, 1.3f},
+    {"u", 10, 1.4f},
+    {"r", 11, 1.5f},
+  };
+  CandidateTranscript next = {
+    next_tokens, sizeof(next_tokens) / sizeof(next_tokens[0]), 1.0f,
+  };
+
+  int current_keep;
+  float next_hidden_before;
+  find_handover_point(&current, &next, 0.6f, 2.0f, &current_keep,
+    &next_hidden_before);
+  CandidateTranscript kept = { current_tokens, current_keep, 1.0f };
+  char* kept_text = plain_text_from_transcript(&kept);
+  TEST_STREQ("one two", kept_text);
+  free(kept_text);
+
+  TranscriptTiming timing = { 0.0f, next_hidden_before, NULL };
+  char* next_text = plain_text_from_gated_transcript(&next, &timing);
+  TEST_STREQ("three four", next_text);
+  free(next_text);
+}
+
+void test_merge_channel_segments() {
+  TokenMetadata left_tokens[] = {
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"b", 300, 6.0f},
+    {"y", 305, 6.1f},
+    {"e", 310, 6.2f},
+  };
+  CandidateTranscript left = {
+    left_tokens, sizeof(left_tokens) / sizeof(left_tokens[0]), 1.0f,
+  };
+  TokenMetadata right_tokens[] = {
+    {" ", 40, 0.8f},
+    {"y", 150, 3.0f},
+    {"o", 155, 3.1f},
+    {" ", 160, 3.2f},
+    {"y", 165, 3.3f},
+    {"o", 170, 3.4f},
+    {" ", 175, 3.5f},
+  };
+  CandidateTranscript right = {
+    right_tokens, sizeof(right_tokens) / sizeof(right_tokens[0]), 1.0f,
+  };
+
+  ChannelSegment* segments = NULL;
+  int segments_length = 0;
+  add_channel_segments(&left, 0, &segments, &segments_length);
+  TEST_INTEQ(2, segments_length);
+  TEST_STREQ("hi", segments[0].text);
+  TEST_CHECK(fabsf(segments[0].start_time - 1.0f) < 0.001f);
+  TEST_STREQ("bye", segments[1].text);
+  add_channel_segments(&right, 1, &segments, &segments_length);
+  TEST_INTEQ(3, segments_length);
+  TEST_STREQ("yo yo", segments[2].text);
+  TEST_CHECK(fabsf(segments[2].start_time - 3.0f) < 0.001f);
+
+  char* merged = merge_channel_segments(segments, segments_length);
+  TEST_STREQ("channel 0: hi\nchannel 1: yo yo\nchannel 0: bye\n", merged);
+  free(merged);
+  channel_segments_free(segments, segments_length);
+
+  TokenMetadata silent_tokens[] = {
+    {" ", 10, 0.2f},
+  };
+  CandidateTranscript silent = { silent_tokens, 1, 1.0f };
+  segments = NULL;
+  segments_length = 0;
+  add_channel_segments(&silent, 0, &segments, &segments_length);
+  TEST_INTEQ(0, segments_length);
+  merged = merge_channel_segments(segments, segments_length);
+  TEST_STREQ("", merged);
+  free(merged);
+  channel_segments_free(segments, segments_length);
+}
+
+void test_stitch_transcripts() {
+  // What a sequential decode of the whole recording produces.
+  TokenMetadata whole_tokens[] = {
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"t", 65, 1.3f},
+    {"h", 70, 1.4f},
+    {"e", 75, 1.5f},
+    {"r", 80, 1.6f},
+    {"e", 85, 1.7f},
+    {" ", 600, 12.0f},
+    {"b", 605, 12.1f},
+    {"y", 610, 12.2f},
+    {"e", 615, 12.3f},
+  };
+  CandidateTranscript whole = {
+    whole_tokens, sizeof(whole_tokens) / sizeof(whole_tokens[0]), 1.0f,
+  };
+
+  // The same speech decoded as two pieces, cut at 10 seconds, with each
+  // piece's times counted from its own start and no space at the join.
+  TokenMetadata first_tokens[] = {
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"t", 65, 1.3f},
+    {"h", 70, 1.4f},
+    {"e", 75, 1.5f},
+    {"r", 80, 1.6f},
+    {"e", 85, 1.7f},
+  };
+  CandidateTranscript first = {
+    first_tokens, sizeof(first_tokens) / sizeof(first_tokens[0]), 1.0f,
+  };
+  TokenMetadata second_tokens[] = {
+    {"b", 105, 2.1f},
+    {"y", 110, 2.2f},
+    {"e", 115, 2.3f},
+  };
+  CandidateTranscript second = {
+    second_tokens, sizeof(second_tokens) / sizeof(second_tokens[0]), 1.0f,
+  };
+
+  const CandidateTranscript* pieces[] = { &first, &second };
+  const float start_times[] = { 0.0f, 10.0f };
+  int tokens_length = 0;
+  TokenMetadata* tokens =
+    stitch_transcripts(pieces, start_times, 2, &tokens_length);
+  TEST_INTEQ(12, tokens_length);
+  TEST_STREQ(" ", tokens[8].text);
+  TEST_INTEQ(605, tokens[8].timestep);
+  TEST_STREQ("b", tokens[9].text);
+  TEST_INTEQ(605, tokens[9].timestep);
+  TEST_CHECK(fabsf(tokens[9].start_time - 12.1f) < 0.001f);
+
+  CandidateTranscript stitched = { tokens, tokens_length, 1.0f };
+  char* stitched_text = plain_text_from_transcript(&stitched);
+  char* whole_text = plain_text_from_transcript(&whole);
+  TEST_STREQ(whole_text, stitched_text);
+  free(whole_text);
+  free(stitched_text);
+  free(tokens);
+}
+
+void test_is_plain_stream_job() {
+  char* plain_argv[] = { "spchcat", "--connect", "--socket_path", "/x.sock",
+    "--source=stdin" };
+  SocketJob job;
+  memset(&job, 0, sizeof(job));
+  job.argv = plain_argv;
+  job.argc = sizeof(plain_argv) / sizeof(plain_argv[0]);
+  TEST_CHECK(is_plain_stream_job(&job));
+
+  char* dash_argv[] = { "spchcat", "--connect=true", "-" };
+  job.argv = dash_argv;
+  job.argc = sizeof(dash_argv) / sizeof(dash_argv[0]);
+  TEST_CHECK(is_plain_stream_job(&job));
+
+  // Any other option has to be handled by parsing the whole command line.
+  char* json_argv[] = { "spchcat", "--connect", "--json_output=true", "-" };
+  job.argv = json_argv;
+  job.argc = sizeof(json_argv) / sizeof(json_argv[0]);
+  TEST_CHECK(!is_plain_stream_job(&job));
+}
+
 TEST_LIST = {
   {"plain_text_from_transcript", test_plain_text_from_transcript},
+  {"plain_text_from_gated_transcript",
+    test_plain_text_from_gated_transcript},
   {"print_changed_lines", test_print_changed_lines},
+  {"write_finalized_lines", test_write_finalized_lines},
+  {"is_utterance_finished", test_is_utterance_finished},
+  {"find_handover_point", test_find_handover_point},
+  {"merge_channel_segments", test_merge_channel_segments},
+  {"stitch_transcripts", test_stitch_transcripts},
+  {"is_plain_stream_job", test_is_plain_stream_job},
   {NULL, NULL},
 };
\ No newline at end of file
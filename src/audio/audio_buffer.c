@@ -2,14 +2,32 @@
 
 #include "stdlib.h"
 
+#include <sys/mman.h>
+
 AudioBuffer* audio_buffer_alloc(int32_t sample_rate,
   int32_t samples_per_channel, int32_t channels) {
   AudioBuffer* result = calloc(1, sizeof(AudioBuffer));
   result->sample_rate = sample_rate;
   result->channels = channels;
   result->samples_per_channel = samples_per_channel;
-  const size_t byte_count = (samples_per_channel * channels * sizeof(int16_t));
+  const size_t byte_count =
+    ((size_t)(samples_per_channel) * channels * sizeof(int16_t));
   result->data = calloc(1, byte_count);
+  result->mapping = NULL;
+  result->mapping_byte_count = 0;
+  return result;
+}
+
+AudioBuffer* audio_buffer_alloc_mapped(int32_t sample_rate,
+  int32_t samples_per_channel, int32_t channels, int16_t* data,
+  void* mapping, size_t mapping_byte_count) {
+  AudioBuffer* result = calloc(1, sizeof(AudioBuffer));
+  result->sample_rate = sample_rate;
+  result->channels = channels;
+  result->samples_per_channel = samples_per_channel;
+  result->data = data;
+  result->mapping = mapping;
+  result->mapping_byte_count = mapping_byte_count;
   return result;
 }
 
@@ -17,6 +35,11 @@ void audio_buffer_free(AudioBuffer* buffer) {
   if (buffer == NULL) {
     return;
   }
-  free(buffer->data);
+  if (buffer->mapping != NULL) {
+    munmap(buffer->mapping, buffer->mapping_byte_count);
+  }
+  else {
+    free(buffer->data);
+  }
   free(buffer);
 }
@@ -1,6 +1,7 @@
 #ifndef INCLUDE_AUDIO_BUFFER_H
 #define INCLUDE_AUDIO_BUFFER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct AudioBufferStruct {
@@ -10,10 +11,20 @@ typedef struct AudioBufferStruct {
   // Convention is that samples are stored interleaved by channel, so 
   // |C0|C1|C0|C1|...
   int16_t* data;
+  // When the samples point straight into a memory-mapped file instead of a
+  // heap allocation, this holds the whole mapping so it can be released.
+  void* mapping;
+  size_t mapping_byte_count;
 } AudioBuffer;
 
 AudioBuffer* audio_buffer_alloc(int32_t sample_rate,
   int32_t samples_per_channel, int32_t channels);
+
+// Wraps samples that live inside an existing mmap() region. The buffer takes
+// ownership of the mapping, and will munmap() it when it's freed.
+AudioBuffer* audio_buffer_alloc_mapped(int32_t sample_rate,
+  int32_t samples_per_channel, int32_t channels, int16_t* data,
+  void* mapping, size_t mapping_byte_count);
 void audio_buffer_free(AudioBuffer* buffer);
 
 #endif  // INCLUDE_AUDIO_BUFFER_H
\ No newline at end of file
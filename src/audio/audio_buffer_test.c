@@ -12,7 +12,28 @@ static void test_audio_buffer_alloc() {
   audio_buffer_free(buffer);
 }
 
+static void test_audio_buffer_alloc_mapped() {
+  const size_t mapping_byte_count = 4096;
+  void* mapping = mmap(NULL, mapping_byte_count, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  TEST_ASSERT(mapping != MAP_FAILED);
+  int16_t* data = (int16_t*)(mapping) + 22;
+  data[0] = 1234;
+
+  AudioBuffer* buffer = audio_buffer_alloc_mapped(16000, 100, 1, data,
+    mapping, mapping_byte_count);
+  TEST_CHECK(buffer != NULL);
+  TEST_INTEQ(16000, buffer->sample_rate);
+  TEST_INTEQ(100, buffer->samples_per_channel);
+  TEST_INTEQ(1, buffer->channels);
+  TEST_CHECK(buffer->data == data);
+  TEST_CHECK(buffer->mapping == mapping);
+  TEST_INTEQ(1234, buffer->data[0]);
+  audio_buffer_free(buffer);
+}
+
 TEST_LIST = {
   {"audio_buffer_alloc", test_audio_buffer_alloc},
+  {"audio_buffer_alloc_mapped", test_audio_buffer_alloc_mapped},
   {NULL, NULL},
 };
\ No newline at end of file
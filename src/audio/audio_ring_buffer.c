@@ -0,0 +1,105 @@
+#include "audio_ring_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int32_t next_power_of_two(int32_t value) {
+  int32_t result = 1;
+  while (result < value) {
+    result *= 2;
+  }
+  return result;
+}
+
+AudioRingBuffer* audio_ring_buffer_alloc(int32_t min_capacity) {
+  AudioRingBuffer* result = calloc(1, sizeof(AudioRingBuffer));
+  result->capacity = next_power_of_two(min_capacity);
+  result->data = calloc(result->capacity, sizeof(int16_t));
+  result->write_position = 0;
+  result->read_position = 0;
+  result->overrun_count = 0;
+  result->overrun_samples = 0;
+  result->peak_occupancy = 0;
+  return result;
+}
+
+void audio_ring_buffer_free(AudioRingBuffer* ring) {
+  if (ring == NULL) {
+    return;
+  }
+  free(ring->data);
+  free(ring);
+}
+
+// Copies between a linear array and the ring, splitting into two parts if the
+// range wraps around the end of the storage.
+static void copy_in(AudioRingBuffer* ring, uint64_t position,
+  const int16_t* samples, int32_t count) {
+  const int32_t start = (int32_t)(position & (ring->capacity - 1));
+  const int32_t first_count = ((start + count) > ring->capacity) ?
+    (ring->capacity - start) : count;
+  memcpy(ring->data + start, samples, first_count * sizeof(int16_t));
+  memcpy(ring->data, samples + first_count,
+    (count - first_count) * sizeof(int16_t));
+}
+
+static void copy_out(const AudioRingBuffer* ring, uint64_t position,
+  int16_t* samples, int32_t count) {
+  const int32_t start = (int32_t)(position & (ring->capacity - 1));
+  const int32_t first_count = ((start + count) > ring->capacity) ?
+    (ring->capacity - start) : count;
+  memcpy(samples, ring->data + start, first_count * sizeof(int16_t));
+  memcpy(samples + first_count, ring->data,
+    (count - first_count) * sizeof(int16_t));
+}
+
+int32_t audio_ring_buffer_write(AudioRingBuffer* ring, const int16_t* samples,
+  int32_t count) {
+  const uint64_t write_position = ring->write_position;
+  // Acquire pairs with the consumer's release, so we know it's finished
+  // copying out of any space we're about to reuse.
+  const uint64_t read_position =
+    __atomic_load_n(&ring->read_position, __ATOMIC_ACQUIRE);
+  const int32_t occupancy = (int32_t)(write_position - read_position);
+  const int32_t space = ring->capacity - occupancy;
+  int32_t to_write = count;
+  if (to_write > space) {
+    to_write = space;
+    __atomic_store_n(&ring->overrun_count, ring->overrun_count + 1,
+      __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->overrun_samples,
+      ring->overrun_samples + (count - space), __ATOMIC_RELAXED);
+  }
+  copy_in(ring, write_position, samples, to_write);
+  // Release makes the copied samples visible before the new position.
+  __atomic_store_n(&ring->write_position, write_position + to_write,
+    __ATOMIC_RELEASE);
+  const int32_t new_occupancy = occupancy + to_write;
+  if (new_occupancy > ring->peak_occupancy) {
+    __atomic_store_n(&ring->peak_occupancy, new_occupancy, __ATOMIC_RELAXED);
+  }
+  return to_write;
+}
+
+int32_t audio_ring_buffer_read(AudioRingBuffer* ring, int16_t* samples,
+  int32_t max_count) {
+  const uint64_t read_position = ring->read_position;
+  const uint64_t write_position =
+    __atomic_load_n(&ring->write_position, __ATOMIC_ACQUIRE);
+  int32_t to_read = (int32_t)(write_position - read_position);
+  if (to_read > max_count) {
+    to_read = max_count;
+  }
+  copy_out(ring, read_position, samples, to_read);
+  __atomic_store_n(&ring->read_position, read_position + to_read,
+    __ATOMIC_RELEASE);
+  return to_read;
+}
+
+int32_t audio_ring_buffer_occupancy(const AudioRingBuffer* ring) {
+  const uint64_t read_position =
+    __atomic_load_n(&ring->read_position, __ATOMIC_ACQUIRE);
+  const uint64_t write_position =
+    __atomic_load_n(&ring->write_position, __ATOMIC_ACQUIRE);
+  return (int32_t)(write_position - read_position);
+}
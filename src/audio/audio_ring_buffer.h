@@ -0,0 +1,40 @@
+#ifndef INCLUDE_AUDIO_RING_BUFFER_H
+#define INCLUDE_AUDIO_RING_BUFFER_H
+
+#include <stdint.h>
+
+// Lock-free queue of samples for handing audio from exactly one producer
+// thread to exactly one consumer thread. The producer never blocks, so it's
+// safe to use from a real-time capture thread. If the consumer falls too far
+// behind, samples that don't fit are dropped and counted as an overrun.
+typedef struct AudioRingBufferStruct {
+  int16_t* data;
+  // Always a power of two, so positions can be wrapped with a mask.
+  int32_t capacity;
+  // These only ever increase. The producer owns `write_position` and the
+  // consumer owns `read_position`, and each only reads the other's.
+  uint64_t write_position;
+  uint64_t read_position;
+  // Statistics, only updated by the producer.
+  uint64_t overrun_count;
+  uint64_t overrun_samples;
+  int32_t peak_occupancy;
+} AudioRingBuffer;
+
+// The capacity is rounded up to the next power of two.
+AudioRingBuffer* audio_ring_buffer_alloc(int32_t min_capacity);
+void audio_ring_buffer_free(AudioRingBuffer* ring);
+
+// Producer side. Returns how many samples were stored, which is less than
+// `count` if there wasn't room for all of them.
+int32_t audio_ring_buffer_write(AudioRingBuffer* ring, const int16_t* samples,
+  int32_t count);
+
+// Consumer side. Returns how many samples were copied into `samples`.
+int32_t audio_ring_buffer_read(AudioRingBuffer* ring, int16_t* samples,
+  int32_t max_count);
+
+// How many samples are waiting to be read. Safe to call from either side.
+int32_t audio_ring_buffer_occupancy(const AudioRingBuffer* ring);
+
+#endif  // INCLUDE_AUDIO_RING_BUFFER_H
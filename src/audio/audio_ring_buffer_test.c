@@ -0,0 +1,120 @@
+#include "acutest.h"
+
+#include "audio_ring_buffer.c"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+static void test_audio_ring_buffer_alloc() {
+  AudioRingBuffer* ring = audio_ring_buffer_alloc(1000);
+  TEST_ASSERT(ring != NULL);
+  TEST_INTEQ(1024, ring->capacity);
+  TEST_CHECK(ring->data != NULL);
+  TEST_INTEQ(0, audio_ring_buffer_occupancy(ring));
+  audio_ring_buffer_free(ring);
+
+  ring = audio_ring_buffer_alloc(16);
+  TEST_INTEQ(16, ring->capacity);
+  audio_ring_buffer_free(ring);
+}
+
+static void test_audio_ring_buffer_write_and_read() {
+  AudioRingBuffer* ring = audio_ring_buffer_alloc(8);
+  const int16_t input[] = { 1, 2, 3, 4, 5, 6 };
+  int16_t output[8];
+
+  int32_t count = audio_ring_buffer_write(ring, input, 6);
+  TEST_INTEQ(6, count);
+  TEST_INTEQ(6, audio_ring_buffer_occupancy(ring));
+  count = audio_ring_buffer_read(ring, output, 4);
+  TEST_INTEQ(4, count);
+  TEST_INTEQ(1, output[0]);
+  TEST_INTEQ(4, output[3]);
+  TEST_INTEQ(2, audio_ring_buffer_occupancy(ring));
+
+  // This write wraps around the end of the storage.
+  count = audio_ring_buffer_write(ring, input, 6);
+  TEST_INTEQ(6, count);
+  count = audio_ring_buffer_read(ring, output, 8);
+  TEST_INTEQ(8, count);
+  const int16_t expected[] = { 5, 6, 1, 2, 3, 4, 5, 6 };
+  TEST_MEMEQ(expected, output, sizeof(expected));
+  TEST_INTEQ(0, audio_ring_buffer_occupancy(ring));
+  TEST_INTEQ(8, ring->peak_occupancy);
+  TEST_CHECK(ring->overrun_count == 0);
+
+  count = audio_ring_buffer_read(ring, output, 8);
+  TEST_INTEQ(0, count);
+
+  audio_ring_buffer_free(ring);
+}
+
+static void test_audio_ring_buffer_overrun() {
+  AudioRingBuffer* ring = audio_ring_buffer_alloc(8);
+  const int16_t input[] = { 1, 2, 3, 4, 5, 6 };
+  int16_t output[8];
+
+  audio_ring_buffer_write(ring, input, 6);
+  const int32_t count = audio_ring_buffer_write(ring, input, 6);
+  TEST_INTEQ(2, count);
+  TEST_CHECK(ring->overrun_count == 1);
+  TEST_CHECK(ring->overrun_samples == 4);
+  TEST_INTEQ(8, ring->peak_occupancy);
+
+  // Everything that was accepted should still come out in order.
+  audio_ring_buffer_read(ring, output, 8);
+  const int16_t expected[] = { 1, 2, 3, 4, 5, 6, 1, 2 };
+  TEST_MEMEQ(expected, output, sizeof(expected));
+
+  audio_ring_buffer_free(ring);
+}
+
+#define STRESS_SAMPLE_COUNT (1000000)
+
+static void* stress_producer(void* arg) {
+  AudioRingBuffer* ring = (AudioRingBuffer*)(arg);
+  int16_t block[37];
+  int32_t next_value = 0;
+  while (next_value < STRESS_SAMPLE_COUNT) {
+    int32_t block_count = 0;
+    for (int i = 0; (i < 37) && (next_value + i < STRESS_SAMPLE_COUNT); ++i) {
+      block[i] = (int16_t)(next_value + i);
+      block_count += 1;
+    }
+    // Only advance past what was accepted, so nothing is ever dropped.
+    next_value += audio_ring_buffer_write(ring, block, block_count);
+  }
+  return NULL;
+}
+
+static void test_audio_ring_buffer_threads() {
+  AudioRingBuffer* ring = audio_ring_buffer_alloc(256);
+  pthread_t producer;
+  TEST_ASSERT(pthread_create(&producer, NULL, stress_producer, ring) == 0);
+
+  int16_t block[50];
+  int32_t expected_value = 0;
+  bool all_in_order = true;
+  while (expected_value < STRESS_SAMPLE_COUNT) {
+    const int32_t count = audio_ring_buffer_read(ring, block, 50);
+    for (int i = 0; i < count; ++i) {
+      if (block[i] != (int16_t)(expected_value)) {
+        all_in_order = false;
+      }
+      expected_value += 1;
+    }
+  }
+  pthread_join(producer, NULL);
+  TEST_CHECK(all_in_order);
+  TEST_INTEQ(0, audio_ring_buffer_occupancy(ring));
+
+  audio_ring_buffer_free(ring);
+}
+
+TEST_LIST = {
+  {"audio_ring_buffer_alloc", test_audio_ring_buffer_alloc},
+  {"audio_ring_buffer_write_and_read", test_audio_ring_buffer_write_and_read},
+  {"audio_ring_buffer_overrun", test_audio_ring_buffer_overrun},
+  {"audio_ring_buffer_threads", test_audio_ring_buffer_threads},
+  {NULL, NULL},
+};
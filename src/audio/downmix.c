@@ -0,0 +1,160 @@
+#include "downmix.h"
+
+#include <string.h>
+
+#if defined(CPU_FEATURES_HAS_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_HAS_AVX2)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+// All of the stereo kernels round the average down, matching NEON's halving
+// add, so they give identical results. Each one handles as many frames as it
+// can in whole vectors and returns how many that was, leaving the rest for
+// the scalar loop.
+static int32_t average_stereo_scalar(const int16_t* input, int32_t start,
+  int32_t frames, int16_t* output) {
+  for (int32_t i = start; i < frames; ++i) {
+    const int32_t sum = input[i * 2] + input[(i * 2) + 1];
+    output[i] = (int16_t)(sum >> 1);
+  }
+  return frames;
+}
+
+#if defined(CPU_FEATURES_HAS_SSE2)
+static int32_t average_stereo_sse2(const int16_t* input, int32_t frames,
+  int16_t* output) {
+  const __m128i ones = _mm_set1_epi16(1);
+  int32_t i = 0;
+  for (; (i + 8) <= frames; i += 8) {
+    const __m128i first = _mm_loadu_si128((const __m128i*)(input + (i * 2)));
+    const __m128i second =
+      _mm_loadu_si128((const __m128i*)(input + (i * 2) + 8));
+    // Multiplying by one and adding neighbors sums each left/right pair into
+    // a 32-bit lane, so nothing overflows.
+    const __m128i first_sums = _mm_srai_epi32(_mm_madd_epi16(first, ones), 1);
+    const __m128i second_sums =
+      _mm_srai_epi32(_mm_madd_epi16(second, ones), 1);
+    _mm_storeu_si128((__m128i*)(output + i),
+      _mm_packs_epi32(first_sums, second_sums));
+  }
+  return i;
+}
+#endif
+
+#if defined(CPU_FEATURES_HAS_AVX2)
+__attribute__((target("avx2")))
+static int32_t average_stereo_avx2(const int16_t* input, int32_t frames,
+  int16_t* output) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  int32_t i = 0;
+  for (; (i + 16) <= frames; i += 16) {
+    const __m256i first =
+      _mm256_loadu_si256((const __m256i*)(input + (i * 2)));
+    const __m256i second =
+      _mm256_loadu_si256((const __m256i*)(input + (i * 2) + 16));
+    const __m256i first_sums =
+      _mm256_srai_epi32(_mm256_madd_epi16(first, ones), 1);
+    const __m256i second_sums =
+      _mm256_srai_epi32(_mm256_madd_epi16(second, ones), 1);
+    // Packing works within each 128-bit half, so the middle two quarters
+    // have to be swapped back into order afterwards.
+    const __m256i packed = _mm256_packs_epi32(first_sums, second_sums);
+    _mm256_storeu_si256((__m256i*)(output + i),
+      _mm256_permute4x64_epi64(packed, 0xd8));
+  }
+  return i;
+}
+#endif
+
+#if defined(CPU_FEATURES_HAS_NEON)
+static int32_t average_stereo_neon(const int16_t* input, int32_t frames,
+  int16_t* output) {
+  int32_t i = 0;
+  for (; (i + 8) <= frames; i += 8) {
+    const int16x8x2_t pair = vld2q_s16(input + (i * 2));
+    vst1q_s16(output + i, vhaddq_s16(pair.val[0], pair.val[1]));
+  }
+  return i;
+}
+#endif
+
+static void average_stereo(const int16_t* input, int32_t frames,
+  CpuKernel kernel, int16_t* output) {
+  int32_t done = 0;
+  switch (kernel) {
+#if defined(CPU_FEATURES_HAS_SSE2)
+  case CPU_KERNEL_SSE2:
+    done = average_stereo_sse2(input, frames, output);
+    break;
+#endif
+#if defined(CPU_FEATURES_HAS_AVX2)
+  case CPU_KERNEL_AVX2:
+    done = average_stereo_avx2(input, frames, output);
+    break;
+#endif
+#if defined(CPU_FEATURES_HAS_NEON)
+  case CPU_KERNEL_NEON:
+    done = average_stereo_neon(input, frames, output);
+    break;
+#endif
+  default:
+    break;
+  }
+  average_stereo_scalar(input, done, frames, output);
+}
+
+static void average_channels(const int16_t* input, int32_t frames,
+  int32_t channels, int16_t* output) {
+  for (int32_t i = 0; i < frames; ++i) {
+    const int16_t* frame = input + (i * channels);
+    int32_t sum = 0;
+    for (int32_t channel = 0; channel < channels; ++channel) {
+      sum += frame[channel];
+    }
+    output[i] = (int16_t)(sum / channels);
+  }
+}
+
+static void pick_channel(const int16_t* input, int32_t frames,
+  int32_t channels, int32_t channel, int16_t* output) {
+  for (int32_t i = 0; i < frames; ++i) {
+    output[i] = input[(i * channels) + channel];
+  }
+}
+
+void downmix_to_mono_with_kernel(const int16_t* input, int32_t frames,
+  int32_t channels, int32_t channel, CpuKernel kernel, int16_t* output) {
+  if (channels == 1) {
+    if (output != input) {
+      memmove(output, input, frames * sizeof(int16_t));
+    }
+  }
+  else if (channel != DOWNMIX_ALL_CHANNELS) {
+    pick_channel(input, frames, channels, channel, output);
+  }
+  else if (channels == 2) {
+    average_stereo(input, frames, kernel, output);
+  }
+  else {
+    average_channels(input, frames, channels, output);
+  }
+}
+
+void downmix_to_mono(const int16_t* input, int32_t frames, int32_t channels,
+  int32_t channel, int16_t* output) {
+  downmix_to_mono_with_kernel(input, frames, channels, channel,
+    cpu_best_kernel(), output);
+}
+
+void downmix_buffer(AudioBuffer* buffer, int32_t channel) {
+  downmix_to_mono(buffer->data, buffer->samples_per_channel,
+    buffer->channels, channel, buffer->data);
+  buffer->channels = 1;
+}
@@ -0,0 +1,29 @@
+#ifndef INCLUDE_DOWNMIX_H
+#define INCLUDE_DOWNMIX_H
+
+#include <stdint.h>
+
+#include "audio_buffer.h"
+#include "cpu_features.h"
+
+// Pass as the channel to average all of them together.
+#define DOWNMIX_ALL_CHANNELS (-1)
+
+// Converts `frames` interleaved frames with `channels` channels into mono,
+// either by averaging every channel or by picking out a single one. The
+// output can be the same memory as the input, so a block can be converted in
+// place. Stereo averaging has SIMD versions, since it's by far the most
+// common case.
+void downmix_to_mono(const int16_t* input, int32_t frames, int32_t channels,
+  int32_t channel, int16_t* output);
+
+// Same as downmix_to_mono(), but using a particular kernel, which must be
+// supported on this CPU.
+void downmix_to_mono_with_kernel(const int16_t* input, int32_t frames,
+  int32_t channels, int32_t channel, CpuKernel kernel, int16_t* output);
+
+// Converts a whole buffer to mono in place, without allocating any new
+// sample memory.
+void downmix_buffer(AudioBuffer* buffer, int32_t channel);
+
+#endif  // INCLUDE_DOWNMIX_H
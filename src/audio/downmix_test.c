@@ -0,0 +1,134 @@
+#include "acutest.h"
+
+#include "downmix.c"
+
+#include <stdlib.h>
+
+#include "time_utils.h"
+
+static void fill_random(int16_t* data, int32_t count) {
+  srand(7);
+  for (int32_t i = 0; i < count; ++i) {
+    data[i] = (int16_t)((rand() % 65536) - 32768);
+  }
+}
+
+void test_downmix_stereo() {
+  const int16_t input[] = {
+    100, 200,
+    -100, -201,
+    32767, 32767,
+    -32768, -32768,
+    32767, -32768,
+    3, 4,
+  };
+  const int32_t frames = 6;
+  int16_t output[6];
+  downmix_to_mono(input, frames, 2, DOWNMIX_ALL_CHANNELS, output);
+  TEST_INTEQ(150, output[0]);
+  TEST_INTEQ(-151, output[1]);
+  TEST_INTEQ(32767, output[2]);
+  TEST_INTEQ(-32768, output[3]);
+  TEST_INTEQ(-1, output[4]);
+  TEST_INTEQ(3, output[5]);
+
+  downmix_to_mono(input, frames, 2, 1, output);
+  TEST_INTEQ(200, output[0]);
+  TEST_INTEQ(-201, output[1]);
+  TEST_INTEQ(4, output[5]);
+}
+
+void test_downmix_multichannel() {
+  const int16_t input[] = {
+    1, 2, 3, 4, 5, 6,
+    -6, -6, -6, -6, -6, -6,
+  };
+  int16_t output[2];
+  downmix_to_mono(input, 2, 6, DOWNMIX_ALL_CHANNELS, output);
+  TEST_INTEQ(3, output[0]);
+  TEST_INTEQ(-6, output[1]);
+
+  downmix_to_mono(input, 2, 6, 4, output);
+  TEST_INTEQ(5, output[0]);
+  TEST_INTEQ(-6, output[1]);
+
+  const int16_t mono[] = { 7, 8, 9 };
+  int16_t mono_output[3];
+  downmix_to_mono(mono, 3, 1, DOWNMIX_ALL_CHANNELS, mono_output);
+  TEST_CHECK(memcmp(mono, mono_output, sizeof(mono)) == 0);
+}
+
+void test_downmix_kernels() {
+  // An odd length makes sure the scalar tail after the vector loop is used.
+  const int32_t frames = 1003;
+  int16_t* input = malloc(frames * 2 * sizeof(int16_t));
+  fill_random(input, frames * 2);
+  int16_t* expected = malloc(frames * sizeof(int16_t));
+  downmix_to_mono_with_kernel(input, frames, 2, DOWNMIX_ALL_CHANNELS,
+    CPU_KERNEL_SCALAR, expected);
+  int16_t* output = malloc(frames * sizeof(int16_t));
+  for (int kernel = 0; kernel < CPU_KERNEL_COUNT; ++kernel) {
+    if (!cpu_kernel_is_supported(kernel)) {
+      continue;
+    }
+    TEST_CASE(cpu_kernel_name(kernel));
+    memset(output, 0, frames * sizeof(int16_t));
+    downmix_to_mono_with_kernel(input, frames, 2, DOWNMIX_ALL_CHANNELS,
+      kernel, output);
+    TEST_CHECK(memcmp(expected, output, frames * sizeof(int16_t)) == 0);
+
+    // Converting in place has to give the same result.
+    int16_t* in_place = malloc(frames * 2 * sizeof(int16_t));
+    memcpy(in_place, input, frames * 2 * sizeof(int16_t));
+    downmix_to_mono_with_kernel(in_place, frames, 2, DOWNMIX_ALL_CHANNELS,
+      kernel, in_place);
+    TEST_CHECK(memcmp(expected, in_place, frames * sizeof(int16_t)) == 0);
+    free(in_place);
+  }
+  free(output);
+  free(expected);
+  free(input);
+}
+
+void test_downmix_buffer() {
+  AudioBuffer* buffer = audio_buffer_alloc(16000, 3, 2);
+  const int16_t samples[] = { 10, 20, 30, 40, 50, 60 };
+  memcpy(buffer->data, samples, sizeof(samples));
+  downmix_buffer(buffer, DOWNMIX_ALL_CHANNELS);
+  TEST_INTEQ(1, buffer->channels);
+  TEST_INTEQ(3, buffer->samples_per_channel);
+  TEST_INTEQ(15, buffer->data[0]);
+  TEST_INTEQ(35, buffer->data[1]);
+  TEST_INTEQ(55, buffer->data[2]);
+  audio_buffer_free(buffer);
+}
+
+void test_downmix_benchmark() {
+  const int32_t frames = 48000 * 60;
+  int16_t* input = malloc(frames * 2 * sizeof(int16_t));
+  fill_random(input, frames * 2);
+  int16_t* output = malloc(frames * sizeof(int16_t));
+  printf("\n");
+  for (int kernel = 0; kernel < CPU_KERNEL_COUNT; ++kernel) {
+    if (!cpu_kernel_is_supported(kernel)) {
+      continue;
+    }
+    const double start_ms = time_now_ms();
+    downmix_to_mono_with_kernel(input, frames, 2, DOWNMIX_ALL_CHANNELS,
+      kernel, output);
+    const double elapsed_ms = time_now_ms() - start_ms;
+    printf("%s: stereo to mono, %.1fM frames/sec\n", cpu_kernel_name(kernel),
+      (frames / 1000.0) / (elapsed_ms + 0.0001));
+  }
+  free(output);
+  free(input);
+}
+
+TEST_LIST = {
+  {"downmix_stereo", test_downmix_stereo},
+  {"downmix_multichannel", test_downmix_multichannel},
+  {"downmix_kernels", test_downmix_kernels},
+  {"downmix_buffer", test_downmix_buffer},
+  {"downmix_benchmark", test_downmix_benchmark},
+  {NULL, NULL},
+};
@@ -0,0 +1,391 @@
+#include "resampler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CPU_FEATURES_HAS_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_HAS_AVX2)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+// How many zero crossings of the sinc are kept on each side of the center,
+// measured at the lower of the two rates. More gives a sharper cutoff, at the
+// cost of longer dot products.
+#define RESAMPLER_ZERO_CROSSINGS (8)
+// Where the pass band ends, as a fraction of the lower Nyquist frequency, so
+// the transition band fits below it and nothing aliases.
+#define RESAMPLER_ROLLOFF (0.92)
+// Gives around 80dB of stop band attenuation.
+#define RESAMPLER_KAISER_BETA (8.0)
+
+static float dot_scalar(const float* coefficients, const float* samples,
+  int32_t count) {
+  float result = 0.0f;
+  for (int32_t i = 0; i < count; ++i) {
+    result += coefficients[i] * samples[i];
+  }
+  return result;
+}
+
+#if defined(CPU_FEATURES_HAS_SSE2)
+static float dot_sse2(const float* coefficients, const float* samples,
+  int32_t count) {
+  __m128 sum0 = _mm_setzero_ps();
+  __m128 sum1 = _mm_setzero_ps();
+  for (int32_t i = 0; i < count; i += 8) {
+    sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(coefficients + i),
+      _mm_loadu_ps(samples + i)));
+    sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(coefficients + i + 4),
+      _mm_loadu_ps(samples + i + 4)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(sum0, sum1));
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+#if defined(CPU_FEATURES_HAS_AVX2)
+// Built for AVX2 regardless of the compiler flags, and only called after
+// checking the CPU supports it.
+__attribute__((target("avx2")))
+static float dot_avx2(const float* coefficients, const float* samples,
+  int32_t count) {
+  __m256 sum = _mm256_setzero_ps();
+  for (int32_t i = 0; i < count; i += 8) {
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(coefficients + i),
+      _mm256_loadu_ps(samples + i)));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, sum);
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+    ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+#endif
+
+#if defined(CPU_FEATURES_HAS_NEON)
+static float dot_neon(const float* coefficients, const float* samples,
+  int32_t count) {
+  float32x4_t sum0 = vdupq_n_f32(0.0f);
+  float32x4_t sum1 = vdupq_n_f32(0.0f);
+  for (int32_t i = 0; i < count; i += 8) {
+    sum0 = vmlaq_f32(sum0, vld1q_f32(coefficients + i),
+      vld1q_f32(samples + i));
+    sum1 = vmlaq_f32(sum1, vld1q_f32(coefficients + i + 4),
+      vld1q_f32(samples + i + 4));
+  }
+  const float32x4_t sum = vaddq_f32(sum0, sum1);
+  const float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+  return vget_lane_f32(vpadd_f32(half, half), 0);
+}
+#endif
+
+static ResamplerDotFunction dot_function(CpuKernel kernel) {
+  switch (kernel) {
+#if defined(CPU_FEATURES_HAS_SSE2)
+  case CPU_KERNEL_SSE2:
+    return dot_sse2;
+#endif
+#if defined(CPU_FEATURES_HAS_AVX2)
+  case CPU_KERNEL_AVX2:
+    return dot_avx2;
+#endif
+#if defined(CPU_FEATURES_HAS_NEON)
+  case CPU_KERNEL_NEON:
+    return dot_neon;
+#endif
+  default:
+    return dot_scalar;
+  }
+}
+
+bool resampler_set_kernel(Resampler* resampler, CpuKernel kernel) {
+  if (!cpu_kernel_is_supported(kernel)) {
+    return false;
+  }
+  resampler->kernel = kernel;
+  resampler->dot = dot_function(kernel);
+  return true;
+}
+
+static int32_t greatest_common_divisor(int32_t a, int32_t b) {
+  while (b != 0) {
+    const int32_t remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+  return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind, used by the
+// Kaiser window.
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 64; ++k) {
+    const double factor = x / (2.0 * k);
+    term *= factor * factor;
+    sum += term;
+    if (term < (sum * 1e-12)) {
+      break;
+    }
+  }
+  return sum;
+}
+
+// Designs the low-pass filter at the upsampled rate, and splits it into one
+// row of coefficients per phase. Each row is normalized to unity gain, so
+// flat input comes out at the same level whichever phase is used.
+static void build_coefficients(Resampler* resampler) {
+  const int32_t up = resampler->up_factor;
+  const int32_t down = resampler->down_factor;
+  const int32_t taps = resampler->taps_per_phase;
+  const int32_t max_factor = (up > down) ? up : down;
+  const double cutoff = (RESAMPLER_ROLLOFF * 0.5) / max_factor;
+  const double center = (taps * (double)(up)) / 2.0;
+  const double window_scale = 1.0 / bessel_i0(RESAMPLER_KAISER_BETA);
+
+  resampler->coefficients = calloc((size_t)(up) * taps, sizeof(float));
+  for (int32_t phase = 0; phase < up; ++phase) {
+    float* row = resampler->coefficients + ((size_t)(phase) * taps);
+    double row_sum = 0.0;
+    for (int32_t tap = 0; tap < taps; ++tap) {
+      const double offset = (phase + ((double)(tap) * up)) - center;
+      const double sinc_x = M_PI * 2.0 * cutoff * offset;
+      const double sinc = (offset == 0.0) ? 1.0 : (sin(sinc_x) / sinc_x);
+      const double ratio = offset / center;
+      const double window = bessel_i0(RESAMPLER_KAISER_BETA *
+        sqrt(fmax(0.0, 1.0 - (ratio * ratio)))) * window_scale;
+      const double value = sinc * window;
+      row[taps - 1 - tap] = value;
+      row_sum += value;
+    }
+    if (row_sum != 0.0) {
+      for (int32_t tap = 0; tap < taps; ++tap) {
+        row[tap] /= row_sum;
+      }
+    }
+  }
+}
+
+Resampler* resampler_alloc(int32_t input_rate, int32_t output_rate,
+  int32_t channels) {
+  if ((input_rate < RESAMPLER_MIN_RATE) || (input_rate > RESAMPLER_MAX_RATE) ||
+    (output_rate < RESAMPLER_MIN_RATE) || (output_rate > RESAMPLER_MAX_RATE)) {
+    fprintf(stderr, "Can't convert from %d Hz to %d Hz, rates must be "
+      "between %d and %d\n", input_rate, output_rate, RESAMPLER_MIN_RATE,
+      RESAMPLER_MAX_RATE);
+    return NULL;
+  }
+  if (channels <= 0) {
+    fprintf(stderr, "Can't resample audio with %d channels\n", channels);
+    return NULL;
+  }
+  Resampler* result = calloc(1, sizeof(Resampler));
+  result->input_rate = input_rate;
+  result->output_rate = output_rate;
+  result->channels = channels;
+  const int32_t divisor = greatest_common_divisor(input_rate, output_rate);
+  result->up_factor = output_rate / divisor;
+  result->down_factor = input_rate / divisor;
+
+  // The filter has to be longer when downsampling, since its cutoff is lower
+  // relative to the input rate.
+  const int32_t ratio = (result->down_factor + result->up_factor - 1) /
+    result->up_factor;
+  const int32_t taps = 2 * RESAMPLER_ZERO_CROSSINGS * ratio;
+  result->taps_per_phase = (taps + 7) & ~7;
+  build_coefficients(result);
+
+  // Start with a full filter's worth of silence before the first sample.
+  result->history = calloc(channels, sizeof(float*));
+  result->history_capacity = result->taps_per_phase * 2;
+  for (int32_t channel = 0; channel < channels; ++channel) {
+    result->history[channel] =
+      calloc(result->history_capacity, sizeof(float));
+  }
+  result->history_length = result->taps_per_phase;
+  result->history_start = -result->taps_per_phase;
+  result->input_count = 0;
+  result->output_count = 0;
+
+  resampler_set_kernel(result, cpu_best_kernel());
+  return result;
+}
+
+void resampler_free(Resampler* resampler) {
+  if (resampler == NULL) {
+    return;
+  }
+  for (int32_t channel = 0; channel < resampler->channels; ++channel) {
+    free(resampler->history[channel]);
+  }
+  free(resampler->history);
+  free(resampler->coefficients);
+  free(resampler);
+}
+
+int32_t resampler_max_output(const Resampler* resampler,
+  int32_t input_frames) {
+  const int64_t pending = input_frames + resampler->taps_per_phase;
+  return ((pending * resampler->up_factor) / resampler->down_factor) + 2;
+}
+
+static void reserve_history(Resampler* resampler, int32_t frames) {
+  const int32_t needed = resampler->history_length + frames;
+  if (needed <= resampler->history_capacity) {
+    return;
+  }
+  while (resampler->history_capacity < needed) {
+    resampler->history_capacity *= 2;
+  }
+  for (int32_t channel = 0; channel < resampler->channels; ++channel) {
+    resampler->history[channel] = realloc(resampler->history[channel],
+      resampler->history_capacity * sizeof(float));
+  }
+}
+
+static void append_input(Resampler* resampler, const int16_t* input,
+  int32_t input_frames) {
+  reserve_history(resampler, input_frames);
+  const int32_t channels = resampler->channels;
+  for (int32_t channel = 0; channel < channels; ++channel) {
+    float* history = resampler->history[channel] + resampler->history_length;
+    for (int32_t i = 0; i < input_frames; ++i) {
+      history[i] = input[(i * channels) + channel];
+    }
+  }
+  resampler->history_length += input_frames;
+  resampler->input_count += input_frames;
+}
+
+static int16_t round_to_int16(float value) {
+  const float rounded = (value >= 0.0f) ? (value + 0.5f) : (value - 0.5f);
+  if (rounded >= 32767.0f) {
+    return 32767;
+  }
+  else if (rounded <= -32768.0f) {
+    return -32768;
+  }
+  return (int16_t)(rounded);
+}
+
+// Output frame N is centered on input position N * down / up. The filter
+// covers `taps_per_phase` input samples ending at `base`, and its center is
+// half way along, which cancels out the filter delay.
+static void output_position(const Resampler* resampler, int64_t index,
+  int64_t* base, int32_t* phase) {
+  const int64_t upsampled = (index * resampler->down_factor) +
+    ((resampler->taps_per_phase * (int64_t)(resampler->up_factor)) / 2);
+  *base = upsampled / resampler->up_factor;
+  *phase = upsampled % resampler->up_factor;
+}
+
+// Writes every output frame whose input samples have all arrived, up to
+// `output_limit` frames in total, then drops history that's no longer needed.
+static int32_t write_ready_frames(Resampler* resampler, int64_t output_limit,
+  int16_t* output) {
+  const int32_t channels = resampler->channels;
+  const int32_t taps = resampler->taps_per_phase;
+  const int64_t available_end =
+    resampler->history_start + resampler->history_length;
+  int32_t written = 0;
+  while (resampler->output_count < output_limit) {
+    int64_t base;
+    int32_t phase;
+    output_position(resampler, resampler->output_count, &base, &phase);
+    if (base >= available_end) {
+      break;
+    }
+    const float* row = resampler->coefficients + ((size_t)(phase) * taps);
+    const int64_t offset = (base - taps + 1) - resampler->history_start;
+    for (int32_t channel = 0; channel < channels; ++channel) {
+      const float value =
+        resampler->dot(row, resampler->history[channel] + offset, taps);
+      output[(written * channels) + channel] = round_to_int16(value);
+    }
+    written += 1;
+    resampler->output_count += 1;
+  }
+
+  int64_t next_base;
+  int32_t next_phase;
+  output_position(resampler, resampler->output_count, &next_base,
+    &next_phase);
+  int64_t discard = (next_base - taps + 1) - resampler->history_start;
+  if (discard > resampler->history_length) {
+    discard = resampler->history_length;
+  }
+  if (discard > 0) {
+    const int32_t remaining = resampler->history_length - discard;
+    for (int32_t channel = 0; channel < channels; ++channel) {
+      float* history = resampler->history[channel];
+      memmove(history, history + discard, remaining * sizeof(float));
+    }
+    resampler->history_length = remaining;
+    resampler->history_start += discard;
+  }
+  return written;
+}
+
+int32_t resampler_process(Resampler* resampler, const int16_t* input,
+  int32_t input_frames, int16_t* output) {
+  append_input(resampler, input, input_frames);
+  return write_ready_frames(resampler, INT64_MAX, output);
+}
+
+int32_t resampler_flush(Resampler* resampler, int16_t* output) {
+  // Pad with silence so the last frames have a full filter's worth of
+  // input, but stop at the frame that lines up with the end of the input.
+  const int32_t padding = resampler->taps_per_phase;
+  reserve_history(resampler, padding);
+  for (int32_t channel = 0; channel < resampler->channels; ++channel) {
+    memset(resampler->history[channel] + resampler->history_length, 0,
+      padding * sizeof(float));
+  }
+  resampler->history_length += padding;
+  const int64_t output_end =
+    ((resampler->input_count * resampler->up_factor) +
+      resampler->down_factor - 1) / resampler->down_factor;
+  return write_ready_frames(resampler, output_end, output);
+}
+
+AudioBuffer* resampler_resample_buffer(const AudioBuffer* input,
+  int32_t output_rate) {
+  Resampler* resampler = resampler_alloc(input->sample_rate, output_rate,
+    input->channels);
+  if (resampler == NULL) {
+    return NULL;
+  }
+  const int32_t max_frames =
+    resampler_max_output(resampler, input->samples_per_channel) +
+    resampler_max_output(resampler, 0);
+  AudioBuffer* result = audio_buffer_alloc(output_rate, max_frames,
+    input->channels);
+  // Working through the input in blocks keeps the float history small.
+  const int32_t block_size = 16384;
+  int32_t frames = 0;
+  for (int32_t start = 0; start < input->samples_per_channel;
+    start += block_size) {
+    int32_t block_frames = input->samples_per_channel - start;
+    if (block_frames > block_size) {
+      block_frames = block_size;
+    }
+    frames += resampler_process(resampler,
+      input->data + ((size_t)(start) * input->channels), block_frames,
+      result->data + ((size_t)(frames) * input->channels));
+  }
+  frames += resampler_flush(resampler,
+    result->data + ((size_t)(frames) * input->channels));
+  result->samples_per_channel = frames;
+  resampler_free(resampler);
+  return result;
+}
@@ -0,0 +1,76 @@
+#ifndef INCLUDE_RESAMPLER_H
+#define INCLUDE_RESAMPLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_buffer.h"
+#include "cpu_features.h"
+
+// Rates outside this range are refused, since the filter needed to convert
+// between them and a typical model rate would be enormous.
+#define RESAMPLER_MIN_RATE (1000)
+#define RESAMPLER_MAX_RATE (384000)
+
+typedef float (*ResamplerDotFunction)(const float* coefficients,
+  const float* samples, int32_t count);
+
+// Streaming polyphase sample rate converter. The ratio between the two rates
+// is reduced to `up_factor / down_factor`, and a windowed-sinc low-pass filter
+// is split into `up_factor` phases, so each output sample only needs one
+// short dot product over the most recent input samples. The filter delay is
+// compensated for, so output sample N lines up with input time N / rate, and
+// token timestamps from a decoder stay correct.
+typedef struct ResamplerStruct {
+  int32_t input_rate;
+  int32_t output_rate;
+  int32_t channels;
+  int32_t up_factor;
+  int32_t down_factor;
+  // Always a multiple of eight, so the SIMD kernels never need a tail loop.
+  int32_t taps_per_phase;
+  // `up_factor` rows of `taps_per_phase` coefficients, reversed so they can be
+  // applied directly to samples in the order they arrived.
+  float* coefficients;
+  // One buffer per channel of the input samples that may still be needed,
+  // converted to float. `history_start` is the index in the whole input
+  // stream of the first sample held.
+  float** history;
+  int32_t history_length;
+  int32_t history_capacity;
+  int64_t history_start;
+  int64_t input_count;
+  int64_t output_count;
+  CpuKernel kernel;
+  ResamplerDotFunction dot;
+} Resampler;
+
+// Uses the fastest dot product kernel the CPU supports. Returns NULL if either
+// rate is outside the supported range, or there are no channels.
+Resampler* resampler_alloc(int32_t input_rate, int32_t output_rate,
+  int32_t channels);
+void resampler_free(Resampler* resampler);
+
+// The most frames that a call to resampler_process() with `input_frames`
+// frames, or to resampler_flush() with zero, can write out.
+int32_t resampler_max_output(const Resampler* resampler,
+  int32_t input_frames);
+
+// Converts interleaved frames from `input`, writing as many interleaved output
+// frames as the input received so far allows, and returns how many that was.
+int32_t resampler_process(Resampler* resampler, const int16_t* input,
+  int32_t input_frames, int16_t* output);
+
+// Call once the input has ended, to write out the frames that were waiting
+// on future input samples.
+int32_t resampler_flush(Resampler* resampler, int16_t* output);
+
+// Switches to a particular kernel, returning false if it isn't supported.
+bool resampler_set_kernel(Resampler* resampler, CpuKernel kernel);
+
+// Converts a whole buffer in one go, returning a new buffer at `output_rate`,
+// or NULL if the rates aren't supported.
+AudioBuffer* resampler_resample_buffer(const AudioBuffer* input,
+  int32_t output_rate);
+
+#endif  // INCLUDE_RESAMPLER_H
@@ -0,0 +1,273 @@
+#include "acutest.h"
+
+#include "resampler.c"
+
+#include "time_utils.h"
+
+static void fill_tone(int16_t* data, int32_t count, int32_t channels,
+  float frequency, int32_t sample_rate, float amplitude) {
+  for (int32_t i = 0; i < count; ++i) {
+    const float value = amplitude * sinf((2.0f * M_PI * frequency * i) /
+      sample_rate);
+    for (int32_t channel = 0; channel < channels; ++channel) {
+      data[(i * channels) + channel] = (int16_t)(value);
+    }
+  }
+}
+
+// Largest difference from the expected tone, ignoring the edges where the
+// filter runs into the silence before and after the input.
+static float max_tone_error(const int16_t* data, int32_t count,
+  float frequency, int32_t sample_rate, float amplitude) {
+  const int32_t margin = sample_rate / 100;
+  float result = 0.0f;
+  for (int32_t i = margin; i < (count - margin); ++i) {
+    const float expected = amplitude * sinf((2.0f * M_PI * frequency * i) /
+      sample_rate);
+    const float error = fabsf(data[i] - expected);
+    if (error > result) {
+      result = error;
+    }
+  }
+  return result;
+}
+
+static float rms(const int16_t* data, int32_t count) {
+  double total = 0.0;
+  for (int32_t i = 0; i < count; ++i) {
+    total += (double)(data[i]) * data[i];
+  }
+  return sqrt(total / count);
+}
+
+static int32_t resample_all(Resampler* resampler, const int16_t* input,
+  int32_t input_frames, int32_t block_size, int16_t* output) {
+  const int32_t channels = resampler->channels;
+  int32_t written = 0;
+  for (int32_t start = 0; start < input_frames; start += block_size) {
+    int32_t frames = input_frames - start;
+    if (frames > block_size) {
+      frames = block_size;
+    }
+    const int32_t max_output = resampler_max_output(resampler, frames);
+    const int32_t block_written = resampler_process(resampler,
+      input + (start * channels), frames, output + (written * channels));
+    TEST_CHECK(block_written <= max_output);
+    written += block_written;
+  }
+  written += resampler_flush(resampler, output + (written * channels));
+  return written;
+}
+
+void test_resampler_alloc() {
+  Resampler* resampler = resampler_alloc(48000, 16000, 1);
+  TEST_INTEQ(1, resampler->up_factor);
+  TEST_INTEQ(3, resampler->down_factor);
+  TEST_INTEQ(48, resampler->taps_per_phase);
+  resampler_free(resampler);
+
+  resampler = resampler_alloc(44100, 16000, 2);
+  TEST_INTEQ(160, resampler->up_factor);
+  TEST_INTEQ(441, resampler->down_factor);
+  TEST_INTEQ(0, resampler->taps_per_phase % 8);
+  resampler_free(resampler);
+
+  resampler = resampler_alloc(8000, 16000, 1);
+  TEST_INTEQ(2, resampler->up_factor);
+  TEST_INTEQ(1, resampler->down_factor);
+  TEST_INTEQ(16, resampler->taps_per_phase);
+  resampler_free(resampler);
+
+  TEST_CHECK(resampler_alloc(0, 16000, 1) == NULL);
+  TEST_CHECK(resampler_alloc(INT32_MAX, 16000, 1) == NULL);
+  TEST_CHECK(resampler_alloc(48000, 16000, 0) == NULL);
+}
+
+void test_resampler_tones() {
+  const int32_t input_rates[] = { 8000, 11025, 22050, 32000, 44100, 48000 };
+  const int input_rates_length = sizeof(input_rates) / sizeof(input_rates[0]);
+  const int32_t output_rate = 16000;
+  const float amplitude = 10000.0f;
+  const float frequency = 440.0f;
+  for (int i = 0; i < input_rates_length; ++i) {
+    const int32_t input_rate = input_rates[i];
+    TEST_CASE_("%d", input_rate);
+    const int32_t input_frames = input_rate;
+    int16_t* input = malloc(input_frames * sizeof(int16_t));
+    fill_tone(input, input_frames, 1, frequency, input_rate, amplitude);
+
+    Resampler* resampler = resampler_alloc(input_rate, output_rate, 1);
+    int16_t* output = malloc((resampler_max_output(resampler, input_frames) +
+      resampler_max_output(resampler, 0)) * sizeof(int16_t));
+    const int32_t output_frames =
+      resample_all(resampler, input, input_frames, 1000, output);
+    TEST_INTEQ(output_rate, output_frames);
+    const float error = max_tone_error(output, output_frames, frequency,
+      output_rate, amplitude);
+    TEST_CHECK(error < 100.0f);
+    TEST_MSG("Error was %f", error);
+
+    resampler_free(resampler);
+    free(output);
+    free(input);
+  }
+}
+
+void test_resampler_anti_aliasing() {
+  // A 12KHz tone is above the 8KHz Nyquist limit of the output, so it should
+  // be filtered out rather than folding back down to 4KHz.
+  const int32_t input_frames = 48000;
+  int16_t* input = malloc(input_frames * sizeof(int16_t));
+  fill_tone(input, input_frames, 1, 12000.0f, 48000, 10000.0f);
+  Resampler* resampler = resampler_alloc(48000, 16000, 1);
+  int16_t* output = malloc((resampler_max_output(resampler, input_frames) +
+    resampler_max_output(resampler, 0)) * sizeof(int16_t));
+  const int32_t output_frames =
+    resample_all(resampler, input, input_frames, 4096, output);
+  TEST_INTEQ(16000, output_frames);
+  const float output_rms = rms(output + 160, output_frames - 320);
+  TEST_CHECK(output_rms < 10.0f);
+  TEST_MSG("RMS was %f", output_rms);
+  resampler_free(resampler);
+  free(output);
+  free(input);
+}
+
+void test_resampler_block_sizes() {
+  // The output shouldn't depend on how the input is split up, and each
+  // channel should be converted independently.
+  const int32_t input_frames = 44100;
+  int16_t* input = malloc(input_frames * 2 * sizeof(int16_t));
+  fill_tone(input, input_frames, 2, 1000.0f, 44100, 8000.0f);
+  for (int i = 0; i < input_frames; ++i) {
+    input[(i * 2) + 1] = -input[(i * 2) + 1];
+  }
+
+  Resampler* resampler = resampler_alloc(44100, 16000, 2);
+  const int32_t max_frames = resampler_max_output(resampler, input_frames) +
+    resampler_max_output(resampler, 0);
+  int16_t* expected = malloc(max_frames * 2 * sizeof(int16_t));
+  const int32_t expected_frames =
+    resample_all(resampler, input, input_frames, input_frames, expected);
+  resampler_free(resampler);
+  TEST_INTEQ(16000, expected_frames);
+
+  const int32_t block_sizes[] = { 1, 7, 160, 441, 10000 };
+  const int block_sizes_length = sizeof(block_sizes) / sizeof(block_sizes[0]);
+  int16_t* output = malloc(max_frames * 2 * sizeof(int16_t));
+  for (int i = 0; i < block_sizes_length; ++i) {
+    TEST_CASE_("%d", block_sizes[i]);
+    resampler = resampler_alloc(44100, 16000, 2);
+    const int32_t output_frames =
+      resample_all(resampler, input, input_frames, block_sizes[i], output);
+    TEST_INTEQ(expected_frames, output_frames);
+    TEST_CHECK(memcmp(expected, output,
+      expected_frames * 2 * sizeof(int16_t)) == 0);
+    resampler_free(resampler);
+  }
+  for (int i = 0; i < expected_frames; ++i) {
+    if (!TEST_CHECK(expected[i * 2] == -expected[(i * 2) + 1])) {
+      TEST_MSG("Channels differ at %d", i);
+      break;
+    }
+  }
+
+  free(output);
+  free(expected);
+  free(input);
+}
+
+void test_resampler_kernels() {
+  TEST_CHECK(cpu_kernel_is_supported(CPU_KERNEL_SCALAR));
+  const int32_t input_frames = 48000;
+  int16_t* input = malloc(input_frames * sizeof(int16_t));
+  fill_tone(input, input_frames, 1, 300.0f, 48000, 20000.0f);
+  Resampler* resampler = resampler_alloc(48000, 16000, 1);
+  const int32_t max_frames = resampler_max_output(resampler, input_frames) +
+    resampler_max_output(resampler, 0);
+  int16_t* expected = malloc(max_frames * sizeof(int16_t));
+  TEST_CHECK(resampler_set_kernel(resampler, CPU_KERNEL_SCALAR));
+  const int32_t expected_frames =
+    resample_all(resampler, input, input_frames, 1024, expected);
+  resampler_free(resampler);
+
+  int16_t* output = malloc(max_frames * sizeof(int16_t));
+  for (int kernel = 0; kernel < CPU_KERNEL_COUNT; ++kernel) {
+    if (!cpu_kernel_is_supported(kernel)) {
+      continue;
+    }
+    TEST_CASE(cpu_kernel_name(kernel));
+    resampler = resampler_alloc(48000, 16000, 1);
+    TEST_CHECK(resampler_set_kernel(resampler, kernel));
+    const int32_t output_frames =
+      resample_all(resampler, input, input_frames, 1024, output);
+    TEST_INTEQ(expected_frames, output_frames);
+    // Summing in a different order can change the rounding slightly.
+    for (int i = 0; i < expected_frames; ++i) {
+      if (!TEST_CHECK(abs(expected[i] - output[i]) <= 1)) {
+        TEST_MSG("Mismatch at %d: %d vs %d", i, expected[i], output[i]);
+        break;
+      }
+    }
+    resampler_free(resampler);
+  }
+  free(output);
+  free(expected);
+  free(input);
+}
+
+void test_resampler_resample_buffer() {
+  AudioBuffer* input = audio_buffer_alloc(8000, 4000, 1);
+  fill_tone(input->data, 4000, 1, 500.0f, 8000, 5000.0f);
+  AudioBuffer* output = resampler_resample_buffer(input, 16000);
+  TEST_INTEQ(16000, output->sample_rate);
+  TEST_INTEQ(1, output->channels);
+  TEST_INTEQ(8000, output->samples_per_channel);
+  const float error = max_tone_error(output->data, output->samples_per_channel,
+    500.0f, 16000, 5000.0f);
+  TEST_CHECK(error < 100.0f);
+  TEST_MSG("Error was %f", error);
+  audio_buffer_free(output);
+  audio_buffer_free(input);
+}
+
+void test_resampler_benchmark() {
+  const int32_t input_rate = 48000;
+  const int32_t input_frames = input_rate * 10;
+  const int32_t block_size = 4800;
+  int16_t* input = malloc(input_frames * sizeof(int16_t));
+  fill_tone(input, input_frames, 1, 440.0f, input_rate, 10000.0f);
+  printf("\n");
+  for (int kernel = 0; kernel < CPU_KERNEL_COUNT; ++kernel) {
+    if (!cpu_kernel_is_supported(kernel)) {
+      continue;
+    }
+    Resampler* resampler = resampler_alloc(input_rate, 16000, 1);
+    resampler_set_kernel(resampler, kernel);
+    int16_t* output =
+      malloc(resampler_max_output(resampler, block_size) * sizeof(int16_t));
+    const double start_ms = time_now_ms();
+    for (int32_t start = 0; start < input_frames; start += block_size) {
+      resampler_process(resampler, input + start, block_size, output);
+    }
+    resampler_flush(resampler, output);
+    const double elapsed_ms = time_now_ms() - start_ms;
+    printf("%s: 48KHz to 16KHz, %.1fM input samples/sec\n",
+      cpu_kernel_name(kernel),
+      (input_frames / 1000.0) / (elapsed_ms + 0.0001));
+    free(output);
+    resampler_free(resampler);
+  }
+  free(input);
+}
+
+TEST_LIST = {
+  {"resampler_alloc", test_resampler_alloc},
+  {"resampler_tones", test_resampler_tones},
+  {"resampler_anti_aliasing", test_resampler_anti_aliasing},
+  {"resampler_block_sizes", test_resampler_block_sizes},
+  {"resampler_kernels", test_resampler_kernels},
+  {"resampler_resample_buffer", test_resampler_resample_buffer},
+  {"resampler_benchmark", test_resampler_benchmark},
+  {NULL, NULL},
+};
@@ -0,0 +1,298 @@
+#include "sample_convert.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(CPU_FEATURES_HAS_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_HAS_AVX2)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+int32_t sample_format_bytes(SampleFormat format) {
+  switch (format) {
+  case SAMPLE_FORMAT_S16:
+    return 2;
+  case SAMPLE_FORMAT_U8:
+    return 1;
+  case SAMPLE_FORMAT_S24:
+    return 3;
+  case SAMPLE_FORMAT_S32:
+    return 4;
+  case SAMPLE_FORMAT_F32:
+    return 4;
+  case SAMPLE_FORMAT_F64:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+const char* sample_format_name(SampleFormat format) {
+  switch (format) {
+  case SAMPLE_FORMAT_S16:
+    return "16-bit integer";
+  case SAMPLE_FORMAT_U8:
+    return "8-bit integer";
+  case SAMPLE_FORMAT_S24:
+    return "24-bit integer";
+  case SAMPLE_FORMAT_S32:
+    return "32-bit integer";
+  case SAMPLE_FORMAT_F32:
+    return "32-bit float";
+  case SAMPLE_FORMAT_F64:
+    return "64-bit float";
+  default:
+    return "unknown";
+  }
+}
+
+// Clamping before the conversion keeps it in range, and also turns NaNs into
+// the minimum value, the same way the SIMD max instructions do.
+static int16_t float_to_int16(float value) {
+  float scaled = value * 32768.0f;
+  if (!(scaled > -32768.0f)) {
+    scaled = -32768.0f;
+  }
+  if (scaled > 32767.0f) {
+    scaled = 32767.0f;
+  }
+  // Uses the current rounding mode, which is round-to-nearest-even like the
+  // SIMD conversions.
+  return (int16_t)(lrintf(scaled));
+}
+
+// Each of these handles as many samples as it can in whole vectors and
+// returns how many that was, leaving the rest for the scalar loop.
+static int32_t convert_f32_scalar(const float* input, int32_t start,
+  int32_t count, int16_t* output) {
+  for (int32_t i = start; i < count; ++i) {
+    output[i] = float_to_int16(input[i]);
+  }
+  return count;
+}
+
+static int32_t convert_s32_scalar(const int32_t* input, int32_t start,
+  int32_t count, int16_t* output) {
+  for (int32_t i = start; i < count; ++i) {
+    output[i] = (int16_t)(input[i] >> 16);
+  }
+  return count;
+}
+
+#if defined(CPU_FEATURES_HAS_SSE2)
+static int32_t convert_f32_sse2(const float* input, int32_t count,
+  int16_t* output) {
+  const __m128 scale = _mm_set1_ps(32768.0f);
+  const __m128 minimum = _mm_set1_ps(-32768.0f);
+  const __m128 maximum = _mm_set1_ps(32767.0f);
+  int32_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    __m128 first = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+    __m128 second = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+    first = _mm_min_ps(_mm_max_ps(first, minimum), maximum);
+    second = _mm_min_ps(_mm_max_ps(second, minimum), maximum);
+    _mm_storeu_si128((__m128i*)(output + i), _mm_packs_epi32(
+      _mm_cvtps_epi32(first), _mm_cvtps_epi32(second)));
+  }
+  return i;
+}
+
+static int32_t convert_s32_sse2(const int32_t* input, int32_t count,
+  int16_t* output) {
+  int32_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    const __m128i first = _mm_srai_epi32(
+      _mm_loadu_si128((const __m128i*)(input + i)), 16);
+    const __m128i second = _mm_srai_epi32(
+      _mm_loadu_si128((const __m128i*)(input + i + 4)), 16);
+    _mm_storeu_si128((__m128i*)(output + i), _mm_packs_epi32(first, second));
+  }
+  return i;
+}
+#endif
+
+#if defined(CPU_FEATURES_HAS_AVX2)
+// Packing works within each 128-bit half, so the middle two quarters of the
+// result have to be swapped back into order.
+__attribute__((target("avx2")))
+static void store_packed_avx2(__m256i first, __m256i second,
+  int16_t* output) {
+  const __m256i packed = _mm256_packs_epi32(first, second);
+  _mm256_storeu_si256((__m256i*)(output),
+    _mm256_permute4x64_epi64(packed, 0xd8));
+}
+
+__attribute__((target("avx2")))
+static int32_t convert_f32_avx2(const float* input, int32_t count,
+  int16_t* output) {
+  const __m256 scale = _mm256_set1_ps(32768.0f);
+  const __m256 minimum = _mm256_set1_ps(-32768.0f);
+  const __m256 maximum = _mm256_set1_ps(32767.0f);
+  int32_t i = 0;
+  for (; (i + 16) <= count; i += 16) {
+    __m256 first = _mm256_mul_ps(_mm256_loadu_ps(input + i), scale);
+    __m256 second = _mm256_mul_ps(_mm256_loadu_ps(input + i + 8), scale);
+    first = _mm256_min_ps(_mm256_max_ps(first, minimum), maximum);
+    second = _mm256_min_ps(_mm256_max_ps(second, minimum), maximum);
+    store_packed_avx2(_mm256_cvtps_epi32(first), _mm256_cvtps_epi32(second),
+      output + i);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int32_t convert_s32_avx2(const int32_t* input, int32_t count,
+  int16_t* output) {
+  int32_t i = 0;
+  for (; (i + 16) <= count; i += 16) {
+    const __m256i first = _mm256_srai_epi32(
+      _mm256_loadu_si256((const __m256i*)(input + i)), 16);
+    const __m256i second = _mm256_srai_epi32(
+      _mm256_loadu_si256((const __m256i*)(input + i + 8)), 16);
+    store_packed_avx2(first, second, output + i);
+  }
+  return i;
+}
+#endif
+
+#if defined(CPU_FEATURES_HAS_NEON)
+// 32-bit ARM only has a float conversion that truncates, which wouldn't
+// match the other kernels, so float input falls back to scalar code there.
+#if defined(__aarch64__)
+static int32_t convert_f32_neon(const float* input, int32_t count,
+  int16_t* output) {
+  const float32x4_t scale = vdupq_n_f32(32768.0f);
+  const float32x4_t minimum = vdupq_n_f32(-32768.0f);
+  const float32x4_t maximum = vdupq_n_f32(32767.0f);
+  int32_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    float32x4_t first = vmulq_f32(vld1q_f32(input + i), scale);
+    float32x4_t second = vmulq_f32(vld1q_f32(input + i + 4), scale);
+    first = vminq_f32(vmaxq_f32(first, minimum), maximum);
+    second = vminq_f32(vmaxq_f32(second, minimum), maximum);
+    vst1q_s16(output + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(first)),
+      vqmovn_s32(vcvtnq_s32_f32(second))));
+  }
+  return i;
+}
+#endif
+
+static int32_t convert_s32_neon(const int32_t* input, int32_t count,
+  int16_t* output) {
+  int32_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    vst1q_s16(output + i, vcombine_s16(vshrn_n_s32(vld1q_s32(input + i), 16),
+      vshrn_n_s32(vld1q_s32(input + i + 4), 16)));
+  }
+  return i;
+}
+#endif
+
+static void convert_f32(const float* input, int32_t count, CpuKernel kernel,
+  int16_t* output) {
+  int32_t done = 0;
+  switch (kernel) {
+#if defined(CPU_FEATURES_HAS_SSE2)
+  case CPU_KERNEL_SSE2:
+    done = convert_f32_sse2(input, count, output);
+    break;
+#endif
+#if defined(CPU_FEATURES_HAS_AVX2)
+  case CPU_KERNEL_AVX2:
+    done = convert_f32_avx2(input, count, output);
+    break;
+#endif
+#if defined(CPU_FEATURES_HAS_NEON) && defined(__aarch64__)
+  case CPU_KERNEL_NEON:
+    done = convert_f32_neon(input, count, output);
+    break;
+#endif
+  default:
+    break;
+  }
+  convert_f32_scalar(input, done, count, output);
+}
+
+static void convert_s32(const int32_t* input, int32_t count, CpuKernel kernel,
+  int16_t* output) {
+  int32_t done = 0;
+  switch (kernel) {
+#if defined(CPU_FEATURES_HAS_SSE2)
+  case CPU_KERNEL_SSE2:
+    done = convert_s32_sse2(input, count, output);
+    break;
+#endif
+#if defined(CPU_FEATURES_HAS_AVX2)
+  case CPU_KERNEL_AVX2:
+    done = convert_s32_avx2(input, count, output);
+    break;
+#endif
+#if defined(CPU_FEATURES_HAS_NEON)
+  case CPU_KERNEL_NEON:
+    done = convert_s32_neon(input, count, output);
+    break;
+#endif
+  default:
+    break;
+  }
+  convert_s32_scalar(input, done, count, output);
+}
+
+static void convert_u8(const uint8_t* input, int32_t count,
+  int16_t* output) {
+  for (int32_t i = 0; i < count; ++i) {
+    output[i] = (int16_t)((input[i] - 128) * 256);
+  }
+}
+
+// Only the top two bytes of each sample are needed.
+static void convert_s24(const uint8_t* input, int32_t count,
+  int16_t* output) {
+  for (int32_t i = 0; i < count; ++i) {
+    const uint8_t* sample = input + (i * 3);
+    output[i] = (int16_t)(sample[1] | (sample[2] << 8));
+  }
+}
+
+static void convert_f64(const double* input, int32_t count,
+  int16_t* output) {
+  for (int32_t i = 0; i < count; ++i) {
+    output[i] = float_to_int16((float)(input[i]));
+  }
+}
+
+void sample_convert_with_kernel(SampleFormat format, const void* input,
+  int32_t count, CpuKernel kernel, int16_t* output) {
+  switch (format) {
+  case SAMPLE_FORMAT_S16:
+    memmove(output, input, count * sizeof(int16_t));
+    break;
+  case SAMPLE_FORMAT_U8:
+    convert_u8((const uint8_t*)(input), count, output);
+    break;
+  case SAMPLE_FORMAT_S24:
+    convert_s24((const uint8_t*)(input), count, output);
+    break;
+  case SAMPLE_FORMAT_S32:
+    convert_s32((const int32_t*)(input), count, kernel, output);
+    break;
+  case SAMPLE_FORMAT_F32:
+    convert_f32((const float*)(input), count, kernel, output);
+    break;
+  case SAMPLE_FORMAT_F64:
+    convert_f64((const double*)(input), count, output);
+    break;
+  }
+}
+
+void sample_convert(SampleFormat format, const void* input, int32_t count,
+  int16_t* output) {
+  sample_convert_with_kernel(format, input, count, cpu_best_kernel(), output);
+}
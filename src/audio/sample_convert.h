@@ -0,0 +1,34 @@
+#ifndef INCLUDE_SAMPLE_CONVERT_H
+#define INCLUDE_SAMPLE_CONVERT_H
+
+#include <stdint.h>
+
+#include "cpu_features.h"
+
+// The little-endian sample encodings that can be read from WAV files.
+typedef enum SampleFormatEnum {
+  SAMPLE_FORMAT_S16 = 0,
+  SAMPLE_FORMAT_U8,
+  SAMPLE_FORMAT_S24,
+  SAMPLE_FORMAT_S32,
+  SAMPLE_FORMAT_F32,
+  SAMPLE_FORMAT_F64,
+} SampleFormat;
+
+int32_t sample_format_bytes(SampleFormat format);
+const char* sample_format_name(SampleFormat format);
+
+// Converts `count` samples to 16-bit. Integer formats keep their top bits,
+// and float samples are scaled so that 1.0 is full scale, rounded to the
+// nearest value, and clamped. No dither is added, so the results are
+// repeatable. The 32-bit formats have SIMD versions, since those are what
+// most audio editors export.
+void sample_convert(SampleFormat format, const void* input, int32_t count,
+  int16_t* output);
+
+// Same as sample_convert(), but using a particular kernel, which must be
+// supported on this CPU.
+void sample_convert_with_kernel(SampleFormat format, const void* input,
+  int32_t count, CpuKernel kernel, int16_t* output);
+
+#endif  // INCLUDE_SAMPLE_CONVERT_H
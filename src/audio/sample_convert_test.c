@@ -0,0 +1,144 @@
+#include "acutest.h"
+
+#include "sample_convert.c"
+
+#include <stdlib.h>
+
+#include "time_utils.h"
+
+void test_sample_format_bytes() {
+  TEST_INTEQ(2, sample_format_bytes(SAMPLE_FORMAT_S16));
+  TEST_INTEQ(1, sample_format_bytes(SAMPLE_FORMAT_U8));
+  TEST_INTEQ(3, sample_format_bytes(SAMPLE_FORMAT_S24));
+  TEST_INTEQ(4, sample_format_bytes(SAMPLE_FORMAT_S32));
+  TEST_INTEQ(4, sample_format_bytes(SAMPLE_FORMAT_F32));
+  TEST_INTEQ(8, sample_format_bytes(SAMPLE_FORMAT_F64));
+  TEST_STREQ("32-bit float", sample_format_name(SAMPLE_FORMAT_F32));
+}
+
+void test_sample_convert_integers() {
+  const uint8_t u8[] = { 0, 128, 255, 1 };
+  int16_t output[4];
+  sample_convert(SAMPLE_FORMAT_U8, u8, 4, output);
+  TEST_INTEQ(-32768, output[0]);
+  TEST_INTEQ(0, output[1]);
+  TEST_INTEQ(32512, output[2]);
+  TEST_INTEQ(-32512, output[3]);
+
+  const uint8_t s24[] = {
+    0xff, 0x34, 0x12,
+    0x00, 0x00, 0x80,
+    0xff, 0xff, 0x7f,
+    0xff, 0xff, 0xff,
+  };
+  sample_convert(SAMPLE_FORMAT_S24, s24, 4, output);
+  TEST_INTEQ(0x1234, output[0]);
+  TEST_INTEQ(-32768, output[1]);
+  TEST_INTEQ(32767, output[2]);
+  TEST_INTEQ(-1, output[3]);
+
+  const int32_t s32[] = { 0x12345678, INT32_MIN, INT32_MAX, -1 };
+  sample_convert(SAMPLE_FORMAT_S32, s32, 4, output);
+  TEST_INTEQ(0x1234, output[0]);
+  TEST_INTEQ(-32768, output[1]);
+  TEST_INTEQ(32767, output[2]);
+  TEST_INTEQ(-1, output[3]);
+
+  const int16_t s16[] = { 1, -2, 3 };
+  sample_convert(SAMPLE_FORMAT_S16, s16, 3, output);
+  TEST_CHECK(memcmp(s16, output, sizeof(s16)) == 0);
+}
+
+void test_sample_convert_floats() {
+  const float f32[] = { 0.0f, 0.5f, -0.5f, 1.0f, -1.0f, 2.0f, -2.0f, NAN,
+    1.0f / 65536.0f, 3.0f / 65536.0f };
+  const int count = sizeof(f32) / sizeof(f32[0]);
+  int16_t output[10];
+  sample_convert(SAMPLE_FORMAT_F32, f32, count, output);
+  TEST_INTEQ(0, output[0]);
+  TEST_INTEQ(16384, output[1]);
+  TEST_INTEQ(-16384, output[2]);
+  TEST_INTEQ(32767, output[3]);
+  TEST_INTEQ(-32768, output[4]);
+  TEST_INTEQ(32767, output[5]);
+  TEST_INTEQ(-32768, output[6]);
+  TEST_INTEQ(-32768, output[7]);
+  // Halves round to the nearest even value.
+  TEST_INTEQ(0, output[8]);
+  TEST_INTEQ(2, output[9]);
+
+  const double f64[] = { 0.25, -0.25, 1.5 };
+  sample_convert(SAMPLE_FORMAT_F64, f64, 3, output);
+  TEST_INTEQ(8192, output[0]);
+  TEST_INTEQ(-8192, output[1]);
+  TEST_INTEQ(32767, output[2]);
+}
+
+void test_sample_convert_kernels() {
+  // An odd length makes sure the scalar tail after the vector loop is used,
+  // and the range goes past full scale to test clamping.
+  const int32_t count = 1001;
+  float* f32 = malloc(count * sizeof(float));
+  int32_t* s32 = malloc(count * sizeof(int32_t));
+  srand(11);
+  for (int32_t i = 0; i < count; ++i) {
+    f32[i] = ((rand() / (float)(RAND_MAX)) * 2.4f) - 1.2f;
+    s32[i] = (int32_t)((uint32_t)(rand()) * 2654435761u);
+  }
+  f32[17] = NAN;
+  int16_t* expected_f32 = malloc(count * sizeof(int16_t));
+  int16_t* expected_s32 = malloc(count * sizeof(int16_t));
+  sample_convert_with_kernel(SAMPLE_FORMAT_F32, f32, count,
+    CPU_KERNEL_SCALAR, expected_f32);
+  sample_convert_with_kernel(SAMPLE_FORMAT_S32, s32, count,
+    CPU_KERNEL_SCALAR, expected_s32);
+
+  int16_t* output = malloc(count * sizeof(int16_t));
+  for (int kernel = 0; kernel < CPU_KERNEL_COUNT; ++kernel) {
+    if (!cpu_kernel_is_supported(kernel)) {
+      continue;
+    }
+    TEST_CASE(cpu_kernel_name(kernel));
+    sample_convert_with_kernel(SAMPLE_FORMAT_F32, f32, count, kernel, output);
+    TEST_CHECK(memcmp(expected_f32, output, count * sizeof(int16_t)) == 0);
+    sample_convert_with_kernel(SAMPLE_FORMAT_S32, s32, count, kernel, output);
+    TEST_CHECK(memcmp(expected_s32, output, count * sizeof(int16_t)) == 0);
+  }
+  free(output);
+  free(expected_s32);
+  free(expected_f32);
+  free(s32);
+  free(f32);
+}
+
+void test_sample_convert_benchmark() {
+  const int32_t count = 48000 * 60;
+  float* input = malloc(count * sizeof(float));
+  for (int32_t i = 0; i < count; ++i) {
+    input[i] = sinf(i * 0.01f) * 0.8f;
+  }
+  int16_t* output = malloc(count * sizeof(int16_t));
+  printf("\n");
+  for (int kernel = 0; kernel < CPU_KERNEL_COUNT; ++kernel) {
+    if (!cpu_kernel_is_supported(kernel)) {
+      continue;
+    }
+    const double start_ms = time_now_ms();
+    sample_convert_with_kernel(SAMPLE_FORMAT_F32, input, count, kernel,
+      output);
+    const double elapsed_ms = time_now_ms() - start_ms;
+    printf("%s: float to 16-bit, %.1fM samples/sec\n",
+      cpu_kernel_name(kernel), (count / 1000.0) / (elapsed_ms + 0.0001));
+  }
+  free(output);
+  free(input);
+}
+
+TEST_LIST = {
+  {"sample_format_bytes", test_sample_format_bytes},
+  {"sample_convert_integers", test_sample_convert_integers},
+  {"sample_convert_floats", test_sample_convert_floats},
+  {"sample_convert_kernels", test_sample_convert_kernels},
+  {"sample_convert_benchmark", test_sample_convert_benchmark},
+  {NULL, NULL},
+};
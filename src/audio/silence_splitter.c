@@ -0,0 +1,101 @@
+#include "silence_splitter.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Energy is added up over blocks this many times shorter than the gap being
+// looked for. That keeps the table small even for recordings that are hours
+// long, while still placing each cut to within a fraction of the gap.
+#define SILENCE_SPLITTER_BLOCKS_PER_GAP (10)
+
+static void add_segment(int32_t start, int32_t end, AudioSegment** segments,
+  int* segments_length) {
+  *segments = realloc(*segments, (*segments_length + 1) * sizeof(AudioSegment));
+  AudioSegment* segment = &(*segments)[*segments_length];
+  segment->start = start;
+  segment->length = end - start;
+  *segments_length += 1;
+}
+
+// Returns a table where entry N holds the total energy of the first N blocks,
+// so the energy of any run of blocks is just the difference of two entries.
+static double* block_energy_sums(const int16_t* samples, int32_t count,
+  int32_t block_length, int32_t blocks_count) {
+  double* result = malloc((blocks_count + 1) * sizeof(double));
+  result[0] = 0.0;
+  for (int32_t block = 0; block < blocks_count; ++block) {
+    const int32_t start = block * block_length;
+    int32_t end = start + block_length;
+    if (end > count) {
+      end = count;
+    }
+    int64_t sum_of_squares = 0;
+    for (int32_t i = start; i < end; ++i) {
+      const int32_t sample = samples[i];
+      sum_of_squares += sample * sample;
+    }
+    result[block + 1] = result[block] + (double)(sum_of_squares);
+  }
+  return result;
+}
+
+void silence_splitter_find_segments(const int16_t* samples, int32_t count,
+  int32_t target_length, int32_t gap_length, AudioSegment** segments,
+  int* segments_length) {
+  *segments = NULL;
+  *segments_length = 0;
+  const int32_t max_last_length = target_length + ((target_length * 3) / 4);
+  if ((target_length <= 0) || (count <= max_last_length)) {
+    add_segment(0, count, segments, segments_length);
+    return;
+  }
+
+  int32_t block_length = gap_length / SILENCE_SPLITTER_BLOCKS_PER_GAP;
+  if (block_length < 1) {
+    block_length = 1;
+  }
+  int32_t gap_blocks = gap_length / block_length;
+  if (gap_blocks < 1) {
+    gap_blocks = 1;
+  }
+  const int32_t gap_offset = (gap_blocks * block_length) / 2;
+  const int32_t blocks_count = (count + block_length - 1) / block_length;
+  double* energy_sums =
+    block_energy_sums(samples, count, block_length, blocks_count);
+
+  const int32_t search_length = target_length / 4;
+  int32_t start = 0;
+  while ((count - start) > max_last_length) {
+    const int32_t target = start + target_length;
+    // Every window whose middle is within the search range is a candidate.
+    int32_t first_block =
+      (target - search_length - gap_offset) / block_length;
+    if (first_block < (start / block_length)) {
+      first_block = start / block_length;
+    }
+    int32_t last_block = (target + search_length - gap_offset) / block_length;
+    if (last_block > (blocks_count - gap_blocks)) {
+      last_block = blocks_count - gap_blocks;
+    }
+    int32_t cut = target;
+    double best_energy = 0.0;
+    int32_t best_distance = 0;
+    for (int32_t block = first_block; block <= last_block; ++block) {
+      const double energy =
+        energy_sums[block + gap_blocks] - energy_sums[block];
+      const int32_t middle = (block * block_length) + gap_offset;
+      const int32_t distance = abs(middle - target);
+      const bool is_first = (block == first_block);
+      if (is_first || (energy < best_energy) ||
+        ((energy == best_energy) && (distance < best_distance))) {
+        best_energy = energy;
+        best_distance = distance;
+        cut = middle;
+      }
+    }
+    add_segment(start, cut, segments, segments_length);
+    start = cut;
+  }
+  add_segment(start, count, segments, segments_length);
+  free(energy_sums);
+}
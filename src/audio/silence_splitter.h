@@ -0,0 +1,23 @@
+#ifndef INCLUDE_SILENCE_SPLITTER_H
+#define INCLUDE_SILENCE_SPLITTER_H
+
+#include <stdint.h>
+
+// A stretch of a longer recording, in samples.
+typedef struct AudioSegmentStruct {
+  int32_t start;
+  int32_t length;
+} AudioSegment;
+
+// Cuts a long mono recording into pieces that can be decoded independently.
+// A cut is made roughly every `target_length` samples, in the middle of the
+// quietest `gap_length` stretch found within a quarter of the target either
+// side, so that it falls in a pause rather than through a word. Rather than
+// leaving a short piece at the end, the last one can be up to 1.75 times the
+// target. The pieces cover every sample, in order, and `*segments` must be
+// freed by the caller.
+void silence_splitter_find_segments(const int16_t* samples, int32_t count,
+  int32_t target_length, int32_t gap_length, AudioSegment** segments,
+  int* segments_length);
+
+#endif  // INCLUDE_SILENCE_SPLITTER_H
@@ -0,0 +1,101 @@
+#include "acutest.h"
+
+#include "silence_splitter.c"
+
+// Fills the buffer with a loud square wave, except for silent gaps of
+// `gap_length` samples starting at each of `gap_starts`.
+static void fill_speech_with_gaps(int16_t* samples, int32_t count,
+  const int32_t* gap_starts, int gaps_length, int32_t gap_length) {
+  for (int32_t i = 0; i < count; ++i) {
+    samples[i] = ((i / 20) % 2) ? 8000 : -8000;
+  }
+  for (int gap = 0; gap < gaps_length; ++gap) {
+    for (int32_t i = 0; i < gap_length; ++i) {
+      samples[gap_starts[gap] + i] = 0;
+    }
+  }
+}
+
+static void check_coverage(const AudioSegment* segments, int segments_length,
+  int32_t count) {
+  int32_t expected_start = 0;
+  for (int i = 0; i < segments_length; ++i) {
+    TEST_INTEQ(expected_start, segments[i].start);
+    TEST_CHECK(segments[i].length > 0);
+    expected_start += segments[i].length;
+  }
+  TEST_INTEQ(count, expected_start);
+}
+
+void test_silence_splitter_short() {
+  int16_t samples[100] = {};
+  AudioSegment* segments = NULL;
+  int segments_length = 0;
+  silence_splitter_find_segments(samples, 100, 60, 10, &segments,
+    &segments_length);
+  TEST_INTEQ(1, segments_length);
+  TEST_INTEQ(0, segments[0].start);
+  TEST_INTEQ(100, segments[0].length);
+  free(segments);
+
+  // Splitting can be turned off with a zero target.
+  silence_splitter_find_segments(samples, 100, 0, 10, &segments,
+    &segments_length);
+  TEST_INTEQ(1, segments_length);
+  free(segments);
+}
+
+void test_silence_splitter_cuts_at_gaps() {
+  const int32_t count = 16000 * 40;
+  int16_t* samples = malloc(count * sizeof(int16_t));
+  // Pauses near, but not exactly at, every ten seconds.
+  const int32_t gap_starts[] = { 16000 * 11, 16000 * 19, 16000 * 28 };
+  const int gaps_length = sizeof(gap_starts) / sizeof(gap_starts[0]);
+  const int32_t gap_length = 16000 / 2;
+  fill_speech_with_gaps(samples, count, gap_starts, gaps_length, gap_length);
+
+  AudioSegment* segments = NULL;
+  int segments_length = 0;
+  silence_splitter_find_segments(samples, count, 16000 * 10, 16000 * 3 / 10,
+    &segments, &segments_length);
+  TEST_INTEQ(4, segments_length);
+  check_coverage(segments, segments_length, count);
+  for (int i = 1; i < segments_length; ++i) {
+    const int32_t cut = segments[i].start;
+    TEST_CASE_("Cut %d at %d", i, cut);
+    TEST_CHECK(samples[cut] == 0);
+    TEST_CHECK(cut > gap_starts[i - 1]);
+    TEST_CHECK(cut < (gap_starts[i - 1] + gap_length));
+  }
+  free(segments);
+  free(samples);
+}
+
+void test_silence_splitter_no_gaps() {
+  // Without any pauses the cuts still happen, within the search range.
+  const int32_t count = 16000 * 35;
+  int16_t* samples = malloc(count * sizeof(int16_t));
+  fill_speech_with_gaps(samples, count, NULL, 0, 0);
+  AudioSegment* segments = NULL;
+  int segments_length = 0;
+  const int32_t target_length = 16000 * 10;
+  silence_splitter_find_segments(samples, count, target_length, 4800,
+    &segments, &segments_length);
+  check_coverage(segments, segments_length, count);
+  TEST_INTEQ(3, segments_length);
+  for (int i = 0; i < (segments_length - 1); ++i) {
+    TEST_CHECK(segments[i].length >= ((target_length * 3) / 4));
+    TEST_CHECK(segments[i].length <= ((target_length * 5) / 4));
+  }
+  TEST_CHECK(segments[segments_length - 1].length <=
+    ((target_length * 7) / 4));
+  free(segments);
+  free(samples);
+}
+
+TEST_LIST = {
+  {"silence_splitter_short", test_silence_splitter_short},
+  {"silence_splitter_cuts_at_gaps", test_silence_splitter_cuts_at_gaps},
+  {"silence_splitter_no_gaps", test_silence_splitter_no_gaps},
+  {NULL, NULL},
+};
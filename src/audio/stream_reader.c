@@ -0,0 +1,270 @@
+#include "stream_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "downmix.h"
+#include "wav_io.h"
+
+// How many more bytes to ask for each time while a header is arriving, and
+// how much to hold onto before giving up on ever reaching the samples.
+#define STREAM_READER_HEADER_STEP (4096)
+#define STREAM_READER_MAX_HEADER_SIZE (1024 * 1024)
+
+StreamReader* stream_reader_alloc(int fd, int32_t raw_sample_rate,
+  int32_t raw_channels, int32_t output_rate, int32_t channel,
+  int32_t read_size) {
+  StreamReader* reader = calloc(1, sizeof(StreamReader));
+  reader->fd = fd;
+  reader->original_flags = fcntl(fd, F_GETFL);
+  if (reader->original_flags != -1) {
+    fcntl(fd, F_SETFL, reader->original_flags | O_NONBLOCK);
+  }
+  reader->output_rate = output_rate;
+  reader->raw_sample_rate = raw_sample_rate;
+  reader->raw_channels = raw_channels;
+  reader->channel = channel;
+  reader->read_size = read_size;
+  reader->has_format = false;
+  reader->bytes_left = -1;
+  reader->is_finished = false;
+  return reader;
+}
+
+void stream_reader_limit_length(StreamReader* reader, int64_t length,
+  const uint8_t* prefix, size_t prefix_length) {
+  if ((int64_t)(prefix_length) > length) {
+    prefix_length = length;
+  }
+  const size_t capacity = reader->pending_length + prefix_length;
+  if (capacity > reader->pending_capacity) {
+    reader->pending = realloc(reader->pending, capacity);
+    reader->pending_capacity = capacity;
+  }
+  memcpy(reader->pending + reader->pending_length, prefix, prefix_length);
+  reader->pending_length += prefix_length;
+  reader->bytes_left = length - prefix_length;
+}
+
+void stream_reader_free(StreamReader* reader) {
+  if (reader == NULL) {
+    return;
+  }
+  if (reader->original_flags != -1) {
+    fcntl(reader->fd, F_SETFL, reader->original_flags);
+  }
+  resampler_free(reader->resampler);
+  free(reader->pending);
+  free(reader->converted);
+  free(reader->output);
+  free(reader);
+}
+
+static int32_t frame_byte_count(const StreamReader* reader) {
+  return reader->channels * sample_format_bytes(reader->format);
+}
+
+// Returns false if the samples can't be converted to the output rate.
+static bool set_format(StreamReader* reader, int32_t sample_rate,
+  int32_t channels, SampleFormat format) {
+  if ((sample_rate < RESAMPLER_MIN_RATE) ||
+    (sample_rate > RESAMPLER_MAX_RATE)) {
+    fprintf(stderr, "Stream's sample rate of %d Hz isn't between %d and %d\n",
+      sample_rate, RESAMPLER_MIN_RATE, RESAMPLER_MAX_RATE);
+    return false;
+  }
+  if ((channels < 1) || (channels > STREAM_READER_MAX_CHANNELS)) {
+    fprintf(stderr, "Stream has %d channels, but only 1 to %d are supported\n",
+      channels, STREAM_READER_MAX_CHANNELS);
+    return false;
+  }
+  reader->sample_rate = sample_rate;
+  reader->channels = channels;
+  reader->format = format;
+  reader->has_format = true;
+  if (sample_rate != reader->output_rate) {
+    reader->resampler = resampler_alloc(sample_rate, reader->output_rate, 1);
+    if (reader->resampler == NULL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool is_header_start(const uint8_t* data) {
+  return (memcmp(data, "RIFF", 4) == 0) || (memcmp(data, "RF64", 4) == 0) ||
+    (memcmp(data, "BW64", 4) == 0);
+}
+
+// Decides how the samples are stored, once enough of the stream has arrived
+// to tell. Returns false if there's a header that can't be used.
+static bool find_format(StreamReader* reader, bool is_at_end) {
+  if ((reader->pending_length < 4) && !is_at_end) {
+    return true;
+  }
+  if ((reader->pending_length < 4) || !is_header_start(reader->pending)) {
+    return set_format(reader, reader->raw_sample_rate, reader->raw_channels,
+      SAMPLE_FORMAT_S16);
+  }
+
+  WavStreamFormat wav_format;
+  const WavIoHeaderStatus status = wav_io_parse_stream_header(
+    reader->pending, reader->pending_length, &wav_format);
+  if (status == WAV_IO_HEADER_INVALID) {
+    return false;
+  }
+  if (status == WAV_IO_HEADER_INCOMPLETE) {
+    if (is_at_end) {
+      fprintf(stderr, "Audio stream ended before its WAV header did\n");
+      return false;
+    }
+    if (reader->pending_length >= STREAM_READER_MAX_HEADER_SIZE) {
+      fprintf(stderr, "No samples found in the first %d bytes of WAV stream\n",
+        STREAM_READER_MAX_HEADER_SIZE);
+      return false;
+    }
+    return true;
+  }
+  reader->pending_length -= wav_format.header_size;
+  memmove(reader->pending, reader->pending + wav_format.header_size,
+    reader->pending_length);
+  return set_format(reader, wav_format.sample_rate, wav_format.channels,
+    wav_format.format);
+}
+
+// Takes whatever is waiting on the descriptor, until there are `capacity`
+// bytes pending, without blocking.
+static bool read_available(StreamReader* reader, size_t capacity,
+  bool* is_at_end) {
+  if (capacity > reader->pending_capacity) {
+    reader->pending = realloc(reader->pending, capacity);
+    reader->pending_capacity = capacity;
+  }
+  while (reader->pending_length < capacity) {
+    size_t wanted = capacity - reader->pending_length;
+    if (reader->bytes_left == 0) {
+      *is_at_end = true;
+      return true;
+    }
+    if ((reader->bytes_left > 0) && ((int64_t)(wanted) > reader->bytes_left)) {
+      wanted = reader->bytes_left;
+    }
+    const ssize_t read_count = read(reader->fd,
+      reader->pending + reader->pending_length, wanted);
+    if (read_count > 0) {
+      reader->pending_length += read_count;
+      if (reader->bytes_left > 0) {
+        reader->bytes_left -= read_count;
+      }
+    }
+    else if (read_count == 0) {
+      *is_at_end = true;
+      return true;
+    }
+    else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+      return true;
+    }
+    else if (errno != EINTR) {
+      fprintf(stderr, "Reading audio stream failed with '%s'\n",
+        strerror(errno));
+      return false;
+    }
+  }
+  *is_at_end = (reader->bytes_left == 0);
+  return true;
+}
+
+int32_t stream_reader_read(StreamReader* reader, int timeout_ms,
+  const int16_t** samples) {
+  *samples = reader->output;
+  if (reader->is_finished) {
+    return 0;
+  }
+  // Nothing more will arrive once a length-limited stream has all its bytes,
+  // so there's no point waiting.
+  if (reader->bytes_left == 0) {
+    timeout_ms = 0;
+  }
+  struct pollfd poll_fd = { reader->fd, POLLIN, 0 };
+  const int poll_result = poll(&poll_fd, 1, timeout_ms);
+  if (poll_result < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    fprintf(stderr, "Waiting for audio stream failed with '%s'\n",
+      strerror(errno));
+    return -1;
+  }
+  if ((poll_result == 0) && (reader->bytes_left != 0)) {
+    return 0;
+  }
+
+  size_t capacity = reader->pending_length + STREAM_READER_HEADER_STEP;
+  if (reader->has_format) {
+    capacity = (size_t)(reader->read_size) * frame_byte_count(reader);
+  }
+  bool is_at_end = false;
+  if (!read_available(reader, capacity, &is_at_end)) {
+    return -1;
+  }
+  if (!reader->has_format) {
+    if (!find_format(reader, is_at_end)) {
+      return -1;
+    }
+    if (!reader->has_format) {
+      return 0;
+    }
+    if ((reader->channel < DOWNMIX_ALL_CHANNELS) ||
+      (reader->channel >= reader->channels)) {
+      fprintf(stderr,
+        "Channel %d was requested, but the audio stream has %d channel%s\n",
+        reader->channel, reader->channels,
+        (reader->channels == 1) ? "" : "s");
+      return -1;
+    }
+  }
+
+  // Any partial frame at the end waits for the rest of it to arrive, unless
+  // the stream has ended, in which case it's dropped.
+  const int32_t frame_size = frame_byte_count(reader);
+  const int32_t frames = reader->pending_length / frame_size;
+  const int32_t sample_count = frames * reader->channels;
+  if (sample_count > reader->converted_capacity) {
+    reader->converted =
+      realloc(reader->converted, sample_count * sizeof(int16_t));
+    reader->converted_capacity = sample_count;
+  }
+  sample_convert(reader->format, reader->pending, sample_count,
+    reader->converted);
+  const size_t used_length = (size_t)(frames) * frame_size;
+  reader->pending_length -= used_length;
+  memmove(reader->pending, reader->pending + used_length,
+    reader->pending_length);
+  downmix_to_mono(reader->converted, frames, reader->channels,
+    reader->channel, reader->converted);
+  reader->is_finished = is_at_end;
+
+  if (reader->resampler == NULL) {
+    *samples = reader->converted;
+    return frames;
+  }
+  const int32_t output_needed = resampler_max_output(reader->resampler,
+    frames) + resampler_max_output(reader->resampler, 0);
+  if (output_needed > reader->output_capacity) {
+    reader->output =
+      realloc(reader->output, output_needed * sizeof(int16_t));
+    reader->output_capacity = output_needed;
+  }
+  int32_t result = resampler_process(reader->resampler, reader->converted,
+    frames, reader->output);
+  if (is_at_end) {
+    result += resampler_flush(reader->resampler, reader->output + result);
+  }
+  *samples = reader->output;
+  return result;
+}
@@ -0,0 +1,77 @@
+#ifndef INCLUDE_STREAM_READER_H
+#define INCLUDE_STREAM_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resampler.h"
+#include "sample_convert.h"
+
+// Every frame is converted in one piece, so streams with more channels than
+// this are refused rather than trusting whatever a header or client says.
+#define STREAM_READER_MAX_CHANNELS (64)
+
+// Reads audio from a pipe or other file descriptor that can't be seeked, like
+// the output of another program sent to stdin. If the stream starts with a
+// WAV header the samples are read in whatever format it describes, otherwise
+// they're treated as raw 16-bit little-endian samples at `raw_sample_rate`
+// with `raw_channels` interleaved channels. Either way they come out as mono
+// 16-bit samples at `output_rate`, ready to feed straight to a decoder.
+typedef struct StreamReaderStruct {
+  int fd;
+  // The descriptor is switched to non-blocking reads, and put back how it
+  // was when the reader is freed.
+  int original_flags;
+  int32_t output_rate;
+  int32_t raw_sample_rate;
+  int32_t raw_channels;
+  // Channel to keep, or DOWNMIX_ALL_CHANNELS to average them.
+  int32_t channel;
+  // Most input frames to convert in one call.
+  int32_t read_size;
+  // Only valid once `has_format` is set, after the start of the stream has
+  // been seen.
+  bool has_format;
+  int32_t sample_rate;
+  int32_t channels;
+  SampleFormat format;
+  // Bytes that have been read but not yet converted, either because they're
+  // part of a header that's still arriving, or the start of a frame.
+  uint8_t* pending;
+  size_t pending_length;
+  size_t pending_capacity;
+  int16_t* converted;
+  int32_t converted_capacity;
+  // Only set if the stream isn't already at `output_rate`.
+  Resampler* resampler;
+  int16_t* output;
+  int32_t output_capacity;
+  // Bytes still to come from the descriptor, or -1 if the stream only ends
+  // when it's closed.
+  int64_t bytes_left;
+  bool is_finished;
+} StreamReader;
+
+StreamReader* stream_reader_alloc(int fd, int32_t raw_sample_rate,
+  int32_t raw_channels, int32_t output_rate, int32_t channel,
+  int32_t read_size);
+void stream_reader_free(StreamReader* reader);
+
+// Ends the stream after `length` bytes instead of when the descriptor is
+// closed, for input like an HTTP request body. Any of those bytes that were
+// already read from the descriptor along with something else are passed in
+// as `prefix`.
+void stream_reader_limit_length(StreamReader* reader, int64_t length,
+  const uint8_t* prefix, size_t prefix_length);
+
+// Waits up to `timeout_ms` for input to arrive, or forever if it's negative,
+// then takes whatever is available without blocking again. Sets `samples`
+// to the converted audio, which stays valid until the next call, and
+// returns how many samples there are, which may be zero if only part of a
+// header or frame arrived. Once the stream has ended `is_finished` is set.
+// Returns -1 if the stream couldn't be read or understood.
+int32_t stream_reader_read(StreamReader* reader, int timeout_ms,
+  const int16_t** samples);
+
+#endif  // INCLUDE_STREAM_READER_H
@@ -0,0 +1,181 @@
+#include "acutest.h"
+
+#include "stream_reader.c"
+
+static void write_all(int fd, const void* data, size_t size) {
+  TEST_ASSERT(write(fd, data, size) == (ssize_t)(size));
+}
+
+// Reads until the stream ends, collecting all of the converted samples.
+static int32_t read_all(StreamReader* reader, int16_t* output,
+  int32_t max_output) {
+  int32_t result = 0;
+  while (!reader->is_finished) {
+    const int16_t* samples;
+    const int32_t count = stream_reader_read(reader, -1, &samples);
+    if (count < 0) {
+      return -1;
+    }
+    TEST_ASSERT((result + count) <= max_output);
+    memcpy(output + result, samples, count * sizeof(int16_t));
+    result += count;
+  }
+  return result;
+}
+
+void test_stream_reader_raw() {
+  int fds[2];
+  TEST_ASSERT(pipe(fds) == 0);
+  const int16_t input[] = { 100, 300, -100, -300, 5, 6, 7 };
+  // The last sample is only half of a frame, so it should be dropped.
+  write_all(fds[1], input, sizeof(input));
+  close(fds[1]);
+
+  StreamReader* reader =
+    stream_reader_alloc(fds[0], 16000, 2, 16000, DOWNMIX_ALL_CHANNELS, 640);
+  int16_t output[8];
+  TEST_INTEQ(3, read_all(reader, output, 8));
+  TEST_INTEQ(200, output[0]);
+  TEST_INTEQ(-200, output[1]);
+  TEST_INTEQ(5, output[2]);
+  TEST_CHECK(reader->resampler == NULL);
+  stream_reader_free(reader);
+  close(fds[0]);
+}
+
+void test_stream_reader_wav_header() {
+  int fds[2];
+  TEST_ASSERT(pipe(fds) == 0);
+  // 8KHz mono 32-bit float, with unknown sizes as written to a pipe.
+  const unsigned char header[] = {
+    'R', 'I', 'F', 'F',
+    0xff, 0xff, 0xff, 0xff,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,
+    3, 0, 1, 0, 0x40, 0x1f, 0, 0, 0x00, 0x7d, 0, 0, 4, 0, 32, 0,
+    'd', 'a', 't', 'a',
+    0xff, 0xff, 0xff, 0xff,
+  };
+  StreamReader* reader =
+    stream_reader_alloc(fds[0], 16000, 1, 16000, DOWNMIX_ALL_CHANNELS, 640);
+
+  // Nothing can come out until the whole header has arrived, and reads
+  // shouldn't block while waiting for it.
+  const int16_t* samples;
+  write_all(fds[1], header, 20);
+  TEST_INTEQ(0, stream_reader_read(reader, 0, &samples));
+  TEST_CHECK(!reader->has_format);
+  TEST_INTEQ(0, stream_reader_read(reader, 0, &samples));
+  TEST_CHECK(!reader->is_finished);
+  write_all(fds[1], header + 20, sizeof(header) - 20);
+
+  const int32_t input_frames = 800;
+  float* input = malloc(input_frames * sizeof(float));
+  for (int32_t i = 0; i < input_frames; ++i) {
+    input[i] = 0.25f;
+  }
+  write_all(fds[1], input, input_frames * sizeof(float));
+  close(fds[1]);
+
+  const int32_t max_output = input_frames * 4;
+  int16_t* output = malloc(max_output * sizeof(int16_t));
+  const int32_t output_count = read_all(reader, output, max_output);
+  TEST_INTEQ(8000, reader->sample_rate);
+  TEST_INTEQ(SAMPLE_FORMAT_F32, reader->format);
+  TEST_CHECK(reader->resampler != NULL);
+  TEST_INTEQ(input_frames * 2, output_count);
+  // Away from the edges, the level should be unchanged by resampling.
+  TEST_CHECK(abs(output[output_count / 2] - 8192) < 100);
+  TEST_MSG("Middle sample was %d", output[output_count / 2]);
+
+  free(output);
+  free(input);
+  stream_reader_free(reader);
+  close(fds[0]);
+}
+
+void test_stream_reader_bad_channel() {
+  int fds[2];
+  TEST_ASSERT(pipe(fds) == 0);
+  const int16_t input[] = { 1, 2, 3, 4 };
+  write_all(fds[1], input, sizeof(input));
+  close(fds[1]);
+  StreamReader* reader = stream_reader_alloc(fds[0], 16000, 1, 16000, 1, 640);
+  const int16_t* samples;
+  TEST_INTEQ(-1, stream_reader_read(reader, -1, &samples));
+  stream_reader_free(reader);
+  close(fds[0]);
+}
+
+void test_stream_reader_bad_format() {
+  const int32_t formats[][2] = {
+    { 100, 1 },
+    { 1000000, 1 },
+    { 16000, STREAM_READER_MAX_CHANNELS + 1 },
+  };
+  for (size_t i = 0; i < (sizeof(formats) / sizeof(formats[0])); ++i) {
+    TEST_CASE_("%d Hz, %d channels", formats[i][0], formats[i][1]);
+    int fds[2];
+    TEST_ASSERT(pipe(fds) == 0);
+    const int16_t input[] = { 1, 2, 3, 4 };
+    write_all(fds[1], input, sizeof(input));
+    close(fds[1]);
+    StreamReader* reader = stream_reader_alloc(fds[0], formats[i][0],
+      formats[i][1], 16000, DOWNMIX_ALL_CHANNELS, 640);
+    const int16_t* samples;
+    TEST_INTEQ(-1, stream_reader_read(reader, -1, &samples));
+    stream_reader_free(reader);
+    close(fds[0]);
+  }
+}
+
+void test_stream_reader_restores_flags() {
+  int fds[2];
+  TEST_ASSERT(pipe(fds) == 0);
+  const int original_flags = fcntl(fds[0], F_GETFL);
+  StreamReader* reader =
+    stream_reader_alloc(fds[0], 16000, 1, 16000, DOWNMIX_ALL_CHANNELS, 640);
+  TEST_CHECK((fcntl(fds[0], F_GETFL) & O_NONBLOCK) != 0);
+  stream_reader_free(reader);
+  TEST_INTEQ(original_flags, fcntl(fds[0], F_GETFL));
+  close(fds[1]);
+  close(fds[0]);
+}
+
+void test_stream_reader_limit_length() {
+  int fds[2];
+  TEST_ASSERT(pipe(fds) == 0);
+  // The first sample was already read by someone else, and anything after
+  // the fourth isn't part of the stream.
+  const int16_t input[] = { 2, 3, 4, 99 };
+  write_all(fds[1], input, sizeof(input));
+  const int16_t prefix[] = { 1 };
+
+  StreamReader* reader =
+    stream_reader_alloc(fds[0], 16000, 1, 16000, DOWNMIX_ALL_CHANNELS, 640);
+  stream_reader_limit_length(reader, 4 * sizeof(int16_t),
+    (const uint8_t*)(prefix), sizeof(prefix));
+  // The write end is still open, so this only finishes because of the limit.
+  int16_t output[8];
+  TEST_INTEQ(4, read_all(reader, output, 8));
+  TEST_INTEQ(1, output[0]);
+  TEST_INTEQ(4, output[3]);
+  stream_reader_free(reader);
+
+  int16_t rest;
+  TEST_CHECK(read(fds[0], &rest, sizeof(rest)) == sizeof(rest));
+  TEST_INTEQ(99, rest);
+  close(fds[1]);
+  close(fds[0]);
+}
+
+TEST_LIST = {
+  {"stream_reader_raw", test_stream_reader_raw},
+  {"stream_reader_wav_header", test_stream_reader_wav_header},
+  {"stream_reader_bad_channel", test_stream_reader_bad_channel},
+  {"stream_reader_bad_format", test_stream_reader_bad_format},
+  {"stream_reader_restores_flags", test_stream_reader_restores_flags},
+  {"stream_reader_limit_length", test_stream_reader_limit_length},
+  {NULL, NULL},
+};
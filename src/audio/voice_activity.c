@@ -0,0 +1,251 @@
+#include "voice_activity.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VOICE_ACTIVITY_FRAME_MS (20)
+// How many speech frames in a row are needed to start passing audio through,
+// so that single clicks and pops are ignored.
+#define VOICE_ACTIVITY_ONSET_FRAMES (2)
+// Mean squared amplitude that the noise floor can't drop below, so that
+// digital silence doesn't make the detector trigger on the faintest hiss.
+#define VOICE_ACTIVITY_MIN_NOISE_ENERGY (100.0f)
+// How many times louder than the noise floor a voiced frame has to be, or an
+// unvoiced one with a high zero-crossing rate.
+#define VOICE_ACTIVITY_VOICED_RATIO (4.0f)
+#define VOICE_ACTIVITY_UNVOICED_RATIO (2.0f)
+#define VOICE_ACTIVITY_UNVOICED_ZCR (0.25f)
+
+VoiceActivity* voice_activity_alloc(int32_t sample_rate, int32_t preroll_ms,
+  int32_t hangover_ms) {
+  VoiceActivity* result = calloc(1, sizeof(VoiceActivity));
+  result->sample_rate = sample_rate;
+  result->frame_size = (sample_rate * VOICE_ACTIVITY_FRAME_MS) / 1000;
+  result->frame = calloc(result->frame_size, sizeof(int16_t));
+  result->frame_fill = 0;
+  // The first few speech frames are held back until the onset is confirmed,
+  // so make room for them on top of the requested pre-roll.
+  result->preroll_capacity = ((sample_rate * preroll_ms) / 1000) +
+    ((VOICE_ACTIVITY_ONSET_FRAMES - 1) * result->frame_size);
+  if (result->preroll_capacity < 1) {
+    result->preroll_capacity = 1;
+  }
+  result->preroll = calloc(result->preroll_capacity, sizeof(int16_t));
+  result->preroll_start = 0;
+  result->preroll_length = 0;
+  result->hangover_frames = hangover_ms / VOICE_ACTIVITY_FRAME_MS;
+  result->frames_since_speech = 0;
+  result->onset_frames = 0;
+  result->is_active = false;
+  result->noise_floor = -1.0f;
+  result->stream_samples = 0;
+  result->output_samples = 0;
+  result->segments = NULL;
+  result->segments_length = 0;
+  result->segments_capacity = 0;
+  return result;
+}
+
+void voice_activity_free(VoiceActivity* vad) {
+  if (vad == NULL) {
+    return;
+  }
+  free(vad->frame);
+  free(vad->preroll);
+  free(vad->segments);
+  free(vad);
+}
+
+int32_t voice_activity_max_output(const VoiceActivity* vad,
+  int32_t input_count) {
+  return input_count + vad->frame_size + vad->preroll_capacity;
+}
+
+static bool frame_is_speech(VoiceActivity* vad, const int16_t* frame) {
+  int64_t sum_of_squares = 0;
+  int32_t crossings = 0;
+  for (int i = 0; i < vad->frame_size; ++i) {
+    const int32_t sample = frame[i];
+    sum_of_squares += sample * sample;
+    if ((i > 0) && ((sample < 0) != (frame[i - 1] < 0))) {
+      crossings += 1;
+    }
+  }
+  const float energy = (float)(sum_of_squares) / vad->frame_size;
+  const float zcr = (float)(crossings) / vad->frame_size;
+
+  if (vad->noise_floor < 0.0f) {
+    vad->noise_floor = energy;
+  }
+  if (vad->noise_floor < VOICE_ACTIVITY_MIN_NOISE_ENERGY) {
+    vad->noise_floor = VOICE_ACTIVITY_MIN_NOISE_ENERGY;
+  }
+
+  const bool is_speech =
+    (energy > (vad->noise_floor * VOICE_ACTIVITY_VOICED_RATIO)) ||
+    ((energy > (vad->noise_floor * VOICE_ACTIVITY_UNVOICED_RATIO)) &&
+      (zcr > VOICE_ACTIVITY_UNVOICED_ZCR));
+
+  // The floor follows quiet frames down quickly, but only creeps up slowly
+  // during non-speech, so a burst of speech can't drag it up with it.
+  if (energy < vad->noise_floor) {
+    vad->noise_floor += (energy - vad->noise_floor) * 0.2f;
+  }
+  else if (!is_speech) {
+    vad->noise_floor += (energy - vad->noise_floor) * 0.05f;
+  }
+  if (vad->noise_floor < VOICE_ACTIVITY_MIN_NOISE_ENERGY) {
+    vad->noise_floor = VOICE_ACTIVITY_MIN_NOISE_ENERGY;
+  }
+
+  return is_speech;
+}
+
+static void preroll_push(VoiceActivity* vad, const int16_t* samples,
+  int32_t count) {
+  for (int i = 0; i < count; ++i) {
+    const int32_t end =
+      (vad->preroll_start + vad->preroll_length) % vad->preroll_capacity;
+    vad->preroll[end] = samples[i];
+    if (vad->preroll_length < vad->preroll_capacity) {
+      vad->preroll_length += 1;
+    }
+    else {
+      vad->preroll_start = (vad->preroll_start + 1) % vad->preroll_capacity;
+    }
+  }
+}
+
+static int32_t preroll_drain(VoiceActivity* vad, int16_t* output) {
+  const int32_t count = vad->preroll_length;
+  const int32_t first_count = ((vad->preroll_start + count) >
+    vad->preroll_capacity) ? (vad->preroll_capacity - vad->preroll_start) :
+    count;
+  memcpy(output, vad->preroll + vad->preroll_start,
+    first_count * sizeof(int16_t));
+  memcpy(output + first_count, vad->preroll,
+    (count - first_count) * sizeof(int16_t));
+  vad->preroll_start = 0;
+  vad->preroll_length = 0;
+  return count;
+}
+
+static void add_segment(VoiceActivity* vad, int64_t output_start,
+  int64_t stream_start) {
+  if (vad->segments_length == vad->segments_capacity) {
+    vad->segments_capacity = (vad->segments_capacity == 0) ? 16 :
+      (vad->segments_capacity * 2);
+    vad->segments = realloc(vad->segments,
+      vad->segments_capacity * sizeof(VoiceActivitySegment));
+  }
+  VoiceActivitySegment* segment = &vad->segments[vad->segments_length];
+  segment->output_start = output_start;
+  segment->stream_start = stream_start;
+  vad->segments_length += 1;
+}
+
+// Decides what to do with one complete frame, and returns how many samples
+// were written to `output`.
+static int32_t process_frame(VoiceActivity* vad, int16_t* output) {
+  const int16_t* frame = vad->frame;
+  const int32_t frame_size = vad->frame_size;
+  const int64_t frame_stream_start = vad->stream_samples;
+  vad->stream_samples += frame_size;
+
+  const bool is_speech = frame_is_speech(vad, frame);
+  int32_t output_count = 0;
+  if (vad->is_active) {
+    memcpy(output, frame, frame_size * sizeof(int16_t));
+    output_count = frame_size;
+    if (is_speech) {
+      vad->frames_since_speech = 0;
+    }
+    else {
+      vad->frames_since_speech += 1;
+      if (vad->frames_since_speech > vad->hangover_frames) {
+        vad->is_active = false;
+        vad->onset_frames = 0;
+      }
+    }
+  }
+  else {
+    vad->onset_frames = is_speech ? (vad->onset_frames + 1) : 0;
+    if (vad->onset_frames < VOICE_ACTIVITY_ONSET_FRAMES) {
+      preroll_push(vad, frame, frame_size);
+    }
+    else {
+      const int64_t stream_start = frame_stream_start - vad->preroll_length;
+      add_segment(vad, vad->output_samples, stream_start);
+      output_count = preroll_drain(vad, output);
+      memcpy(output + output_count, frame, frame_size * sizeof(int16_t));
+      output_count += frame_size;
+      vad->is_active = true;
+      vad->frames_since_speech = 0;
+    }
+  }
+  vad->output_samples += output_count;
+  return output_count;
+}
+
+int32_t voice_activity_process(VoiceActivity* vad, const int16_t* input,
+  int32_t input_count, int16_t* output) {
+  int32_t output_count = 0;
+  int32_t input_offset = 0;
+  while (input_offset < input_count) {
+    int32_t copy_count = vad->frame_size - vad->frame_fill;
+    if (copy_count > (input_count - input_offset)) {
+      copy_count = (input_count - input_offset);
+    }
+    memcpy(vad->frame + vad->frame_fill, input + input_offset,
+      copy_count * sizeof(int16_t));
+    vad->frame_fill += copy_count;
+    input_offset += copy_count;
+    if (vad->frame_fill == vad->frame_size) {
+      output_count += process_frame(vad, output + output_count);
+      vad->frame_fill = 0;
+    }
+  }
+  return output_count;
+}
+
+// Returns the index of the last segment that starts at or before
+// `output_sample`, or -1 if there isn't one.
+static int find_segment(const VoiceActivity* vad, int64_t output_sample) {
+  int low = 0;
+  int high = vad->segments_length - 1;
+  int found = -1;
+  while (low <= high) {
+    const int middle = (low + high) / 2;
+    if (vad->segments[middle].output_start <= output_sample) {
+      found = middle;
+      low = middle + 1;
+    }
+    else {
+      high = middle - 1;
+    }
+  }
+  return found;
+}
+
+float voice_activity_stream_time(const VoiceActivity* vad, float output_time) {
+  const int64_t output_sample = (int64_t)(output_time * vad->sample_rate);
+  const int found = find_segment(vad, output_sample);
+  if (found == -1) {
+    return output_time;
+  }
+  const VoiceActivitySegment* segment = &vad->segments[found];
+  const int64_t stream_sample =
+    segment->stream_start + (output_sample - segment->output_start);
+  return (float)(stream_sample) / vad->sample_rate;
+}
+
+void voice_activity_forget_before(VoiceActivity* vad, int64_t output_sample) {
+  // The segment that this sample falls in is still needed.
+  const int found = find_segment(vad, output_sample);
+  if (found <= 0) {
+    return;
+  }
+  vad->segments_length -= found;
+  memmove(vad->segments, vad->segments + found,
+    vad->segments_length * sizeof(VoiceActivitySegment));
+}
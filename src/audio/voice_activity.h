@@ -0,0 +1,69 @@
+#ifndef INCLUDE_VOICE_ACTIVITY_H
+#define INCLUDE_VOICE_ACTIVITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Records where a run of audio that was passed through starts, both in the
+// gated output and in the original stream, so times can be mapped back.
+typedef struct VoiceActivitySegmentStruct {
+  int64_t output_start;
+  int64_t stream_start;
+} VoiceActivitySegment;
+
+// Cheap voice activity detector, used to avoid running the decoder over long
+// stretches of silence. It splits audio into short frames, and treats a frame
+// as speech if its energy is well above the background noise level, or
+// somewhat above it with the high zero-crossing rate of unvoiced sounds like
+// 's' and 'f'. Audio is only passed on while speech is active. The most
+// recent stretch of non-speech is held back in a pre-roll buffer and sent
+// just before the first speech frame, so the start of words isn't clipped.
+typedef struct VoiceActivityStruct {
+  int32_t sample_rate;
+  int32_t frame_size;
+  int16_t* frame;
+  int32_t frame_fill;
+  int16_t* preroll;
+  int32_t preroll_capacity;
+  int32_t preroll_start;
+  int32_t preroll_length;
+  int32_t hangover_frames;
+  int32_t frames_since_speech;
+  int32_t onset_frames;
+  bool is_active;
+  float noise_floor;
+  // Total samples seen on the input and sent to the output.
+  int64_t stream_samples;
+  int64_t output_samples;
+  VoiceActivitySegment* segments;
+  int segments_length;
+  int segments_capacity;
+} VoiceActivity;
+
+// Speech stays active for `hangover_ms` after the last speech frame, so short
+// pauses between words don't chop up the audio.
+VoiceActivity* voice_activity_alloc(int32_t sample_rate, int32_t preroll_ms,
+  int32_t hangover_ms);
+void voice_activity_free(VoiceActivity* vad);
+
+// The most samples that a call to voice_activity_process() with
+// `input_count` samples can write out.
+int32_t voice_activity_max_output(const VoiceActivity* vad,
+  int32_t input_count);
+
+// Copies any speech from `input` into `output`, and returns how many samples
+// were written. Partial frames are held until the next call.
+int32_t voice_activity_process(VoiceActivity* vad, const int16_t* input,
+  int32_t input_count, int16_t* output);
+
+// Converts a time in seconds, measured in the gated output, back to the time
+// in the original input stream. Use this on token timestamps from a decoder
+// that was fed the gated audio.
+float voice_activity_stream_time(const VoiceActivity* vad, float output_time);
+
+// A segment is recorded each time speech starts, so in a long live session
+// the ones that no remaining output time can fall in are dropped, once
+// nothing will be looked up from before `output_sample`.
+void voice_activity_forget_before(VoiceActivity* vad, int64_t output_sample);
+
+#endif  // INCLUDE_VOICE_ACTIVITY_H
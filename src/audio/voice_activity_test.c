@@ -0,0 +1,142 @@
+#include "acutest.h"
+
+#include "voice_activity.c"
+
+#include <math.h>
+
+static void fill_sine(int16_t* data, int32_t count, float amplitude) {
+  for (int i = 0; i < count; ++i) {
+    data[i] = (int16_t)(amplitude * sinf(i * 0.1f));
+  }
+}
+
+static void fill_noise(int16_t* data, int32_t count, int32_t amplitude) {
+  srand(42);
+  for (int i = 0; i < count; ++i) {
+    data[i] = (int16_t)((rand() % ((amplitude * 2) + 1)) - amplitude);
+  }
+}
+
+void test_voice_activity_silence() {
+  VoiceActivity* vad = voice_activity_alloc(16000, 300, 200);
+  const int32_t input_count = 16000;
+  int16_t* input = calloc(input_count, sizeof(int16_t));
+  fill_noise(input, input_count, 20);
+  int16_t* output =
+    calloc(voice_activity_max_output(vad, input_count), sizeof(int16_t));
+  const int32_t output_count =
+    voice_activity_process(vad, input, input_count, output);
+  TEST_INTEQ(0, output_count);
+  TEST_CHECK(!vad->is_active);
+  // 300ms of pre-roll, plus room for the frame that starts an onset.
+  TEST_INTEQ(4800 + 320, vad->preroll_length);
+  free(input);
+  free(output);
+  voice_activity_free(vad);
+}
+
+void test_voice_activity_speech_with_preroll() {
+  // One second of quiet noise, half a second of loud tone, then a second of
+  // quiet again.
+  const int32_t input_count = 40000;
+  int16_t* input = calloc(input_count, sizeof(int16_t));
+  fill_noise(input, input_count, 20);
+  fill_sine(input + 16000, 8000, 8000.0f);
+
+  VoiceActivity* vad = voice_activity_alloc(16000, 300, 200);
+  int16_t* output =
+    calloc(voice_activity_max_output(vad, input_count), sizeof(int16_t));
+  // Feed in awkwardly-sized pieces to exercise the partial frame handling.
+  int32_t output_count = 0;
+  for (int offset = 0; offset < input_count; offset += 1000) {
+    output_count +=
+      voice_activity_process(vad, input + offset, 1000, output + output_count);
+  }
+
+  // We expect 300ms of pre-roll, the tone, 200ms of hangover, and the frame
+  // that ends it.
+  TEST_INTEQ(4800 + 8000 + 3200 + 320, output_count);
+  TEST_CHECK(!vad->is_active);
+  TEST_INTEQ(1, vad->segments_length);
+  TEST_CHECK(memcmp(output + 4800, input + 16000, 8000 * sizeof(int16_t)) == 0);
+
+  // The start of the tone in the output should map back to one second in.
+  const float tone_time = voice_activity_stream_time(vad, 0.3f);
+  TEST_CHECK(fabsf(tone_time - 1.0f) < 0.001f);
+  TEST_MSG("%f", tone_time);
+
+  // A second burst should be passed through too, and get its own segment.
+  fill_noise(input, input_count, 20);
+  fill_sine(input, 8000, 8000.0f);
+  output_count = voice_activity_process(vad, input, input_count, output);
+  TEST_INTEQ(4800 + 8000 + 3200 + 320, output_count);
+  TEST_INTEQ(2, vad->segments_length);
+  const float second_time = voice_activity_stream_time(vad, 1.02f + 0.3f);
+  TEST_CHECK(fabsf(second_time - 2.5f) < 0.001f);
+  TEST_MSG("%f", second_time);
+
+  free(input);
+  free(output);
+  voice_activity_free(vad);
+}
+
+void test_voice_activity_unvoiced() {
+  // Loud-ish hiss, like a fricative, after quieter background noise. It isn't
+  // enough louder to count as voiced, but the crossing rate should catch it.
+  const int32_t input_count = 24000;
+  int16_t* input = calloc(input_count, sizeof(int16_t));
+  fill_noise(input, input_count, 100);
+  for (int i = 16000; i < input_count; ++i) {
+    input[i] = (int16_t)(input[i] * 1.7f);
+  }
+  VoiceActivity* vad = voice_activity_alloc(16000, 100, 100);
+  int16_t* output =
+    calloc(voice_activity_max_output(vad, input_count), sizeof(int16_t));
+  const int32_t output_count =
+    voice_activity_process(vad, input, input_count, output);
+  TEST_CHECK(output_count > 0);
+  TEST_CHECK(vad->is_active);
+  free(input);
+  free(output);
+  voice_activity_free(vad);
+}
+
+void test_voice_activity_stream_time() {
+  VoiceActivity* vad = voice_activity_alloc(1000, 100, 100);
+  TEST_CHECK(voice_activity_stream_time(vad, 1.5f) == 1.5f);
+  add_segment(vad, 0, 2000);
+  add_segment(vad, 500, 10000);
+  add_segment(vad, 800, 20000);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 0.1f) - 2.1f) < 0.001f);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 0.5f) - 10.0f) < 0.001f);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 0.7f) - 10.2f) < 0.001f);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 1.0f) - 20.2f) < 0.001f);
+  voice_activity_free(vad);
+}
+
+void test_voice_activity_forget_before() {
+  VoiceActivity* vad = voice_activity_alloc(1000, 100, 100);
+  add_segment(vad, 0, 2000);
+  voice_activity_forget_before(vad, 100);
+  TEST_INTEQ(1, vad->segments_length);
+  add_segment(vad, 500, 10000);
+  add_segment(vad, 800, 20000);
+  voice_activity_forget_before(vad, 600);
+  TEST_INTEQ(2, vad->segments_length);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 0.7f) - 10.2f) < 0.001f);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 1.0f) - 20.2f) < 0.001f);
+  voice_activity_forget_before(vad, 900);
+  TEST_INTEQ(1, vad->segments_length);
+  TEST_CHECK(fabsf(voice_activity_stream_time(vad, 1.0f) - 20.2f) < 0.001f);
+  voice_activity_free(vad);
+}
+
+TEST_LIST = {
+  {"voice_activity_silence", test_voice_activity_silence},
+  {"voice_activity_speech_with_preroll",
+    test_voice_activity_speech_with_preroll},
+  {"voice_activity_unvoiced", test_voice_activity_unvoiced},
+  {"voice_activity_stream_time", test_voice_activity_stream_time},
+  {"voice_activity_forget_before", test_voice_activity_forget_before},
+  {NULL, NULL},
+};
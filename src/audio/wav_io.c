@@ -3,28 +3,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "audio_buffer.h"
 #include "string_utils.h"
 #include "trace.h"
 
+// RF64 and BW64 files store this in any 32-bit size field that overflowed,
+// with the real 64-bit value held in the 'ds64' chunk instead.
+#define WAV_IO_SIZE_PLACEHOLDER (0xffffffff)
+
+// Format type codes from the 'fmt ' chunk.
+#define WAV_IO_FORMAT_PCM (0x0001)
+#define WAV_IO_FORMAT_FLOAT (0x0003)
+#define WAV_IO_FORMAT_EXTENSIBLE (0xfffe)
+
 static bool expect_data(const char* expected, int expected_size,
   FILE* file) {
-  uint8_t* data = calloc(1, expected_size);
-  fread(data, expected_size, 1, file);
-  const bool result = (memcmp(data, expected, expected_size) == 0);
-  free(data);
-  return result;
-}
-
-static void fread_and_discard(int size, FILE* file) {
-  uint8_t* data = calloc(1, size);
-  fread(data, size, 1, file);
-  free(data);
+  uint8_t data[16] = {};
+  if ((expected_size > sizeof(data)) ||
+    (fread(data, expected_size, 1, file) != 1)) {
+    return false;
+  }
+  return (memcmp(data, expected, expected_size) == 0);
 }
 
 static uint16_t fread_uint16(FILE* file) {
-  uint16_t result;
+  uint16_t result = 0;
   fread(&result, 2, 1, file);
   return result;
 }
@@ -34,7 +40,7 @@ static void fwrite_uint16(const uint16_t value, FILE* file) {
 }
 
 static uint32_t fread_uint32(FILE* file) {
-  uint32_t result;
+  uint32_t result = 0;
   fread(&result, 4, 1, file);
   return result;
 }
@@ -43,77 +49,507 @@ static void fwrite_uint32(const uint32_t value, FILE* file) {
   fwrite(&value, 4, 1, file);
 }
 
-bool wav_io_load(const char* filename, AudioBuffer** result) {
-  *result = NULL;
+static uint64_t fread_uint64(FILE* file) {
+  uint64_t result = 0;
+  fread(&result, 8, 1, file);
+  return result;
+}
 
-  FILE* file = fopen(filename, "rb");
-  if (file == NULL) {
-    fprintf(stderr, "Couldn't load file '%s'\n", filename);
-    return false;
+// Location of one chunk's payload within the file, after its id and size.
+typedef struct WavChunkStruct {
+  char id[4];
+  int64_t offset;
+  int64_t size;
+} WavChunk;
+
+static void add_chunk(const char* id, int64_t offset, int64_t size,
+  WavChunk** chunks, int* chunks_length) {
+  *chunks = realloc(*chunks, (*chunks_length + 1) * sizeof(WavChunk));
+  WavChunk* chunk = &(*chunks)[*chunks_length];
+  memcpy(chunk->id, id, 4);
+  chunk->offset = offset;
+  chunk->size = size;
+  *chunks_length += 1;
+}
+
+static const WavChunk* find_chunk(const char* id, const WavChunk* chunks,
+  int chunks_length) {
+  for (int i = 0; i < chunks_length; ++i) {
+    if (memcmp(chunks[i].id, id, 4) == 0) {
+      return &chunks[i];
+    }
+  }
+  return NULL;
+}
+
+// Walks the list of chunks that follows the 12-byte RIFF header, recording
+// where each one starts. Payloads are skipped by seeking, so nothing beyond
+// the chunk headers is actually read, except for the small 'ds64' chunk that
+// holds the 64-bit sizes for RF64 files. Sizes that run past the end of the
+// file are truncated, which also handles recorders that never went back to
+// fill in the final size.
+static void read_chunk_index(FILE* file, int64_t file_size, bool is_rf64,
+  WavChunk** chunks, int* chunks_length) {
+  *chunks = NULL;
+  *chunks_length = 0;
+  WavChunk* ds64_sizes = NULL;
+  int ds64_sizes_length = 0;
+
+  int64_t offset = 12;
+  while ((offset + 8) <= file_size) {
+    char id[4];
+    if ((fseeko(file, offset, SEEK_SET) != 0) ||
+      (fread(id, 4, 1, file) != 1)) {
+      break;
+    }
+    const uint32_t size32 = fread_uint32(file);
+    const int64_t payload_offset = offset + 8;
+    int64_t size = size32;
+
+    if (is_rf64 && (memcmp(id, "ds64", 4) == 0)) {
+      fread_uint64(file);  // riff_size
+      const uint64_t data_size = fread_uint64(file);
+      fread_uint64(file);  // sample_count
+      add_chunk("data", 0, data_size, &ds64_sizes, &ds64_sizes_length);
+      const uint32_t table_length = fread_uint32(file);
+      for (uint32_t i = 0; i < table_length; ++i) {
+        char table_id[4];
+        if (fread(table_id, 4, 1, file) != 1) {
+          break;
+        }
+        const uint64_t table_size = fread_uint64(file);
+        add_chunk(table_id, 0, table_size, &ds64_sizes, &ds64_sizes_length);
+      }
+    }
+    else if (size32 == WAV_IO_SIZE_PLACEHOLDER) {
+      const WavChunk* ds64_size =
+        find_chunk(id, ds64_sizes, ds64_sizes_length);
+      if (ds64_size != NULL) {
+        size = ds64_size->size;
+      }
+    }
+
+    const int64_t remaining = file_size - payload_offset;
+    if (size > remaining) {
+      size = remaining;
+    }
+    add_chunk(id, payload_offset, size, chunks, chunks_length);
+
+    // Chunks with an odd size are followed by a padding byte.
+    offset = payload_offset + size + (size & 1);
   }
 
-  if (!expect_data("RIFF", 4, file)) {
+  free(ds64_sizes);
+}
+
+static bool sample_format_from_header(uint16_t format_type,
+  uint16_t bits_per_sample, SampleFormat* format) {
+  if (format_type == WAV_IO_FORMAT_PCM) {
+    switch (bits_per_sample) {
+    case 8:
+      *format = SAMPLE_FORMAT_U8;
+      return true;
+    case 16:
+      *format = SAMPLE_FORMAT_S16;
+      return true;
+    case 24:
+      *format = SAMPLE_FORMAT_S24;
+      return true;
+    case 32:
+      *format = SAMPLE_FORMAT_S32;
+      return true;
+    }
+  }
+  else if (format_type == WAV_IO_FORMAT_FLOAT) {
+    switch (bits_per_sample) {
+    case 32:
+      *format = SAMPLE_FORMAT_F32;
+      return true;
+    case 64:
+      *format = SAMPLE_FORMAT_F64;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool read_header(const char* filename, WavReader* reader) {
+  FILE* file = reader->file;
+  char riff_id[4];
+  if (fread(riff_id, 4, 1, file) != 1) {
+    fprintf(stderr, "'RIFF' wasn't found in header of WAV file '%s'\n",
+      filename);
+    return false;
+  }
+  const bool is_rf64 = (memcmp(riff_id, "RF64", 4) == 0) ||
+    (memcmp(riff_id, "BW64", 4) == 0);
+  if (!is_rf64 && (memcmp(riff_id, "RIFF", 4) != 0)) {
     fprintf(stderr, "'RIFF' wasn't found in header of WAV file '%s'\n",
       filename);
-    fclose(file);
     return false;
   }
   fread_uint32(file);  // file_size_minus_eight
   if (!expect_data("WAVE", 4, file)) {
     fprintf(stderr, "'WAVE' wasn't found in header of WAV file '%s'\n",
       filename);
-    fclose(file);
     return false;
   }
 
-  uint8_t found_chunk_id[4];
-  fread(found_chunk_id, 4, 1, file);
-  while (memcmp(found_chunk_id, "fmt ", 4) != 0) {
-    const uint32_t chunk_size = fread_uint32(file);
-    fread_and_discard(chunk_size, file);
-    fread(found_chunk_id, 4, 1, file);
+  struct stat file_stat;
+  if (fstat(fileno(file), &file_stat) != 0) {
+    fprintf(stderr, "Couldn't get the size of WAV file '%s'\n", filename);
+    return false;
   }
-  const uint32_t format_chunk_size = fread_uint32(file);
-  if ((format_chunk_size != 18) && (format_chunk_size != 16)) {
-    fprintf(stderr,
-      "Format chunk size was %d instead of 16 or 18 in WAV file '%s'\n",
-      format_chunk_size, filename);
+  WavChunk* chunks = NULL;
+  int chunks_length = 0;
+  read_chunk_index(file, file_stat.st_size, is_rf64, &chunks,
+    &chunks_length);
+
+  const WavChunk* format_chunk = find_chunk("fmt ", chunks, chunks_length);
+  if (format_chunk == NULL) {
+    fprintf(stderr, "'fmt ' chunk wasn't found in WAV file '%s'\n",
+      filename);
+    free(chunks);
     return false;
   }
-  const uint16_t format_type = fread_uint16(file);
-  if (format_type != 1) {
+  if (format_chunk->size < 16) {
     fprintf(stderr,
-      "Format type was %d instead of 1 in WAV file '%s'\n",
-      format_type, filename);
+      "Format chunk size was %d instead of at least 16 in WAV file '%s'\n",
+      (int)(format_chunk->size), filename);
+    free(chunks);
     return false;
   }
+  fseeko(file, format_chunk->offset, SEEK_SET);
+  uint16_t format_type = fread_uint16(file);
   const uint16_t channels = fread_uint16(file);
   const uint32_t sample_rate = fread_uint32(file);
   fread_uint32(file);  // bytes_per_second
   fread_uint16(file);  // bytes_per_sample
   const uint16_t bits_per_sample = fread_uint16(file);
-  if (bits_per_sample != 16) {
+  // Extensible headers hold the real format type in the first two bytes of
+  // a sub-format GUID, after the extra fields. The container size in
+  // `bits_per_sample` is still what's needed to read the samples.
+  if (format_type == WAV_IO_FORMAT_EXTENSIBLE) {
+    if (format_chunk->size < 40) {
+      fprintf(stderr,
+        "Extensible format chunk was only %d bytes in WAV file '%s'\n",
+        (int)(format_chunk->size), filename);
+      free(chunks);
+      return false;
+    }
+    fread_uint16(file);  // extension_size
+    fread_uint16(file);  // valid_bits_per_sample
+    fread_uint32(file);  // channel_mask
+    format_type = fread_uint16(file);
+  }
+  SampleFormat format;
+  if (!sample_format_from_header(format_type, bits_per_sample, &format)) {
     fprintf(stderr,
-      "Bits per sample was %d instead of 16 in WAV file '%s'\n",
-      bits_per_sample, filename);
+      "Format type %d with %d bits per sample isn't supported in WAV file "
+      "'%s'\n", format_type, bits_per_sample, filename);
+    free(chunks);
+    return false;
+  }
+  if (channels == 0) {
+    fprintf(stderr, "No channels were found in WAV file '%s'\n", filename);
+    free(chunks);
     return false;
   }
-  if (format_chunk_size == 18) {
-    fread_and_discard(2, file);
+  if ((sample_rate == 0) || (sample_rate > INT32_MAX)) {
+    fprintf(stderr, "Sample rate %u isn't valid in WAV file '%s'\n",
+      sample_rate, filename);
+    free(chunks);
+    return false;
   }
 
-  fread(found_chunk_id, 4, 1, file);
-  while (memcmp(found_chunk_id, "data", 4) != 0) {
-    const uint32_t chunk_size = fread_uint32(file);
-    fread_and_discard(chunk_size, file);
+  const WavChunk* data_chunk = find_chunk("data", chunks, chunks_length);
+  if (data_chunk == NULL) {
+    fprintf(stderr, "'data' chunk wasn't found in WAV file '%s'\n",
+      filename);
+    free(chunks);
+    return false;
   }
 
-  const uint32_t chunk_size = fread_uint32(file);
-  const int samples_per_channel = (chunk_size / channels) / 2;
-  *result = audio_buffer_alloc(sample_rate, samples_per_channel, channels);
-  fread((*result)->data, chunk_size, 1, file);
+  reader->sample_rate = sample_rate;
+  reader->channels = channels;
+  reader->format = format;
+  reader->samples_per_channel =
+    (data_chunk->size / channels) / sample_format_bytes(format);
+  reader->samples_per_channel_read = 0;
+  reader->data_offset = data_chunk->offset;
+  free(chunks);
 
-  fclose(file);
+  fseeko(file, reader->data_offset, SEEK_SET);
+  return true;
+}
+
+bool wav_io_open(const char* filename, WavReader** result) {
+  *result = NULL;
+
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "Couldn't load file '%s'\n", filename);
+    return false;
+  }
+
+  WavReader* reader = calloc(1, sizeof(WavReader));
+  reader->file = file;
+  if (!read_header(filename, reader)) {
+    wav_io_close(reader);
+    return false;
+  }
+
+  *result = reader;
+  return true;
+}
+
+int32_t wav_io_read(WavReader* reader, int16_t* data,
+  int32_t max_samples_per_channel) {
+  const int64_t samples_remaining =
+    reader->samples_per_channel - reader->samples_per_channel_read;
+  int32_t samples_to_read = max_samples_per_channel;
+  if (samples_to_read > samples_remaining) {
+    samples_to_read = samples_remaining;
+  }
+  if (samples_to_read <= 0) {
+    return 0;
+  }
+  if (reader->format == SAMPLE_FORMAT_S16) {
+    const size_t frame_byte_count = reader->channels * sizeof(int16_t);
+    const int32_t samples_read =
+      fread(data, frame_byte_count, samples_to_read, reader->file);
+    reader->samples_per_channel_read += samples_read;
+    return samples_read;
+  }
+
+  const size_t frame_byte_count =
+    reader->channels * sample_format_bytes(reader->format);
+  const size_t raw_byte_count = samples_to_read * frame_byte_count;
+  if (raw_byte_count > reader->raw_capacity) {
+    reader->raw = realloc(reader->raw, raw_byte_count);
+    reader->raw_capacity = raw_byte_count;
+  }
+  const int32_t samples_read =
+    fread(reader->raw, frame_byte_count, samples_to_read, reader->file);
+  sample_convert(reader->format, reader->raw,
+    samples_read * reader->channels, data);
+  reader->samples_per_channel_read += samples_read;
+  return samples_read;
+}
+
+void wav_io_close(WavReader* reader) {
+  if (reader == NULL) {
+    return;
+  }
+  fclose(reader->file);
+  free(reader->raw);
+  free(reader);
+}
+
+static uint16_t bytes_uint16(const uint8_t* data) {
+  uint16_t result;
+  memcpy(&result, data, 2);
+  return result;
+}
+
+static uint32_t bytes_uint32(const uint8_t* data) {
+  uint32_t result;
+  memcpy(&result, data, 4);
+  return result;
+}
+
+WavIoHeaderStatus wav_io_parse_stream_header(const uint8_t* data,
+  size_t size, WavStreamFormat* result) {
+  if (size < 12) {
+    return WAV_IO_HEADER_INCOMPLETE;
+  }
+  const bool is_riff = (memcmp(data, "RIFF", 4) == 0) ||
+    (memcmp(data, "RF64", 4) == 0) || (memcmp(data, "BW64", 4) == 0);
+  if (!is_riff || (memcmp(data + 8, "WAVE", 4) != 0)) {
+    fprintf(stderr, "'RIFF' wasn't found in header of WAV stream\n");
+    return WAV_IO_HEADER_INVALID;
+  }
+
+  // Without being able to seek, every chunk before the samples has to be
+  // read through in order, and the 'fmt ' chunk has to come first.
+  bool has_format = false;
+  size_t offset = 12;
+  while ((offset + 8) <= size) {
+    const uint8_t* id = data + offset;
+    const size_t chunk_size = bytes_uint32(data + offset + 4);
+    const size_t payload_offset = offset + 8;
+    if (memcmp(id, "data", 4) == 0) {
+      if (!has_format) {
+        fprintf(stderr,
+          "'fmt ' chunk wasn't found before the samples in WAV stream\n");
+        return WAV_IO_HEADER_INVALID;
+      }
+      result->header_size = payload_offset;
+      return WAV_IO_HEADER_COMPLETE;
+    }
+    if (memcmp(id, "fmt ", 4) == 0) {
+      if (chunk_size < 16) {
+        fprintf(stderr,
+          "Format chunk size was %d instead of at least 16 in WAV stream\n",
+          (int)(chunk_size));
+        return WAV_IO_HEADER_INVALID;
+      }
+      if ((payload_offset + 16) > size) {
+        return WAV_IO_HEADER_INCOMPLETE;
+      }
+      const uint8_t* format_data = data + payload_offset;
+      uint16_t format_type = bytes_uint16(format_data);
+      const uint16_t channels = bytes_uint16(format_data + 2);
+      const uint32_t sample_rate = bytes_uint32(format_data + 4);
+      const uint16_t bits_per_sample = bytes_uint16(format_data + 14);
+      if (format_type == WAV_IO_FORMAT_EXTENSIBLE) {
+        if (chunk_size < 40) {
+          fprintf(stderr,
+            "Extensible format chunk was only %d bytes in WAV stream\n",
+            (int)(chunk_size));
+          return WAV_IO_HEADER_INVALID;
+        }
+        if ((payload_offset + 40) > size) {
+          return WAV_IO_HEADER_INCOMPLETE;
+        }
+        format_type = bytes_uint16(format_data + 24);
+      }
+      if (!sample_format_from_header(format_type, bits_per_sample,
+        &result->format)) {
+        fprintf(stderr,
+          "Format type %d with %d bits per sample isn't supported in WAV "
+          "stream\n", format_type, bits_per_sample);
+        return WAV_IO_HEADER_INVALID;
+      }
+      if (channels == 0) {
+        fprintf(stderr, "No channels were found in WAV stream\n");
+        return WAV_IO_HEADER_INVALID;
+      }
+      if ((sample_rate == 0) || (sample_rate > INT32_MAX)) {
+        fprintf(stderr, "Sample rate %u isn't valid in WAV stream\n",
+          sample_rate);
+        return WAV_IO_HEADER_INVALID;
+      }
+      result->sample_rate = sample_rate;
+      result->channels = channels;
+      has_format = true;
+    }
+    // Sizes come straight from the stream, so this is checked before adding
+    // them, since a huge one could wrap around a 32-bit size_t. A chunk
+    // that hasn't all arrived yet is waited for.
+    if (chunk_size >= (size - payload_offset)) {
+      return WAV_IO_HEADER_INCOMPLETE;
+    }
+    offset = payload_offset + chunk_size + (chunk_size & 1);
+  }
+  return WAV_IO_HEADER_INCOMPLETE;
+}
+
+// AudioBuffer can only hold up to 2^31 samples per channel, which is over a
+// day of audio at 16KHz. Longer files can still be processed in blocks with
+// the WavReader interface.
+static bool check_loadable_length(const char* filename,
+  const WavReader* reader) {
+  // Buffers are indexed by int32_t sample counts across all channels.
+  if ((reader->samples_per_channel * reader->channels) > INT32_MAX) {
+    fprintf(stderr,
+      "WAV file '%s' is too long to load at once, try --stream_files\n",
+      filename);
+    return false;
+  }
+  return true;
+}
+
+// Reading in blocks keeps the buffer used to convert other sample formats
+// small, rather than the size of the whole file.
+static AudioBuffer* load_by_copying(WavReader* reader) {
+  AudioBuffer* result = audio_buffer_alloc(reader->sample_rate,
+    reader->samples_per_channel, reader->channels);
+  const int32_t block_size = 65536;
+  int32_t offset = 0;
+  while (offset < result->samples_per_channel) {
+    const int32_t samples_read = wav_io_read(reader,
+      result->data + ((size_t)(offset) * reader->channels), block_size);
+    if (samples_read == 0) {
+      break;
+    }
+    offset += samples_read;
+  }
+  return result;
+}
+
+static bool is_host_little_endian() {
+  const uint16_t value = 1;
+  return (*(const uint8_t*)(&value) == 1);
+}
+
+bool wav_io_load(const char* filename, AudioBuffer** result) {
+  *result = NULL;
+
+  WavReader* reader = NULL;
+  if (!wav_io_open(filename, &reader)) {
+    return false;
+  }
+  if (!check_loadable_length(filename, reader)) {
+    wav_io_close(reader);
+    return false;
+  }
+
+  *result = load_by_copying(reader);
+
+  wav_io_close(reader);
+  return true;
+}
+
+bool wav_io_load_mapped(const char* filename, AudioBuffer** result) {
+  *result = NULL;
+
+  WavReader* reader = NULL;
+  if (!wav_io_open(filename, &reader)) {
+    return false;
+  }
+  if (!check_loadable_length(filename, reader)) {
+    wav_io_close(reader);
+    return false;
+  }
+
+  const int64_t data_offset = reader->data_offset;
+  const size_t data_byte_count =
+    (size_t)(reader->samples_per_channel) * reader->channels * sizeof(int16_t);
+  struct stat file_stat;
+  const int fd = fileno(reader->file);
+  const bool can_map = is_host_little_endian() &&
+    (reader->format == SAMPLE_FORMAT_S16) &&
+    (data_offset >= 0) &&
+    ((data_offset % sizeof(int16_t)) == 0) &&
+    (data_byte_count > 0) &&
+    (fstat(fd, &file_stat) == 0) &&
+    ((data_offset + data_byte_count) <= file_stat.st_size);
+  if (!can_map) {
+    *result = load_by_copying(reader);
+    wav_io_close(reader);
+    return true;
+  }
+
+  // A private writable mapping means anything that modifies the samples gets
+  // its own copy of the touched pages, rather than changing the file.
+  const size_t mapping_byte_count = file_stat.st_size;
+  void* mapping = mmap(NULL, mapping_byte_count, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    *result = load_by_copying(reader);
+    wav_io_close(reader);
+    return true;
+  }
+  posix_madvise(mapping, mapping_byte_count, POSIX_MADV_SEQUENTIAL);
+
+  int16_t* data = (int16_t*)((uint8_t*)(mapping) + data_offset);
+  *result = audio_buffer_alloc_mapped(reader->sample_rate,
+    reader->samples_per_channel, reader->channels, data, mapping,
+    mapping_byte_count);
+
+  // The mapping stays valid after the file is closed.
+  wav_io_close(reader);
   return true;
 }
 
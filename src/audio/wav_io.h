@@ -2,11 +2,78 @@
 #define INCLUDE_WAV_IO_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "audio_buffer.h"
+#include "sample_convert.h"
 
+// Samples can be 8, 16, 24 or 32-bit integers, or 32 or 64-bit floats, in
+// either a plain or a WAVE_FORMAT_EXTENSIBLE header. They're always converted
+// to 16-bit as they're read.
 bool wav_io_load(const char* filename, AudioBuffer** result);
 
+// Like wav_io_load(), but for 16-bit little-endian data the buffer points
+// straight into a private copy-on-write mapping of the file, avoiding a heap
+// allocation and a copy of every sample. The samples can still be changed in
+// place, for example by downmixing, which copies only the pages written to
+// and leaves the file alone. Falls back to copying when the samples can't be
+// used in place, for example on big-endian hosts or with misaligned data.
+bool wav_io_load_mapped(const char* filename, AudioBuffer** result);
+
+// Incremental reader for files that are too long to hold in memory at once.
+// After opening, the format fields describe the whole file, and each call to
+// wav_io_read() returns the next block of interleaved samples.
+typedef struct WavReaderStruct {
+  FILE* file;
+  int32_t sample_rate;
+  int32_t channels;
+  // 64-bit to handle RF64 and BW64 files with data chunks over 4GB.
+  int64_t samples_per_channel;
+  int64_t samples_per_channel_read;
+  int64_t data_offset;
+  // How the samples are stored in the file. Anything other than 16-bit is
+  // read into `raw` first, and converted from there.
+  SampleFormat format;
+  uint8_t* raw;
+  size_t raw_capacity;
+} WavReader;
+
+bool wav_io_open(const char* filename, WavReader** result);
+
+// Reads up to `max_samples_per_channel` frames into `data`, which must have
+// room for that many samples times the number of channels. Returns the number
+// of frames actually read, which will be zero once the end is reached.
+int32_t wav_io_read(WavReader* reader, int16_t* data,
+  int32_t max_samples_per_channel);
+
+void wav_io_close(WavReader* reader);
+
+// Sample layout of a WAV file that's arriving through a pipe, where the
+// header has to be parsed from the bytes seen so far rather than by seeking
+// around the file.
+typedef struct WavStreamFormatStruct {
+  int32_t sample_rate;
+  int32_t channels;
+  SampleFormat format;
+  // Number of bytes before the first sample.
+  size_t header_size;
+} WavStreamFormat;
+
+typedef enum {
+  WAV_IO_HEADER_INCOMPLETE,
+  WAV_IO_HEADER_COMPLETE,
+  WAV_IO_HEADER_INVALID,
+} WavIoHeaderStatus;
+
+// Looks for a header at the start of the first `size` bytes of a stream,
+// returning WAV_IO_HEADER_INCOMPLETE until enough has arrived to reach the
+// samples. The size of the 'data' chunk is ignored, since programs writing
+// to a pipe can't go back to fill it in, so the samples last until the
+// stream ends.
+WavIoHeaderStatus wav_io_parse_stream_header(const uint8_t* data,
+  size_t size, WavStreamFormat* result);
+
 bool wav_io_save(const char* filename, const AudioBuffer* buffer);
 
 #endif  // INCLUDE_WAV_IO_H
\ No newline at end of file
@@ -19,20 +19,6 @@ void test_expect_data() {
   fclose(file);
 }
 
-void test_fread_and_discard() {
-  const char* test_filename = "/tmp/test_fread_and_discard";
-  file_write(test_filename, "FooBarBaz", 9);
-
-  FILE* file = fopen(test_filename, "rb");
-  TEST_CHECK(file != NULL);
-
-  TEST_CHECK(expect_data("Foo", 3, file));
-  fread_and_discard(3, file);
-  TEST_CHECK(expect_data("Baz", 3, file));
-
-  fclose(file);
-}
-
 void test_fread_uint16() {
   const char* test_filename = "/tmp/test_fread_uint16";
   uint16_t value = 0x3123;
@@ -131,6 +117,371 @@ void test_wav_io_load() {
   audio_buffer_free(buffer);
 }
 
+void test_wav_io_load_mapped() {
+  const char* test_filename = "/tmp/test_wav_io_load_mapped.wav";
+  AudioBuffer* original = audio_buffer_alloc(16000, 1000, 2);
+  for (int i = 0; i < 2000; ++i) {
+    original->data[i] = (i * 37) - 10000;
+  }
+  TEST_ASSERT(wav_io_save(test_filename, original));
+
+  AudioBuffer* buffer = NULL;
+  TEST_ASSERT(wav_io_load_mapped(test_filename, &buffer));
+  TEST_ASSERT(buffer != NULL);
+  TEST_CHECK(buffer->mapping != NULL);
+  TEST_INTEQ(2, buffer->channels);
+  TEST_INTEQ(16000, buffer->sample_rate);
+  TEST_INTEQ(1000, buffer->samples_per_channel);
+  TEST_MEMEQ(original->data, buffer->data, 2000 * sizeof(int16_t));
+
+  // Writes should only affect the private copy, not the file on disk.
+  buffer->data[0] = 42;
+  audio_buffer_free(buffer);
+
+  TEST_ASSERT(wav_io_load(test_filename, &buffer));
+  TEST_INTEQ(original->data[0], buffer->data[0]);
+  audio_buffer_free(buffer);
+  audio_buffer_free(original);
+}
+
+void test_wav_io_open_and_read() {
+  const char* test_filename = "/tmp/test_wav_io_open_and_read.wav";
+  unsigned char test_data[] = {
+    'R', 'I', 'F', 'F',
+    46, 0, 0, 0,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,  // Format chunk size.
+    1, 0,  // Format type.
+    1, 0,  // Channels.
+    0x80, 0x3e, 0, 0,  // Sample rate.
+    0x00, 0x7d, 0, 0,  // Bytes per second.
+    2, 0,  // Bytes per frame (#channels).
+    16, 0, // Bits per sample.
+    'd', 'a', 't', 'a',
+    10, 0, 0, 0,  // Data chunk size.
+    1, 0,  // Sample #1.
+    2, 0,  // Sample #2.
+    3, 0,  // Sample #3.
+    4, 0,  // Sample #4.
+    5, 0,  // Sample #5.
+  };
+  const size_t test_data_length = sizeof(test_data) / sizeof(test_data[0]);
+  file_write(test_filename, (char*)(test_data), test_data_length);
+
+  WavReader* reader = NULL;
+  TEST_ASSERT(wav_io_open(test_filename, &reader));
+  TEST_ASSERT(reader != NULL);
+  TEST_INTEQ(1, reader->channels);
+  TEST_INTEQ(16000, reader->sample_rate);
+  TEST_INTEQ(5, (int)(reader->samples_per_channel));
+
+  int16_t block[3];
+  int32_t samples_read = wav_io_read(reader, block, 3);
+  TEST_INTEQ(3, samples_read);
+  TEST_INTEQ(1, block[0]);
+  TEST_INTEQ(2, block[1]);
+  TEST_INTEQ(3, block[2]);
+  samples_read = wav_io_read(reader, block, 3);
+  TEST_INTEQ(2, samples_read);
+  TEST_INTEQ(4, block[0]);
+  TEST_INTEQ(5, block[1]);
+  samples_read = wav_io_read(reader, block, 3);
+  TEST_INTEQ(0, samples_read);
+  wav_io_close(reader);
+
+  reader = NULL;
+  TEST_CHECK(!wav_io_open("/tmp/does_not_exist.wav", &reader));
+  TEST_CHECK(reader == NULL);
+}
+
+void test_read_chunk_index() {
+  const char* test_filename = "/tmp/test_read_chunk_index.wav";
+  unsigned char test_data[] = {
+    'R', 'I', 'F', 'F',  // #0
+    48, 0, 0, 0,  // #4
+    'W', 'A', 'V', 'E',  // #8
+    'f', 'm', 't', ' ',  // #12
+    16, 0, 0, 0,  // #16, Format chunk size.
+    1, 0, 1, 0, 0x80, 0x3e, 0, 0, 0x00, 0x7d, 0, 0, 2, 0, 16, 0,  // #20
+    'L', 'I', 'S', 'T',  // #36
+    3, 0, 0, 0,  // #40, Odd size, so should be followed by a padding byte.
+    'a', 'b', 'c', 0,  // #44
+    'd', 'a', 't', 'a',  // #48
+    100, 0, 0, 0,  // #52, Larger than the actual data.
+    1, 0, 2, 0,  // #56
+  };
+  const size_t test_data_length = sizeof(test_data) / sizeof(test_data[0]);
+  file_write(test_filename, (char*)(test_data), test_data_length);
+
+  FILE* file = fopen(test_filename, "rb");
+  TEST_ASSERT(file != NULL);
+  WavChunk* chunks = NULL;
+  int chunks_length = 0;
+  read_chunk_index(file, test_data_length, false, &chunks, &chunks_length);
+  fclose(file);
+
+  TEST_ASSERT(chunks_length == 3);
+  TEST_MEMEQ("fmt ", chunks[0].id, 4);
+  TEST_INTEQ(20, (int)(chunks[0].offset));
+  TEST_INTEQ(16, (int)(chunks[0].size));
+  TEST_MEMEQ("LIST", chunks[1].id, 4);
+  TEST_INTEQ(44, (int)(chunks[1].offset));
+  TEST_INTEQ(3, (int)(chunks[1].size));
+  TEST_MEMEQ("data", chunks[2].id, 4);
+  TEST_INTEQ(56, (int)(chunks[2].offset));
+  TEST_INTEQ(4, (int)(chunks[2].size));
+  TEST_CHECK(find_chunk("data", chunks, chunks_length) == &chunks[2]);
+  TEST_CHECK(find_chunk("JUNK", chunks, chunks_length) == NULL);
+  free(chunks);
+
+  // This used to loop forever, because of the chunk before 'data'.
+  AudioBuffer* buffer = NULL;
+  TEST_ASSERT(wav_io_load(test_filename, &buffer));
+  TEST_INTEQ(2, buffer->samples_per_channel);
+  TEST_INTEQ(1, buffer->data[0]);
+  TEST_INTEQ(2, buffer->data[1]);
+  audio_buffer_free(buffer);
+}
+
+void test_wav_io_load_rf64() {
+  const char* test_filename = "/tmp/test_wav_io_load_rf64.wav";
+  unsigned char test_data[] = {
+    'R', 'F', '6', '4',
+    0xff, 0xff, 0xff, 0xff,
+    'W', 'A', 'V', 'E',
+    'd', 's', '6', '4',
+    28, 0, 0, 0,
+    0x40, 0, 0, 0, 0, 0, 0, 0,  // RIFF size.
+    6, 0, 0, 0, 0, 0, 0, 0,  // Data size.
+    3, 0, 0, 0, 0, 0, 0, 0,  // Sample count.
+    0, 0, 0, 0,  // Table length.
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,
+    1, 0, 1, 0, 0x80, 0x3e, 0, 0, 0x00, 0x7d, 0, 0, 2, 0, 16, 0,
+    'd', 'a', 't', 'a',
+    0xff, 0xff, 0xff, 0xff,
+    7, 0, 8, 0, 9, 0,
+    // Trailing chunk that shouldn't be counted as part of the data.
+    'J', 'U', 'N', 'K',
+    2, 0, 0, 0,
+    0, 0,
+  };
+  const size_t test_data_length = sizeof(test_data) / sizeof(test_data[0]);
+  file_write(test_filename, (char*)(test_data), test_data_length);
+
+  WavReader* reader = NULL;
+  TEST_ASSERT(wav_io_open(test_filename, &reader));
+  TEST_INTEQ(1, reader->channels);
+  TEST_INTEQ(16000, reader->sample_rate);
+  TEST_INTEQ(3, (int)(reader->samples_per_channel));
+  wav_io_close(reader);
+
+  AudioBuffer* buffer = NULL;
+  TEST_ASSERT(wav_io_load(test_filename, &buffer));
+  TEST_INTEQ(3, buffer->samples_per_channel);
+  TEST_INTEQ(7, buffer->data[0]);
+  TEST_INTEQ(8, buffer->data[1]);
+  TEST_INTEQ(9, buffer->data[2]);
+  audio_buffer_free(buffer);
+
+  // BW64 uses the same layout with a different id.
+  test_data[0] = 'B';
+  test_data[1] = 'W';
+  file_write(test_filename, (char*)(test_data), test_data_length);
+  TEST_ASSERT(wav_io_load(test_filename, &buffer));
+  TEST_INTEQ(3, buffer->samples_per_channel);
+  audio_buffer_free(buffer);
+}
+
+void test_wav_io_load_missing_data() {
+  const char* test_filename = "/tmp/test_wav_io_load_missing_data.wav";
+  unsigned char test_data[] = {
+    'R', 'I', 'F', 'F',
+    28, 0, 0, 0,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,
+    1, 0, 1, 0, 0x80, 0x3e, 0, 0, 0x00, 0x7d, 0, 0, 2, 0, 16, 0,
+  };
+  const size_t test_data_length = sizeof(test_data) / sizeof(test_data[0]);
+  file_write(test_filename, (char*)(test_data), test_data_length);
+
+  AudioBuffer* buffer = NULL;
+  TEST_CHECK(!wav_io_load(test_filename, &buffer));
+  TEST_CHECK(buffer == NULL);
+}
+
+void test_check_loadable_length() {
+  WavReader reader;
+  memset(&reader, 0, sizeof(reader));
+  reader.channels = 2;
+  reader.samples_per_channel = INT32_MAX / 2;
+  TEST_CHECK(check_loadable_length("test.wav", &reader));
+  // Fewer frames than INT32_MAX can still be too many samples in total.
+  reader.samples_per_channel = (INT32_MAX / 2) + 1;
+  TEST_CHECK(!check_loadable_length("test.wav", &reader));
+}
+
+void test_wav_io_load_formats() {
+  const char* test_filename = "/tmp/test_wav_io_load_formats.wav";
+  // 32-bit float in an extensible header, as written by most audio editors.
+  unsigned char float_data[] = {
+    'R', 'I', 'F', 'F',
+    76, 0, 0, 0,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    40, 0, 0, 0,  // Format chunk size.
+    0xfe, 0xff,  // Format type (extensible).
+    1, 0,  // Channels.
+    0x80, 0xbb, 0, 0,  // Sample rate.
+    0x00, 0xee, 0x02, 0,  // Bytes per second.
+    4, 0,  // Bytes per frame.
+    32, 0,  // Bits per sample.
+    22, 0,  // Extension size.
+    32, 0,  // Valid bits per sample.
+    4, 0, 0, 0,  // Channel mask.
+    3, 0, 0, 0, 0, 0, 0x10, 0,  // Sub-format GUID (float).
+    0x80, 0, 0, 0xaa, 0, 0x38, 0x9b, 0x71,
+    'd', 'a', 't', 'a',
+    12, 0, 0, 0,  // Data chunk size.
+    0, 0, 0, 0x3f,  // 0.5
+    0, 0, 0x80, 0xbe,  // -0.25
+    0, 0, 0, 0x40,  // 2.0
+  };
+  file_write(test_filename, (char*)(float_data), sizeof(float_data));
+  AudioBuffer* buffer = NULL;
+  TEST_ASSERT(wav_io_load_mapped(test_filename, &buffer));
+  TEST_CHECK(buffer->mapping == NULL);
+  TEST_INTEQ(48000, buffer->sample_rate);
+  TEST_INTEQ(1, buffer->channels);
+  TEST_INTEQ(3, buffer->samples_per_channel);
+  TEST_INTEQ(16384, buffer->data[0]);
+  TEST_INTEQ(-8192, buffer->data[1]);
+  TEST_INTEQ(32767, buffer->data[2]);
+  audio_buffer_free(buffer);
+
+  // 24-bit stereo PCM, read through the streaming interface.
+  unsigned char s24_data[] = {
+    'R', 'I', 'F', 'F',
+    48, 0, 0, 0,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,
+    1, 0, 2, 0, 0x80, 0x3e, 0, 0, 0x00, 0x77, 0x01, 0, 6, 0, 24, 0,
+    'd', 'a', 't', 'a',
+    12, 0, 0, 0,
+    0x00, 0x34, 0x12, 0xff, 0xff, 0xff,
+    0x00, 0x00, 0x80, 0xff, 0xff, 0x7f,
+  };
+  file_write(test_filename, (char*)(s24_data), sizeof(s24_data));
+  WavReader* reader = NULL;
+  TEST_ASSERT(wav_io_open(test_filename, &reader));
+  TEST_INTEQ(SAMPLE_FORMAT_S24, reader->format);
+  TEST_INTEQ(2, (int)(reader->samples_per_channel));
+  int16_t block[4];
+  TEST_INTEQ(2, wav_io_read(reader, block, 2));
+  TEST_INTEQ(0x1234, block[0]);
+  TEST_INTEQ(-1, block[1]);
+  TEST_INTEQ(-32768, block[2]);
+  TEST_INTEQ(32767, block[3]);
+  wav_io_close(reader);
+
+  // 8-bit PCM is unsigned.
+  unsigned char u8_data[] = {
+    'R', 'I', 'F', 'F',
+    39, 0, 0, 0,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,
+    1, 0, 1, 0, 0x40, 0x1f, 0, 0, 0x40, 0x1f, 0, 0, 1, 0, 8, 0,
+    'd', 'a', 't', 'a',
+    3, 0, 0, 0,
+    0, 128, 255,
+    0,  // Padding byte.
+  };
+  file_write(test_filename, (char*)(u8_data), sizeof(u8_data));
+  TEST_ASSERT(wav_io_load(test_filename, &buffer));
+  TEST_INTEQ(8000, buffer->sample_rate);
+  TEST_INTEQ(3, buffer->samples_per_channel);
+  TEST_INTEQ(-32768, buffer->data[0]);
+  TEST_INTEQ(0, buffer->data[1]);
+  TEST_INTEQ(32512, buffer->data[2]);
+  audio_buffer_free(buffer);
+
+  // A-law compressed audio isn't supported.
+  u8_data[20] = 6;
+  file_write(test_filename, (char*)(u8_data), sizeof(u8_data));
+  buffer = NULL;
+  TEST_CHECK(!wav_io_load(test_filename, &buffer));
+  TEST_CHECK(buffer == NULL);
+}
+
+void test_wav_io_parse_stream_header() {
+  // As written by a program piping its output, with placeholder sizes and a
+  // metadata chunk before the samples.
+  const unsigned char header[] = {
+    'R', 'I', 'F', 'F',
+    0xff, 0xff, 0xff, 0xff,
+    'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ',
+    16, 0, 0, 0,
+    1, 0, 2, 0, 0x44, 0xac, 0, 0, 0x10, 0xb1, 0x02, 0, 4, 0, 16, 0,
+    'L', 'I', 'S', 'T',
+    3, 0, 0, 0,
+    'a', 'b', 'c',
+    0,  // Padding byte.
+    'd', 'a', 't', 'a',
+    0xff, 0xff, 0xff, 0xff,
+    0x12, 0x34,
+  };
+  const size_t header_size = sizeof(header) - 2;
+  WavStreamFormat format;
+  for (size_t size = 0; size < header_size; ++size) {
+    if (!TEST_CHECK(wav_io_parse_stream_header(header, size, &format) ==
+      WAV_IO_HEADER_INCOMPLETE)) {
+      TEST_MSG("Size was %d", (int)(size));
+      break;
+    }
+  }
+  TEST_CHECK(wav_io_parse_stream_header(header, sizeof(header), &format) ==
+    WAV_IO_HEADER_COMPLETE);
+  TEST_INTEQ(44100, format.sample_rate);
+  TEST_INTEQ(2, format.channels);
+  TEST_INTEQ(SAMPLE_FORMAT_S16, format.format);
+  TEST_INTEQ((int)(header_size), (int)(format.header_size));
+
+  const unsigned char raw[] = { 'R', 'I', 'F', 'X', 0, 0, 0, 0,
+    'W', 'A', 'V', 'E' };
+  TEST_CHECK(wav_io_parse_stream_header(raw, sizeof(raw), &format) ==
+    WAV_IO_HEADER_INVALID);
+
+  // A chunk too large to ever arrive is waited for, rather than its size
+  // wrapping the offset back into the header.
+  unsigned char huge_chunk[sizeof(header)];
+  memcpy(huge_chunk, header, sizeof(header));
+  memset(huge_chunk + 40, 0xff, 4);
+  TEST_CHECK(wav_io_parse_stream_header(huge_chunk, sizeof(huge_chunk),
+    &format) == WAV_IO_HEADER_INCOMPLETE);
+  huge_chunk[40] = 0xf8;
+  TEST_CHECK(wav_io_parse_stream_header(huge_chunk, sizeof(huge_chunk),
+    &format) == WAV_IO_HEADER_INCOMPLETE);
+
+  // The samples can't be read without knowing their format first.
+  unsigned char no_format[sizeof(header)];
+  memcpy(no_format, header, sizeof(header));
+  memcpy(no_format + 12, "JUNK", 4);
+  TEST_CHECK(wav_io_parse_stream_header(no_format, sizeof(no_format),
+    &format) == WAV_IO_HEADER_INVALID);
+
+  // Rates that don't fit in the format's int32_t are refused.
+  unsigned char bad_rate[sizeof(header)];
+  memcpy(bad_rate, header, sizeof(header));
+  memset(bad_rate + 24, 0xff, 4);
+  TEST_CHECK(wav_io_parse_stream_header(bad_rate, sizeof(bad_rate),
+    &format) == WAV_IO_HEADER_INVALID);
+}
+
 void test_wav_io_save() {
   const char* test_filename = "/tmp/test_wav_io_save.wav";
 
@@ -207,12 +558,19 @@ void test_wav_io_save_listenable() {
 
 TEST_LIST = {
   {"expect_data", test_expect_data},
-  {"fread_and_discard", test_fread_and_discard},
   {"fread_uint16", test_fread_uint16},
   {"fwrite_uint16", test_fwrite_uint16},
   {"fread_uint32", test_fread_uint32},
   {"fwrite_uint32", test_fwrite_uint32},
   {"wav_io_load", test_wav_io_load},
+  {"read_chunk_index", test_read_chunk_index},
+  {"wav_io_load_rf64", test_wav_io_load_rf64},
+  {"wav_io_load_missing_data", test_wav_io_load_missing_data},
+  {"check_loadable_length", test_check_loadable_length},
+  {"wav_io_load_mapped", test_wav_io_load_mapped},
+  {"wav_io_open_and_read", test_wav_io_open_and_read},
+  {"wav_io_load_formats", test_wav_io_load_formats},
+  {"wav_io_parse_stream_header", test_wav_io_parse_stream_header},
   {"wav_io_save", test_wav_io_save},
   {"wav_io_save_listenable", test_wav_io_save_listenable},
   {NULL, NULL},
@@ -0,0 +1,64 @@
+#include "decode_cadence.h"
+
+#include <stdlib.h>
+
+// Adaptive mode never goes quicker than this, even if the requested interval
+// is zero, since otherwise it has no audio period to compare against.
+#define DECODE_CADENCE_MIN_ADAPTIVE_MS (40)
+
+DecodeCadence* decode_cadence_alloc(int32_t sample_rate, int32_t interval_ms,
+  bool is_adaptive) {
+  DecodeCadence* result = calloc(1, sizeof(DecodeCadence));
+  result->sample_rate = sample_rate;
+  if (interval_ms < 0) {
+    interval_ms = 0;
+  }
+  if (is_adaptive && (interval_ms < DECODE_CADENCE_MIN_ADAPTIVE_MS)) {
+    interval_ms = DECODE_CADENCE_MIN_ADAPTIVE_MS;
+  }
+  result->min_interval_ms = interval_ms;
+  result->interval_ms = interval_ms;
+  result->is_adaptive = is_adaptive;
+  result->samples_since_decode = 0;
+  return result;
+}
+
+void decode_cadence_free(DecodeCadence* cadence) {
+  free(cadence);
+}
+
+void decode_cadence_add_samples(DecodeCadence* cadence, int32_t count) {
+  cadence->samples_since_decode += count;
+}
+
+bool decode_cadence_should_decode(const DecodeCadence* cadence) {
+  if (cadence->samples_since_decode == 0) {
+    return false;
+  }
+  const int64_t interval_samples =
+    ((int64_t)(cadence->interval_ms) * cadence->sample_rate) / 1000;
+  return (cadence->samples_since_decode >= interval_samples);
+}
+
+void decode_cadence_record_decode(DecodeCadence* cadence, double decode_ms) {
+  cadence->samples_since_decode = 0;
+  if (!cadence->is_adaptive) {
+    return;
+  }
+  // Back off when decoding eats up more than half of the audio period, and
+  // only speed up again once it's well under, so we don't oscillate.
+  if ((decode_ms > (cadence->interval_ms * 0.5)) &&
+    (cadence->interval_ms < DECODE_CADENCE_MAX_INTERVAL_MS)) {
+    cadence->interval_ms *= 2;
+    if (cadence->interval_ms > DECODE_CADENCE_MAX_INTERVAL_MS) {
+      cadence->interval_ms = DECODE_CADENCE_MAX_INTERVAL_MS;
+    }
+  }
+  else if ((decode_ms < (cadence->interval_ms * 0.125)) &&
+    (cadence->interval_ms > cadence->min_interval_ms)) {
+    cadence->interval_ms /= 2;
+    if (cadence->interval_ms < cadence->min_interval_ms) {
+      cadence->interval_ms = cadence->min_interval_ms;
+    }
+  }
+}
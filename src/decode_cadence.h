@@ -0,0 +1,45 @@
+#ifndef INCLUDE_DECODE_CADENCE_H
+#define INCLUDE_DECODE_CADENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // The longest gap between partial results that adaptive mode will back off
+  // to, however slow decoding gets.
+#define DECODE_CADENCE_MAX_INTERVAL_MS (2000)
+
+  // Decides how often to ask for intermediate results while audio is being
+  // fed to a stream. Each intermediate decode re-runs the search over the
+  // whole stream, so it's much more expensive than feeding, and there's little
+  // point doing it more often than people can read. Intervals are measured in
+  // audio time, by counting the samples fed since the last decode.
+  typedef struct DecodeCadenceStruct {
+    int32_t sample_rate;
+    int32_t min_interval_ms;
+    int32_t interval_ms;
+    bool is_adaptive;
+    int64_t samples_since_decode;
+  } DecodeCadence;
+
+  // An `interval_ms` of zero decodes after every feed. In adaptive mode, the
+  // interval starts there and doubles whenever a decode takes more than half
+  // of it, then halves again once decodes get quick enough.
+  DecodeCadence* decode_cadence_alloc(int32_t sample_rate, int32_t interval_ms,
+    bool is_adaptive);
+  void decode_cadence_free(DecodeCadence* cadence);
+
+  void decode_cadence_add_samples(DecodeCadence* cadence, int32_t count);
+  bool decode_cadence_should_decode(const DecodeCadence* cadence);
+
+  // Call after every intermediate decode, with how long it took.
+  void decode_cadence_record_decode(DecodeCadence* cadence, double decode_ms);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_DECODE_CADENCE_H
@@ -0,0 +1,72 @@
+#include "acutest.h"
+
+#include "decode_cadence.c"
+
+void test_decode_cadence_every_feed() {
+  DecodeCadence* cadence = decode_cadence_alloc(16000, 0, false);
+  TEST_CHECK(!decode_cadence_should_decode(cadence));
+  decode_cadence_add_samples(cadence, 640);
+  TEST_CHECK(decode_cadence_should_decode(cadence));
+  decode_cadence_record_decode(cadence, 1000.0);
+  TEST_CHECK(!decode_cadence_should_decode(cadence));
+  TEST_INTEQ(0, cadence->interval_ms);
+  decode_cadence_free(cadence);
+}
+
+void test_decode_cadence_fixed_interval() {
+  DecodeCadence* cadence = decode_cadence_alloc(16000, 200, false);
+  // 200ms at 16KHz is 3,200 samples, so five 640-sample feeds.
+  for (int i = 0; i < 4; ++i) {
+    decode_cadence_add_samples(cadence, 640);
+    TEST_CHECK(!decode_cadence_should_decode(cadence));
+    TEST_MSG("After feed %d", i);
+  }
+  decode_cadence_add_samples(cadence, 640);
+  TEST_CHECK(decode_cadence_should_decode(cadence));
+  // Slow decodes shouldn't change a fixed interval.
+  decode_cadence_record_decode(cadence, 1000.0);
+  TEST_INTEQ(200, cadence->interval_ms);
+  TEST_CHECK(!decode_cadence_should_decode(cadence));
+  decode_cadence_free(cadence);
+}
+
+void test_decode_cadence_adaptive() {
+  DecodeCadence* cadence = decode_cadence_alloc(16000, 100, true);
+  TEST_INTEQ(100, cadence->interval_ms);
+
+  // A decode that takes most of the period should double the interval.
+  decode_cadence_record_decode(cadence, 80.0);
+  TEST_INTEQ(200, cadence->interval_ms);
+  decode_cadence_record_decode(cadence, 150.0);
+  TEST_INTEQ(400, cadence->interval_ms);
+
+  // In between, nothing should change.
+  decode_cadence_record_decode(cadence, 100.0);
+  TEST_INTEQ(400, cadence->interval_ms);
+
+  // Quick decodes bring it back down, but not below the requested interval.
+  decode_cadence_record_decode(cadence, 10.0);
+  TEST_INTEQ(200, cadence->interval_ms);
+  decode_cadence_record_decode(cadence, 10.0);
+  TEST_INTEQ(100, cadence->interval_ms);
+  decode_cadence_record_decode(cadence, 1.0);
+  TEST_INTEQ(100, cadence->interval_ms);
+
+  // Really slow decodes are capped.
+  for (int i = 0; i < 10; ++i) {
+    decode_cadence_record_decode(cadence, 100000.0);
+  }
+  TEST_INTEQ(DECODE_CADENCE_MAX_INTERVAL_MS, cadence->interval_ms);
+  decode_cadence_free(cadence);
+
+  cadence = decode_cadence_alloc(16000, 0, true);
+  TEST_INTEQ(DECODE_CADENCE_MIN_ADAPTIVE_MS, cadence->interval_ms);
+  decode_cadence_free(cadence);
+}
+
+TEST_LIST = {
+  {"decode_cadence_every_feed", test_decode_cadence_every_feed},
+  {"decode_cadence_fixed_interval", test_decode_cadence_fixed_interval},
+  {"decode_cadence_adaptive", test_decode_cadence_adaptive},
+  {NULL, NULL},
+};
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "file_utils.h"
 #include "string_utils.h"
@@ -69,11 +70,52 @@ static void set_defaults(Settings* settings) {
   settings->extended_metadata = false;
   settings->json_output = false;
   settings->json_candidate_transcripts = 3;
+  settings->format = "text";
+  settings->cue_max_ms = 7000;
+  settings->cue_max_chars = 42;
   settings->stream_size = 0;
-  settings->extended_stream_size = 0;
+  settings->extended_stream_size = 30000;
   settings->hot_words = NULL;
   settings->stream_capture_file = NULL;
   settings->stream_capture_duration = 16000;
+  settings->jobs = 1;
+  settings->shared_model = false;
+  settings->stream_files = false;
+  settings->file_buffer_size = 16000;
+  settings->channel = -1;
+  settings->split_channels = false;
+  settings->split_seconds = 0;
+  settings->raw_sample_rate = 16000;
+  settings->raw_channels = 1;
+  settings->ring_buffer_ms = 2000;
+  settings->show_pipeline_stats = false;
+  settings->decode_interval_ms = 0;
+  settings->adaptive_decode = false;
+  settings->vad = false;
+  settings->vad_preroll_ms = 300;
+  settings->vad_hangover_ms = 500;
+  settings->endpoint_silence_ms = 1000;
+  settings->stream_overlap_ms = 2000;
+  settings->serve = false;
+  settings->connect = false;
+  settings->socket_path = NULL;
+  settings->stream_workers = 0;
+  settings->http_port = 0;
+  settings->http_address = "127.0.0.1";
+  settings->model_cache_mb = 0;
+}
+
+// Sockets in a shared directory like /tmp could be replaced by another user,
+// so the default is in the user's own runtime directory, or failing that, a
+// directory in /tmp named after the user, which the daemon creates so that
+// only they can use it.
+static char* default_socket_path() {
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if ((runtime_dir != NULL) && (runtime_dir[0] == '/')) {
+    return file_join_paths(runtime_dir, "spchcat.sock");
+  }
+  return string_alloc_sprintf("/tmp/spchcat-%d/spchcat.sock",
+    (int)(geteuid()));
 }
 
 static void find_model_for_language(Settings* settings) {
@@ -116,7 +158,7 @@ static void find_model_for_language(Settings* settings) {
     file_find_one_with_prefix(settings->languages_dir, lang_only);
   free(lang_only);
   if (lang_only_folder == NULL) {
-    fprintf(stderr, "Unable to find a language model for '%s' in '%s'",
+    fprintf(stderr, "Unable to find a language model for '%s' in '%s'\n",
       settings->language, settings->languages_dir);
     return;
   }
@@ -182,8 +224,129 @@ static void find_scorer_for_language(Settings* settings) {
   free(language_folder);
 }
 
+bool settings_find_language(const Settings* settings, const char* language,
+  char** model, char** scorer) {
+  *model = NULL;
+  *scorer = NULL;
+  // The name comes from clients, so make sure it can't point outside the
+  // languages folder.
+  if ((language[0] == 0) || (strspn(language,
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-") !=
+    strlen(language))) {
+    fprintf(stderr, "Language '%s' isn't a valid name.\n", language);
+    return false;
+  }
+  Settings language_settings = *settings;
+  language_settings.language = string_duplicate(language);
+  language_settings.language_from_args = NULL;
+  language_settings.model = NULL;
+  language_settings.scorer = NULL;
+  find_model_for_language(&language_settings);
+  if (language_settings.model == NULL) {
+    free(language_settings.language);
+    return false;
+  }
+  find_scorer_for_language(&language_settings);
+  free(language_settings.language);
+  *model = language_settings.model;
+  *scorer = language_settings.scorer;
+  return true;
+}
+
+// Checks that the values given on the command line are in range, and that
+// the options asked for can be used together.
+static bool validate_settings(const Settings* settings) {
+  if ((settings->raw_sample_rate <= 0) || (settings->raw_channels <= 0)) {
+    fprintf(stderr, "Raw sample rate and channels must be positive.\n");
+    return false;
+  }
+  if ((settings->jobs <= 0) || (settings->file_buffer_size <= 0) ||
+    (settings->source_buffer_size <= 0) || (settings->ring_buffer_ms <= 0)) {
+    fprintf(stderr, "Jobs, file and source buffer sizes, and ring buffer "
+      "size must be positive.\n");
+    return false;
+  }
+  if ((settings->split_seconds < 0) || (settings->decode_interval_ms < 0) ||
+    (settings->vad_preroll_ms < 0) || (settings->vad_hangover_ms < 0)) {
+    fprintf(stderr, "Split seconds, decode interval, and VAD preroll and "
+      "hangover times can't be negative.\n");
+    return false;
+  }
+  if ((settings->split_seconds > 0) &&
+    (settings->stream_files || settings->split_channels)) {
+    fprintf(stderr, "Split seconds can't be used with streamed or split "
+      "channel files.\n");
+    return false;
+  }
+  if (settings->json_candidate_transcripts < 1) {
+    fprintf(stderr, "At least one JSON candidate transcript is needed.\n");
+    return false;
+  }
+  if (settings->json_output && settings->split_channels) {
+    fprintf(stderr, "JSON output can't be used with split channel files.\n");
+    return false;
+  }
+  if ((strcmp(settings->format, "text") != 0) &&
+    (strcmp(settings->format, "srt") != 0) &&
+    (strcmp(settings->format, "vtt") != 0)) {
+    fprintf(stderr, "Format '%s' isn't one of 'text', 'srt', or 'vtt'.\n",
+      settings->format);
+    return false;
+  }
+  if ((strcmp(settings->format, "text") != 0) &&
+    (settings->json_output || settings->split_channels)) {
+    fprintf(stderr, "Subtitle formats can't be used with JSON output or "
+      "split channel files.\n");
+    return false;
+  }
+  if (settings->show_times &&
+    ((strcmp(settings->format, "text") != 0) || settings->split_channels)) {
+    fprintf(stderr, "Word times can't be shown for subtitles or split "
+      "channel files.\n");
+    return false;
+  }
+  if (settings->serve && settings->connect) {
+    fprintf(stderr, "Serve and connect can't be used together.\n");
+    return false;
+  }
+  if (settings->stream_workers < 0) {
+    fprintf(stderr, "Stream workers can't be negative.\n");
+    return false;
+  }
+  if ((settings->http_port < 0) || (settings->http_port > 65535)) {
+    fprintf(stderr, "HTTP port %d isn't between 1 and 65535.\n",
+      settings->http_port);
+    return false;
+  }
+  if ((settings->http_port != 0) && !settings->serve) {
+    fprintf(stderr, "An HTTP port can only be used with --serve.\n");
+    return false;
+  }
+  if (settings->model_cache_mb < 0) {
+    fprintf(stderr, "Model cache size can't be negative.\n");
+    return false;
+  }
+  if ((settings->cue_max_ms < 0) || (settings->cue_max_chars < 0)) {
+    fprintf(stderr, "Subtitle cue limits can't be negative.\n");
+    return false;
+  }
+  return true;
+}
+
 static bool set_source(Settings* settings) {
-  const int files_length = yargs_get_unnamed_length();
+  int files_length = yargs_get_unnamed_length();
+  // Like other Unix tools, a file name of '-' means read from stdin.
+  if ((files_length == 1) && (strcmp(yargs_get_unnamed(0), "-") == 0)) {
+    if ((settings->source != NULL) &&
+      (strcmp(settings->source, "stdin") != 0)) {
+      fprintf(stderr,
+        "Source '%s' was specified, but '-' was passed to read from stdin.\n",
+        settings->source);
+      return false;
+    }
+    settings->source = "stdin";
+    files_length = 0;
+  }
   if (settings->source != NULL) {
     if ((files_length != 0) &&
       (strcmp(settings->source, "file") != 0)) {
@@ -243,15 +406,77 @@ Settings* settings_init_from_argv(int argc, char** argv) {
     YARGS_INT32("beam_width", "b", &settings->beam_width, ""),
     YARGS_FLOAT("lm_alpha", "a", &settings->lm_alpha, ""),
     YARGS_FLOAT("lm_beta", "e", &settings->lm_beta, ""),
-    YARGS_BOOL("show_times", "t", &settings->show_times, ""),
+    YARGS_BOOL("show_times", "t", &settings->show_times,
+      "Write each word with its start and end time in seconds"),
     YARGS_BOOL("has_versions", "q", &settings->has_versions, ""),
     YARGS_BOOL("extended_metadata", "x", &settings->extended_metadata, ""),
-    YARGS_BOOL("json_output", "j", &settings->json_output, ""),
-    YARGS_INT32("json_candidate_transcripts", "n", &settings->json_candidate_transcripts, ""),
-    YARGS_INT32("stream_size", "z", &settings->stream_size, ""),
-    YARGS_INT32("extended_stream_size", "r", &settings->extended_stream_size, ""),
+    YARGS_BOOL("json_output", "j", &settings->json_output,
+      "Write results as JSON Lines, with token times and confidences"),
+    YARGS_INT32("json_candidate_transcripts", "n",
+      &settings->json_candidate_transcripts,
+      "Number of alternative transcripts to include in JSON results"),
+    YARGS_STRING("format", NULL, &settings->format,
+      "Output as plain 'text', or 'srt' or 'vtt' subtitles"),
+    YARGS_INT32("cue_max_ms", NULL, &settings->cue_max_ms,
+      "Longest time a subtitle cue can cover, 0 for no limit"),
+    YARGS_INT32("cue_max_chars", NULL, &settings->cue_max_chars,
+      "Most characters in a subtitle cue, 0 for no limit"),
+    YARGS_INT32("stream_size", "z", &settings->stream_size,
+      "Milliseconds of live speech after which any short pause ends it"),
+    YARGS_INT32("extended_stream_size", "r", &settings->extended_stream_size,
+      "Milliseconds of live speech before switching to a new stream"),
     YARGS_STRING("stream_capture_file", "f", &settings->stream_capture_file, ""),
     YARGS_INT32("stream_capture_duration", "g", &settings->stream_capture_duration, ""),
+    YARGS_INT32("jobs", NULL, &settings->jobs,
+      "Number of files to transcribe in parallel"),
+    YARGS_BOOL("shared_model", NULL, &settings->shared_model,
+      "Use one model for all --jobs workers instead of one each"),
+    YARGS_BOOL("stream_files", NULL, &settings->stream_files,
+      "Read files in blocks and write lines as soon as they're final"),
+    YARGS_INT32("file_buffer_size", NULL, &settings->file_buffer_size,
+      "Number of samples to read at once in --stream_files mode"),
+    YARGS_INT32("channel", NULL, &settings->channel,
+      "Channel of multi-channel files to use, or -1 to mix them all"),
+    YARGS_BOOL("split_channels", NULL, &settings->split_channels,
+      "Transcribe each channel separately, labelling lines by channel"),
+    YARGS_INT32("split_seconds", NULL, &settings->split_seconds,
+      "Cut files into pieces this long at pauses, and decode them in parallel"),
+    YARGS_INT32("raw_sample_rate", NULL, &settings->raw_sample_rate,
+      "Sample rate of 16-bit audio piped to stdin without a WAV header"),
+    YARGS_INT32("raw_channels", NULL, &settings->raw_channels,
+      "Channels of 16-bit audio piped to stdin without a WAV header"),
+    YARGS_INT32("ring_buffer_ms", NULL, &settings->ring_buffer_ms,
+      "Milliseconds of live audio to queue while the decoder is busy"),
+    YARGS_BOOL("show_pipeline_stats", NULL, &settings->show_pipeline_stats,
+      "Report capture queue occupancy and overruns on stderr"),
+    YARGS_INT32("decode_interval_ms", NULL, &settings->decode_interval_ms,
+      "Milliseconds of audio between partial results, 0 for every read"),
+    YARGS_BOOL("adaptive_decode", NULL, &settings->adaptive_decode,
+      "Show partial results less often when decoding can't keep up"),
+    YARGS_BOOL("vad", NULL, &settings->vad,
+      "Only pass live audio to the decoder while someone is speaking"),
+    YARGS_INT32("vad_preroll_ms", NULL, &settings->vad_preroll_ms,
+      "Milliseconds of audio to keep from before speech starts"),
+    YARGS_INT32("vad_hangover_ms", NULL, &settings->vad_hangover_ms,
+      "Milliseconds of quiet to wait before speech is over"),
+    YARGS_INT32("endpoint_silence_ms", NULL, &settings->endpoint_silence_ms,
+      "Milliseconds of silence that end a live utterance, 0 to disable"),
+    YARGS_INT32("stream_overlap_ms", NULL, &settings->stream_overlap_ms,
+      "Milliseconds both streams hear when switching without a pause"),
+    YARGS_BOOL("serve", NULL, &settings->serve,
+      "Keep the model loaded and run jobs sent with --connect"),
+    YARGS_BOOL("connect", NULL, &settings->connect,
+      "Run on a --serve daemon if there is one, or in this process if not"),
+    YARGS_STRING("socket_path", NULL, (const char**)(&settings->socket_path),
+      "UNIX domain socket the daemon listens on"),
+    YARGS_INT32("stream_workers", NULL, &settings->stream_workers,
+      "Threads a --serve daemon shares between stdin streams, 0 to fork each"),
+    YARGS_INT32("http_port", NULL, &settings->http_port,
+      "Port a --serve daemon takes POST /transcribe requests on, 0 for none"),
+    YARGS_STRING("http_address", NULL, &settings->http_address,
+      "IPv4 address the daemon's HTTP port listens on"),
+    YARGS_INT32("model_cache_mb", NULL, &settings->model_cache_mb,
+      "Megabytes of other languages' models the daemon keeps loaded"),
   };
   const int flags_length = sizeof(flags) / sizeof(flags[0]);
 
@@ -276,6 +501,14 @@ Settings* settings_init_from_argv(int argc, char** argv) {
     return NULL;
   }
 
+  if (!validate_settings(settings)) {
+    yargs_free();
+    free(language_flag.description);
+    free(settings->language);
+    free(settings);
+    return NULL;
+  }
+
   find_model_for_language(settings);
   if (settings->model == NULL) {
     yargs_free();
@@ -298,6 +531,13 @@ Settings* settings_init_from_argv(int argc, char** argv) {
 
   free(language_description_string);
 
+  if (settings->socket_path != NULL) {
+    settings->socket_path = string_duplicate(settings->socket_path);
+  }
+  else {
+    settings->socket_path = default_socket_path();
+  }
+
   return settings;
 }
 
@@ -309,6 +549,7 @@ void settings_free(Settings* settings) {
   free(settings->language);
   free(settings->model);
   free(settings->scorer);
+  free(settings->socket_path);
   string_list_free(settings->files, settings->files_count);
   free(settings);
 }
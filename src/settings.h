@@ -26,11 +26,39 @@ extern "C" {
     bool extended_metadata;
     bool json_output;
     int json_candidate_transcripts;
+    const char* format;
+    int cue_max_ms;
+    int cue_max_chars;
     int stream_size;
     int extended_stream_size;
     const char* hot_words;
     const char* stream_capture_file;
     int stream_capture_duration;
+    int jobs;
+    bool shared_model;
+    bool stream_files;
+    int file_buffer_size;
+    int channel;
+    bool split_channels;
+    int split_seconds;
+    int raw_sample_rate;
+    int raw_channels;
+    int ring_buffer_ms;
+    bool show_pipeline_stats;
+    int decode_interval_ms;
+    bool adaptive_decode;
+    bool vad;
+    int vad_preroll_ms;
+    int vad_hangover_ms;
+    int endpoint_silence_ms;
+    int stream_overlap_ms;
+    bool serve;
+    bool connect;
+    char* socket_path;
+    int stream_workers;
+    int http_port;
+    const char* http_address;
+    int model_cache_mb;
     char** files;
     int files_count;
   } Settings;
@@ -38,6 +66,12 @@ extern "C" {
   Settings* settings_init_from_argv(int argc, char** argv);
   void settings_free(Settings* settings);
 
+  // Finds the model and scorer for another language, the same way the
+  // command line's language is resolved. The results should be freed by the
+  // caller, and the scorer may be NULL if there isn't one.
+  bool settings_find_language(const Settings* settings, const char* language,
+    char** model, char** scorer);
+
 #ifdef __CPLUSPLUS
 }
 #endif  // __CPLUSPLUS
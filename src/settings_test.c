@@ -126,6 +126,42 @@ void test_find_model_for_language() {
   rmdir(languages_dir);
 }
 
+void test_settings_find_language() {
+  const char* languages_dir = "/tmp/test_lang_dir4";
+  const char* languages[] = {
+    "en_US", "de_DE",
+  };
+  const int languages_length = sizeof(languages) / sizeof(languages[0]);
+  create_mock_languages_dir(languages_dir, languages, languages_length);
+  char* de_de_dir = file_join_paths(languages_dir, "de_DE");
+  char* de_de_model = file_join_paths(de_de_dir, "model.tflite");
+  char* de_de_scorer = file_join_paths(de_de_dir, "large.scorer");
+  free(de_de_dir);
+  file_write(de_de_model, "a\0", 2);
+  file_write(de_de_scorer, "a\0", 2);
+
+  Settings settings = {};
+  settings.languages_dir = languages_dir;
+  settings.language = "en_US";
+  settings.model = "/foo/bar/baz.tflite";
+  char* model;
+  char* scorer;
+  TEST_CHECK(settings_find_language(&settings, "de_AT", &model, &scorer));
+  TEST_STREQ(de_de_model, model);
+  TEST_STREQ(de_de_scorer, scorer);
+  free(model);
+  free(scorer);
+  TEST_STREQ("en_US", settings.language);
+
+  TEST_CHECK(!settings_find_language(&settings, "fr_FR", &model, &scorer));
+  TEST_CHECK(model == NULL);
+  TEST_CHECK(!settings_find_language(&settings, "../de_DE", &model, &scorer));
+
+  free(de_de_model);
+  free(de_de_scorer);
+  rmdir(languages_dir);
+}
+
 void test_find_scorer_for_language() {
   const char* languages_dir = "/tmp/test_lang_dir3";
   const char* languages[] = {
@@ -201,6 +237,59 @@ void test_set_source() {
   Settings* settings6 = settings_init_from_argv(argc6, argv6);
   TEST_CHECK(settings6 == NULL);
   settings_free(settings6);
+
+  char* argv7[] = { "program", "-" };
+  const int argc7 = sizeof(argv7) / sizeof(argv7[0]);
+  Settings* settings7 = settings_init_from_argv(argc7, argv7);
+  TEST_CHECK(settings7 != NULL);
+  TEST_STREQ("stdin", settings7->source);
+  TEST_INTEQ(0, settings7->files_count);
+  settings_free(settings7);
+
+  char* argv8[] = { "program", "--source=mic", "-" };
+  const int argc8 = sizeof(argv8) / sizeof(argv8[0]);
+  Settings* settings8 = settings_init_from_argv(argc8, argv8);
+  TEST_CHECK(settings8 == NULL);
+  settings_free(settings8);
+}
+
+void test_validate_settings() {
+  char* argv1[] = { "program", "--json_output=true", "--split_channels=true",
+    "foo.wav" };
+  const int argc1 = sizeof(argv1) / sizeof(argv1[0]);
+  Settings* settings1 = settings_init_from_argv(argc1, argv1);
+  TEST_CHECK(settings1 == NULL);
+  settings_free(settings1);
+
+  char* argv2[] = { "program", "--format=ass", "foo.wav" };
+  const int argc2 = sizeof(argv2) / sizeof(argv2[0]);
+  Settings* settings2 = settings_init_from_argv(argc2, argv2);
+  TEST_CHECK(settings2 == NULL);
+  settings_free(settings2);
+
+  char* argv3[] = { "program", "--file_buffer_size=0", "foo.wav" };
+  const int argc3 = sizeof(argv3) / sizeof(argv3[0]);
+  Settings* settings3 = settings_init_from_argv(argc3, argv3);
+  TEST_CHECK(settings3 == NULL);
+  settings_free(settings3);
+
+  char* argv4[] = { "program", "--jobs=0", "foo.wav" };
+  const int argc4 = sizeof(argv4) / sizeof(argv4[0]);
+  Settings* settings4 = settings_init_from_argv(argc4, argv4);
+  TEST_CHECK(settings4 == NULL);
+  settings_free(settings4);
+
+  char* argv5[] = { "program", "--vad_hangover_ms=-1" };
+  const int argc5 = sizeof(argv5) / sizeof(argv5[0]);
+  Settings* settings5 = settings_init_from_argv(argc5, argv5);
+  TEST_CHECK(settings5 == NULL);
+  settings_free(settings5);
+
+  char* argv6[] = { "program", "--source_buffer_size=0", "-" };
+  const int argc6 = sizeof(argv6) / sizeof(argv6[0]);
+  Settings* settings6 = settings_init_from_argv(argc6, argv6);
+  TEST_CHECK(settings6 == NULL);
+  settings_free(settings6);
 }
 
 void test_settings_init_from_argv() {
@@ -297,7 +386,9 @@ TEST_LIST = {
   {"test_language_description", test_language_description},
   {"test_set_defaults", test_set_defaults},
   {"test_find_model_for_language", test_find_model_for_language},
+  {"test_settings_find_language", test_settings_find_language},
   {"test_set_source", test_set_source},
+  {"test_validate_settings", test_validate_settings},
   {"test_settings_init_from_argv", test_settings_init_from_argv},
   {NULL, NULL},
 };
\ No newline at end of file
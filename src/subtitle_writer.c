@@ -0,0 +1,177 @@
+#include "subtitle_writer.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+SubtitleWriter* subtitle_writer_alloc(FILE* file, SubtitleFormat format,
+  float max_duration, int max_chars) {
+  SubtitleWriter* result = calloc(1, sizeof(SubtitleWriter));
+  result->file = file;
+  result->text = string_builder_alloc();
+  result->format = format;
+  result->max_duration = max_duration;
+  result->max_chars = max_chars;
+  result->processed_until = -INFINITY;
+  result->last_token_time = -INFINITY;
+  result->word = string_builder_alloc();
+  result->cue = string_builder_alloc();
+  if (format == SUBTITLE_FORMAT_VTT) {
+    string_builder_append(result->text, "WEBVTT\n\n");
+  }
+  if ((file != NULL) && (result->text->length > 0)) {
+    fputs(result->text->data, file);
+    string_builder_reset(result->text);
+  }
+  return result;
+}
+
+void subtitle_writer_free(SubtitleWriter* writer) {
+  if (writer == NULL) {
+    return;
+  }
+  string_builder_free(writer->text);
+  string_builder_free(writer->word);
+  string_builder_free(writer->cue);
+  free(writer);
+}
+
+// Writes a time as "hh:mm:ss,mmm" for SubRip, or "hh:mm:ss.mmm" for WebVTT.
+static void append_time(SubtitleWriter* writer, float seconds) {
+  const int64_t total_ms = (int64_t)(roundf(fmaxf(seconds, 0.0f) * 1000.0f));
+  const char separator = (writer->format == SUBTITLE_FORMAT_SRT) ? ',' : '.';
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d%c%03d",
+    (int)(total_ms / 3600000), (int)((total_ms / 60000) % 60),
+    (int)((total_ms / 1000) % 60), separator, (int)(total_ms % 1000));
+  string_builder_append(writer->text, buffer);
+}
+
+// Writes out the current cue. It stays on screen until the next one starts,
+// or for a short while after its last word if there's a long pause first.
+static void close_cue(SubtitleWriter* writer, float next_start) {
+  if (writer->cue->length == 0) {
+    return;
+  }
+  float end = writer->cue_end + SUBTITLE_CUE_TAIL;
+  if ((next_start > writer->cue_end) && (next_start < end)) {
+    end = next_start;
+  }
+
+  writer->cues_written += 1;
+  if (writer->format == SUBTITLE_FORMAT_SRT) {
+    char index[16];
+    snprintf(index, sizeof(index), "%d\n", writer->cues_written);
+    string_builder_append(writer->text, index);
+  }
+  append_time(writer, writer->cue_start);
+  string_builder_append(writer->text, " --> ");
+  append_time(writer, end);
+  string_builder_append_char(writer->text, '\n');
+  string_builder_append_span(writer->text, writer->cue->data,
+    writer->cue->length);
+  string_builder_append(writer->text, "\n\n");
+  string_builder_reset(writer->cue);
+
+  if (writer->file != NULL) {
+    fputs(writer->text->data, writer->file);
+    fflush(writer->file);
+    string_builder_reset(writer->text);
+  }
+}
+
+// Moves the finished word into the current cue, first closing the cue if
+// the word would take it over one of the limits.
+static void finish_word(SubtitleWriter* writer) {
+  if (writer->word->length == 0) {
+    return;
+  }
+  if (writer->cue->length > 0) {
+    const bool too_long = (writer->max_chars > 0) &&
+      ((writer->cue->length + 1 + writer->word->length) > writer->max_chars);
+    const bool too_slow = (writer->max_duration > 0.0f) &&
+      ((writer->word_end - writer->cue_start) > writer->max_duration);
+    if (too_long || too_slow) {
+      close_cue(writer, writer->word_start);
+    }
+  }
+  if (writer->cue->length == 0) {
+    writer->cue_start = writer->word_start;
+  } else {
+    string_builder_append_char(writer->cue, ' ');
+  }
+  string_builder_append_span(writer->cue, writer->word->data,
+    writer->word->length);
+  writer->cue_end = writer->word_end;
+  string_builder_reset(writer->word);
+}
+
+static void add_token(SubtitleWriter* writer, const char* text,
+  float session_time) {
+  if ((session_time - writer->last_token_time) > TRANSCRIPT_LINE_GAP) {
+    finish_word(writer);
+    close_cue(writer, session_time);
+  }
+  writer->last_token_time = session_time;
+  if (strcmp(text, " ") == 0) {
+    finish_word(writer);
+    return;
+  }
+  if (writer->word->length == 0) {
+    writer->word_start = session_time;
+  }
+  string_builder_append(writer->word, text);
+  writer->word_end = session_time;
+}
+
+static bool is_token_visible(const TokenMetadata* token,
+  const TranscriptTiming* timing) {
+  return (timing == NULL) || (token->start_time >= timing->hidden_before);
+}
+
+void subtitle_writer_update(SubtitleWriter* writer,
+  const CandidateTranscript* transcript, const TranscriptTiming* timing,
+  bool is_final) {
+  // Everything before the last long pause is settled, and a pause always
+  // ends a cue, so the cues before it can be written straight away.
+  float settled_before = INFINITY;
+  if (!is_final) {
+    settled_before = -INFINITY;
+    float previous_time = writer->last_token_time;
+    for (unsigned int i = 0; i < transcript->num_tokens; ++i) {
+      const TokenMetadata* token = &transcript->tokens[i];
+      if (!is_token_visible(token, timing)) {
+        continue;
+      }
+      const float session_time =
+        transcript_session_time(token->start_time, timing);
+      if ((session_time - previous_time) > TRANSCRIPT_LINE_GAP) {
+        settled_before = session_time;
+      }
+      previous_time = session_time;
+    }
+  }
+
+  for (unsigned int i = 0; i < transcript->num_tokens; ++i) {
+    const TokenMetadata* token = &transcript->tokens[i];
+    if (!is_token_visible(token, timing)) {
+      continue;
+    }
+    const float session_time =
+      transcript_session_time(token->start_time, timing);
+    if (session_time >= settled_before) {
+      break;
+    }
+    if (session_time <= writer->processed_until) {
+      continue;
+    }
+    add_token(writer, token->text, session_time);
+    writer->processed_until = session_time;
+  }
+
+  if (settled_before > writer->processed_until) {
+    finish_word(writer);
+    close_cue(writer, settled_before);
+  }
+}
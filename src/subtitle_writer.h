@@ -0,0 +1,70 @@
+#ifndef INCLUDE_SUBTITLE_WRITER_H
+#define INCLUDE_SUBTITLE_WRITER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "coqui-stt.h"
+
+#include "string_utils.h"
+#include "transcript_renderer.h"
+
+// How long a cue stays on screen after its last word starts, unless the next
+// cue begins before then.
+#define SUBTITLE_CUE_TAIL (1.0f)
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  typedef enum {
+    SUBTITLE_FORMAT_SRT,
+    SUBTITLE_FORMAT_VTT,
+  } SubtitleFormat;
+
+  // Turns the words in a transcript into SubRip or WebVTT cues, writing each
+  // one out as soon as it can't change any more. Words are gathered into a
+  // cue until there's a pause long enough to start a new line of text, or
+  // the cue would go over its length or duration limit.
+  typedef struct SubtitleWriterStruct {
+    // If this is NULL, cues are kept in `text` until the caller takes them.
+    // Otherwise each one is written to the file as soon as it's finished.
+    FILE* file;
+    StringBuilder* text;
+    SubtitleFormat format;
+    float max_duration;
+    int max_chars;
+    int cues_written;
+    // Session time of the last token that's been used, so that each update
+    // only looks at tokens that haven't been seen before.
+    float processed_until;
+    float last_token_time;
+    // The word being put together from the tokens.
+    StringBuilder* word;
+    float word_start;
+    float word_end;
+    // The cue being put together from the words.
+    StringBuilder* cue;
+    float cue_start;
+    float cue_end;
+  } SubtitleWriter;
+
+  // `max_duration` is in seconds. Either limit can be zero to disable it.
+  SubtitleWriter* subtitle_writer_alloc(FILE* file, SubtitleFormat format,
+    float max_duration, int max_chars);
+  void subtitle_writer_free(SubtitleWriter* writer);
+
+  // Takes the latest transcript for the current stream. Tokens before its
+  // last long pause won't change any more, so their cues can be written.
+  // If `is_final` is set the stream is over, and all of its cues are
+  // written, so this must be called with it before the writer is freed.
+  // `timing` works in the same way as for the renderer, and may be NULL.
+  void subtitle_writer_update(SubtitleWriter* writer,
+    const CandidateTranscript* transcript, const TranscriptTiming* timing,
+    bool is_final);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_SUBTITLE_WRITER_H
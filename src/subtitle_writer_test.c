@@ -0,0 +1,135 @@
+#include "acutest.h"
+
+#include "subtitle_writer.c"
+
+void test_subtitle_writer_srt() {
+  // "the cat" then a long pause before "sat".
+  TokenMetadata tokens[] = {
+    {"t", 25, 0.5f},
+    {"h", 30, 0.6f},
+    {"e", 35, 0.7f},
+    {" ", 40, 0.8f},
+    {"c", 45, 0.9f},
+    {"a", 50, 1.0f},
+    {"t", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"s", 200, 4.0f},
+    {"a", 205, 4.1f},
+    {"t", 210, 4.2f},
+  };
+  CandidateTranscript transcript = {
+    tokens, sizeof(tokens) / sizeof(tokens[0]), -1.0,
+  };
+  SubtitleWriter* writer =
+    subtitle_writer_alloc(NULL, SUBTITLE_FORMAT_SRT, 7.0f, 42);
+  subtitle_writer_update(writer, &transcript, NULL, true);
+  TEST_STREQ("1\n00:00:00,500 --> 00:00:02,100\nthe cat\n\n"
+    "2\n00:00:04,000 --> 00:00:05,200\nsat\n\n", writer->text->data);
+  subtitle_writer_free(writer);
+}
+
+void test_subtitle_writer_limits() {
+  TokenMetadata tokens[] = {
+    {"a", 0, 0.0f},
+    {"b", 5, 0.1f},
+    {" ", 10, 0.2f},
+    {"c", 15, 0.3f},
+    {"d", 20, 0.4f},
+    {" ", 25, 0.5f},
+    {"e", 30, 0.6f},
+    {" ", 35, 0.7f},
+    {"f", 40, 0.8f},
+    {" ", 45, 0.9f},
+    {"g", 50, 1.6f},
+  };
+  CandidateTranscript transcript = {
+    tokens, sizeof(tokens) / sizeof(tokens[0]), -1.0,
+  };
+  // At most five characters, so "ab cd" fills the first cue.
+  SubtitleWriter* writer =
+    subtitle_writer_alloc(NULL, SUBTITLE_FORMAT_VTT, 0.0f, 5);
+  subtitle_writer_update(writer, &transcript, NULL, true);
+  TEST_STREQ("WEBVTT\n\n"
+    "00:00:00.000 --> 00:00:00.600\nab cd\n\n"
+    "00:00:00.600 --> 00:00:02.600\ne f g\n\n", writer->text->data);
+  subtitle_writer_free(writer);
+
+  // At most a second, so "g" has to go in a cue of its own.
+  writer = subtitle_writer_alloc(NULL, SUBTITLE_FORMAT_VTT, 1.0f, 0);
+  subtitle_writer_update(writer, &transcript, NULL, true);
+  TEST_STREQ("WEBVTT\n\n"
+    "00:00:00.000 --> 00:00:01.600\nab cd e f\n\n"
+    "00:00:01.600 --> 00:00:02.600\ng\n\n", writer->text->data);
+  subtitle_writer_free(writer);
+}
+
+void test_subtitle_writer_streaming() {
+  TokenMetadata tokens[] = {
+    {"h", 5, 0.1f},
+    {"i", 10, 0.2f},
+    {" ", 15, 0.3f},
+    {"y", 150, 3.0f},
+    {"o", 155, 3.1f},
+    {"u", 160, 3.2f},
+  };
+  const int tokens_length = sizeof(tokens) / sizeof(tokens[0]);
+  FILE* file = tmpfile();
+  SubtitleWriter* writer =
+    subtitle_writer_alloc(file, SUBTITLE_FORMAT_SRT, 7.0f, 42);
+
+  // Nothing is settled until a pause follows the words.
+  CandidateTranscript partial = { tokens, 2, -1.0 };
+  subtitle_writer_update(writer, &partial, NULL, false);
+  TEST_INTEQ(0, (int)(ftell(file)));
+
+  // Once the next word starts after a pause, the first cue is written.
+  CandidateTranscript paused = { tokens, 4, -1.0 };
+  subtitle_writer_update(writer, &paused, NULL, false);
+  const long first_length = ftell(file);
+  TEST_CHECK(first_length > 0);
+
+  // The same transcript again doesn't write anything new.
+  subtitle_writer_update(writer, &paused, NULL, false);
+  TEST_INTEQ((int)(first_length), (int)(ftell(file)));
+
+  CandidateTranscript final = { tokens, tokens_length, -1.0 };
+  subtitle_writer_update(writer, &final, NULL, true);
+  subtitle_writer_free(writer);
+
+  char contents[256] = {};
+  rewind(file);
+  const size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+  contents[length] = 0;
+  TEST_STREQ("1\n00:00:00,100 --> 00:00:01,200\nhi\n\n"
+    "2\n00:00:03,000 --> 00:00:04,200\nyou\n\n", contents);
+  fclose(file);
+}
+
+void test_subtitle_writer_timing() {
+  // A second live stream that took over from the first one, which already
+  // handled "ok".
+  TokenMetadata tokens[] = {
+    {"o", 10, 0.2f},
+    {"k", 15, 0.3f},
+    {" ", 20, 0.4f},
+    {"g", 25, 0.5f},
+    {"o", 30, 0.6f},
+  };
+  CandidateTranscript transcript = {
+    tokens, sizeof(tokens) / sizeof(tokens[0]), -1.0,
+  };
+  TranscriptTiming timing = { 3600.0f, 0.35f, NULL };
+  SubtitleWriter* writer =
+    subtitle_writer_alloc(NULL, SUBTITLE_FORMAT_SRT, 7.0f, 42);
+  subtitle_writer_update(writer, &transcript, &timing, true);
+  TEST_STREQ("1\n01:00:00,500 --> 01:00:01,600\ngo\n\n", writer->text->data);
+  subtitle_writer_free(writer);
+}
+
+TEST_LIST = {
+  {"subtitle_writer_srt", test_subtitle_writer_srt},
+  {"subtitle_writer_limits", test_subtitle_writer_limits},
+  {"subtitle_writer_streaming", test_subtitle_writer_streaming},
+  {"subtitle_writer_timing", test_subtitle_writer_timing},
+  {NULL, NULL},
+};
@@ -0,0 +1,110 @@
+#include "transcript_json.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "word_timing.h"
+
+// Token times come from 20ms timesteps, so more digits would be noise.
+#define TRANSCRIPT_JSON_TIME_DECIMALS (2)
+#define TRANSCRIPT_JSON_CONFIDENCE_DECIMALS (4)
+
+static bool is_token_hidden(const TokenMetadata* token,
+  const TranscriptTiming* timing) {
+  return (timing != NULL) && (token->start_time < timing->hidden_before);
+}
+
+// Writes the visible tokens joined together as one string, without copying
+// them anywhere first. A space is only written once there's a word after
+// it, so there are none at the start or end.
+static void write_text(JsonWriter* writer,
+  const CandidateTranscript* transcript, const TranscriptTiming* timing) {
+  json_writer_string_begin(writer);
+  bool has_words = false;
+  bool has_pending_space = false;
+  for (unsigned int i = 0; i < transcript->num_tokens; ++i) {
+    const TokenMetadata* token = &transcript->tokens[i];
+    if (is_token_hidden(token, timing)) {
+      continue;
+    }
+    if (strcmp(token->text, " ") == 0) {
+      has_pending_space = has_words;
+      continue;
+    }
+    if (has_pending_space) {
+      json_writer_string_append(writer, " ");
+      has_pending_space = false;
+    }
+    json_writer_string_append(writer, token->text);
+    has_words = true;
+  }
+  json_writer_string_end(writer);
+}
+
+static void write_tokens(JsonWriter* writer,
+  const CandidateTranscript* transcript, const TranscriptTiming* timing) {
+  json_writer_begin_array(writer);
+  for (unsigned int i = 0; i < transcript->num_tokens; ++i) {
+    const TokenMetadata* token = &transcript->tokens[i];
+    if (is_token_hidden(token, timing)) {
+      continue;
+    }
+    json_writer_begin_object(writer);
+    json_writer_key(writer, "text");
+    json_writer_string(writer, token->text);
+    json_writer_key(writer, "start_time");
+    json_writer_double(writer,
+      transcript_session_time(token->start_time, timing),
+      TRANSCRIPT_JSON_TIME_DECIMALS);
+    json_writer_end_object(writer);
+  }
+  json_writer_end_array(writer);
+}
+
+static void write_words(JsonWriter* writer,
+  const CandidateTranscript* transcript, const TranscriptTiming* timing) {
+  json_writer_begin_array(writer);
+  unsigned int index = 0;
+  WordTiming word;
+  while (word_timing_next(transcript, timing, &index, &word)) {
+    json_writer_begin_object(writer);
+    json_writer_key(writer, "text");
+    json_writer_string_begin(writer);
+    const unsigned int end = word.first_token + word.tokens_length;
+    for (unsigned int i = word.first_token; i < end; ++i) {
+      json_writer_string_append(writer, transcript->tokens[i].text);
+    }
+    json_writer_string_end(writer);
+    json_writer_key(writer, "start_time");
+    json_writer_double(writer, word.start_time,
+      TRANSCRIPT_JSON_TIME_DECIMALS);
+    json_writer_key(writer, "end_time");
+    json_writer_double(writer, word.end_time, TRANSCRIPT_JSON_TIME_DECIMALS);
+    json_writer_end_object(writer);
+  }
+  json_writer_end_array(writer);
+}
+
+void transcript_json_write_candidates(JsonWriter* writer,
+  const CandidateTranscript* transcripts, int transcripts_count,
+  const TranscriptTiming* timing, bool include_words) {
+  json_writer_key(writer, "transcripts");
+  json_writer_begin_array(writer);
+  for (int i = 0; i < transcripts_count; ++i) {
+    const CandidateTranscript* transcript = &transcripts[i];
+    json_writer_begin_object(writer);
+    json_writer_key(writer, "confidence");
+    json_writer_double(writer, transcript->confidence,
+      TRANSCRIPT_JSON_CONFIDENCE_DECIMALS);
+    json_writer_key(writer, "text");
+    write_text(writer, transcript, timing);
+    if (include_words) {
+      json_writer_key(writer, "words");
+      write_words(writer, transcript, timing);
+    }
+    json_writer_key(writer, "tokens");
+    write_tokens(writer, transcript, timing);
+    json_writer_end_object(writer);
+  }
+  json_writer_end_array(writer);
+}
@@ -0,0 +1,37 @@
+#ifndef INCLUDE_TRANSCRIPT_JSON_H
+#define INCLUDE_TRANSCRIPT_JSON_H
+
+#include <stdbool.h>
+
+#include "coqui-stt.h"
+
+#include "json_writer.h"
+#include "transcript_renderer.h"
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // Writes a "transcripts" key into the current object, holding an array with
+  // one entry for each of the `transcripts_count` candidates, best first:
+  //
+  // "transcripts":[{"confidence":-12.3456,"text":"hi there",
+  //   "tokens":[{"text":"h","start_time":1.00},...]},...]
+  //
+  // The text is put together from the tokens as they're written, with spaces
+  // at either end dropped. `timing` places the tokens on a live session's
+  // timeline, and skips those already shown from an earlier stream, in the
+  // same way as the renderer, or can be NULL to leave times as they are.
+  // If `include_words` is set, each candidate also has a "words" array
+  // between its text and tokens, with the start and end time of each word:
+  //
+  //   "words":[{"text":"hi","start_time":1.00,"end_time":1.20},...]
+  void transcript_json_write_candidates(JsonWriter* writer,
+    const CandidateTranscript* transcripts, int transcripts_count,
+    const TranscriptTiming* timing, bool include_words);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_TRANSCRIPT_JSON_H
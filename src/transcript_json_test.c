@@ -0,0 +1,126 @@
+#include "acutest.h"
+
+#include "transcript_json.c"
+
+#include "time_utils.h"
+
+void test_transcript_json_candidates() {
+  TokenMetadata best_tokens[] = {
+    {" ", 45, 0.9f},
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"\"", 65, 1.3f},
+    {" ", 70, 1.4f},
+  };
+  TokenMetadata other_tokens[] = {
+    {"h", 50, 1.0f},
+    {"a", 55, 1.1f},
+  };
+  CandidateTranscript transcripts[] = {
+    { best_tokens, sizeof(best_tokens) / sizeof(best_tokens[0]), -1.5 },
+    { other_tokens, sizeof(other_tokens) / sizeof(other_tokens[0]), -3.25 },
+  };
+
+  JsonWriter* writer = json_writer_alloc(NULL);
+  json_writer_begin_object(writer);
+  transcript_json_write_candidates(writer, transcripts, 2, NULL, false);
+  json_writer_end_object(writer);
+  TEST_STREQ("{\"transcripts\":["
+    "{\"confidence\":-1.5000,\"text\":\"hi \\\"\",\"tokens\":["
+    "{\"text\":\" \",\"start_time\":0.90},"
+    "{\"text\":\"h\",\"start_time\":1.00},"
+    "{\"text\":\"i\",\"start_time\":1.10},"
+    "{\"text\":\" \",\"start_time\":1.20},"
+    "{\"text\":\"\\\"\",\"start_time\":1.30},"
+    "{\"text\":\" \",\"start_time\":1.40}]},"
+    "{\"confidence\":-3.2500,\"text\":\"ha\",\"tokens\":["
+    "{\"text\":\"h\",\"start_time\":1.00},"
+    "{\"text\":\"a\",\"start_time\":1.10}]}]}",
+    writer->buffer->data);
+  json_writer_free(writer);
+}
+
+void test_transcript_json_timing() {
+  TokenMetadata tokens[] = {
+    {"o", 10, 0.2f},
+    {"k", 15, 0.3f},
+    {" ", 20, 0.4f},
+    {"g", 25, 0.5f},
+    {"o", 30, 0.6f},
+  };
+  CandidateTranscript transcript = {
+    tokens, sizeof(tokens) / sizeof(tokens[0]), -2.0,
+  };
+  // The first word was already shown from the previous stream, which this
+  // one took over from ten seconds into the session.
+  TranscriptTiming timing = { 10.0f, 0.35f, NULL };
+
+  JsonWriter* writer = json_writer_alloc(NULL);
+  json_writer_begin_object(writer);
+  transcript_json_write_candidates(writer, &transcript, 1, &timing, true);
+  json_writer_end_object(writer);
+  TEST_STREQ("{\"transcripts\":["
+    "{\"confidence\":-2.0000,\"text\":\"go\","
+    "\"words\":[{\"text\":\"go\",\"start_time\":10.50,\"end_time\":10.60}],"
+    "\"tokens\":["
+    "{\"text\":\" \",\"start_time\":10.40},"
+    "{\"text\":\"g\",\"start_time\":10.50},"
+    "{\"text\":\"o\",\"start_time\":10.60}]}]}",
+    writer->buffer->data);
+  json_writer_free(writer);
+}
+
+// Serializes the N-best results for about three hours of speech, to check
+// that output stays cheap next to decoding. Not a pass/fail test, but the
+// numbers are printed to help spot regressions.
+void test_transcript_json_benchmark() {
+  const char* letters[] = { "t", "h", "e", " ", "c", "a", "t", " " };
+  const int letters_length = sizeof(letters) / sizeof(letters[0]);
+  const int tokens_length = 200000;
+  const int candidates_length = 3;
+  TokenMetadata* tokens = malloc(tokens_length * sizeof(TokenMetadata));
+  for (int i = 0; i < tokens_length; ++i) {
+    const TokenMetadata token = { letters[i % letters_length], i * 3,
+      i * 0.06f };
+    memcpy(&tokens[i], &token, sizeof(TokenMetadata));
+  }
+  CandidateTranscript* transcripts =
+    malloc(candidates_length * sizeof(CandidateTranscript));
+  for (int i = 0; i < candidates_length; ++i) {
+    const CandidateTranscript transcript = { tokens, tokens_length,
+      -100.0 * (i + 1) };
+    memcpy(&transcripts[i], &transcript, sizeof(CandidateTranscript));
+  }
+
+  FILE* file = tmpfile();
+  const double start_ms = time_now_ms();
+  JsonWriter* writer = json_writer_alloc(file);
+  json_writer_begin_object(writer);
+  json_writer_key(writer, "file");
+  json_writer_string(writer, "lecture.wav");
+  transcript_json_write_candidates(writer, transcripts, candidates_length,
+    NULL, true);
+  json_writer_end_object(writer);
+  json_writer_end_line(writer);
+  json_writer_free(writer);
+  const double elapsed_ms = time_now_ms() - start_ms;
+
+  const long length = ftell(file);
+  TEST_CHECK(length > (tokens_length * candidates_length * 30));
+  printf("\n%d tokens x %d candidates: %.2fms, %.1f MB/s, "
+    "%.1f million tokens/s\n", tokens_length, candidates_length, elapsed_ms,
+    (length / 1000.0) / (elapsed_ms + 0.0001),
+    ((tokens_length * candidates_length) / 1000.0) / (elapsed_ms + 0.0001));
+
+  fclose(file);
+  free(transcripts);
+  free(tokens);
+}
+
+TEST_LIST = {
+  {"transcript_json_candidates", test_transcript_json_candidates},
+  {"transcript_json_timing", test_transcript_json_timing},
+  {"transcript_json_benchmark", test_transcript_json_benchmark},
+  {NULL, NULL},
+};
@@ -0,0 +1,253 @@
+#include "transcript_renderer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+float transcript_session_time(float token_time,
+  const TranscriptTiming* timing) {
+  if (timing == NULL) {
+    return token_time;
+  }
+  float result = timing->stream_start + token_time;
+  if (timing->vad != NULL) {
+    result = voice_activity_stream_time(timing->vad, result);
+  }
+  return result;
+}
+
+// Makes sure `*data` has room for at least `needed` elements, growing it
+// geometrically so repeated appends stay cheap.
+static void ensure_capacity(void** data, int32_t* capacity, int32_t needed,
+  size_t element_size) {
+  if (needed <= *capacity) {
+    return;
+  }
+  int32_t new_capacity = (*capacity == 0) ? 64 : *capacity;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  *data = realloc(*data, new_capacity * element_size);
+  *capacity = new_capacity;
+}
+
+TranscriptRenderer* transcript_renderer_alloc() {
+  TranscriptRenderer* result = calloc(1, sizeof(TranscriptRenderer));
+  result->text = string_builder_alloc();
+  transcript_renderer_reset(result);
+  return result;
+}
+
+void transcript_renderer_free(TranscriptRenderer* renderer) {
+  if (renderer == NULL) {
+    return;
+  }
+  free(renderer->tokens);
+  free(renderer->token_text);
+  string_builder_free(renderer->text);
+  free(renderer->line_offsets);
+  free(renderer->scratch);
+  free(renderer);
+}
+
+void transcript_renderer_reset(TranscriptRenderer* renderer) {
+  renderer->tokens_length = 0;
+  renderer->token_text_length = 0;
+  string_builder_reset(renderer->text);
+  ensure_capacity((void**)(&renderer->line_offsets),
+    &renderer->lines_capacity, 1, sizeof(int32_t));
+  renderer->line_offsets[0] = 0;
+  renderer->lines_length = 1;
+  renderer->lines_printed = 0;
+}
+
+static void append_text(TranscriptRenderer* renderer, const char* text) {
+  const int32_t length = strlen(text);
+  for (int i = 0; i < length; ++i) {
+    if (text[i] == '\n') {
+      ensure_capacity((void**)(&renderer->line_offsets),
+        &renderer->lines_capacity, renderer->lines_length + 1,
+        sizeof(int32_t));
+      renderer->line_offsets[renderer->lines_length] =
+        renderer->text->length + i + 1;
+      renderer->lines_length += 1;
+    }
+  }
+  string_builder_append_span(renderer->text, text, length);
+}
+
+static void add_token(TranscriptRenderer* renderer, const TokenMetadata* token,
+  float session_time, float previous_time) {
+  ensure_capacity((void**)(&renderer->tokens), &renderer->tokens_capacity,
+    renderer->tokens_length + 1, sizeof(RenderedToken));
+  RenderedToken* rendered = &renderer->tokens[renderer->tokens_length];
+  renderer->tokens_length += 1;
+
+  const int32_t token_length = strlen(token->text);
+  ensure_capacity((void**)(&renderer->token_text),
+    &renderer->token_text_capacity,
+    renderer->token_text_length + token_length + 1, sizeof(char));
+  memcpy(renderer->token_text + renderer->token_text_length, token->text,
+    token_length + 1);
+
+  rendered->start_time = token->start_time;
+  rendered->session_time = session_time;
+  rendered->token_text_offset = renderer->token_text_length;
+  rendered->text_offset = renderer->text->length;
+  rendered->replaced_space = false;
+  renderer->token_text_length += token_length + 1;
+
+  const bool is_space = (strcmp(token->text, " ") == 0);
+  if ((session_time - previous_time) > TRANSCRIPT_LINE_GAP) {
+    if ((renderer->text->length > 0) &&
+      (renderer->text->data[renderer->text->length - 1] == ' ')) {
+      renderer->text->data[renderer->text->length - 1] = '\n';
+      ensure_capacity((void**)(&renderer->line_offsets),
+        &renderer->lines_capacity, renderer->lines_length + 1,
+        sizeof(int32_t));
+      renderer->line_offsets[renderer->lines_length] = renderer->text->length;
+      renderer->lines_length += 1;
+      rendered->replaced_space = true;
+    }
+    else {
+      append_text(renderer, "\n");
+    }
+    if (!is_space) {
+      append_text(renderer, token->text);
+    }
+  }
+  else {
+    append_text(renderer, token->text);
+  }
+}
+
+// Throws away the tokens from `index` onwards, along with their text.
+static void truncate_tokens(TranscriptRenderer* renderer, int index) {
+  if (index >= renderer->tokens_length) {
+    return;
+  }
+  const RenderedToken* first_removed = &renderer->tokens[index];
+  string_builder_truncate(renderer->text, first_removed->text_offset);
+  if (first_removed->replaced_space) {
+    renderer->text->data[renderer->text->length - 1] = ' ';
+  }
+  renderer->token_text_length = first_removed->token_text_offset;
+  renderer->tokens_length = index;
+
+  while ((renderer->lines_length > 1) &&
+    (renderer->line_offsets[renderer->lines_length - 1] >
+      renderer->text->length)) {
+    renderer->lines_length -= 1;
+  }
+  const int32_t last_line_start =
+    renderer->line_offsets[renderer->lines_length - 1];
+  if ((renderer->lines_length > 1) &&
+    (renderer->text->data[last_line_start - 1] != '\n')) {
+    renderer->lines_length -= 1;
+  }
+}
+
+static void write_line(const TranscriptRenderer* renderer, int index,
+  FILE* file) {
+  const int32_t start = renderer->line_offsets[index];
+  int32_t end = renderer->text->length;
+  if ((index + 1) < renderer->lines_length) {
+    end = renderer->line_offsets[index + 1] - 1;
+  }
+  fputc('\r', file);
+  fwrite(renderer->text->data + start, 1, end - start, file);
+}
+
+bool transcript_renderer_update(TranscriptRenderer* renderer,
+  const CandidateTranscript* transcript, const TranscriptTiming* timing,
+  FILE* file) {
+  const float hidden_before = (timing == NULL) ? 0.0f : timing->hidden_before;
+
+  // Find the first token that's different from last time.
+  int first_change = 0;
+  int token_index = 0;
+  while (token_index < transcript->num_tokens) {
+    const TokenMetadata* token = &transcript->tokens[token_index];
+    if (token->start_time < hidden_before) {
+      token_index += 1;
+      continue;
+    }
+    if (first_change >= renderer->tokens_length) {
+      break;
+    }
+    const RenderedToken* rendered = &renderer->tokens[first_change];
+    if ((token->start_time != rendered->start_time) ||
+      (strcmp(token->text,
+        renderer->token_text + rendered->token_text_offset) != 0)) {
+      break;
+    }
+    first_change += 1;
+    token_index += 1;
+  }
+  if ((token_index == transcript->num_tokens) &&
+    (first_change == renderer->tokens_length)) {
+    return false;
+  }
+
+  // Remember the text that's about to be replaced.
+  int32_t change_offset = renderer->text->length;
+  if (first_change < renderer->tokens_length) {
+    const RenderedToken* first_removed = &renderer->tokens[first_change];
+    change_offset = first_removed->text_offset;
+    if (first_removed->replaced_space) {
+      change_offset -= 1;
+    }
+  }
+  const int32_t old_tail_length = renderer->text->length - change_offset;
+  ensure_capacity((void**)(&renderer->scratch), &renderer->scratch_capacity,
+    old_tail_length + 1, sizeof(char));
+  memcpy(renderer->scratch, renderer->text->data + change_offset, old_tail_length);
+
+  truncate_tokens(renderer, first_change);
+  float previous_time = transcript_session_time(hidden_before, timing);
+  if (renderer->tokens_length > 0) {
+    previous_time =
+      renderer->tokens[renderer->tokens_length - 1].session_time;
+  }
+  for (; token_index < transcript->num_tokens; ++token_index) {
+    const TokenMetadata* token = &transcript->tokens[token_index];
+    if (token->start_time < hidden_before) {
+      continue;
+    }
+    const float session_time =
+      transcript_session_time(token->start_time, timing);
+    add_token(renderer, token, session_time, previous_time);
+    previous_time = session_time;
+  }
+
+  const int32_t new_tail_length = renderer->text->length - change_offset;
+  if ((new_tail_length == old_tail_length) &&
+    (memcmp(renderer->scratch, renderer->text->data + change_offset,
+      old_tail_length) == 0)) {
+    return false;
+  }
+
+  if (file != NULL) {
+    const int last_line = renderer->lines_length - 1;
+    for (int i = renderer->lines_printed; i < last_line; ++i) {
+      write_line(renderer, i, file);
+      fputc('\n', file);
+    }
+    write_line(renderer, last_line, file);
+    fputs("        ", file);
+    fflush(file);
+    renderer->lines_printed = last_line;
+  }
+  return true;
+}
+
+bool transcript_renderer_last_word_time(const TranscriptRenderer* renderer,
+  float* time) {
+  for (int i = (renderer->tokens_length - 1); i >= 0; --i) {
+    const RenderedToken* rendered = &renderer->tokens[i];
+    if (strcmp(renderer->token_text + rendered->token_text_offset, " ") != 0) {
+      *time = rendered->session_time;
+      return true;
+    }
+  }
+  return false;
+}
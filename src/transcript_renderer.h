@@ -0,0 +1,100 @@
+#ifndef INCLUDE_TRANSCRIPT_RENDERER_H
+#define INCLUDE_TRANSCRIPT_RENDERER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "coqui-stt.h"
+
+#include "string_utils.h"
+#include "voice_activity.h"
+
+// Tokens that start more than this many seconds after the previous one begin
+// a new line.
+#define TRANSCRIPT_LINE_GAP (1.0f)
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // How to place the tokens from one live stream on the session's timeline.
+  // Live sessions start a new stream for each utterance, and may hand over
+  // from one stream to another partway through, so token times need
+  // adjusting.
+  typedef struct TranscriptTimingStruct {
+    // Seconds of audio that had been fed before the stream began.
+    float stream_start;
+    // Tokens that start before this time, relative to the stream, have
+    // already been shown from the previous stream, so they're skipped.
+    float hidden_before;
+    // Set if the stream was only fed the speech that this let through, so
+    // that times can be mapped back to the original input.
+    const VoiceActivity* vad;
+  } TranscriptTiming;
+
+  // Converts a token time into seconds since live input started. A NULL
+  // `timing` leaves the time unchanged.
+  float transcript_session_time(float token_time,
+    const TranscriptTiming* timing);
+
+  // What's remembered about each token from the last update, so the next one
+  // can tell where the transcript starts to differ.
+  typedef struct RenderedTokenStruct {
+    float start_time;
+    float session_time;
+    // Where the token's own text is stored in `token_text`.
+    int32_t token_text_offset;
+    // Where this token's output starts in `text`.
+    int32_t text_offset;
+    // True if this token turned a trailing space before it into a newline.
+    bool replaced_space;
+  } RenderedToken;
+
+  // Turns a stream of partial transcripts into text, one line per stretch of
+  // speech, and keeps a terminal display of it up to date. Each partial
+  // result from the decoder usually only differs from the previous one in
+  // the last few tokens, so rather than rebuilding all the text every time,
+  // only the tokens from the first difference onwards are rendered again.
+  typedef struct TranscriptRendererStruct {
+    RenderedToken* tokens;
+    int tokens_length;
+    int tokens_capacity;
+    char* token_text;
+    int32_t token_text_length;
+    int32_t token_text_capacity;
+    StringBuilder* text;
+    // Where each line starts in `text`.
+    int32_t* line_offsets;
+    int lines_length;
+    int lines_capacity;
+    // How many complete lines have been written out, so they aren't repeated.
+    int lines_printed;
+    // Holds what used to follow the first change, to check if it's different.
+    char* scratch;
+    int32_t scratch_capacity;
+  } TranscriptRenderer;
+
+  TranscriptRenderer* transcript_renderer_alloc();
+  void transcript_renderer_free(TranscriptRenderer* renderer);
+
+  // Forgets the current transcript, but keeps the memory allocated.
+  void transcript_renderer_reset(TranscriptRenderer* renderer);
+
+  // Brings the text up to date with `transcript`. If `file` isn't NULL, any
+  // newly-finished lines are written to it, followed by the current partial
+  // line, which is overwritten next time. Returns true if the text changed.
+  bool transcript_renderer_update(TranscriptRenderer* renderer,
+    const CandidateTranscript* transcript, const TranscriptTiming* timing,
+    FILE* file);
+
+  // Finds the session time of the last token that isn't a space. Returns
+  // false if there isn't one.
+  bool transcript_renderer_last_word_time(const TranscriptRenderer* renderer,
+    float* time);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_TRANSCRIPT_RENDERER_H
@@ -0,0 +1,142 @@
+#include "acutest.h"
+
+#include "transcript_renderer.c"
+
+static char* read_file_contents(FILE* file) {
+  fflush(file);
+  const long length = ftell(file);
+  char* result = calloc(length + 1, 1);
+  rewind(file);
+  TEST_ASSERT(fread(result, 1, length, file) == (size_t)(length));
+  rewind(file);
+  TEST_ASSERT(ftruncate(fileno(file), 0) == 0);
+  return result;
+}
+
+void test_transcript_renderer_text() {
+  TokenMetadata tokens[] = {
+    {"h", 50, 1.0f},
+    {"i", 55, 1.1f},
+    {" ", 60, 1.2f},
+    {"y", 500, 10.0f},
+    {"o", 505, 10.1f},
+    {" ", 510, 10.2f},
+    {"y", 515, 10.3f},
+    {"o", 520, 10.4f},
+  };
+  const int tokens_length = sizeof(tokens) / sizeof(tokens[0]);
+  CandidateTranscript transcript = { tokens, tokens_length, 1.0f };
+
+  TranscriptRenderer* renderer = transcript_renderer_alloc();
+  TEST_CHECK(transcript_renderer_update(renderer, &transcript, NULL, NULL));
+  TEST_STREQ("hi\nyo yo", renderer->text->data);
+  TEST_INTEQ(2, renderer->lines_length);
+  TEST_INTEQ(3, renderer->line_offsets[1]);
+
+  // Nothing's changed, so nothing should happen.
+  TEST_CHECK(!transcript_renderer_update(renderer, &transcript, NULL, NULL));
+
+  // Dropping the tokens after the gap should turn the newline back into a
+  // space.
+  CandidateTranscript shorter = { tokens, 3, 1.0f };
+  TEST_CHECK(transcript_renderer_update(renderer, &shorter, NULL, NULL));
+  TEST_STREQ("hi ", renderer->text->data);
+  TEST_INTEQ(1, renderer->lines_length);
+  TEST_INTEQ(3, renderer->tokens_length);
+
+  float last_word_time = 0.0f;
+  TEST_CHECK(transcript_renderer_last_word_time(renderer, &last_word_time));
+  TEST_CHECK(last_word_time == 1.1f);
+
+  transcript_renderer_reset(renderer);
+  TEST_STREQ("", renderer->text->data);
+  TEST_CHECK(!transcript_renderer_last_word_time(renderer, &last_word_time));
+  transcript_renderer_free(renderer);
+}
+
+void test_transcript_renderer_revision() {
+  TokenMetadata first_tokens[] = {
+    {"c", 10, 0.1f},
+    {"a", 12, 0.2f},
+    {"t", 14, 0.3f},
+  };
+  TokenMetadata second_tokens[] = {
+    {"c", 10, 0.1f},
+    {"a", 12, 0.2f},
+    {"r", 14, 0.3f},
+    {"t", 16, 0.4f},
+  };
+  CandidateTranscript first = { first_tokens, 3, 1.0f };
+  CandidateTranscript second = { second_tokens, 4, 1.0f };
+
+  TranscriptRenderer* renderer = transcript_renderer_alloc();
+  transcript_renderer_update(renderer, &first, NULL, NULL);
+  TEST_STREQ("cat", renderer->text->data);
+  TEST_CHECK(transcript_renderer_update(renderer, &second, NULL, NULL));
+  TEST_STREQ("cart", renderer->text->data);
+  TEST_INTEQ(4, renderer->tokens_length);
+  TEST_INTEQ(2, renderer->tokens[2].text_offset);
+
+  // A token with the same text but a new time is different too, but if the
+  // text doesn't change nothing needs to be written.
+  TokenMetadata third_tokens[] = {
+    {"c", 10, 0.1f},
+    {"a", 12, 0.2f},
+    {"r", 14, 0.3f},
+    {"t", 16, 0.5f},
+  };
+  CandidateTranscript third = { third_tokens, 4, 1.0f };
+  TEST_CHECK(!transcript_renderer_update(renderer, &third, NULL, NULL));
+  TEST_CHECK(renderer->tokens[3].start_time == 0.5f);
+
+  // Skipped tokens shouldn't appear at all.
+  TranscriptTiming timing = { 0.0f, 0.25f, NULL };
+  transcript_renderer_reset(renderer);
+  transcript_renderer_update(renderer, &second, &timing, NULL);
+  TEST_STREQ("rt", renderer->text->data);
+  transcript_renderer_free(renderer);
+}
+
+void test_transcript_renderer_output() {
+  // These match the output of print_changed_lines() in app_main.c.
+  TokenMetadata tokens[] = {
+    {"H", 0, 0.0f},
+    {"i", 1, 0.1f},
+    {" ", 2, 0.2f},
+    {"Y", 3, 2.0f},
+    {"o", 4, 2.1f},
+    {" ", 5, 2.2f},
+    {"Z", 6, 4.0f},
+  };
+  FILE* file = tmpfile();
+  TEST_ASSERT(file != NULL);
+  TranscriptRenderer* renderer = transcript_renderer_alloc();
+
+  CandidateTranscript transcript1 = { tokens, 2, 1.0f };
+  transcript_renderer_update(renderer, &transcript1, NULL, file);
+  char* output = read_file_contents(file);
+  TEST_STREQ("\rHi        ", output);
+  free(output);
+
+  CandidateTranscript transcript2 = { tokens, 5, 1.0f };
+  transcript_renderer_update(renderer, &transcript2, NULL, file);
+  output = read_file_contents(file);
+  TEST_STREQ("\rHi\n\rYo        ", output);
+  free(output);
+
+  CandidateTranscript transcript3 = { tokens, 7, 1.0f };
+  transcript_renderer_update(renderer, &transcript3, NULL, file);
+  output = read_file_contents(file);
+  TEST_STREQ("\rYo\n\rZ        ", output);
+  free(output);
+
+  transcript_renderer_free(renderer);
+  fclose(file);
+}
+
+TEST_LIST = {
+  {"transcript_renderer_text", test_transcript_renderer_text},
+  {"transcript_renderer_revision", test_transcript_renderer_revision},
+  {"transcript_renderer_output", test_transcript_renderer_output},
+  {NULL, NULL},
+};
@@ -0,0 +1,52 @@
+#include "cpu_features.h"
+
+bool cpu_kernel_is_supported(CpuKernel kernel) {
+  switch (kernel) {
+  case CPU_KERNEL_SCALAR:
+    return true;
+#if defined(CPU_FEATURES_HAS_SSE2)
+  case CPU_KERNEL_SSE2:
+    return true;
+#endif
+#if defined(CPU_FEATURES_HAS_AVX2)
+  case CPU_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+#if defined(CPU_FEATURES_HAS_NEON)
+  case CPU_KERNEL_NEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+const char* cpu_kernel_name(CpuKernel kernel) {
+  switch (kernel) {
+  case CPU_KERNEL_SCALAR:
+    return "scalar";
+  case CPU_KERNEL_SSE2:
+    return "sse2";
+  case CPU_KERNEL_AVX2:
+    return "avx2";
+  case CPU_KERNEL_NEON:
+    return "neon";
+  default:
+    return "unknown";
+  }
+}
+
+CpuKernel cpu_best_kernel() {
+  const CpuKernel preferred[] = {
+    CPU_KERNEL_AVX2,
+    CPU_KERNEL_SSE2,
+    CPU_KERNEL_NEON,
+  };
+  const int preferred_length = sizeof(preferred) / sizeof(preferred[0]);
+  for (int i = 0; i < preferred_length; ++i) {
+    if (cpu_kernel_is_supported(preferred[i])) {
+      return preferred[i];
+    }
+  }
+  return CPU_KERNEL_SCALAR;
+}
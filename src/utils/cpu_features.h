@@ -0,0 +1,44 @@
+#ifndef INCLUDE_UTIL_CPU_FEATURES_H
+#define INCLUDE_UTIL_CPU_FEATURES_H
+
+#include <stdbool.h>
+
+// Which SIMD kernels can be compiled in for this target. AVX2 versions are
+// built with a function attribute whatever the compiler flags, so they also
+// need a runtime check before they're called.
+#if defined(__SSE2__)
+#define CPU_FEATURES_HAS_SSE2
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_HAS_AVX2
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CPU_FEATURES_HAS_NEON
+#endif
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // The instruction sets that the audio processing loops have versions for.
+  typedef enum CpuKernelEnum {
+    CPU_KERNEL_SCALAR = 0,
+    CPU_KERNEL_SSE2,
+    CPU_KERNEL_AVX2,
+    CPU_KERNEL_NEON,
+    CPU_KERNEL_COUNT,
+  } CpuKernel;
+
+  bool cpu_kernel_is_supported(CpuKernel kernel);
+  const char* cpu_kernel_name(CpuKernel kernel);
+
+  // The fastest supported kernel.
+  CpuKernel cpu_best_kernel();
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_CPU_FEATURES_H
@@ -0,0 +1,36 @@
+#include "acutest.h"
+
+#include "cpu_features.c"
+
+#include <string.h>
+
+void test_cpu_kernel_is_supported() {
+  TEST_CHECK(cpu_kernel_is_supported(CPU_KERNEL_SCALAR));
+  TEST_CHECK(!cpu_kernel_is_supported(CPU_KERNEL_COUNT));
+#if defined(__x86_64__)
+  TEST_CHECK(cpu_kernel_is_supported(CPU_KERNEL_SSE2));
+  TEST_CHECK(!cpu_kernel_is_supported(CPU_KERNEL_NEON));
+#endif
+}
+
+void test_cpu_kernel_name() {
+  TEST_STREQ("scalar", cpu_kernel_name(CPU_KERNEL_SCALAR));
+  TEST_STREQ("avx2", cpu_kernel_name(CPU_KERNEL_AVX2));
+  TEST_STREQ("unknown", cpu_kernel_name(CPU_KERNEL_COUNT));
+}
+
+void test_cpu_best_kernel() {
+  const CpuKernel best = cpu_best_kernel();
+  TEST_CHECK(cpu_kernel_is_supported(best));
+  TEST_MSG("%s", cpu_kernel_name(best));
+#if defined(__x86_64__)
+  TEST_CHECK(best != CPU_KERNEL_SCALAR);
+#endif
+}
+
+TEST_LIST = {
+  {"cpu_kernel_is_supported", test_cpu_kernel_is_supported},
+  {"cpu_kernel_name", test_cpu_kernel_name},
+  {"cpu_best_kernel", test_cpu_best_kernel},
+  {NULL, NULL},
+};
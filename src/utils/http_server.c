@@ -0,0 +1,336 @@
+#include "http_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "string_utils.h"
+
+// Request lines and headers from real clients are well under this.
+#define HTTP_SERVER_MAX_HEAD_SIZE (16 * 1024)
+// How long to wait for a client that isn't reading its response.
+#define HTTP_SERVER_WRITE_TIMEOUT_MS (10000)
+
+void http_request_free(HttpRequest* request) {
+  if (request == NULL) {
+    return;
+  }
+  free(request->method);
+  free(request->path);
+  free(request->query);
+  free(request->body_start);
+  free(request);
+}
+
+// Returns the start of the value for `name` in the request's query, or NULL
+// if it isn't there. The value ends at the next '&', or the end.
+static const char* find_query_value(const HttpRequest* request,
+  const char* name) {
+  if (request->query == NULL) {
+    return NULL;
+  }
+  const size_t name_length = strlen(name);
+  const char* current = request->query;
+  while (current != NULL) {
+    if ((strncmp(current, name, name_length) == 0) &&
+      (current[name_length] == '=')) {
+      return current + name_length + 1;
+    }
+    current = strchr(current, '&');
+    if (current != NULL) {
+      current += 1;
+    }
+  }
+  return NULL;
+}
+
+bool http_request_query_int(const HttpRequest* request, const char* name,
+  int32_t* value) {
+  const char* number = find_query_value(request, name);
+  if (number == NULL) {
+    return false;
+  }
+  char* end;
+  const long result = strtol(number, &end, 10);
+  if ((end == number) || ((*end != '&') && (*end != 0))) {
+    return false;
+  }
+  *value = result;
+  return true;
+}
+
+char* http_request_query_string(const HttpRequest* request,
+  const char* name) {
+  const char* value = find_query_value(request, name);
+  if (value == NULL) {
+    return NULL;
+  }
+  return string_alloc_sprintf("%.*s", (int)(strcspn(value, "&")), value);
+}
+
+int http_server_listen(const char* address, int port) {
+  struct sockaddr_in socket_address;
+  memset(&socket_address, 0, sizeof(socket_address));
+  socket_address.sin_family = AF_INET;
+  socket_address.sin_port = htons(port);
+  if (inet_pton(AF_INET, address, &socket_address.sin_addr) != 1) {
+    fprintf(stderr, "'%s' isn't a valid IPv4 address\n", address);
+    return -1;
+  }
+  const int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    fprintf(stderr, "Couldn't create a socket: %s\n", strerror(errno));
+    return -1;
+  }
+  // Lets the daemon be restarted straight away on the same port.
+  const int reuse = 1;
+  setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(socket_fd, (struct sockaddr*)(&socket_address),
+    sizeof(socket_address)) != 0) {
+    fprintf(stderr, "Couldn't bind to %s:%d: %s\n", address, port,
+      strerror(errno));
+    close(socket_fd);
+    return -1;
+  }
+  if (listen(socket_fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "Couldn't listen on %s:%d: %s\n", address, port,
+      strerror(errno));
+    close(socket_fd);
+    return -1;
+  }
+  return socket_fd;
+}
+
+// Splits off the next line of the head, which ends with CRLF, and moves
+// `current` past it.
+static char* next_line(char** current) {
+  char* result = *current;
+  char* end = strstr(result, "\r\n");
+  if (end == NULL) {
+    *current = result + strlen(result);
+    return result;
+  }
+  *end = 0;
+  *current = end + 2;
+  return result;
+}
+
+static bool parse_request_line(char* line, HttpRequest* request) {
+  char* target = strchr(line, ' ');
+  if (target == NULL) {
+    return false;
+  }
+  *target = 0;
+  target += 1;
+  char* version = strchr(target, ' ');
+  if (version == NULL) {
+    return false;
+  }
+  *version = 0;
+  version += 1;
+  if (!string_starts_with(version, "HTTP/1.") || (*line == 0) ||
+    (*target != '/')) {
+    return false;
+  }
+  char* query = strchr(target, '?');
+  if (query != NULL) {
+    *query = 0;
+    request->query = string_duplicate(query + 1);
+  }
+  request->method = string_duplicate(line);
+  request->path = string_duplicate(target);
+  return true;
+}
+
+static bool parse_header(char* line, HttpRequest* request) {
+  char* value = strchr(line, ':');
+  if (value == NULL) {
+    return false;
+  }
+  *value = 0;
+  value += 1;
+  while ((*value == ' ') || (*value == '\t')) {
+    value += 1;
+  }
+  if (strcasecmp(line, "Content-Length") == 0) {
+    char* end;
+    const long long length = strtoll(value, &end, 10);
+    if ((end == value) || (*end != 0) || (length < 0)) {
+      return false;
+    }
+    request->content_length = length;
+  }
+  else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+    request->is_chunked = (strcasecmp(value, "identity") != 0);
+  }
+  return true;
+}
+
+HttpHeadReader* http_head_reader_alloc() {
+  HttpHeadReader* result = calloc(1, sizeof(HttpHeadReader));
+  result->buffer = malloc(HTTP_SERVER_MAX_HEAD_SIZE + 1);
+  result->length = 0;
+  return result;
+}
+
+void http_head_reader_free(HttpHeadReader* reader) {
+  if (reader == NULL) {
+    return;
+  }
+  free(reader->buffer);
+  free(reader);
+}
+
+HttpHeadStatus http_head_reader_read(HttpHeadReader* reader, int socket_fd,
+  HttpRequest** request, int* error_status) {
+  char* buffer = reader->buffer;
+  char* head_end = NULL;
+  while (head_end == NULL) {
+    if (reader->length == HTTP_SERVER_MAX_HEAD_SIZE) {
+      fprintf(stderr, "HTTP request headers were too long\n");
+      *error_status = 431;
+      return HTTP_HEAD_INVALID;
+    }
+    const ssize_t read_count = read(socket_fd, buffer + reader->length,
+      HTTP_SERVER_MAX_HEAD_SIZE - reader->length);
+    if ((read_count < 0) && (errno == EINTR)) {
+      continue;
+    }
+    if ((read_count < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      return HTTP_HEAD_INCOMPLETE;
+    }
+    if (read_count <= 0) {
+      *error_status = 408;
+      return HTTP_HEAD_INVALID;
+    }
+    // The end of the head may straddle two reads.
+    const size_t search_start =
+      (reader->length > 3) ? (reader->length - 3) : 0;
+    reader->length += read_count;
+    buffer[reader->length] = 0;
+    head_end = strstr(buffer + search_start, "\r\n\r\n");
+  }
+
+  HttpRequest* result = calloc(1, sizeof(HttpRequest));
+  result->content_length = -1;
+  char* body = head_end + 4;
+  result->body_start_length = reader->length - (body - buffer);
+  if (result->body_start_length > 0) {
+    result->body_start = malloc(result->body_start_length);
+    memcpy(result->body_start, body, result->body_start_length);
+  }
+  // Only the head itself is parsed from here on.
+  head_end[2] = 0;
+
+  char* current = buffer;
+  bool status = parse_request_line(next_line(&current), result);
+  while (status && (*current != 0)) {
+    status = parse_header(next_line(&current), result);
+  }
+  if (!status) {
+    fprintf(stderr, "Bad HTTP request received\n");
+    http_request_free(result);
+    *error_status = 400;
+    return HTTP_HEAD_INVALID;
+  }
+  *request = result;
+  return HTTP_HEAD_COMPLETE;
+}
+
+// Sends everything, waiting for room on a non-blocking connection, but not
+// forever. Closed connections show up as errors rather than SIGPIPE.
+static bool send_all(int socket_fd, const char* data, size_t length) {
+  while (length > 0) {
+    const ssize_t sent = send(socket_fd, data, length, MSG_NOSIGNAL);
+    if (sent >= 0) {
+      data += sent;
+      length -= sent;
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+      return false;
+    }
+    struct pollfd poll_fd = { socket_fd, POLLOUT, 0 };
+    if (poll(&poll_fd, 1, HTTP_SERVER_WRITE_TIMEOUT_MS) <= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static const char* status_text(int status) {
+  switch (status) {
+  case 200: return "OK";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 408: return "Request Timeout";
+  case 411: return "Length Required";
+  case 431: return "Request Header Fields Too Large";
+  case 503: return "Service Unavailable";
+  default: return "Internal Server Error";
+  }
+}
+
+bool http_server_send_response(int socket_fd, int status,
+  const char* content_type, const char* body, size_t length) {
+  char* head = string_alloc_sprintf("HTTP/1.1 %d %s\r\n"
+    "Content-Type: %s\r\n"
+    "Content-Length: %zu\r\n"
+    "Connection: close\r\n"
+    "\r\n", status, status_text(status), content_type, length);
+  const bool result = send_all(socket_fd, head, strlen(head)) &&
+    send_all(socket_fd, body, length);
+  free(head);
+  return result;
+}
+
+bool http_server_send_error(int socket_fd, int status, const char* message) {
+  char* body = string_append(message, "\n");
+  const bool result = http_server_send_response(socket_fd, status,
+    "text/plain", body, strlen(body));
+  free(body);
+  return result;
+}
+
+bool http_server_begin_chunked(int socket_fd, const char* content_type) {
+  char* response = string_alloc_sprintf("HTTP/1.1 200 OK\r\n"
+    "Content-Type: %s\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: close\r\n"
+    "\r\n", content_type);
+  const bool result = send_all(socket_fd, response, strlen(response));
+  free(response);
+  return result;
+}
+
+bool http_server_send_chunk(int socket_fd, const char* data, size_t length) {
+  // An empty chunk would end the body.
+  if (length == 0) {
+    return true;
+  }
+  char chunk_size[32];
+  snprintf(chunk_size, sizeof(chunk_size), "%zx\r\n", length);
+  StringBuilder* chunk = string_builder_alloc();
+  string_builder_append(chunk, chunk_size);
+  string_builder_append_span(chunk, data, length);
+  string_builder_append(chunk, "\r\n");
+  const bool result = send_all(socket_fd, chunk->data, chunk->length);
+  string_builder_free(chunk);
+  return result;
+}
+
+bool http_server_end_chunked(int socket_fd) {
+  const char* end = "0\r\n\r\n";
+  return send_all(socket_fd, end, strlen(end));
+}
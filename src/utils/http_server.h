@@ -0,0 +1,86 @@
+#ifndef INCLUDE_UTIL_HTTP_SERVER_H
+#define INCLUDE_UTIL_HTTP_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // Just enough of HTTP/1.1 to take audio uploads and stream results back.
+  // Every connection carries a single request, and is closed once the
+  // response has been sent.
+  typedef struct HttpRequestStruct {
+    char* method;
+    char* path;
+    // Everything after the '?' in the request target, or NULL if there's
+    // no query.
+    char* query;
+    // -1 if there was no Content-Length header.
+    int64_t content_length;
+    bool is_chunked;
+    // The start of the body, if it arrived along with the headers.
+    char* body_start;
+    size_t body_start_length;
+  } HttpRequest;
+
+  void http_request_free(HttpRequest* request);
+
+  // Looks for `name=<integer>` in the request's query. Returns false if it
+  // isn't there or isn't a number.
+  bool http_request_query_int(const HttpRequest* request, const char* name,
+    int32_t* value);
+  // Returns a copy of the value of `name` in the request's query, or NULL if
+  // it isn't there. Percent-encoded characters aren't decoded.
+  char* http_request_query_string(const HttpRequest* request,
+    const char* name);
+
+  // Starts listening for TCP connections on `address`, which must be a
+  // numeric IPv4 address. Returns the socket, or -1 on failure.
+  int http_server_listen(const char* address, int port);
+
+  // Gathers a request's line and headers from a new connection, over as
+  // many reads as it takes for them to arrive, so a slow client doesn't hold
+  // up a thread that's looking after others too.
+  typedef struct HttpHeadReaderStruct {
+    char* buffer;
+    size_t length;
+  } HttpHeadReader;
+
+  typedef enum HttpHeadStatusEnum {
+    HTTP_HEAD_INCOMPLETE,
+    HTTP_HEAD_COMPLETE,
+    HTTP_HEAD_INVALID,
+  } HttpHeadStatus;
+
+  HttpHeadReader* http_head_reader_alloc();
+  void http_head_reader_free(HttpHeadReader* reader);
+
+  // Reads whatever has arrived on a non-blocking connection. Once the whole
+  // head is there, it's parsed into `request`, and the body is left for the
+  // caller to read. If it's invalid, or the client hung up, the caller
+  // should reply with the `error_status` HTTP status.
+  HttpHeadStatus http_head_reader_read(HttpHeadReader* reader, int socket_fd,
+    HttpRequest** request, int* error_status);
+
+  // Sends a complete response whose whole body is already known.
+  bool http_server_send_response(int socket_fd, int status,
+    const char* content_type, const char* body, size_t length);
+
+  // Sends a complete response with a short plain text explanation.
+  bool http_server_send_error(int socket_fd, int status, const char* message);
+
+  // Sends a successful response's headers, for a body that's sent in parts
+  // as it's produced, then each part, and finally the end of the body.
+  // Writes wait for the connection even if it's non-blocking.
+  bool http_server_begin_chunked(int socket_fd, const char* content_type);
+  bool http_server_send_chunk(int socket_fd, const char* data, size_t length);
+  bool http_server_end_chunked(int socket_fd);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_HTTP_SERVER_H
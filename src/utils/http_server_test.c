@@ -0,0 +1,201 @@
+#include "acutest.h"
+
+#include "http_server.c"
+
+#include <fcntl.h>
+
+// Sends `text` from one end of a new connection, and returns the other.
+static int connection_with(const char* text, int* client_fd) {
+  int sockets[2];
+  TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+  TEST_ASSERT(write(sockets[0], text, strlen(text)) ==
+    (ssize_t)(strlen(text)));
+  *client_fd = sockets[0];
+  return sockets[1];
+}
+
+// Reads the head of a request that's already arrived in full.
+static HttpHeadStatus read_head(int server_fd, HttpRequest** request,
+  int* error_status) {
+  fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+  HttpHeadReader* reader = http_head_reader_alloc();
+  const HttpHeadStatus status =
+    http_head_reader_read(reader, server_fd, request, error_status);
+  http_head_reader_free(reader);
+  return status;
+}
+
+// Reads everything the server sent, once it's closed its end.
+static char* response_from(int client_fd, int server_fd) {
+  close(server_fd);
+  StringBuilder* response = string_builder_alloc();
+  char buffer[256];
+  ssize_t read_count;
+  while ((read_count = read(client_fd, buffer, sizeof(buffer))) > 0) {
+    string_builder_append_span(response, buffer, read_count);
+  }
+  close(client_fd);
+  char* result = string_builder_duplicate(response);
+  string_builder_free(response);
+  return result;
+}
+
+void test_http_head_reader_read() {
+  int client_fd;
+  const int server_fd = connection_with(
+    "POST /transcribe?sample_rate=8000&channels=2 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "content-length:  6\r\n"
+    "\r\n"
+    "RIFF", &client_fd);
+  HttpRequest* request = NULL;
+  int error_status = 0;
+  TEST_CHECK(read_head(server_fd, &request, &error_status) ==
+    HTTP_HEAD_COMPLETE);
+  TEST_STREQ("POST", request->method);
+  TEST_STREQ("/transcribe", request->path);
+  TEST_STREQ("sample_rate=8000&channels=2", request->query);
+  TEST_INTEQ(6, (int)(request->content_length));
+  TEST_CHECK(!request->is_chunked);
+  // The start of the body arrived with the headers.
+  TEST_INTEQ(4, (int)(request->body_start_length));
+  TEST_CHECK(memcmp("RIFF", request->body_start, 4) == 0);
+
+  int32_t value = 0;
+  TEST_CHECK(http_request_query_int(request, "sample_rate", &value));
+  TEST_INTEQ(8000, value);
+  TEST_CHECK(http_request_query_int(request, "channels", &value));
+  TEST_INTEQ(2, value);
+  TEST_CHECK(!http_request_query_int(request, "rate", &value));
+  char* channels = http_request_query_string(request, "channels");
+  TEST_STREQ("2", channels);
+  free(channels);
+  TEST_CHECK(http_request_query_string(request, "language") == NULL);
+  http_request_free(request);
+  close(server_fd);
+  close(client_fd);
+}
+
+void test_http_head_reader_partial() {
+  int client_fd;
+  const int server_fd = connection_with("POST /transcribe HTTP/1.1\r\n"
+    "Content-Length: 0\r", &client_fd);
+  fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+  HttpHeadReader* reader = http_head_reader_alloc();
+  HttpRequest* request = NULL;
+  int error_status = 0;
+  // Nothing waits for the rest of the head to arrive.
+  TEST_CHECK(http_head_reader_read(reader, server_fd, &request,
+    &error_status) == HTTP_HEAD_INCOMPLETE);
+  TEST_CHECK(request == NULL);
+
+  // The blank line that ends the head is split across the two reads.
+  TEST_ASSERT(write(client_fd, "\n\r\n", 3) == 3);
+  TEST_CHECK(http_head_reader_read(reader, server_fd, &request,
+    &error_status) == HTTP_HEAD_COMPLETE);
+  TEST_ASSERT(request != NULL);
+  TEST_INTEQ(0, (int)(request->content_length));
+  TEST_INTEQ(0, (int)(request->body_start_length));
+  http_request_free(request);
+  http_head_reader_free(reader);
+  close(server_fd);
+  close(client_fd);
+}
+
+void test_http_server_bad_requests() {
+  const char* requests[] = {
+    "GET\r\n\r\n",
+    "POST /transcribe SPDY/3\r\n\r\n",
+    "POST /transcribe HTTP/1.1\r\nContent-Length: lots\r\n\r\n",
+    "POST /transcribe HTTP/1.1\r\nNo colon here\r\n\r\n",
+  };
+  for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); ++i) {
+    int client_fd;
+    const int server_fd = connection_with(requests[i], &client_fd);
+    HttpRequest* request = NULL;
+    int error_status = 0;
+    TEST_CHECK(read_head(server_fd, &request, &error_status) ==
+      HTTP_HEAD_INVALID);
+    TEST_INTEQ(400, error_status);
+    close(server_fd);
+    close(client_fd);
+  }
+
+  // A client that hangs up before finishing its headers.
+  int client_fd;
+  const int server_fd = connection_with("POST /transcribe HTTP/1.1\r\n",
+    &client_fd);
+  shutdown(client_fd, SHUT_WR);
+  HttpRequest* request = NULL;
+  int error_status = 0;
+  TEST_CHECK(read_head(server_fd, &request, &error_status) ==
+    HTTP_HEAD_INVALID);
+  TEST_INTEQ(408, error_status);
+  close(server_fd);
+  close(client_fd);
+}
+
+void test_http_server_chunked_response() {
+  int client_fd;
+  const int server_fd = connection_with("", &client_fd);
+  TEST_CHECK(http_server_begin_chunked(server_fd, "application/x-ndjson"));
+  TEST_CHECK(http_server_send_chunk(server_fd, "{\"final\":false}\n", 16));
+  TEST_CHECK(http_server_send_chunk(server_fd, "", 0));
+  TEST_CHECK(http_server_end_chunked(server_fd));
+  char* response = response_from(client_fd, server_fd);
+  TEST_STREQ("HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/x-ndjson\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "10\r\n{\"final\":false}\n\r\n"
+    "0\r\n\r\n", response);
+  free(response);
+}
+
+void test_http_server_send_error() {
+  int client_fd;
+  const int server_fd = connection_with("", &client_fd);
+  TEST_CHECK(http_server_send_error(server_fd, 404, "Try /transcribe"));
+  char* response = response_from(client_fd, server_fd);
+  TEST_STREQ("HTTP/1.1 404 Not Found\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 16\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Try /transcribe\n", response);
+  free(response);
+}
+
+void test_http_server_send_response() {
+  int client_fd;
+  const int server_fd = connection_with("", &client_fd);
+  TEST_CHECK(http_server_send_response(server_fd, 200, "application/json",
+    "{}\n", 3));
+  char* response = response_from(client_fd, server_fd);
+  TEST_STREQ("HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 3\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "{}\n", response);
+  free(response);
+}
+
+void test_http_server_listen() {
+  TEST_INTEQ(-1, http_server_listen("localhost", 0));
+  const int listen_fd = http_server_listen("127.0.0.1", 0);
+  TEST_CHECK(listen_fd >= 0);
+  close(listen_fd);
+}
+
+TEST_LIST = {
+  {"http_head_reader_read", test_http_head_reader_read},
+  {"http_head_reader_partial", test_http_head_reader_partial},
+  {"http_server_bad_requests", test_http_server_bad_requests},
+  {"http_server_chunked_response", test_http_server_chunked_response},
+  {"http_server_send_error", test_http_server_send_error},
+  {"http_server_send_response", test_http_server_send_response},
+  {"http_server_listen", test_http_server_listen},
+  {NULL, NULL},
+};
@@ -0,0 +1,457 @@
+// Needed for struct ucred.
+#define _GNU_SOURCE
+
+#include "job_socket.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "string_utils.h"
+
+// Catches anything that isn't a spchcat client, or a client from a version
+// with a different message layout.
+#define JOB_SOCKET_MAGIC (0x4a435053)
+// Command lines are nowhere near this long, so anything bigger is an error.
+#define JOB_SOCKET_MAX_PAYLOAD (1024 * 1024)
+#define JOB_SOCKET_FDS_COUNT (3)
+
+typedef struct JobHeaderStruct {
+  uint32_t magic;
+  uint32_t flags;
+  uint32_t payload_length;
+} JobHeader;
+
+void socket_job_free(SocketJob* job) {
+  if (job == NULL) {
+    return;
+  }
+  string_list_free(job->argv, job->argc);
+  free(job->cwd);
+  for (int i = 0; i < JOB_SOCKET_FDS_COUNT; ++i) {
+    if (job->fds[i] >= 0) {
+      close(job->fds[i]);
+    }
+  }
+  free(job);
+}
+
+static bool fill_address(const char* path, struct sockaddr_un* address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address->sun_path)) {
+    fprintf(stderr, "Socket path '%s' is too long\n", path);
+    return false;
+  }
+  strcpy(address->sun_path, path);
+  return true;
+}
+
+// Jobs carry a user's files and standard streams, so they're only ever
+// passed between processes run by the same user.
+static bool is_peer_trusted(int socket_fd) {
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &credentials,
+    &length) != 0) {
+    return false;
+  }
+  return (credentials.uid == geteuid());
+}
+
+int job_socket_connect(const char* path) {
+  struct sockaddr_un address;
+  if (!fill_address(path, &address)) {
+    return -1;
+  }
+  const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    return -1;
+  }
+  if (connect(socket_fd, (struct sockaddr*)(&address), sizeof(address)) != 0) {
+    close(socket_fd);
+    return -1;
+  }
+  if (!is_peer_trusted(socket_fd)) {
+    fprintf(stderr, "Socket '%s' belongs to another user, so it won't be "
+      "used\n", path);
+    close(socket_fd);
+    return -1;
+  }
+  return socket_fd;
+}
+
+// Creates the socket's directory if it doesn't exist yet, so that only this
+// user can get into it. An existing one has to belong to this user or root,
+// and if anyone else can write to it, only the owners of files should be
+// able to remove them, like in /tmp.
+static bool prepare_directory(const char* path) {
+  const char* last_slash = strrchr(path, '/');
+  if ((last_slash == NULL) || (last_slash == path)) {
+    return true;
+  }
+  char* directory = string_duplicate(path);
+  directory[last_slash - path] = 0;
+  bool status = true;
+  struct stat info;
+  if ((mkdir(directory, 0700) != 0) && (errno != EEXIST)) {
+    fprintf(stderr, "Couldn't create directory '%s': %s\n", directory,
+      strerror(errno));
+    status = false;
+  }
+  else if (lstat(directory, &info) != 0) {
+    fprintf(stderr, "Couldn't check directory '%s': %s\n", directory,
+      strerror(errno));
+    status = false;
+  }
+  else if (!S_ISDIR(info.st_mode) ||
+    ((info.st_uid != geteuid()) && (info.st_uid != 0)) ||
+    (((info.st_mode & (S_IWGRP | S_IWOTH)) != 0) &&
+      ((info.st_mode & S_ISVTX) == 0))) {
+    fprintf(stderr, "Directory '%s' could be changed by another user, so "
+      "the socket can't be put there\n", directory);
+    status = false;
+  }
+  free(directory);
+  return status;
+}
+
+int job_socket_listen(const char* path) {
+  struct sockaddr_un address;
+  if (!fill_address(path, &address)) {
+    return -1;
+  }
+  const int existing_fd = job_socket_connect(path);
+  if (existing_fd >= 0) {
+    close(existing_fd);
+    fprintf(stderr, "Another daemon is already listening on '%s'\n", path);
+    return -1;
+  }
+  if (!prepare_directory(path)) {
+    return -1;
+  }
+  unlink(path);
+
+  const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    fprintf(stderr, "Couldn't create a socket: %s\n", strerror(errno));
+    return -1;
+  }
+  if (bind(socket_fd, (struct sockaddr*)(&address), sizeof(address)) != 0) {
+    fprintf(stderr, "Couldn't bind to '%s': %s\n", path, strerror(errno));
+    close(socket_fd);
+    return -1;
+  }
+  // Connecting needs write access to the socket file.
+  if (chmod(path, 0600) != 0) {
+    fprintf(stderr, "Couldn't restrict access to '%s': %s\n", path,
+      strerror(errno));
+    close(socket_fd);
+    return -1;
+  }
+  if (listen(socket_fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "Couldn't listen on '%s': %s\n", path, strerror(errno));
+    close(socket_fd);
+    return -1;
+  }
+  return socket_fd;
+}
+
+static bool write_all(int fd, const void* data, size_t length) {
+  const char* current = data;
+  while (length > 0) {
+    const ssize_t written = write(fd, current, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    current += written;
+    length -= written;
+  }
+  return true;
+}
+
+static bool read_all(int fd, void* data, size_t length) {
+  char* current = data;
+  while (length > 0) {
+    const ssize_t bytes_read = read(fd, current, length);
+    if (bytes_read < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (bytes_read == 0) {
+      return false;
+    }
+    current += bytes_read;
+    length -= bytes_read;
+  }
+  return true;
+}
+
+bool job_socket_send_job(int socket_fd, int argc, char** argv,
+  const char* cwd, const int* fds, int flags) {
+  // The payload is the working directory then each argument, all
+  // zero-terminated.
+  StringBuilder* payload = string_builder_alloc();
+  string_builder_append_span(payload, cwd, strlen(cwd) + 1);
+  for (int i = 0; i < argc; ++i) {
+    string_builder_append_span(payload, argv[i], strlen(argv[i]) + 1);
+  }
+
+  JobHeader header = { JOB_SOCKET_MAGIC, flags, payload->length };
+  struct iovec header_vector = { &header, sizeof(header) };
+  char control[CMSG_SPACE(sizeof(int) * JOB_SOCKET_FDS_COUNT)];
+  memset(control, 0, sizeof(control));
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &header_vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  struct cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+  control_message->cmsg_level = SOL_SOCKET;
+  control_message->cmsg_type = SCM_RIGHTS;
+  control_message->cmsg_len = CMSG_LEN(sizeof(int) * JOB_SOCKET_FDS_COUNT);
+  memcpy(CMSG_DATA(control_message), fds, sizeof(int) * JOB_SOCKET_FDS_COUNT);
+
+  bool status = (sendmsg(socket_fd, &message, 0) == sizeof(header));
+  if (status) {
+    status = write_all(socket_fd, payload->data, payload->length);
+  }
+  if (!status) {
+    fprintf(stderr, "Couldn't send job to daemon: %s\n", strerror(errno));
+  }
+  string_builder_free(payload);
+  return status;
+}
+
+JobSocketReader* job_socket_reader_alloc() {
+  JobSocketReader* result = calloc(1, sizeof(JobSocketReader));
+  result->expected_length = sizeof(JobHeader);
+  result->buffer = malloc(result->expected_length);
+  return result;
+}
+
+void job_socket_reader_free(JobSocketReader* reader) {
+  if (reader == NULL) {
+    return;
+  }
+  socket_job_free(reader->job);
+  free(reader->buffer);
+  free(reader);
+}
+
+// The first read also picks up the file descriptors sent with the header.
+static JobSocketReadStatus receive_first_part(JobSocketReader* reader,
+  int socket_fd) {
+  if (!is_peer_trusted(socket_fd)) {
+    fprintf(stderr, "Refused a job from another user\n");
+    return JOB_SOCKET_READ_INVALID;
+  }
+  struct iovec header_vector = { reader->buffer, sizeof(JobHeader) };
+  char control[CMSG_SPACE(sizeof(int) * JOB_SOCKET_FDS_COUNT)];
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &header_vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(socket_fd, &message, MSG_DONTWAIT);
+  } while ((received < 0) && (errno == EINTR));
+  if ((received < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+    return JOB_SOCKET_READ_INCOMPLETE;
+  }
+  // Hanging up without sending anything isn't an error worth reporting,
+  // since it's how a new daemon checks whether this one is still running.
+  if (received < 0) {
+    fprintf(stderr, "Couldn't receive job from client\n");
+  }
+  if (received <= 0) {
+    return JOB_SOCKET_READ_INVALID;
+  }
+
+  reader->job = calloc(1, sizeof(SocketJob));
+  for (int i = 0; i < JOB_SOCKET_FDS_COUNT; ++i) {
+    reader->job->fds[i] = -1;
+  }
+  struct cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+  if ((control_message != NULL) &&
+    (control_message->cmsg_level == SOL_SOCKET) &&
+    (control_message->cmsg_type == SCM_RIGHTS) &&
+    (control_message->cmsg_len ==
+      CMSG_LEN(sizeof(int) * JOB_SOCKET_FDS_COUNT))) {
+    memcpy(reader->job->fds, CMSG_DATA(control_message),
+      sizeof(int) * JOB_SOCKET_FDS_COUNT);
+  }
+  reader->length = received;
+  return JOB_SOCKET_READ_COMPLETE;
+}
+
+// Once the header is complete, checks it and makes room for the payload.
+static bool start_payload(JobSocketReader* reader) {
+  JobHeader header;
+  memcpy(&header, reader->buffer, sizeof(header));
+  if ((header.magic != JOB_SOCKET_MAGIC) || (reader->job->fds[0] < 0) ||
+    (header.payload_length == 0) ||
+    (header.payload_length > JOB_SOCKET_MAX_PAYLOAD)) {
+    fprintf(stderr, "Bad job received from client\n");
+    return false;
+  }
+  reader->job->flags = header.flags;
+  reader->expected_length += header.payload_length;
+  reader->buffer = realloc(reader->buffer, reader->expected_length);
+  return true;
+}
+
+JobSocketReadStatus job_socket_reader_read(JobSocketReader* reader,
+  int socket_fd, SocketJob** job) {
+  if (reader->job == NULL) {
+    const JobSocketReadStatus status = receive_first_part(reader, socket_fd);
+    if (status != JOB_SOCKET_READ_COMPLETE) {
+      return status;
+    }
+  }
+  // The rest of the header may come separately from the first byte, and the
+  // payload can take any number of reads.
+  while (true) {
+    if (reader->length == reader->expected_length) {
+      if (reader->expected_length > sizeof(JobHeader)) {
+        break;
+      }
+      if (!start_payload(reader)) {
+        return JOB_SOCKET_READ_INVALID;
+      }
+      continue;
+    }
+    const ssize_t bytes_read = recv(socket_fd, reader->buffer + reader->length,
+      reader->expected_length - reader->length, MSG_DONTWAIT);
+    if ((bytes_read < 0) && (errno == EINTR)) {
+      continue;
+    }
+    if ((bytes_read < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      return JOB_SOCKET_READ_INCOMPLETE;
+    }
+    if (bytes_read <= 0) {
+      fprintf(stderr, "Couldn't receive job from client\n");
+      return JOB_SOCKET_READ_INVALID;
+    }
+    reader->length += bytes_read;
+  }
+
+  const char* payload = reader->buffer + sizeof(JobHeader);
+  const char* end = reader->buffer + reader->expected_length;
+  if (end[-1] != 0) {
+    fprintf(stderr, "Bad job received from client\n");
+    return JOB_SOCKET_READ_INVALID;
+  }
+  SocketJob* result = reader->job;
+  result->cwd = string_duplicate(payload);
+  const char* current = payload + strlen(payload) + 1;
+  while (current < end) {
+    string_list_add(current, &result->argv, &result->argc);
+    current += strlen(current) + 1;
+  }
+  reader->job = NULL;
+  *job = result;
+  return JOB_SOCKET_READ_COMPLETE;
+}
+
+static double monotonic_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0);
+}
+
+bool job_socket_receive_job(int socket_fd, int timeout_ms, SocketJob** job) {
+  const double deadline_ms = monotonic_ms() + timeout_ms;
+  JobSocketReader* reader = job_socket_reader_alloc();
+  JobSocketReadStatus status;
+  while ((status = job_socket_reader_read(reader, socket_fd, job)) ==
+    JOB_SOCKET_READ_INCOMPLETE) {
+    const int wait_ms = (timeout_ms < 0) ? -1 :
+      (int)(deadline_ms - monotonic_ms());
+    struct pollfd poll_fd = { socket_fd, POLLIN, 0 };
+    if (((timeout_ms >= 0) && (wait_ms <= 0)) ||
+      (poll(&poll_fd, 1, wait_ms) == 0)) {
+      fprintf(stderr, "Timed out receiving job from client\n");
+      break;
+    }
+  }
+  job_socket_reader_free(reader);
+  return (status == JOB_SOCKET_READ_COMPLETE);
+}
+
+bool job_socket_send_fd(int socket_fd, int fd) {
+  // At least one byte has to be sent for the descriptor to travel with.
+  char byte = 0;
+  struct iovec byte_vector = { &byte, 1 };
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &byte_vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  struct cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+  control_message->cmsg_level = SOL_SOCKET;
+  control_message->cmsg_type = SCM_RIGHTS;
+  control_message->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(control_message), &fd, sizeof(int));
+  return (sendmsg(socket_fd, &message, 0) == 1);
+}
+
+int job_socket_receive_fd(int socket_fd) {
+  char byte;
+  struct iovec byte_vector = { &byte, 1 };
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &byte_vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(socket_fd, &message, 0);
+  } while ((received < 0) && (errno == EINTR));
+  struct cmsghdr* control_message =
+    (received == 1) ? CMSG_FIRSTHDR(&message) : NULL;
+  if ((control_message == NULL) ||
+    (control_message->cmsg_level != SOL_SOCKET) ||
+    (control_message->cmsg_type != SCM_RIGHTS) ||
+    (control_message->cmsg_len != CMSG_LEN(sizeof(int)))) {
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(control_message), sizeof(int));
+  return fd;
+}
+
+bool job_socket_send_status(int socket_fd, int status) {
+  const int32_t value = status;
+  return write_all(socket_fd, &value, sizeof(value));
+}
+
+bool job_socket_receive_status(int socket_fd, int* status) {
+  int32_t value;
+  if (!read_all(socket_fd, &value, sizeof(value))) {
+    return false;
+  }
+  *status = value;
+  return true;
+}
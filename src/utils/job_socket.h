@@ -0,0 +1,101 @@
+#ifndef INCLUDE_UTIL_JOB_SOCKET_H
+#define INCLUDE_UTIL_JOB_SOCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Set if the job's audio is streamed to its standard input, rather than
+// read from files or a capture device.
+#define JOB_SOCKET_FLAG_STREAM (1 << 0)
+
+// Sent in place of an exit status when the daemon can't run the job as it
+// was asked, for example because it needs a different model, so the client
+// should run it itself. Exit statuses are never negative.
+#define JOB_SOCKET_STATUS_RUN_LOCALLY (-1)
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // How a client hands a job over to a daemon: its command line, its working
+  // directory so relative paths still work, and its standard input, output,
+  // and error, so the daemon can read and write them directly.
+  typedef struct SocketJobStruct {
+    int argc;
+    char** argv;
+    char* cwd;
+    int fds[3];
+    // JOB_SOCKET_FLAG_* values describing the job.
+    int flags;
+  } SocketJob;
+
+  void socket_job_free(SocketJob* job);
+
+  // Starts listening on a UNIX domain socket at `path`. A socket file left
+  // behind by a daemon that's no longer running is replaced, but it's an
+  // error if another daemon is still accepting connections there. A missing
+  // directory is created so only this user can use it, and one that other
+  // users could tamper with is refused. Returns the socket, or -1 on
+  // failure.
+  int job_socket_listen(const char* path);
+
+  // Returns a connection to the daemon listening at `path`, or -1 if there
+  // isn't one run by this user.
+  int job_socket_connect(const char* path);
+
+  // Sends the command line, working directory, and the three file
+  // descriptors in `fds` over a connection.
+  bool job_socket_send_job(int socket_fd, int argc, char** argv,
+    const char* cwd, const int* fds, int flags);
+
+  // Gathers a job sent by job_socket_send_job() from a new connection, over
+  // as many reads as it takes to arrive, so a slow client doesn't hold up a
+  // thread that's looking after others too.
+  typedef struct JobSocketReaderStruct {
+    // Created when the first part arrives, since the file descriptors come
+    // with it.
+    SocketJob* job;
+    // The header and then the payload, as they arrive. How long they'll be
+    // is only known once the header is complete.
+    char* buffer;
+    size_t length;
+    size_t expected_length;
+  } JobSocketReader;
+
+  typedef enum JobSocketReadStatusEnum {
+    JOB_SOCKET_READ_INCOMPLETE,
+    JOB_SOCKET_READ_COMPLETE,
+    JOB_SOCKET_READ_INVALID,
+  } JobSocketReadStatus;
+
+  JobSocketReader* job_socket_reader_alloc();
+  void job_socket_reader_free(JobSocketReader* reader);
+
+  // Reads whatever has arrived, without waiting for any more, even if the
+  // connection is blocking. Once the whole job is there the caller owns it,
+  // including the file descriptors in it. Jobs from other users are invalid.
+  JobSocketReadStatus job_socket_reader_read(JobSocketReader* reader,
+    int socket_fd, SocketJob** job);
+
+  // Waits up to `timeout_ms` for a whole job to arrive, or for as long as it
+  // takes if that's negative, for callers that have nothing else to do
+  // meanwhile.
+  bool job_socket_receive_job(int socket_fd, int timeout_ms, SocketJob** job);
+
+  // Passes one more file descriptor over a connection, so a job can be
+  // handed on to another process along with the client's connection.
+  bool job_socket_send_fd(int socket_fd, int fd);
+  // Returns the descriptor, or -1 if none arrived.
+  int job_socket_receive_fd(int socket_fd);
+
+  // Once a job is finished its exit status is sent back, so the client can
+  // exit with the same one. Receiving fails if the connection was closed
+  // before a status arrived.
+  bool job_socket_send_status(int socket_fd, int status);
+  bool job_socket_receive_status(int socket_fd, int* status);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_JOB_SOCKET_H
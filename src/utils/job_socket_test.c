@@ -0,0 +1,161 @@
+// Has to come before any system headers, for job_socket.c's struct ucred.
+#define _GNU_SOURCE
+
+#include "acutest.h"
+
+#include "job_socket.c"
+
+void test_job_socket_send_and_receive() {
+  int sockets[2];
+  TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+  int output_pipe[2];
+  TEST_CHECK(pipe(output_pipe) == 0);
+
+  char* argv[] = { "spchcat", "--json_output=true", "some file.wav" };
+  const int fds[] = { output_pipe[0], output_pipe[1], STDERR_FILENO };
+  TEST_CHECK(job_socket_send_job(sockets[0], 3, argv, "/tmp/work", fds,
+    JOB_SOCKET_FLAG_STREAM));
+
+  SocketJob* job = NULL;
+  TEST_CHECK(job_socket_receive_job(sockets[1], 1000, &job));
+  TEST_STREQ("/tmp/work", job->cwd);
+  TEST_INTEQ(JOB_SOCKET_FLAG_STREAM, job->flags);
+  TEST_INTEQ(3, job->argc);
+  TEST_STREQ("spchcat", job->argv[0]);
+  TEST_STREQ("--json_output=true", job->argv[1]);
+  TEST_STREQ("some file.wav", job->argv[2]);
+
+  // The descriptors received are new ones for the same files.
+  TEST_CHECK(job->fds[1] != output_pipe[1]);
+  TEST_CHECK(write(job->fds[1], "hi", 2) == 2);
+  char buffer[3] = {};
+  TEST_CHECK(read(output_pipe[0], buffer, 2) == 2);
+  TEST_STREQ("hi", buffer);
+
+  TEST_CHECK(job_socket_send_status(sockets[1], 3));
+  int status = 0;
+  TEST_CHECK(job_socket_receive_status(sockets[0], &status));
+  TEST_INTEQ(3, status);
+
+  // A closed connection gives no status.
+  close(sockets[1]);
+  TEST_CHECK(!job_socket_receive_status(sockets[0], &status));
+
+  socket_job_free(job);
+  close(sockets[0]);
+  close(output_pipe[0]);
+  close(output_pipe[1]);
+}
+
+void test_job_socket_reader_partial() {
+  int sockets[2];
+  TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+  JobSocketReader* reader = job_socket_reader_alloc();
+  SocketJob* job = NULL;
+  // Nothing waits for the job to arrive.
+  TEST_CHECK(job_socket_reader_read(reader, sockets[1], &job) ==
+    JOB_SOCKET_READ_INCOMPLETE);
+
+  // The descriptors come with the first part of the header.
+  const char payload[] = "/tmp\0spchcat\0-";
+  const JobHeader header = { JOB_SOCKET_MAGIC, JOB_SOCKET_FLAG_STREAM,
+    sizeof(payload) };
+  struct iovec header_vector = { (void*)(&header), 4 };
+  char control[CMSG_SPACE(sizeof(int) * JOB_SOCKET_FDS_COUNT)];
+  memset(control, 0, sizeof(control));
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &header_vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  struct cmsghdr* control_message = CMSG_FIRSTHDR(&message);
+  control_message->cmsg_level = SOL_SOCKET;
+  control_message->cmsg_type = SCM_RIGHTS;
+  control_message->cmsg_len = CMSG_LEN(sizeof(int) * JOB_SOCKET_FDS_COUNT);
+  const int fds[] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+  memcpy(CMSG_DATA(control_message), fds, sizeof(fds));
+  TEST_ASSERT(sendmsg(sockets[0], &message, 0) == 4);
+  TEST_CHECK(job_socket_reader_read(reader, sockets[1], &job) ==
+    JOB_SOCKET_READ_INCOMPLETE);
+
+  TEST_ASSERT(write(sockets[0], (const char*)(&header) + 4,
+    sizeof(header) - 4) == (ssize_t)(sizeof(header) - 4));
+  TEST_ASSERT(write(sockets[0], payload, 5) == 5);
+  TEST_CHECK(job_socket_reader_read(reader, sockets[1], &job) ==
+    JOB_SOCKET_READ_INCOMPLETE);
+  TEST_CHECK(job == NULL);
+
+  TEST_ASSERT(write(sockets[0], payload + 5, sizeof(payload) - 5) ==
+    (ssize_t)(sizeof(payload) - 5));
+  TEST_CHECK(job_socket_reader_read(reader, sockets[1], &job) ==
+    JOB_SOCKET_READ_COMPLETE);
+  TEST_ASSERT(job != NULL);
+  TEST_STREQ("/tmp", job->cwd);
+  TEST_INTEQ(JOB_SOCKET_FLAG_STREAM, job->flags);
+  TEST_INTEQ(2, job->argc);
+  TEST_STREQ("-", job->argv[1]);
+  TEST_CHECK(job->fds[2] >= 0);
+  socket_job_free(job);
+  job_socket_reader_free(reader);
+
+  // A client that never sends its job is given up on.
+  TEST_CHECK(!job_socket_receive_job(sockets[1], 10, &job));
+  close(sockets[0]);
+  close(sockets[1]);
+}
+
+void test_job_socket_listen() {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/job_socket_test_%d.sock", getpid());
+  unlink(path);
+  TEST_INTEQ(-1, job_socket_connect(path));
+
+  const int listen_fd = job_socket_listen(path);
+  TEST_CHECK(listen_fd >= 0);
+  const int client_fd = job_socket_connect(path);
+  TEST_CHECK(client_fd >= 0);
+  // Only one daemon can use a socket at once.
+  TEST_INTEQ(-1, job_socket_listen(path));
+  close(client_fd);
+  close(listen_fd);
+
+  // Once the daemon has gone, its socket file can be taken over.
+  const int next_listen_fd = job_socket_listen(path);
+  TEST_CHECK(next_listen_fd >= 0);
+  close(next_listen_fd);
+  unlink(path);
+}
+
+void test_job_socket_listen_directory() {
+  char directory[64];
+  snprintf(directory, sizeof(directory), "/tmp/job_socket_test_%d",
+    getpid());
+  char path[96];
+  snprintf(path, sizeof(path), "%s/spchcat.sock", directory);
+  rmdir(directory);
+
+  // A missing directory is created so only this user can get into it.
+  const int listen_fd = job_socket_listen(path);
+  TEST_CHECK(listen_fd >= 0);
+  struct stat info;
+  TEST_CHECK(stat(directory, &info) == 0);
+  TEST_INTEQ(0700, (int)(info.st_mode & 0777));
+  TEST_CHECK(stat(path, &info) == 0);
+  TEST_INTEQ(0600, (int)(info.st_mode & 0777));
+  close(listen_fd);
+  unlink(path);
+
+  // Anyone could swap the socket in a directory like this one.
+  chmod(directory, 0777);
+  TEST_INTEQ(-1, job_socket_listen(path));
+  rmdir(directory);
+}
+
+TEST_LIST = {
+  {"job_socket_send_and_receive", test_job_socket_send_and_receive},
+  {"job_socket_reader_partial", test_job_socket_reader_partial},
+  {"job_socket_listen", test_job_socket_listen},
+  {"job_socket_listen_directory", test_job_socket_listen_directory},
+  {NULL, NULL},
+};
@@ -0,0 +1,186 @@
+#include "json_writer.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void flush_if_full(JsonWriter* writer) {
+  if ((writer->file != NULL) &&
+    (writer->buffer->length >= JSON_WRITER_FLUSH_SIZE)) {
+    json_writer_flush(writer);
+  }
+}
+
+// Adds a comma if there's already a value at this level, and notes that
+// there will be one from now on.
+static void start_value(JsonWriter* writer) {
+  if (writer->after_key) {
+    writer->after_key = false;
+    return;
+  }
+  if (writer->has_values[writer->depth]) {
+    string_builder_append_char(writer->buffer, ',');
+  }
+  writer->has_values[writer->depth] = true;
+}
+
+// Copies `text` into the buffer with quotes, backslashes and control
+// characters escaped. Runs of characters that don't need escaping are
+// copied in one go. Anything outside ASCII is assumed to already be UTF-8,
+// and is passed through untouched.
+static void append_escaped(JsonWriter* writer, const char* text) {
+  static const char hex_digits[] = "0123456789abcdef";
+  const char* run_start = text;
+  const char* current = text;
+  while (*current != 0) {
+    const unsigned char c = (unsigned char)(*current);
+    if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+      current += 1;
+      continue;
+    }
+    string_builder_append_span(writer->buffer, run_start,
+      current - run_start);
+    char escape[7] = { '\\', 0, 0, 0, 0, 0, 0 };
+    switch (c) {
+    case '"': escape[1] = '"'; break;
+    case '\\': escape[1] = '\\'; break;
+    case '\n': escape[1] = 'n'; break;
+    case '\r': escape[1] = 'r'; break;
+    case '\t': escape[1] = 't'; break;
+    case '\b': escape[1] = 'b'; break;
+    case '\f': escape[1] = 'f'; break;
+    default:
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = hex_digits[c >> 4];
+      escape[5] = hex_digits[c & 0xf];
+      break;
+    }
+    string_builder_append(writer->buffer, escape);
+    current += 1;
+    run_start = current;
+  }
+  string_builder_append_span(writer->buffer, run_start, current - run_start);
+}
+
+JsonWriter* json_writer_alloc(FILE* file) {
+  JsonWriter* result = calloc(1, sizeof(JsonWriter));
+  result->file = file;
+  result->buffer = string_builder_alloc();
+  if (file != NULL) {
+    string_builder_reserve(result->buffer, JSON_WRITER_FLUSH_SIZE * 2);
+  }
+  return result;
+}
+
+void json_writer_free(JsonWriter* writer) {
+  if (writer == NULL) {
+    return;
+  }
+  json_writer_flush(writer);
+  string_builder_free(writer->buffer);
+  free(writer);
+}
+
+void json_writer_begin_object(JsonWriter* writer) {
+  start_value(writer);
+  string_builder_append_char(writer->buffer, '{');
+  writer->depth += 1;
+  writer->has_values[writer->depth] = false;
+}
+
+void json_writer_end_object(JsonWriter* writer) {
+  writer->depth -= 1;
+  string_builder_append_char(writer->buffer, '}');
+  flush_if_full(writer);
+}
+
+void json_writer_begin_array(JsonWriter* writer) {
+  start_value(writer);
+  string_builder_append_char(writer->buffer, '[');
+  writer->depth += 1;
+  writer->has_values[writer->depth] = false;
+}
+
+void json_writer_end_array(JsonWriter* writer) {
+  writer->depth -= 1;
+  string_builder_append_char(writer->buffer, ']');
+  flush_if_full(writer);
+}
+
+void json_writer_key(JsonWriter* writer, const char* key) {
+  start_value(writer);
+  string_builder_append_char(writer->buffer, '"');
+  append_escaped(writer, key);
+  string_builder_append(writer->buffer, "\":");
+  writer->after_key = true;
+}
+
+void json_writer_string(JsonWriter* writer, const char* value) {
+  json_writer_string_begin(writer);
+  json_writer_string_append(writer, value);
+  json_writer_string_end(writer);
+}
+
+void json_writer_int(JsonWriter* writer, int64_t value) {
+  start_value(writer);
+  char number[32];
+  snprintf(number, sizeof(number), "%" PRId64, value);
+  string_builder_append(writer->buffer, number);
+}
+
+void json_writer_double(JsonWriter* writer, double value, int decimals) {
+  if (!isfinite(value)) {
+    json_writer_null(writer);
+    return;
+  }
+  start_value(writer);
+  char number[64];
+  snprintf(number, sizeof(number), "%.*f", decimals, value);
+  string_builder_append(writer->buffer, number);
+}
+
+void json_writer_bool(JsonWriter* writer, bool value) {
+  start_value(writer);
+  string_builder_append(writer->buffer, value ? "true" : "false");
+}
+
+void json_writer_null(JsonWriter* writer) {
+  start_value(writer);
+  string_builder_append(writer->buffer, "null");
+}
+
+void json_writer_string_begin(JsonWriter* writer) {
+  start_value(writer);
+  string_builder_append_char(writer->buffer, '"');
+}
+
+void json_writer_string_append(JsonWriter* writer, const char* piece) {
+  append_escaped(writer, piece);
+}
+
+void json_writer_string_end(JsonWriter* writer) {
+  string_builder_append_char(writer->buffer, '"');
+  flush_if_full(writer);
+}
+
+void json_writer_end_line(JsonWriter* writer) {
+  string_builder_append_char(writer->buffer, '\n');
+  writer->has_values[0] = false;
+  json_writer_flush(writer);
+}
+
+void json_writer_flush(JsonWriter* writer) {
+  if ((writer->file == NULL) || (writer->buffer->length == 0)) {
+    return;
+  }
+  fwrite(writer->buffer->data, 1, writer->buffer->length, writer->file);
+  fflush(writer->file);
+  string_builder_reset(writer->buffer);
+}
+
+void json_writer_raw(JsonWriter* writer, const char* text) {
+  string_builder_append(writer->buffer, text);
+}
@@ -0,0 +1,80 @@
+#ifndef INCLUDE_UTIL_JSON_WRITER_H
+#define INCLUDE_UTIL_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "string_utils.h"
+
+// How deeply objects and arrays can be nested.
+#define JSON_WRITER_MAX_DEPTH (16)
+
+// Output is collected in memory until there's at least this much, and then
+// written to the file in one go.
+#define JSON_WRITER_FLUSH_SIZE (64 * 1024)
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // Writes JSON a value at a time, straight into an output buffer, so large
+  // documents can be produced without building up any intermediate strings.
+  // Commas between values are added automatically. Nothing checks that the
+  // calls make a well-formed document, so keys must only be written inside
+  // objects, and every value inside an object needs a key before it.
+  typedef struct JsonWriterStruct {
+    // If this is NULL, everything written is kept in `buffer` until the
+    // caller takes it.
+    FILE* file;
+    StringBuilder* buffer;
+    // Whether the current container at each level already has a value in
+    // it, so the next one needs a comma first.
+    bool has_values[JSON_WRITER_MAX_DEPTH + 1];
+    int depth;
+    // Set after a key, so the value that follows it doesn't get a comma.
+    bool after_key;
+  } JsonWriter;
+
+  JsonWriter* json_writer_alloc(FILE* file);
+  // Flushes anything that hasn't been written to the file yet.
+  void json_writer_free(JsonWriter* writer);
+
+  void json_writer_begin_object(JsonWriter* writer);
+  void json_writer_end_object(JsonWriter* writer);
+  void json_writer_begin_array(JsonWriter* writer);
+  void json_writer_end_array(JsonWriter* writer);
+  void json_writer_key(JsonWriter* writer, const char* key);
+
+  void json_writer_string(JsonWriter* writer, const char* value);
+  void json_writer_int(JsonWriter* writer, int64_t value);
+  // Writes `value` with a fixed number of `decimals`, or null if it isn't
+  // finite, since JSON has no way to represent infinities or NaNs.
+  void json_writer_double(JsonWriter* writer, double value, int decimals);
+  void json_writer_bool(JsonWriter* writer, bool value);
+  void json_writer_null(JsonWriter* writer);
+
+  // Writes a string value a piece at a time, for text that's spread across
+  // several buffers. Call json_writer_string_begin(), then
+  // json_writer_string_append() for each piece, then json_writer_string_end().
+  void json_writer_string_begin(JsonWriter* writer);
+  void json_writer_string_append(JsonWriter* writer, const char* piece);
+  void json_writer_string_end(JsonWriter* writer);
+
+  // Ends a top-level value with a newline, as JSON Lines expects, and pushes
+  // everything written so far out to the file.
+  void json_writer_end_line(JsonWriter* writer);
+
+  // Writes out anything still buffered. Does nothing without a file.
+  void json_writer_flush(JsonWriter* writer);
+
+  // Adds text to the output exactly as it is, for separators between
+  // top-level values. The writer's comma tracking isn't affected.
+  void json_writer_raw(JsonWriter* writer, const char* text);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_JSON_WRITER_H
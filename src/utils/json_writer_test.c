@@ -0,0 +1,94 @@
+#include "acutest.h"
+
+#include "json_writer.c"
+
+void test_json_writer_values() {
+  JsonWriter* writer = json_writer_alloc(NULL);
+  json_writer_begin_object(writer);
+  json_writer_key(writer, "name");
+  json_writer_string(writer, "spchcat");
+  json_writer_key(writer, "count");
+  json_writer_int(writer, -42);
+  json_writer_key(writer, "time");
+  json_writer_double(writer, 1.23456, 2);
+  json_writer_key(writer, "bad");
+  json_writer_double(writer, NAN, 2);
+  json_writer_key(writer, "flags");
+  json_writer_begin_array(writer);
+  json_writer_bool(writer, true);
+  json_writer_bool(writer, false);
+  json_writer_null(writer);
+  json_writer_begin_object(writer);
+  json_writer_end_object(writer);
+  json_writer_begin_array(writer);
+  json_writer_end_array(writer);
+  json_writer_end_array(writer);
+  json_writer_end_object(writer);
+  TEST_STREQ("{\"name\":\"spchcat\",\"count\":-42,\"time\":1.23,"
+    "\"bad\":null,\"flags\":[true,false,null,{},[]]}", writer->buffer->data);
+  TEST_INTEQ(0, writer->depth);
+  json_writer_free(writer);
+}
+
+void test_json_writer_escaping() {
+  JsonWriter* writer = json_writer_alloc(NULL);
+  json_writer_begin_array(writer);
+  json_writer_string(writer, "say \"hi\"\\\n\t\x01");
+  json_writer_string(writer, "caf\xc3\xa9");
+  json_writer_string_begin(writer);
+  json_writer_string_append(writer, "he");
+  json_writer_string_append(writer, "llo\"");
+  json_writer_string_append(writer, "");
+  json_writer_string_end(writer);
+  json_writer_end_array(writer);
+  TEST_STREQ("[\"say \\\"hi\\\"\\\\\\n\\t\\u0001\",\"caf\xc3\xa9\","
+    "\"hello\\\"\"]", writer->buffer->data);
+  json_writer_free(writer);
+}
+
+void test_json_writer_lines() {
+  FILE* file = tmpfile();
+  JsonWriter* writer = json_writer_alloc(file);
+  for (int i = 0; i < 3; ++i) {
+    json_writer_begin_object(writer);
+    json_writer_key(writer, "index");
+    json_writer_int(writer, i);
+    json_writer_end_object(writer);
+    json_writer_end_line(writer);
+    // Each line goes out to the file as soon as it's finished.
+    TEST_INTEQ(0, (int)(writer->buffer->length));
+  }
+  json_writer_free(writer);
+
+  char contents[128] = {};
+  rewind(file);
+  const size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+  contents[length] = 0;
+  TEST_STREQ("{\"index\":0}\n{\"index\":1}\n{\"index\":2}\n", contents);
+  fclose(file);
+}
+
+void test_json_writer_flushes_large_output() {
+  FILE* file = tmpfile();
+  JsonWriter* writer = json_writer_alloc(file);
+  json_writer_begin_array(writer);
+  int64_t total_length = 1;
+  for (int i = 0; i < 100000; ++i) {
+    json_writer_string(writer, "token");
+    total_length += (i == 0) ? 7 : 8;
+    TEST_CHECK(writer->buffer->length < (JSON_WRITER_FLUSH_SIZE + 16));
+  }
+  json_writer_end_array(writer);
+  total_length += 1;
+  json_writer_free(writer);
+  TEST_INTEQ((int)(total_length), (int)(ftell(file)));
+  fclose(file);
+}
+
+TEST_LIST = {
+  {"json_writer_values", test_json_writer_values},
+  {"json_writer_escaping", test_json_writer_escaping},
+  {"json_writer_lines", test_json_writer_lines},
+  {"json_writer_flushes_large_output", test_json_writer_flushes_large_output},
+  {NULL, NULL},
+};
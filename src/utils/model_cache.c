@@ -0,0 +1,234 @@
+#include "model_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "string_utils.h"
+#include "time_utils.h"
+
+ModelCache* model_cache_alloc(int64_t budget_bytes,
+  model_cache_load_funcptr load_func, model_cache_free_funcptr free_func,
+  void* cookie) {
+  ModelCache* result = calloc(1, sizeof(ModelCache));
+  pthread_mutex_init(&result->mutex, NULL);
+  pthread_cond_init(&result->load_finished, NULL);
+  result->stats.budget_bytes = budget_bytes;
+  result->load_func = load_func;
+  result->free_func = free_func;
+  result->cookie = cookie;
+  return result;
+}
+
+void model_cache_free(ModelCache* cache) {
+  if (cache == NULL) {
+    return;
+  }
+  ModelCacheEntry* entry = cache->entries;
+  while (entry != NULL) {
+    ModelCacheEntry* next = entry->next;
+    if (entry->value != NULL) {
+      cache->free_func(cache->cookie, entry->value);
+    }
+    free(entry->key);
+    free(entry);
+    entry = next;
+  }
+  pthread_cond_destroy(&cache->load_finished);
+  pthread_mutex_destroy(&cache->mutex);
+  free(cache);
+}
+
+// Must be called with the mutex held.
+static ModelCacheEntry* find_entry(ModelCache* cache, const char* key) {
+  for (ModelCacheEntry* entry = cache->entries; entry != NULL;
+    entry = entry->next) {
+    if (strcmp(entry->key, key) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// Must be called with the mutex held.
+static ModelCacheEntry* insert_entry(ModelCache* cache, const char* key,
+  void* value, int64_t size_bytes) {
+  ModelCacheEntry* entry = calloc(1, sizeof(ModelCacheEntry));
+  entry->key = string_duplicate(key);
+  entry->value = value;
+  entry->size_bytes = size_bytes;
+  entry->users = 1;
+  cache->clock += 1;
+  entry->last_used = cache->clock;
+  entry->next = cache->entries;
+  cache->entries = entry;
+  cache->stats.entries_count += 1;
+  cache->stats.used_bytes += size_bytes;
+  return entry;
+}
+
+// Must be called with the mutex held.
+static void remove_entry(ModelCache* cache, ModelCacheEntry* entry) {
+  ModelCacheEntry** link = &cache->entries;
+  while (*link != entry) {
+    link = &(*link)->next;
+  }
+  *link = entry->next;
+  entry->next = NULL;
+  cache->stats.entries_count -= 1;
+  cache->stats.used_bytes -= entry->size_bytes;
+}
+
+static bool is_evictable(const ModelCacheEntry* entry) {
+  return (entry->users == 0) && !entry->is_loading && (entry->value != NULL);
+}
+
+// Takes the least recently used entries out of the cache until there's room
+// for `size_bytes` more, and returns them in `evicted` so their values can
+// be freed once the mutex has been released. Nothing is evicted if there
+// isn't enough that's unused to make room. Must be called with the mutex
+// held.
+static bool make_room(ModelCache* cache, int64_t size_bytes,
+  ModelCacheEntry** evicted) {
+  int64_t unused_bytes = 0;
+  for (ModelCacheEntry* entry = cache->entries; entry != NULL;
+    entry = entry->next) {
+    if (is_evictable(entry)) {
+      unused_bytes += entry->size_bytes;
+    }
+  }
+  const int64_t budget_bytes = cache->stats.budget_bytes;
+  if ((cache->stats.used_bytes - unused_bytes + size_bytes) > budget_bytes) {
+    return false;
+  }
+  while ((cache->stats.used_bytes + size_bytes) > budget_bytes) {
+    ModelCacheEntry* oldest = NULL;
+    for (ModelCacheEntry* entry = cache->entries; entry != NULL;
+      entry = entry->next) {
+      if (is_evictable(entry) &&
+        ((oldest == NULL) || (entry->last_used < oldest->last_used))) {
+        oldest = entry;
+      }
+    }
+    remove_entry(cache, oldest);
+    oldest->next = *evicted;
+    *evicted = oldest;
+    cache->stats.evictions += 1;
+  }
+  return true;
+}
+
+// Must be called with the mutex held. Entries whose loads failed have
+// already been taken out of the cache, and are freed by their last user.
+static void release_entry(ModelCacheEntry* entry) {
+  entry->users -= 1;
+  if ((entry->users == 0) && (entry->value == NULL) && !entry->is_loading) {
+    free(entry->key);
+    free(entry);
+  }
+}
+
+ModelCacheEntry* model_cache_add(ModelCache* cache, const char* key,
+  void* value, int64_t size_bytes) {
+  pthread_mutex_lock(&cache->mutex);
+  ModelCacheEntry* result = insert_entry(cache, key, value, size_bytes);
+  pthread_mutex_unlock(&cache->mutex);
+  return result;
+}
+
+ModelCacheEntry* model_cache_acquire(ModelCache* cache, const char* key,
+  int64_t size_bytes, void* load_arg) {
+  pthread_mutex_lock(&cache->mutex);
+  ModelCacheEntry* entry = find_entry(cache, key);
+  if (entry != NULL) {
+    entry->users += 1;
+    cache->clock += 1;
+    entry->last_used = cache->clock;
+    cache->stats.hits += 1;
+    while (entry->is_loading) {
+      pthread_cond_wait(&cache->load_finished, &cache->mutex);
+    }
+    if (entry->value == NULL) {
+      release_entry(entry);
+      entry = NULL;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return entry;
+  }
+
+  cache->stats.misses += 1;
+  ModelCacheEntry* evicted = NULL;
+  if (!make_room(cache, size_bytes, &evicted)) {
+    cache->stats.rejections += 1;
+    pthread_mutex_unlock(&cache->mutex);
+    return NULL;
+  }
+  // The entry holds its place in the budget while it loads, and anyone else
+  // who wants it waits rather than loading it again.
+  entry = insert_entry(cache, key, NULL, size_bytes);
+  entry->is_loading = true;
+  pthread_mutex_unlock(&cache->mutex);
+
+  while (evicted != NULL) {
+    ModelCacheEntry* next = evicted->next;
+    cache->free_func(cache->cookie, evicted->value);
+    free(evicted->key);
+    free(evicted);
+    evicted = next;
+  }
+  const double start_ms = time_now_ms();
+  void* value = NULL;
+  const bool was_loaded =
+    cache->load_func(cache->cookie, key, load_arg, &value);
+  const double load_ms = time_now_ms() - start_ms;
+
+  pthread_mutex_lock(&cache->mutex);
+  entry->is_loading = false;
+  if (was_loaded) {
+    entry->value = value;
+    cache->stats.total_load_ms += load_ms;
+    if (load_ms > cache->stats.max_load_ms) {
+      cache->stats.max_load_ms = load_ms;
+    }
+  }
+  else {
+    cache->stats.load_failures += 1;
+    remove_entry(cache, entry);
+    release_entry(entry);
+    entry = NULL;
+  }
+  pthread_cond_broadcast(&cache->load_finished);
+  pthread_mutex_unlock(&cache->mutex);
+  return entry;
+}
+
+ModelCacheEntry* model_cache_acquire_loaded(ModelCache* cache,
+  const char* key) {
+  pthread_mutex_lock(&cache->mutex);
+  ModelCacheEntry* entry = find_entry(cache, key);
+  if ((entry != NULL) && !entry->is_loading && (entry->value != NULL)) {
+    entry->users += 1;
+    cache->clock += 1;
+    entry->last_used = cache->clock;
+    cache->stats.hits += 1;
+  }
+  else {
+    entry = NULL;
+  }
+  pthread_mutex_unlock(&cache->mutex);
+  return entry;
+}
+
+void model_cache_release(ModelCache* cache, ModelCacheEntry* entry) {
+  if (entry == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&cache->mutex);
+  release_entry(entry);
+  pthread_mutex_unlock(&cache->mutex);
+}
+
+void model_cache_get_stats(ModelCache* cache, ModelCacheStats* stats) {
+  pthread_mutex_lock(&cache->mutex);
+  *stats = cache->stats;
+  pthread_mutex_unlock(&cache->mutex);
+}
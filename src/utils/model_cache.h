@@ -0,0 +1,92 @@
+#ifndef INCLUDE_UTIL_MODEL_CACHE_H
+#define INCLUDE_UTIL_MODEL_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // Loads the value for `key`, using whatever extra information the caller
+  // passed in as `load_arg`. Returns false if it couldn't be loaded.
+  typedef bool (*model_cache_load_funcptr)(void* cookie, const char* key,
+    void* load_arg, void** value);
+  typedef void (*model_cache_free_funcptr)(void* cookie, void* value);
+
+  typedef struct ModelCacheEntryStruct {
+    char* key;
+    // NULL while loading, or if loading failed.
+    void* value;
+    int64_t size_bytes;
+    // How many callers have acquired the entry and not yet released it.
+    // Entries that are in use are never evicted.
+    int users;
+    bool is_loading;
+    // When the entry was last acquired, by the cache's own clock.
+    uint64_t last_used;
+    struct ModelCacheEntryStruct* next;
+  } ModelCacheEntry;
+
+  typedef struct ModelCacheStatsStruct {
+    int64_t hits;
+    int64_t misses;
+    // Misses that couldn't be loaded because everything that would have
+    // had to be evicted to make room was in use.
+    int64_t rejections;
+    int64_t load_failures;
+    int64_t evictions;
+    double total_load_ms;
+    double max_load_ms;
+    int entries_count;
+    int64_t used_bytes;
+    int64_t budget_bytes;
+  } ModelCacheStats;
+
+  // Keeps loaded models around for as long as there's room for them, within
+  // a memory budget. When a new one is needed and there isn't room, the
+  // ones that were used least recently are freed first.
+  typedef struct ModelCacheStruct {
+    pthread_mutex_t mutex;
+    pthread_cond_t load_finished;
+    ModelCacheEntry* entries;
+    uint64_t clock;
+    ModelCacheStats stats;
+    model_cache_load_funcptr load_func;
+    model_cache_free_funcptr free_func;
+    void* cookie;
+  } ModelCache;
+
+  ModelCache* model_cache_alloc(int64_t budget_bytes,
+    model_cache_load_funcptr load_func, model_cache_free_funcptr free_func,
+    void* cookie);
+  // Frees every value. Nothing should still be using them.
+  void model_cache_free(ModelCache* cache);
+
+  // Adds a value that's already been loaded, whether or not there's room
+  // for it. The result has been acquired by the caller.
+  ModelCacheEntry* model_cache_add(ModelCache* cache, const char* key,
+    void* value, int64_t size_bytes);
+
+  // Returns the entry for `key`, loading it if needed, which needs
+  // `size_bytes` of the budget. If another caller is already loading it,
+  // this waits for them to finish. Returns NULL if it couldn't be loaded, or
+  // there wasn't room. The entry has to be released once it's not needed.
+  ModelCacheEntry* model_cache_acquire(ModelCache* cache, const char* key,
+    int64_t size_bytes, void* load_arg);
+  void model_cache_release(ModelCache* cache, ModelCacheEntry* entry);
+
+  // Returns the entry for `key` if it's already loaded, or NULL otherwise,
+  // without ever waiting for a load. Only a successful lookup is counted in
+  // the stats, so a caller can go on to model_cache_acquire() on a miss.
+  ModelCacheEntry* model_cache_acquire_loaded(ModelCache* cache,
+    const char* key);
+
+  void model_cache_get_stats(ModelCache* cache, ModelCacheStats* stats);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_MODEL_CACHE_H
@@ -0,0 +1,142 @@
+#include "acutest.h"
+
+#include "model_cache.c"
+
+typedef struct TestLoaderStruct {
+  int loads;
+  int frees;
+  // Keys starting with this fail to load.
+  const char* bad_prefix;
+} TestLoader;
+
+static bool test_load(void* cookie, const char* key, void* load_arg,
+  void** value) {
+  TestLoader* loader = (TestLoader*)(cookie);
+  loader->loads += 1;
+  if ((loader->bad_prefix != NULL) &&
+    string_starts_with(key, loader->bad_prefix)) {
+    return false;
+  }
+  *value = string_duplicate(key);
+  return true;
+}
+
+static void test_free(void* cookie, void* value) {
+  TestLoader* loader = (TestLoader*)(cookie);
+  loader->frees += 1;
+  free(value);
+}
+
+void test_model_cache_hits_and_misses() {
+  TestLoader loader = { 0, 0, NULL };
+  ModelCache* cache = model_cache_alloc(100, test_load, test_free, &loader);
+  ModelCacheEntry* first = model_cache_acquire(cache, "de_DE", 40, NULL);
+  TEST_CHECK(first != NULL);
+  TEST_STREQ("de_DE", (const char*)(first->value));
+  model_cache_release(cache, first);
+  ModelCacheEntry* second = model_cache_acquire(cache, "de_DE", 40, NULL);
+  TEST_CHECK(second == first);
+  model_cache_release(cache, second);
+  TEST_INTEQ(1, loader.loads);
+
+  ModelCacheStats stats;
+  model_cache_get_stats(cache, &stats);
+  TEST_INTEQ(1, (int)(stats.hits));
+  TEST_INTEQ(1, (int)(stats.misses));
+  TEST_INTEQ(1, stats.entries_count);
+  TEST_INTEQ(40, (int)(stats.used_bytes));
+  TEST_CHECK(stats.max_load_ms >= 0.0);
+  model_cache_free(cache);
+  TEST_INTEQ(1, loader.frees);
+}
+
+void test_model_cache_evicts_least_recently_used() {
+  TestLoader loader = { 0, 0, NULL };
+  ModelCache* cache = model_cache_alloc(100, test_load, test_free, &loader);
+  model_cache_release(cache, model_cache_acquire(cache, "a", 40, NULL));
+  model_cache_release(cache, model_cache_acquire(cache, "b", 40, NULL));
+  // Using "a" again makes "b" the oldest.
+  model_cache_release(cache, model_cache_acquire(cache, "a", 40, NULL));
+  model_cache_release(cache, model_cache_acquire(cache, "c", 40, NULL));
+  TEST_CHECK(find_entry(cache, "a") != NULL);
+  TEST_CHECK(find_entry(cache, "b") == NULL);
+  TEST_CHECK(find_entry(cache, "c") != NULL);
+  TEST_INTEQ(1, loader.frees);
+
+  ModelCacheStats stats;
+  model_cache_get_stats(cache, &stats);
+  TEST_INTEQ(1, (int)(stats.evictions));
+  TEST_INTEQ(80, (int)(stats.used_bytes));
+  model_cache_free(cache);
+}
+
+void test_model_cache_keeps_entries_in_use() {
+  TestLoader loader = { 0, 0, NULL };
+  ModelCache* cache = model_cache_alloc(100, test_load, test_free, &loader);
+  // Added models don't have to fit in the budget.
+  ModelCacheEntry* pinned = model_cache_add(cache, "default",
+    string_duplicate("default"), 150);
+  ModelCacheEntry* entry = model_cache_acquire(cache, "a", 40, NULL);
+  TEST_CHECK(entry == NULL);
+  model_cache_release(cache, pinned);
+
+  // Once it's not in use, it can be evicted to make room.
+  entry = model_cache_acquire(cache, "a", 40, NULL);
+  TEST_CHECK(entry != NULL);
+  // Nothing is evicted if there still wouldn't be enough room.
+  TEST_CHECK(model_cache_acquire(cache, "b", 80, NULL) == NULL);
+  TEST_CHECK(find_entry(cache, "a") != NULL);
+  model_cache_release(cache, entry);
+
+  ModelCacheStats stats;
+  model_cache_get_stats(cache, &stats);
+  TEST_INTEQ(2, (int)(stats.rejections));
+  TEST_INTEQ(1, (int)(stats.evictions));
+  model_cache_free(cache);
+  TEST_INTEQ(2, loader.frees);
+}
+
+void test_model_cache_load_failure() {
+  TestLoader loader = { 0, 0, "bad" };
+  ModelCache* cache = model_cache_alloc(100, test_load, test_free, &loader);
+  TEST_CHECK(model_cache_acquire(cache, "bad_model", 40, NULL) == NULL);
+  // Failures aren't cached, so it's tried again next time.
+  TEST_CHECK(model_cache_acquire(cache, "bad_model", 40, NULL) == NULL);
+  TEST_INTEQ(2, loader.loads);
+
+  ModelCacheStats stats;
+  model_cache_get_stats(cache, &stats);
+  TEST_INTEQ(2, (int)(stats.load_failures));
+  TEST_INTEQ(0, stats.entries_count);
+  TEST_INTEQ(0, (int)(stats.used_bytes));
+  model_cache_free(cache);
+}
+
+void test_model_cache_acquire_loaded() {
+  TestLoader loader = { 0, 0, NULL };
+  ModelCache* cache = model_cache_alloc(100, test_load, test_free, &loader);
+  // Nothing is loaded on a miss.
+  TEST_CHECK(model_cache_acquire_loaded(cache, "a") == NULL);
+  TEST_INTEQ(0, loader.loads);
+  model_cache_release(cache, model_cache_acquire(cache, "a", 40, NULL));
+  ModelCacheEntry* entry = model_cache_acquire_loaded(cache, "a");
+  TEST_CHECK(entry != NULL);
+  TEST_INTEQ(1, entry->users);
+  model_cache_release(cache, entry);
+
+  ModelCacheStats stats;
+  model_cache_get_stats(cache, &stats);
+  TEST_INTEQ(1, (int)(stats.hits));
+  TEST_INTEQ(1, (int)(stats.misses));
+  model_cache_free(cache);
+}
+
+TEST_LIST = {
+  {"model_cache_hits_and_misses", test_model_cache_hits_and_misses},
+  {"model_cache_evicts_least_recently_used",
+    test_model_cache_evicts_least_recently_used},
+  {"model_cache_keeps_entries_in_use", test_model_cache_keeps_entries_in_use},
+  {"model_cache_load_failure", test_model_cache_load_failure},
+  {"model_cache_acquire_loaded", test_model_cache_acquire_loaded},
+  {NULL, NULL},
+};
@@ -0,0 +1,189 @@
+#include "stream_scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "time_utils.h"
+
+static void queue_push(SchedulerQueue* queue, SchedulerStream* stream) {
+  if (queue->length == queue->capacity) {
+    const int new_capacity = (queue->capacity == 0) ? 16 : queue->capacity * 2;
+    SchedulerStream** new_items =
+      malloc(new_capacity * sizeof(SchedulerStream*));
+    for (int i = 0; i < queue->length; ++i) {
+      new_items[i] = queue->items[(queue->head + i) % queue->capacity];
+    }
+    free(queue->items);
+    queue->items = new_items;
+    queue->head = 0;
+    queue->capacity = new_capacity;
+  }
+  const int tail = (queue->head + queue->length) % queue->capacity;
+  queue->items[tail] = stream;
+  queue->length += 1;
+}
+
+static SchedulerStream* queue_pop(SchedulerQueue* queue) {
+  if (queue->length == 0) {
+    return NULL;
+  }
+  SchedulerStream* result = queue->items[queue->head];
+  queue->head = (queue->head + 1) % queue->capacity;
+  queue->length -= 1;
+  return result;
+}
+
+// Adds the stream to the given worker's queue for its priority. Must be
+// called with the mutex held.
+static void enqueue(StreamScheduler* scheduler, int queue_index,
+  SchedulerStream* stream) {
+  stream->state = SCHEDULER_STREAM_QUEUED;
+  stream->queued_ms = time_now_ms();
+  queue_push(&scheduler->queues[stream->priority][queue_index], stream);
+  pthread_cond_signal(&scheduler->work_ready);
+}
+
+// Takes the oldest stream of the highest priority that's waiting, from the
+// worker's own queue if possible, or failing that from the next busy
+// worker's. Must be called with the mutex held.
+static SchedulerStream* take_stream(StreamScheduler* scheduler, int index) {
+  for (int priority = 0; priority < SCHEDULER_PRIORITIES_COUNT; ++priority) {
+    for (int i = 0; i < scheduler->threads_count; ++i) {
+      const int queue_index = (index + i) % scheduler->threads_count;
+      SchedulerStream* stream =
+        queue_pop(&scheduler->queues[priority][queue_index]);
+      if (stream != NULL) {
+        return stream;
+      }
+    }
+  }
+  return NULL;
+}
+
+static void* worker_main(void* arg) {
+  SchedulerWorker* worker = (SchedulerWorker*)(arg);
+  StreamScheduler* scheduler = worker->scheduler;
+  pthread_mutex_lock(&scheduler->mutex);
+  while (true) {
+    SchedulerStream* stream = take_stream(scheduler, worker->index);
+    if (stream == NULL) {
+      if (scheduler->should_stop) {
+        break;
+      }
+      pthread_cond_wait(&scheduler->work_ready, &scheduler->mutex);
+      continue;
+    }
+    const double lag_ms = time_now_ms() - stream->queued_ms;
+    stream->steps_count += 1;
+    stream->total_lag_ms += lag_ms;
+    if (lag_ms > stream->max_lag_ms) {
+      stream->max_lag_ms = lag_ms;
+    }
+    stream->state = SCHEDULER_STREAM_RUNNING;
+    pthread_mutex_unlock(&scheduler->mutex);
+
+    const bool has_more = scheduler->func(scheduler->cookie, worker->index,
+      stream);
+
+    pthread_mutex_lock(&scheduler->mutex);
+    if (has_more || stream->is_woken) {
+      stream->is_woken = false;
+      enqueue(scheduler, worker->index, stream);
+    }
+    else {
+      stream->state = SCHEDULER_STREAM_IDLE;
+    }
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+  return NULL;
+}
+
+StreamScheduler* stream_scheduler_alloc(int threads_count,
+  stream_scheduler_funcptr func, void* cookie) {
+  if (threads_count < 1) {
+    threads_count = 1;
+  }
+  StreamScheduler* result = calloc(1, sizeof(StreamScheduler));
+  pthread_mutex_init(&result->mutex, NULL);
+  pthread_cond_init(&result->work_ready, NULL);
+  result->threads_count = threads_count;
+  result->func = func;
+  result->cookie = cookie;
+  for (int priority = 0; priority < SCHEDULER_PRIORITIES_COUNT; ++priority) {
+    result->queues[priority] = calloc(threads_count, sizeof(SchedulerQueue));
+  }
+  result->workers = calloc(threads_count, sizeof(SchedulerWorker));
+  result->threads = calloc(threads_count, sizeof(pthread_t));
+  for (int i = 0; i < threads_count; ++i) {
+    result->workers[i].scheduler = result;
+    result->workers[i].index = i;
+    if (pthread_create(&result->threads[i], NULL, worker_main,
+      &result->workers[i]) != 0) {
+      fprintf(stderr, "Couldn't start scheduler thread %d\n", i);
+      result->threads_count = i;
+      break;
+    }
+  }
+  if (result->threads_count == 0) {
+    stream_scheduler_free(result);
+    return NULL;
+  }
+  return result;
+}
+
+void stream_scheduler_free(StreamScheduler* scheduler) {
+  if (scheduler == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&scheduler->mutex);
+  scheduler->should_stop = true;
+  pthread_cond_broadcast(&scheduler->work_ready);
+  pthread_mutex_unlock(&scheduler->mutex);
+  for (int i = 0; i < scheduler->threads_count; ++i) {
+    pthread_join(scheduler->threads[i], NULL);
+  }
+  for (int priority = 0; priority < SCHEDULER_PRIORITIES_COUNT; ++priority) {
+    for (int i = 0; i < scheduler->threads_count; ++i) {
+      free(scheduler->queues[priority][i].items);
+    }
+    free(scheduler->queues[priority]);
+  }
+  free(scheduler->workers);
+  free(scheduler->threads);
+  pthread_cond_destroy(&scheduler->work_ready);
+  pthread_mutex_destroy(&scheduler->mutex);
+  free(scheduler);
+}
+
+void scheduler_stream_init(SchedulerStream* stream) {
+  stream->state = SCHEDULER_STREAM_IDLE;
+  stream->priority = SCHEDULER_PRIORITY_LIVE;
+  stream->is_woken = false;
+  stream->queued_ms = 0.0;
+  stream->steps_count = 0;
+  stream->total_lag_ms = 0.0;
+  stream->max_lag_ms = 0.0;
+}
+
+void stream_scheduler_wake(StreamScheduler* scheduler,
+  SchedulerStream* stream) {
+  pthread_mutex_lock(&scheduler->mutex);
+  if (stream->state == SCHEDULER_STREAM_IDLE) {
+    const int queue_index = scheduler->next_queue;
+    scheduler->next_queue =
+      (scheduler->next_queue + 1) % scheduler->threads_count;
+    enqueue(scheduler, queue_index, stream);
+  }
+  else if (stream->state == SCHEDULER_STREAM_RUNNING) {
+    stream->is_woken = true;
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+}
+
+bool stream_scheduler_is_idle(StreamScheduler* scheduler,
+  SchedulerStream* stream) {
+  pthread_mutex_lock(&scheduler->mutex);
+  const bool result = (stream->state == SCHEDULER_STREAM_IDLE);
+  pthread_mutex_unlock(&scheduler->mutex);
+  return result;
+}
@@ -0,0 +1,108 @@
+#ifndef INCLUDE_UTIL_STREAM_SCHEDULER_H
+#define INCLUDE_UTIL_STREAM_SCHEDULER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  typedef enum {
+    SCHEDULER_STREAM_IDLE,
+    SCHEDULER_STREAM_QUEUED,
+    SCHEDULER_STREAM_RUNNING,
+  } SchedulerStreamState;
+
+  // Live streams are always run before batch ones, so batch work only gets
+  // whatever capacity the live streams leave spare. Steps are short, so a
+  // live stream that's woken only has to wait for the steps that are already
+  // running to finish.
+  typedef enum {
+    SCHEDULER_PRIORITY_LIVE,
+    SCHEDULER_PRIORITY_BATCH,
+    SCHEDULER_PRIORITIES_COUNT,
+  } SchedulerPriority;
+
+  // Scheduling state for one stream of work, like a client's live audio.
+  // Put one of these in whatever holds the stream's own state. Everything
+  // here is protected by the scheduler's mutex.
+  typedef struct SchedulerStreamStruct {
+    SchedulerStreamState state;
+    // Live by default. Only change it while the stream is idle.
+    SchedulerPriority priority;
+    // Set if the stream was woken while a step was running, so that it's
+    // queued again afterwards instead of going idle.
+    bool is_woken;
+    double queued_ms;
+    // How long the stream waited in a queue before each step started.
+    int64_t steps_count;
+    double total_lag_ms;
+    double max_lag_ms;
+  } SchedulerStream;
+
+  // Does one short step of work for a stream, like feeding a few hundred
+  // milliseconds of audio to a decoder. Returns true if there's more work
+  // ready to do straight away. Only one step runs at a time for any stream.
+  typedef bool (*stream_scheduler_funcptr)(void* cookie, int thread_index,
+    SchedulerStream* stream);
+
+  // One worker's queue of streams that are ready to run.
+  typedef struct SchedulerQueueStruct {
+    SchedulerStream** items;
+    int head;
+    int length;
+    int capacity;
+  } SchedulerQueue;
+
+  typedef struct SchedulerWorkerStruct {
+    struct StreamSchedulerStruct* scheduler;
+    int index;
+  } SchedulerWorker;
+
+  // Shares a fixed set of worker threads between any number of streams.
+  // Each worker has its own queue for each priority, which it takes streams
+  // from in the order they were added, and when that's empty it steals the
+  // oldest stream from another worker's queue. Batch streams are only taken
+  // once there are no live ones waiting in any queue. A stream that still
+  // has work after a step goes to the back of its queue rather than running
+  // again straight away, so every ready stream of the same priority gets a
+  // step in turn, and a busy one can't starve the others.
+  typedef struct StreamSchedulerStruct {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_t* threads;
+    SchedulerWorker* workers;
+    SchedulerQueue* queues[SCHEDULER_PRIORITIES_COUNT];
+    int threads_count;
+    // Streams woken from outside the workers are spread over the queues.
+    int next_queue;
+    bool should_stop;
+    stream_scheduler_funcptr func;
+    void* cookie;
+  } StreamScheduler;
+
+  // Returns NULL if none of the worker threads could be started.
+  StreamScheduler* stream_scheduler_alloc(int threads_count,
+    stream_scheduler_funcptr func, void* cookie);
+  // Waits for all the queued work to be done, then stops the workers.
+  void stream_scheduler_free(StreamScheduler* scheduler);
+
+  void scheduler_stream_init(SchedulerStream* stream);
+
+  // Queues the stream for a step if it isn't already waiting for one. If a
+  // step is running it's queued again once that's done.
+  void stream_scheduler_wake(StreamScheduler* scheduler,
+    SchedulerStream* stream);
+
+  // True if the stream is neither queued nor running, so nothing will touch
+  // it until it's woken again.
+  bool stream_scheduler_is_idle(StreamScheduler* scheduler,
+    SchedulerStream* stream);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_STREAM_SCHEDULER_H
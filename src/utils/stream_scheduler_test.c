@@ -0,0 +1,170 @@
+#include "acutest.h"
+
+#include "stream_scheduler.c"
+
+#include <string.h>
+
+typedef struct TestStreamStruct {
+  SchedulerStream scheduler_stream;
+  int index;
+  int work_remaining;
+  int steps_done;
+  bool is_running;
+} TestStream;
+
+typedef struct TestCookieStruct {
+  pthread_mutex_t mutex;
+  pthread_cond_t all_done;
+  int work_remaining;
+  bool overlapped;
+  // The order steps ran in, by stream index.
+  int* step_order;
+  int step_order_length;
+} TestCookie;
+
+static bool test_step(void* cookie, int thread_index,
+  SchedulerStream* stream) {
+  TestCookie* test_cookie = (TestCookie*)(cookie);
+  TestStream* test_stream = (TestStream*)(stream);
+  pthread_mutex_lock(&test_cookie->mutex);
+  if (test_stream->is_running) {
+    test_cookie->overlapped = true;
+  }
+  test_stream->is_running = true;
+  pthread_mutex_unlock(&test_cookie->mutex);
+
+  test_stream->work_remaining -= 1;
+  test_stream->steps_done += 1;
+  const bool has_more = (test_stream->work_remaining > 0);
+
+  pthread_mutex_lock(&test_cookie->mutex);
+  test_stream->is_running = false;
+  test_cookie->step_order[test_cookie->step_order_length] =
+    test_stream->index;
+  test_cookie->step_order_length += 1;
+  test_cookie->work_remaining -= 1;
+  if (test_cookie->work_remaining == 0) {
+    pthread_cond_signal(&test_cookie->all_done);
+  }
+  pthread_mutex_unlock(&test_cookie->mutex);
+  return has_more;
+}
+
+// Runs every stream until it's out of work. The streams are live unless
+// `priorities` is set.
+static void run_streams(int threads_count, int streams_count,
+  int work_per_stream, const SchedulerPriority* priorities,
+  TestCookie* cookie, TestStream* streams) {
+  pthread_mutex_init(&cookie->mutex, NULL);
+  pthread_cond_init(&cookie->all_done, NULL);
+  cookie->work_remaining = streams_count * work_per_stream;
+  cookie->overlapped = false;
+  cookie->step_order = calloc(cookie->work_remaining, sizeof(int));
+  cookie->step_order_length = 0;
+
+  StreamScheduler* scheduler =
+    stream_scheduler_alloc(threads_count, test_step, cookie);
+  TEST_CHECK(scheduler != NULL);
+  // Hold the lock while waking, so with one worker every stream is queued
+  // before the first step runs.
+  pthread_mutex_lock(&scheduler->mutex);
+  for (int i = 0; i < streams_count; ++i) {
+    memset(&streams[i], 0, sizeof(TestStream));
+    scheduler_stream_init(&streams[i].scheduler_stream);
+    streams[i].index = i;
+    streams[i].work_remaining = work_per_stream;
+    if (priorities != NULL) {
+      streams[i].scheduler_stream.priority = priorities[i];
+    }
+    enqueue(scheduler, i % threads_count, &streams[i].scheduler_stream);
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+
+  pthread_mutex_lock(&cookie->mutex);
+  while (cookie->work_remaining > 0) {
+    pthread_cond_wait(&cookie->all_done, &cookie->mutex);
+  }
+  pthread_mutex_unlock(&cookie->mutex);
+  stream_scheduler_free(scheduler);
+}
+
+void test_stream_scheduler_runs_everything() {
+  const int streams_count = 50;
+  const int work_per_stream = 20;
+  TestStream streams[50];
+  TestCookie cookie;
+  run_streams(4, streams_count, work_per_stream, NULL, &cookie, streams);
+  TEST_CHECK(!cookie.overlapped);
+  for (int i = 0; i < streams_count; ++i) {
+    TEST_INTEQ(work_per_stream, streams[i].steps_done);
+    TEST_INTEQ(work_per_stream, (int)(streams[i].scheduler_stream.steps_count));
+    TEST_CHECK(streams[i].scheduler_stream.state == SCHEDULER_STREAM_IDLE);
+    TEST_CHECK(streams[i].scheduler_stream.max_lag_ms >= 0.0);
+  }
+  free(cookie.step_order);
+}
+
+void test_stream_scheduler_takes_turns() {
+  // With one worker, ready streams should each get a step in turn, rather
+  // than one running until it's out of work.
+  const int streams_count = 3;
+  TestStream streams[3];
+  TestCookie cookie;
+  run_streams(1, streams_count, 10, NULL, &cookie, streams);
+  for (int i = 0; i < cookie.step_order_length; ++i) {
+    TEST_INTEQ(i % streams_count, cookie.step_order[i]);
+  }
+  free(cookie.step_order);
+}
+
+void test_stream_scheduler_priorities() {
+  // Batch streams should only get steps once the live one has none left,
+  // even though they were queued first.
+  const SchedulerPriority priorities[] = {
+    SCHEDULER_PRIORITY_BATCH, SCHEDULER_PRIORITY_BATCH,
+    SCHEDULER_PRIORITY_LIVE,
+  };
+  const int expected_order[] = { 2, 2, 2, 0, 1, 0, 1, 0, 1 };
+  TestStream streams[3];
+  TestCookie cookie;
+  run_streams(1, 3, 3, priorities, &cookie, streams);
+  TEST_INTEQ(9, cookie.step_order_length);
+  for (int i = 0; i < cookie.step_order_length; ++i) {
+    TEST_INTEQ(expected_order[i], cookie.step_order[i]);
+  }
+  free(cookie.step_order);
+}
+
+void test_stream_scheduler_wake() {
+  TestCookie cookie;
+  memset(&cookie, 0, sizeof(cookie));
+  pthread_mutex_init(&cookie.mutex, NULL);
+  pthread_cond_init(&cookie.all_done, NULL);
+  cookie.step_order = calloc(4, sizeof(int));
+  cookie.work_remaining = 1;
+  StreamScheduler* scheduler = stream_scheduler_alloc(2, test_step, &cookie);
+
+  TestStream stream;
+  memset(&stream, 0, sizeof(stream));
+  scheduler_stream_init(&stream.scheduler_stream);
+  stream.work_remaining = 1;
+  stream_scheduler_wake(scheduler, &stream.scheduler_stream);
+  pthread_mutex_lock(&cookie.mutex);
+  while (cookie.work_remaining > 0) {
+    pthread_cond_wait(&cookie.all_done, &cookie.mutex);
+  }
+  pthread_mutex_unlock(&cookie.mutex);
+  stream_scheduler_free(scheduler);
+
+  TEST_INTEQ(1, stream.steps_done);
+  TEST_CHECK(stream.scheduler_stream.state == SCHEDULER_STREAM_IDLE);
+  free(cookie.step_order);
+}
+
+TEST_LIST = {
+  {"stream_scheduler_runs_everything", test_stream_scheduler_runs_everything},
+  {"stream_scheduler_takes_turns", test_stream_scheduler_takes_turns},
+  {"stream_scheduler_priorities", test_stream_scheduler_priorities},
+  {"stream_scheduler_wake", test_stream_scheduler_wake},
+  {NULL, NULL},
+};
@@ -118,18 +118,16 @@ char* string_append_in_place(char* a, const char* b) {
 }
 
 char* string_join(const char** list, int list_length, const char* separator) {
-  char* current = string_duplicate("");
+  StringBuilder* builder = string_builder_alloc();
   for (int i = 0; i < list_length; ++i) {
-    char* next = string_append(current, list[i]);
-    free(current);
-    current = next;
+    string_builder_append(builder, list[i]);
     if (i < (list_length - 1)) {
-      char* next = string_append(current, separator);
-      free(current);
-      current = next;
+      string_builder_append(builder, separator);
     }
   }
-  return current;
+  char* result = string_builder_duplicate(builder);
+  string_builder_free(builder);
+  return result;
 }
 
 void string_list_filter(const char** in_list, int in_list_length,
@@ -146,3 +144,69 @@ void string_list_filter(const char** in_list, int in_list_length,
     }
   }
 }
+
+StringBuilder* string_builder_alloc() {
+  StringBuilder* result = calloc(1, sizeof(StringBuilder));
+  result->capacity = 64;
+  result->data = malloc(result->capacity + 1);
+  result->data[0] = 0;
+  result->length = 0;
+  return result;
+}
+
+void string_builder_free(StringBuilder* builder) {
+  if (builder == NULL) {
+    return;
+  }
+  free(builder->data);
+  free(builder);
+}
+
+void string_builder_reserve(StringBuilder* builder, size_t capacity) {
+  if (capacity <= builder->capacity) {
+    return;
+  }
+  size_t new_capacity = builder->capacity;
+  while (new_capacity < capacity) {
+    new_capacity *= 2;
+  }
+  builder->data = realloc(builder->data, new_capacity + 1);
+  builder->capacity = new_capacity;
+}
+
+void string_builder_append(StringBuilder* builder, const char* string) {
+  string_builder_append_span(builder, string, strlen(string));
+}
+
+void string_builder_append_char(StringBuilder* builder, char c) {
+  if (builder->length == builder->capacity) {
+    string_builder_reserve(builder, builder->length + 1);
+  }
+  builder->data[builder->length] = c;
+  builder->length += 1;
+  builder->data[builder->length] = 0;
+}
+
+void string_builder_append_span(StringBuilder* builder, const char* data,
+  size_t length) {
+  string_builder_reserve(builder, builder->length + length);
+  memcpy(builder->data + builder->length, data, length);
+  builder->length += length;
+  builder->data[builder->length] = 0;
+}
+
+void string_builder_truncate(StringBuilder* builder, size_t length) {
+  assert(length <= builder->length);
+  builder->length = length;
+  builder->data[builder->length] = 0;
+}
+
+void string_builder_reset(StringBuilder* builder) {
+  string_builder_truncate(builder, 0);
+}
+
+char* string_builder_duplicate(const StringBuilder* builder) {
+  char* result = malloc(builder->length + 1);
+  memcpy(result, builder->data, builder->length + 1);
+  return result;
+}
@@ -2,6 +2,7 @@
 #define INCLUDE_UTIL_STRING_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __CPLUSPLUS
 extern "C" {
@@ -45,6 +46,40 @@ extern "C" {
     string_list_filter_funcptr should_keep_func, void* cookie, char*** out_list,
     int* out_list_length);
 
+  // Builds up a string piece by piece. The buffer grows geometrically, so
+  // appending is cheap no matter how long the string gets, unlike calling
+  // string_append_in_place() repeatedly, which copies the whole string each
+  // time. `data` is always zero-terminated.
+  typedef struct StringBuilderStruct {
+    char* data;
+    size_t length;
+    // Room for this many characters, not counting the terminating zero.
+    size_t capacity;
+  } StringBuilder;
+
+  StringBuilder* string_builder_alloc();
+  void string_builder_free(StringBuilder* builder);
+
+  // Makes sure there's room for at least `capacity` characters without any
+  // more allocations.
+  void string_builder_reserve(StringBuilder* builder, size_t capacity);
+
+  void string_builder_append(StringBuilder* builder, const char* string);
+  void string_builder_append_char(StringBuilder* builder, char c);
+  // Appends `length` characters from `data`, which doesn't need to be
+  // zero-terminated.
+  void string_builder_append_span(StringBuilder* builder, const char* data,
+    size_t length);
+
+  // Shortens the string to `length` characters.
+  void string_builder_truncate(StringBuilder* builder, size_t length);
+
+  // Empties the string, but keeps the memory around for reuse.
+  void string_builder_reset(StringBuilder* builder);
+
+  // Returns a copy of the current string. Caller must free the result.
+  char* string_builder_duplicate(const StringBuilder* builder);
+
 #ifdef __CPLUSPLUS
 }
 #endif  // __CPLUSPLUS
@@ -2,6 +2,8 @@
 
 #include "string_utils.c"
 
+#include "time_utils.h"
+
 void test_string_starts_with() {
 
   const char* string = "foo.txt";
@@ -239,6 +241,77 @@ void test_string_list_add() {
   string_list_free(list, list_length);
 }
 
+void test_string_builder() {
+  StringBuilder* builder = string_builder_alloc();
+  TEST_STREQ("", builder->data);
+  TEST_INTEQ(0, (int)(builder->length));
+
+  string_builder_append(builder, "Hello");
+  string_builder_append_char(builder, ',');
+  string_builder_append_span(builder, " World!!!", 6);
+  TEST_STREQ("Hello, World", builder->data);
+  TEST_INTEQ(12, (int)(builder->length));
+
+  string_builder_truncate(builder, 5);
+  TEST_STREQ("Hello", builder->data);
+
+  char* copy = string_builder_duplicate(builder);
+  TEST_STREQ("Hello", copy);
+  free(copy);
+
+  // Growing past the initial capacity should keep the contents.
+  for (int i = 0; i < 1000; ++i) {
+    string_builder_append_char(builder, 'a' + (i % 26));
+  }
+  TEST_INTEQ(1005, (int)(builder->length));
+  TEST_CHECK(builder->capacity >= 1005);
+  TEST_CHECK(strncmp(builder->data, "Helloabc", 8) == 0);
+  TEST_CHECK(builder->data[1005] == 0);
+
+  // Resetting shouldn't give back the memory.
+  const size_t capacity = builder->capacity;
+  string_builder_reset(builder);
+  TEST_STREQ("", builder->data);
+  TEST_INTEQ((int)(capacity), (int)(builder->capacity));
+
+  string_builder_reserve(builder, 100000);
+  TEST_CHECK(builder->capacity >= 100000);
+
+  string_builder_free(builder);
+}
+
+// Compares building up a long transcript token by token with the string
+// builder against string_append_in_place(). Not a pass/fail test, but the
+// numbers are printed to help spot regressions.
+void test_string_builder_benchmark() {
+  const char* tokens[] = { "t", "h", "e", " ", "c", "a", "t", " " };
+  const int tokens_length = sizeof(tokens) / sizeof(tokens[0]);
+  const int iterations = 20000;
+
+  const double builder_start = time_now_ms();
+  StringBuilder* builder = string_builder_alloc();
+  for (int i = 0; i < iterations; ++i) {
+    string_builder_append(builder, tokens[i % tokens_length]);
+  }
+  const double builder_ms = time_now_ms() - builder_start;
+
+  const double in_place_start = time_now_ms();
+  char* in_place = string_duplicate("");
+  for (int i = 0; i < iterations; ++i) {
+    in_place = string_append_in_place(in_place, tokens[i % tokens_length]);
+  }
+  const double in_place_ms = time_now_ms() - in_place_start;
+
+  TEST_STREQ(in_place, builder->data);
+  printf("\n%d appends: string builder %.2fms (%.1f MB/s), "
+    "string_append_in_place %.2fms (%.1f MB/s)\n", iterations, builder_ms,
+    (builder->length / 1000.0) / (builder_ms + 0.0001), in_place_ms,
+    (builder->length / 1000.0) / (in_place_ms + 0.0001));
+
+  free(in_place);
+  string_builder_free(builder);
+}
+
 TEST_LIST = {
   {"string_starts_with", test_string_starts_with},
   {"string_ends_with", test_string_ends_with},
@@ -250,5 +323,7 @@ TEST_LIST = {
   {"string_join", test_string_join},
   {"string_list_filter", test_string_list_filter},
   {"string_list_add", test_string_list_add},
+  {"string_builder", test_string_builder},
+  {"string_builder_benchmark", test_string_builder_benchmark},
   {NULL, NULL},
 };
\ No newline at end of file
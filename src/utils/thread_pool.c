@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+typedef struct ThreadPoolStateStruct {
+  pthread_mutex_t mutex;
+  int next_item;
+  int item_count;
+  bool failed;
+  thread_pool_funcptr func;
+  void* cookie;
+} ThreadPoolState;
+
+typedef struct ThreadPoolWorkerStruct {
+  ThreadPoolState* state;
+  int thread_index;
+} ThreadPoolWorker;
+
+static bool claim_next_item(ThreadPoolState* state, int* item_index) {
+  pthread_mutex_lock(&state->mutex);
+  const bool has_item = (!state->failed) &&
+    (state->next_item < state->item_count);
+  if (has_item) {
+    *item_index = state->next_item;
+    state->next_item += 1;
+  }
+  pthread_mutex_unlock(&state->mutex);
+  return has_item;
+}
+
+static void* worker_main(void* arg) {
+  ThreadPoolWorker* worker = (ThreadPoolWorker*)(arg);
+  ThreadPoolState* state = worker->state;
+  int item_index;
+  while (claim_next_item(state, &item_index)) {
+    if (!state->func(state->cookie, worker->thread_index, item_index)) {
+      pthread_mutex_lock(&state->mutex);
+      state->failed = true;
+      pthread_mutex_unlock(&state->mutex);
+    }
+  }
+  return NULL;
+}
+
+bool thread_pool_run(int thread_count, int item_count,
+  thread_pool_funcptr func, void* cookie) {
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+  if (thread_count > item_count) {
+    thread_count = item_count;
+  }
+
+  ThreadPoolState state;
+  pthread_mutex_init(&state.mutex, NULL);
+  state.next_item = 0;
+  state.item_count = item_count;
+  state.failed = false;
+  state.func = func;
+  state.cookie = cookie;
+
+  // With a single worker there's no point paying for a thread, so run on the
+  // caller's stack. This also keeps the default behavior easy to debug.
+  if (thread_count <= 1) {
+    ThreadPoolWorker worker = { &state, 0 };
+    worker_main(&worker);
+    pthread_mutex_destroy(&state.mutex);
+    return !state.failed;
+  }
+
+  pthread_t* threads = calloc(thread_count, sizeof(pthread_t));
+  ThreadPoolWorker* workers = calloc(thread_count, sizeof(ThreadPoolWorker));
+  int started_count = 0;
+  for (int i = 0; i < thread_count; ++i) {
+    workers[i].state = &state;
+    workers[i].thread_index = i;
+    if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+      fprintf(stderr, "Unable to start worker thread #%d.\n", i);
+      break;
+    }
+    started_count += 1;
+  }
+  // If no threads could be started at all, do the work ourselves.
+  if (started_count == 0) {
+    workers[0].thread_index = 0;
+    worker_main(&workers[0]);
+  }
+  for (int i = 0; i < started_count; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(workers);
+  free(threads);
+  pthread_mutex_destroy(&state.mutex);
+  return !state.failed;
+}
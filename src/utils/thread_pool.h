@@ -0,0 +1,27 @@
+#ifndef INCLUDE_UTIL_THREAD_POOL_H
+#define INCLUDE_UTIL_THREAD_POOL_H
+
+#include <stdbool.h>
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // Called once for every item. The `thread_index` is stable for the lifetime
+  // of a worker, so it can be used to look up per-thread state, like a model.
+  // Returning false stops any further items from being handed out.
+  typedef bool (*thread_pool_funcptr)(void* cookie, int thread_index,
+    int item_index);
+
+  // Runs `item_count` items across `thread_count` worker threads, with each
+  // worker pulling the next unclaimed item index from a shared counter. Items
+  // are started in ascending order, but may finish in any order. Returns false
+  // if any call to the callback failed.
+  bool thread_pool_run(int thread_count, int item_count,
+    thread_pool_funcptr func, void* cookie);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_THREAD_POOL_H
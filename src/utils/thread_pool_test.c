@@ -0,0 +1,76 @@
+#include "acutest.h"
+
+#include "thread_pool.c"
+
+#include <string.h>
+
+typedef struct TestCookieStruct {
+  pthread_mutex_t mutex;
+  int* visit_counts;
+  int* thread_indexes;
+  int fail_at;
+} TestCookie;
+
+static bool test_func(void* cookie, int thread_index, int item_index) {
+  TestCookie* test_cookie = (TestCookie*)(cookie);
+  pthread_mutex_lock(&test_cookie->mutex);
+  test_cookie->visit_counts[item_index] += 1;
+  test_cookie->thread_indexes[item_index] = thread_index;
+  pthread_mutex_unlock(&test_cookie->mutex);
+  return (item_index != test_cookie->fail_at);
+}
+
+static void run_and_check(int thread_count, int item_count) {
+  TestCookie cookie;
+  pthread_mutex_init(&cookie.mutex, NULL);
+  cookie.visit_counts = calloc(item_count, sizeof(int));
+  cookie.thread_indexes = calloc(item_count, sizeof(int));
+  cookie.fail_at = -1;
+
+  TEST_CHECK(thread_pool_run(thread_count, item_count, test_func, &cookie));
+  for (int i = 0; i < item_count; ++i) {
+    TEST_INTEQ(1, cookie.visit_counts[i]);
+    TEST_MSG("Item %d with %d threads", i, thread_count);
+    TEST_CHECK(cookie.thread_indexes[i] >= 0);
+    TEST_CHECK(cookie.thread_indexes[i] < thread_count);
+  }
+
+  free(cookie.visit_counts);
+  free(cookie.thread_indexes);
+  pthread_mutex_destroy(&cookie.mutex);
+}
+
+void test_thread_pool_run() {
+  run_and_check(1, 10);
+  run_and_check(4, 100);
+  run_and_check(8, 3);
+  run_and_check(4, 0);
+}
+
+void test_thread_pool_run_failure() {
+  const int item_count = 1000;
+  TestCookie cookie;
+  pthread_mutex_init(&cookie.mutex, NULL);
+  cookie.visit_counts = calloc(item_count, sizeof(int));
+  cookie.thread_indexes = calloc(item_count, sizeof(int));
+  cookie.fail_at = 10;
+
+  TEST_CHECK(!thread_pool_run(1, item_count, test_func, &cookie));
+  // With one thread, nothing after the failing item should be started.
+  TEST_INTEQ(1, cookie.visit_counts[10]);
+  TEST_INTEQ(0, cookie.visit_counts[11]);
+
+  memset(cookie.visit_counts, 0, item_count * sizeof(int));
+  TEST_CHECK(!thread_pool_run(4, item_count, test_func, &cookie));
+  TEST_INTEQ(1, cookie.visit_counts[10]);
+
+  free(cookie.visit_counts);
+  free(cookie.thread_indexes);
+  pthread_mutex_destroy(&cookie.mutex);
+}
+
+TEST_LIST = {
+  {"thread_pool_run", test_thread_pool_run},
+  {"thread_pool_run_failure", test_thread_pool_run_failure},
+  {NULL, NULL},
+};
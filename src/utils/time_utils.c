@@ -0,0 +1,9 @@
+#include "time_utils.h"
+
+#include <time.h>
+
+double time_now_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0);
+}
@@ -0,0 +1,16 @@
+#ifndef INCLUDE_UTIL_TIME_UTILS_H
+#define INCLUDE_UTIL_TIME_UTILS_H
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // Milliseconds from an arbitrary starting point, from a clock that never
+  // goes backwards. Only useful for measuring intervals.
+  double time_now_ms();
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_UTIL_TIME_UTILS_H
@@ -0,0 +1,19 @@
+#include "acutest.h"
+
+#include "time_utils.c"
+
+#include <unistd.h>
+
+void test_time_now_ms() {
+  const double start = time_now_ms();
+  usleep(20000);
+  const double end = time_now_ms();
+  TEST_CHECK((end - start) >= 19.0);
+  TEST_MSG("%f", end - start);
+  TEST_CHECK((end - start) < 5000.0);
+}
+
+TEST_LIST = {
+  {"time_now_ms", test_time_now_ms},
+  {NULL, NULL},
+};
@@ -421,70 +421,91 @@ void yargs_free() {
   unnamed_args_length = 0;
 }
 
-void yargs_print_usage(const YargsFlag* flags, int flags_length,
-  const char* app_description) {
-  text_bold(stderr);
-  fprintf(stderr, "Usage");
-  reset_colors(stderr);
-  text_red(stderr);
-  fprintf(stderr, ": %s ", app_name);
-  reset_colors(stderr);
+// Adds a terminal color code to the usage text, if the terminal shows them.
+static void AppendColor(StringBuilder* usage, bool has_color,
+  const char* code) {
+  if (has_color) {
+    string_builder_append(usage, code);
+  }
+}
+
+static void AppendFlagNames(StringBuilder* usage, bool has_color,
+  const YargsFlag* flag) {
+  AppendColor(usage, has_color, ANSI_CODE_GREEN);
+  string_builder_append(usage, "--");
+  string_builder_append(usage, flag->name);
+  AppendColor(usage, has_color, ANSI_CODE_RESET);
+  if (flag->short_name != NULL) {
+    string_builder_append_char(usage, '/');
+    AppendColor(usage, has_color, ANSI_CODE_GREEN);
+    string_builder_append_char(usage, '-');
+    string_builder_append(usage, flag->short_name);
+    AppendColor(usage, has_color, ANSI_CODE_RESET);
+  }
+}
+
+// Builds the whole usage text, so it can be written out in one go.
+static void AppendUsage(StringBuilder* usage, bool has_color,
+  const YargsFlag* flags, int flags_length, const char* app_description) {
+  AppendColor(usage, has_color, ANSI_CODE_BOLD);
+  string_builder_append(usage, "Usage");
+  AppendColor(usage, has_color, ANSI_CODE_RESET);
+  AppendColor(usage, has_color, ANSI_CODE_RED);
+  string_builder_append(usage, ": ");
+  string_builder_append(usage, app_name);
+  string_builder_append_char(usage, ' ');
+  AppendColor(usage, has_color, ANSI_CODE_RESET);
   for (int i = 0; i < flags_length; ++i) {
     const YargsFlag* flag = &flags[i];
-    text_green(stderr);
-    fprintf(stderr, "--%s", flag->name);
-    reset_colors(stderr);
-    if (flag->short_name != NULL) {
-      fprintf(stderr, "/");
-      text_green(stderr);
-      fprintf(stderr, "-%s", flag->short_name);
-      reset_colors(stderr);
-    }
-    fprintf(stderr, " ");
+    AppendFlagNames(usage, has_color, flag);
+    string_builder_append_char(usage, ' ');
     switch (flag->type) {
     case FT_BOOL: {
       // Do nothing.
     } break;
     case FT_FLOAT: {
-      fprintf(stderr, "<float> ");
+      string_builder_append(usage, "<float> ");
     } break;
     case FT_INT32: {
-      fprintf(stderr, "<integer> ");
+      string_builder_append(usage, "<integer> ");
     } break;
     case FT_STRING: {
-      fprintf(stderr, "<string> ");
+      string_builder_append(usage, "<string> ");
     } break;
     default: {
       assert(false);
     } break;
     }
   }
-  fprintf(stderr, "\n");
+  string_builder_append_char(usage, '\n');
   if (app_description != NULL) {
-    text_bold(stderr);
-    fprintf(stderr, "%s\n", app_description);
-    reset_colors(stderr);
+    AppendColor(usage, has_color, ANSI_CODE_BOLD);
+    string_builder_append(usage, app_description);
+    string_builder_append_char(usage, '\n');
+    AppendColor(usage, has_color, ANSI_CODE_RESET);
   }
   for (int i = 0; i < flags_length; ++i) {
     const YargsFlag* flag = &flags[i];
-    text_green(stderr);
-    fprintf(stderr, "--%s", flag->name);
-    reset_colors(stderr);
-    if (flag->short_name != NULL) {
-      fprintf(stderr, "/");
-      text_green(stderr);
-      fprintf(stderr, "-%s", flag->short_name);
-      reset_colors(stderr);
-    }
-    fprintf(stderr, "\t");
+    AppendFlagNames(usage, has_color, flag);
+    string_builder_append_char(usage, '\t');
     if (flag->description != NULL) {
-      text_cyan(stderr);
-      fprintf(stderr, "%s\n", flag->description);
-      reset_colors(stderr);
+      AppendColor(usage, has_color, ANSI_CODE_CYAN);
+      string_builder_append(usage, flag->description);
+      string_builder_append_char(usage, '\n');
+      AppendColor(usage, has_color, ANSI_CODE_RESET);
     }
   }
 }
 
+void yargs_print_usage(const YargsFlag* flags, int flags_length,
+  const char* app_description) {
+  StringBuilder* usage = string_builder_alloc();
+  AppendUsage(usage, supports_color(stderr), flags, flags_length,
+    app_description);
+  fputs(usage->data, stderr);
+  string_builder_free(usage);
+}
+
 bool yargs_load_from_file(const YargsFlag* flags, int flags_length,
   const char* filename) {
   FILE* file = fopen(filename, "r");
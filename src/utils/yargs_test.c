@@ -521,6 +521,38 @@ static void test_yargs_app_name() {
   TEST_STREQ("program", yargs_app_name());
 }
 
+void test_AppendUsage() {
+  const char* some_name = "some_value";
+  int32_t no_short_name = 10;
+  YargsFlag test_flags[] = {
+    YARGS_STRING("some_name", "a", &some_name, "Some name."),
+    YARGS_INT32("no_short_name", NULL, &no_short_name, "No short name."),
+  };
+  const int test_flags_length = sizeof(test_flags) / sizeof(test_flags[0]);
+  char* argv[] = { "program" };
+  const int argc = sizeof(argv) / sizeof(argv[0]);
+  TEST_CHECK(yargs_init(test_flags, test_flags_length, NULL, argv, argc));
+
+  StringBuilder* usage = string_builder_alloc();
+  AppendUsage(usage, false, test_flags, test_flags_length, "Does things.");
+  TEST_STREQ("Usage: program --some_name/-a <string> "
+    "--no_short_name <integer> \n"
+    "Does things.\n"
+    "--some_name/-a\tSome name.\n"
+    "--no_short_name\tNo short name.\n", usage->data);
+
+  string_builder_reset(usage);
+  AppendUsage(usage, true, test_flags, 1, NULL);
+  TEST_STREQ(ANSI_CODE_BOLD "Usage" ANSI_CODE_RESET ANSI_CODE_RED
+    ": program " ANSI_CODE_RESET ANSI_CODE_GREEN "--some_name" ANSI_CODE_RESET
+    "/" ANSI_CODE_GREEN "-a" ANSI_CODE_RESET " <string> \n"
+    ANSI_CODE_GREEN "--some_name" ANSI_CODE_RESET "/" ANSI_CODE_GREEN "-a"
+    ANSI_CODE_RESET "\t" ANSI_CODE_CYAN "Some name.\n" ANSI_CODE_RESET,
+    usage->data);
+  string_builder_free(usage);
+  yargs_free();
+}
+
 TEST_LIST = {
   {"GetFlagWithName", test_GetFlagWithName},
   {"GetFlagWithShortName", test_GetFlagWithShortName},
@@ -533,5 +565,6 @@ TEST_LIST = {
   {"yargs_load_from_file", test_yargs_load_from_file},
   {"yargs_save_to_file", test_yargs_save_to_file},
   {"yargs_app_name", test_yargs_app_name},
+  {"AppendUsage", test_AppendUsage},
   {NULL, NULL},
 };
\ No newline at end of file
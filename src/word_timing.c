@@ -0,0 +1,136 @@
+#include "word_timing.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool is_token_hidden(const TokenMetadata* token,
+  const TranscriptTiming* timing) {
+  return (timing != NULL) && (token->start_time < timing->hidden_before);
+}
+
+static bool is_token_space(const TokenMetadata* token) {
+  return (strcmp(token->text, " ") == 0);
+}
+
+bool word_timing_next(const CandidateTranscript* transcript,
+  const TranscriptTiming* timing, unsigned int* index, WordTiming* word) {
+  const TokenMetadata* tokens = transcript->tokens;
+  const unsigned int tokens_length = transcript->num_tokens;
+  unsigned int i = *index;
+  while ((i < tokens_length) &&
+    (is_token_hidden(&tokens[i], timing) || is_token_space(&tokens[i]))) {
+    ++i;
+  }
+  if (i >= tokens_length) {
+    *index = i;
+    return false;
+  }
+
+  word->first_token = i;
+  word->start_time = transcript_session_time(tokens[i].start_time, timing);
+  float last_time = word->start_time;
+  ++i;
+  while ((i < tokens_length) && !is_token_space(&tokens[i])) {
+    last_time = transcript_session_time(tokens[i].start_time, timing);
+    ++i;
+  }
+  word->tokens_length = i - word->first_token;
+  word->end_time = last_time;
+  if (i < tokens_length) {
+    const float next_time =
+      transcript_session_time(tokens[i].start_time, timing);
+    if ((next_time - last_time) <= TRANSCRIPT_LINE_GAP) {
+      word->end_time = next_time;
+    }
+  }
+  *index = i;
+  return true;
+}
+
+void word_timing_append_text(const CandidateTranscript* transcript,
+  const WordTiming* word, StringBuilder* output) {
+  const unsigned int end = word->first_token + word->tokens_length;
+  for (unsigned int i = word->first_token; i < end; ++i) {
+    string_builder_append(output, transcript->tokens[i].text);
+  }
+}
+
+WordTimingWriter* word_timing_writer_alloc(FILE* file) {
+  WordTimingWriter* result = calloc(1, sizeof(WordTimingWriter));
+  result->file = file;
+  result->text = string_builder_alloc();
+  result->next_token = 0;
+  return result;
+}
+
+void word_timing_writer_free(WordTimingWriter* writer) {
+  if (writer == NULL) {
+    return;
+  }
+  string_builder_free(writer->text);
+  free(writer);
+}
+
+static void append_word(WordTimingWriter* writer,
+  const CandidateTranscript* transcript, const WordTiming* word) {
+  char times[64];
+  snprintf(times, sizeof(times), "%.2f\t%.2f\t", word->start_time,
+    word->end_time);
+  string_builder_append(writer->text, times);
+  word_timing_append_text(transcript, word, writer->text);
+  string_builder_append_char(writer->text, '\n');
+}
+
+// Finds the first token of the last line in the transcript, only looking at
+// the tokens from `start` onwards, since the ones before are already settled.
+static unsigned int find_settled_end(const CandidateTranscript* transcript,
+  const TranscriptTiming* timing, unsigned int start) {
+  unsigned int result = start;
+  float previous_time = -INFINITY;
+  if ((start > 0) && (start <= transcript->num_tokens)) {
+    previous_time = transcript_session_time(
+      transcript->tokens[start - 1].start_time, timing);
+  }
+  for (unsigned int i = start; i < transcript->num_tokens; ++i) {
+    const TokenMetadata* token = &transcript->tokens[i];
+    if (is_token_hidden(token, timing)) {
+      continue;
+    }
+    const float session_time =
+      transcript_session_time(token->start_time, timing);
+    if ((session_time - previous_time) > TRANSCRIPT_LINE_GAP) {
+      result = i;
+    }
+    previous_time = session_time;
+  }
+  return result;
+}
+
+void word_timing_writer_update(WordTimingWriter* writer,
+  const CandidateTranscript* transcript, const TranscriptTiming* timing,
+  bool is_final) {
+  const unsigned int settled_end = is_final ? transcript->num_tokens :
+    find_settled_end(transcript, timing, writer->next_token);
+
+  unsigned int index = writer->next_token;
+  WordTiming word;
+  while (true) {
+    const unsigned int word_search_start = index;
+    if (!word_timing_next(transcript, timing, &index, &word)) {
+      break;
+    }
+    if ((word.first_token + word.tokens_length) > settled_end) {
+      index = word_search_start;
+      break;
+    }
+    append_word(writer, transcript, &word);
+  }
+  writer->next_token = is_final ? 0 : index;
+
+  if ((writer->file != NULL) && (writer->text->length > 0)) {
+    fputs(writer->text->data, writer->file);
+    fflush(writer->file);
+    string_builder_reset(writer->text);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef INCLUDE_WORD_TIMING_H
+#define INCLUDE_WORD_TIMING_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "coqui-stt.h"
+
+#include "string_utils.h"
+#include "transcript_renderer.h"
+
+#ifdef __CPLUSPLUS
+extern "C" {
+#endif  // __CPLUSPLUS
+
+  // One word from a transcript. The text isn't copied anywhere, it's the
+  // `tokens_length` tokens starting at `first_token`.
+  typedef struct WordTimingStruct {
+    unsigned int first_token;
+    unsigned int tokens_length;
+    // Session times in seconds. A word ends when the token after it starts,
+    // unless that's after a long pause, in which case it ends when its own
+    // last token starts.
+    float start_time;
+    float end_time;
+  } WordTiming;
+
+  // Finds the first word that starts at or after token `*index`, and moves
+  // `*index` on to the token after it, so calling this repeatedly walks
+  // through all the words without allocating anything. Tokens hidden by
+  // `timing` are skipped, and `timing` can be NULL. Returns false if there
+  // are no more words.
+  bool word_timing_next(const CandidateTranscript* transcript,
+    const TranscriptTiming* timing, unsigned int* index, WordTiming* word);
+
+  void word_timing_append_text(const CandidateTranscript* transcript,
+    const WordTiming* word, StringBuilder* output);
+
+  // Writes words as tab-separated lines of start time, end time, and text,
+  // as soon as they can't change any more. Like lines of text, everything
+  // before the last long pause in a transcript is treated as settled, and
+  // where that pause was is remembered so later updates only have to look
+  // at the tokens after it.
+  typedef struct WordTimingWriterStruct {
+    // If this is NULL, lines are kept in `text` until the caller takes them.
+    FILE* file;
+    StringBuilder* text;
+    // Tokens before this one in the current stream have been written.
+    unsigned int next_token;
+  } WordTimingWriter;
+
+  WordTimingWriter* word_timing_writer_alloc(FILE* file);
+  void word_timing_writer_free(WordTimingWriter* writer);
+
+  // Takes the latest transcript for the current stream. If `is_final` is
+  // set the stream is over, so all of its words are written, and the next
+  // update is expected to come from a new stream.
+  void word_timing_writer_update(WordTimingWriter* writer,
+    const CandidateTranscript* transcript, const TranscriptTiming* timing,
+    bool is_final);
+
+#ifdef __CPLUSPLUS
+}
+#endif  // __CPLUSPLUS
+
+#endif  // INCLUDE_WORD_TIMING_H
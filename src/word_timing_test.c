@@ -0,0 +1,105 @@
+#include "acutest.h"
+
+#include "word_timing.c"
+
+void test_word_timing_next() {
+  TokenMetadata tokens[] = {
+    {" ", 20, 0.4f},
+    {"h", 25, 0.5f},
+    {"i", 30, 0.6f},
+    {" ", 35, 0.7f},
+    {"y", 40, 0.8f},
+    {"o", 45, 0.9f},
+    {"u", 50, 1.0f},
+    {" ", 150, 3.0f},
+    {"o", 155, 3.1f},
+    {"k", 160, 3.2f},
+  };
+  CandidateTranscript transcript = {
+    tokens, sizeof(tokens) / sizeof(tokens[0]), -1.0,
+  };
+  unsigned int index = 0;
+  WordTiming word;
+  StringBuilder* text = string_builder_alloc();
+
+  TEST_CHECK(word_timing_next(&transcript, NULL, &index, &word));
+  TEST_INTEQ(1, (int)(word.first_token));
+  TEST_INTEQ(2, (int)(word.tokens_length));
+  TEST_CHECK(fabsf(word.start_time - 0.5f) < 0.001f);
+  TEST_CHECK(fabsf(word.end_time - 0.7f) < 0.001f);
+  word_timing_append_text(&transcript, &word, text);
+  TEST_STREQ("hi", text->data);
+
+  // The space after "you" only comes after a long pause, so the word ends
+  // when its last letter starts.
+  TEST_CHECK(word_timing_next(&transcript, NULL, &index, &word));
+  TEST_INTEQ(4, (int)(word.first_token));
+  TEST_CHECK(fabsf(word.start_time - 0.8f) < 0.001f);
+  TEST_CHECK(fabsf(word.end_time - 1.0f) < 0.001f);
+
+  TEST_CHECK(word_timing_next(&transcript, NULL, &index, &word));
+  TEST_INTEQ(8, (int)(word.first_token));
+  TEST_CHECK(fabsf(word.end_time - 3.2f) < 0.001f);
+
+  TEST_CHECK(!word_timing_next(&transcript, NULL, &index, &word));
+  string_builder_free(text);
+}
+
+void test_word_timing_writer() {
+  TokenMetadata tokens[] = {
+    {"h", 5, 0.1f},
+    {"i", 10, 0.2f},
+    {" ", 15, 0.3f},
+    {"y", 150, 3.0f},
+    {"o", 155, 3.1f},
+    {"u", 160, 3.2f},
+  };
+  WordTimingWriter* writer = word_timing_writer_alloc(NULL);
+
+  // Nothing is settled until a pause follows the words.
+  const CandidateTranscript partial = { tokens, 2, -1.0 };
+  word_timing_writer_update(writer, &partial, NULL, false);
+  TEST_STREQ("", writer->text->data);
+
+  const CandidateTranscript paused = { tokens, 4, -1.0 };
+  word_timing_writer_update(writer, &paused, NULL, false);
+  TEST_STREQ("0.10\t0.30\thi\n", writer->text->data);
+  TEST_INTEQ(2, (int)(writer->next_token));
+
+  // The same transcript again doesn't add anything new.
+  word_timing_writer_update(writer, &paused, NULL, false);
+  TEST_STREQ("0.10\t0.30\thi\n", writer->text->data);
+
+  const CandidateTranscript final = { tokens, 6, -1.0 };
+  word_timing_writer_update(writer, &final, NULL, true);
+  TEST_STREQ("0.10\t0.30\thi\n3.00\t3.20\tyou\n", writer->text->data);
+  TEST_INTEQ(0, (int)(writer->next_token));
+  word_timing_writer_free(writer);
+}
+
+void test_word_timing_writer_timing() {
+  // A second live stream that took over from the first one, which already
+  // wrote "ok".
+  TokenMetadata tokens[] = {
+    {"o", 10, 0.2f},
+    {"k", 15, 0.3f},
+    {" ", 20, 0.4f},
+    {"g", 25, 0.5f},
+    {"o", 30, 0.6f},
+  };
+  const CandidateTranscript transcript = {
+    tokens, sizeof(tokens) / sizeof(tokens[0]), -1.0,
+  };
+  TranscriptTiming timing = { 10.0f, 0.35f, NULL };
+  WordTimingWriter* writer = word_timing_writer_alloc(NULL);
+  word_timing_writer_update(writer, &transcript, &timing, true);
+  TEST_STREQ("10.50\t10.60\tgo\n", writer->text->data);
+  word_timing_writer_free(writer);
+}
+
+TEST_LIST = {
+  {"word_timing_next", test_word_timing_next},
+  {"word_timing_writer", test_word_timing_writer},
+  {"word_timing_writer_timing", test_word_timing_writer_timing},
+  {NULL, NULL},
+};